@@ -4,6 +4,7 @@
 
 #include "application/application_instance.h"
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <iostream>
@@ -45,6 +46,40 @@ void SetJSCallbackId(picojson::value& msg, double id) {
 
 ApplicationInstance::ApplicationInstance(ApplicationExtension* extension)
     : extension_(extension) {
+  using std::placeholders::_1;
+
+#define REGISTER_ASYNC(c, x) \
+  RegisterHandler(c, std::bind(&ApplicationInstance::x, this, _1));
+#define REGISTER_SYNC(c, x) \
+  RegisterSyncHandler(c, std::bind(&ApplicationInstance::x, this, _1));
+#define REGISTER_SYNC_NO_ARGS(c, x) \
+  RegisterSyncHandler(c, std::bind(&ApplicationInstance::x, this));
+
+  REGISTER_ASYNC("GetAppsInfo", HandleGetAppsInfo);
+  REGISTER_ASYNC("GetAppsContext", HandleGetAppsContext);
+  REGISTER_ASYNC("KillApp", HandleKillApp);
+  REGISTER_ASYNC("LaunchApp", HandleLaunchApp);
+  REGISTER_ASYNC("LaunchAppControl", HandleLaunchAppControl);
+  REGISTER_ASYNC("FindAppControl", HandleFindAppControl);
+
+  // Sync handlers send their reply themselves.
+  REGISTER_SYNC("GetAppInfo", HandleGetAppInfo);
+  REGISTER_SYNC("GetAppContext", HandleGetAppContext);
+  REGISTER_SYNC_NO_ARGS("GetCurrentApp", HandleGetCurrentApp);
+  REGISTER_SYNC_NO_ARGS("ExitCurrentApp", HandleExitCurrentApp);
+  REGISTER_SYNC_NO_ARGS("HideCurrentApp", HandleHideCurrentApp);
+  REGISTER_SYNC_NO_ARGS("RegisterAppInfoEvent", HandleRegisterAppInfoEvent);
+  REGISTER_SYNC_NO_ARGS("UnregisterAppInfoEvent",
+                        HandleUnregisterAppInfoEvent);
+  REGISTER_SYNC("GetAppMetaData", HandleGetAppMetaData);
+  REGISTER_SYNC("ReplyResult", HandleReplyResult);
+  REGISTER_SYNC_NO_ARGS("ReplyFailure", HandleReplyFailure);
+  REGISTER_SYNC_NO_ARGS("GetRequestedAppControl",
+                        HandleGetRequestedAppControl);
+
+#undef REGISTER_ASYNC
+#undef REGISTER_SYNC
+#undef REGISTER_SYNC_NO_ARGS
 }
 
 ApplicationInstance::~ApplicationInstance() {
@@ -53,72 +88,6 @@ ApplicationInstance::~ApplicationInstance() {
     manager->UnregisterAppInfoEvent(this);
 }
 
-void ApplicationInstance::HandleMessage(const char* msg) {
-  picojson::value v;
-
-  std::string err;
-  picojson::parse(v, msg, msg + strlen(msg), &err);
-  if (!err.empty()) {
-    std::cout << "Ignoring message.\n";
-    return;
-  }
-
-  std::string cmd = v.get("cmd").to_str();
-  if (cmd == "GetAppsInfo") {
-    HandleGetAppsInfo(v);
-  } else if (cmd == "GetAppsContext") {
-    HandleGetAppsContext(v);
-  } else if (cmd == "KillApp") {
-    HandleKillApp(v);
-  } else if (cmd == "LaunchApp") {
-    HandleLaunchApp(v);
-  } else if (cmd == "LaunchAppControl") {
-    HandleLaunchAppControl(v);
-  } else if (cmd == "FindAppControl") {
-    HandleFindAppControl(v);
-  } else {
-    std::cout << "ASSERT NOT REACHED. UNKNOWN COMMAND: " << cmd << std::endl;
-  }
-}
-
-void ApplicationInstance::HandleSyncMessage(const char* msg) {
-  picojson::value v;
-  std::string err;
-
-  picojson::parse(v, msg, msg + strlen(msg), &err);
-  if (!err.empty()) {
-    std::cout << "Ignoring message.\n";
-    return;
-  }
-
-  std::string cmd = v.get("cmd").to_str();
-  if (cmd == "GetAppInfo") {
-    HandleGetAppInfo(v);
-  } else if (cmd == "GetAppContext") {
-    HandleGetAppContext(v);
-  } else if (cmd == "GetCurrentApp") {
-    HandleGetCurrentApp();
-  } else if (cmd == "ExitCurrentApp") {
-    HandleExitCurrentApp();
-  } else if (cmd == "HideCurrentApp") {
-    HandleHideCurrentApp();
-  } else if (cmd == "RegisterAppInfoEvent") {
-    HandleRegisterAppInfoEvent();
-  } else if (cmd == "UnregisterAppInfoEvent") {
-    HandleUnregisterAppInfoEvent();
-  } else if (cmd == "GetAppMetaData") {
-    HandleGetAppMetaData(v);
-  } else if (cmd == "ReplyResult") {
-    HandleReplyResult(v);
-  } else if (cmd == "ReplyFailure") {
-    HandleReplyFailure();
-  } else if (cmd == "GetRequestedAppControl") {
-    HandleGetRequestedAppControl();
-  } else {
-    std::cout << "ASSERT NOT REACHED. UNKNOWN COMMAND: " << cmd << std::endl;
-  }
-}
-
 void ApplicationInstance::HandleGetAppInfo(const picojson::value& msg) {
   if (msg.contains("id") && msg.get("id").is<std::string>()) {
     ApplicationInformation app_info(msg.get("id").to_str());
@@ -19,10 +19,6 @@ class ApplicationInstance : public common::Instance {
   ~ApplicationInstance();
 
  private:
-  // common::Instance implementation.
-  virtual void HandleMessage(const char* msg);
-  virtual void HandleSyncMessage(const char* msg);
-
   // Synchronous message handlers.
   void HandleGetAppInfo(const picojson::value& msg);
   void HandleGetAppContext(const picojson::value& msg);
@@ -275,9 +275,7 @@
   //
   // Extension message listener
   //
-  extension.setMessageListener(function(json) {
-    DBG('Message Listener : \n' + json + '\n');
-    var msg = JSON.parse(json);
+  var _handleMessage = function(msg) {
     var req_id = msg.req_id;
 
     // if req_id found, means this is reaply to earlier request
@@ -355,6 +353,11 @@
       default:
         ERR("Unknown signal '" + msg.cmd + "' from backend");
     }
+  };
+
+  extension.setMessageListener(function(json) {
+    DBG('Message Listener : \n' + json + '\n');
+    xwalk.utils.dispatchMessages(json, _handleMessage);
   });
 
   //
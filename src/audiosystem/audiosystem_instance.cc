@@ -16,6 +16,15 @@
 std::shared_ptr<AudioSystemContext>
     AudioSystemInstance::context_(new AudioSystemContext());
 uint32_t AudioSystemInstance::instance_counter_ = 0;
+
+namespace {
+
+// Volume and mute changes are signalled for every step of a slider.
+const unsigned kMessageBatchWindowMs = 16;
+const size_t kMaxMessageBatchBytes = 64 * 1024;
+
+}  // namespace
+
 std::thread* AudioSystemInstance::t_ = 0;
 std::mutex AudioSystemInstance::mtx_;
 
@@ -63,6 +72,7 @@ void AudioSystemInstance::DeInitContext() {
 
 AudioSystemInstance::AudioSystemInstance() {
   DBG("Creating audiosystem instance");
+  EnableMessageBatching(kMessageBatchWindowMs, kMaxMessageBatchBytes);
   if (++instance_counter_ == 1) {
     AudioSystemInstance::InitContext();
   }
@@ -0,0 +1,36 @@
+{
+  'targets': [
+    {
+      # Host tool replaying message traces against any extension module,
+      # see bench_main.cc. It doesn't include common.gypi, which would add
+      # the extension side of the XW API to it.
+      'target_name': 'xwalk_extension_bench',
+      'type': 'executable',
+      'include_dirs': [
+        '../',
+      ],
+      'cflags': [
+        '-fvisibility=hidden',
+        '-pthread',
+      ],
+      'cflags_cc': [
+        '-std=c++0x',
+      ],
+      'ldflags': [
+        '-pthread',
+      ],
+      'libraries': [
+        '-ldl',
+      ],
+      'sources': [
+        'bench_main.cc',
+        'fake_runtime.cc',
+        'fake_runtime.h',
+        'trace.cc',
+        'trace.h',
+        '../common/message_trace.cc',
+        '../common/message_trace.h',
+      ],
+    },
+  ],
+}
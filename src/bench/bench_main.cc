@@ -0,0 +1,277 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Replays a message trace against an extension module loaded in a stand-in
+// runtime, and reports the time spent in its message handlers:
+//
+//   xwalk_extension_bench [--iterations=N] [--settle-ms=N] [--paced]
+//       [--no-binary] [--runtime-var=key=value]... [--verbose]
+//       <extension.so> <trace>
+//
+// Handler latencies measure the synchronous part of each message only; work
+// posted to other threads shows up in the time until the extension settled,
+// that is until it stopped posting messages for --settle-ms.
+//
+// With --paced, messages of recorded traces are sent with their original
+// timing instead of back to back. --no-binary hides the binary messaging
+// interface from the extension, like older runtimes do.
+//
+// Recorded traces can be printed with:
+//
+//   xwalk_extension_bench --dump <trace>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench/fake_runtime.h"
+#include "bench/trace.h"
+#include "common/message_trace.h"
+
+namespace {
+
+const char kUsage[] =
+    "usage: xwalk_extension_bench [--iterations=N] [--settle-ms=N] [--paced]\n"
+    "           [--no-binary] [--runtime-var=key=value]... [--verbose]\n"
+    "           <extension.so> <trace>\n"
+    "       xwalk_extension_bench --dump <trace>\n";
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool StartsWith(const char* str, const char* prefix) {
+  return !strncmp(str, prefix, strlen(prefix));
+}
+
+double Percentile(const std::vector<uint64_t>& sorted, double fraction) {
+  size_t rank = static_cast<size_t>(sorted.size() * fraction);
+  return sorted[std::min(rank, sorted.size() - 1)] / 1000.0;
+}
+
+typedef std::map<std::pair<std::string, bool>, std::vector<uint64_t> >
+    LatencyMap;
+
+// From the instances of the trace to the ones created for the replay.
+typedef std::map<int32_t, XW_Instance> InstanceMap;
+
+void PrintReport(LatencyMap* latencies, uint64_t messages, uint64_t replay_ns,
+                 uint64_t total_ns, uint64_t posted_messages,
+                 uint64_t posted_bytes) {
+  printf("%-40s %-5s %9s %9s %9s %9s %9s %9s\n", "cmd", "type", "count",
+         "mean", "p50", "p90", "p99", "max");
+  for (LatencyMap::iterator it = latencies->begin(); it != latencies->end();
+       ++it) {
+    std::vector<uint64_t>& samples = it->second;
+    std::sort(samples.begin(), samples.end());
+    uint64_t sum = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+      sum += samples[i];
+    printf("%-40s %-5s %9zu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+           it->first.first.c_str(), it->first.second ? "sync" : "async",
+           samples.size(), sum / 1000.0 / samples.size(),
+           Percentile(samples, 0.5), Percentile(samples, 0.9),
+           Percentile(samples, 0.99), samples.back() / 1000.0);
+  }
+  printf("\n%llu messages replayed in %.3f ms, %.0f messages/s\n",
+         static_cast<unsigned long long>(messages),  // NOLINT
+         replay_ns / 1e6, messages * 1e9 / replay_ns);
+  printf("%.3f ms until the extension settled\n", total_ns / 1e6);
+  printf("%llu messages posted back, %llu bytes\n",
+         static_cast<unsigned long long>(posted_messages),  // NOLINT
+         static_cast<unsigned long long>(posted_bytes));  // NOLINT
+}
+
+// Sends the messages of |trace| once. Instances are created as the trace
+// refers to them, and left alive at the end so that the work they started
+// can complete. Returns the number of messages sent.
+uint64_t Replay(const std::vector<bench::TraceMessage>& trace, bool paced,
+                bool verbose, bench::FakeRuntime* runtime,
+                InstanceMap* instances, LatencyMap* latencies) {
+  uint64_t messages = 0;
+  uint64_t start_ns = NowNs();
+
+  for (size_t i = 0; i < trace.size(); ++i) {
+    const bench::TraceMessage& message = trace[i];
+    if (paced) {
+      uint64_t elapsed_ns = NowNs() - start_ns;
+      if (message.time_ns > elapsed_ns) {
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(message.time_ns - elapsed_ns));
+      }
+    }
+
+    if (message.kind == bench::TraceMessage::DESTROY_INSTANCE) {
+      InstanceMap::iterator it = instances->find(message.instance);
+      if (it != instances->end()) {
+        runtime->DestroyInstance(it->second);
+        instances->erase(it);
+      }
+      continue;
+    }
+
+    // Traces may start after some instances were created.
+    InstanceMap::iterator it = instances->find(message.instance);
+    if (it == instances->end()) {
+      it = instances->insert(std::make_pair(message.instance,
+                                            runtime->CreateInstance())).first;
+    }
+    if (message.kind == bench::TraceMessage::CREATE_INSTANCE)
+      continue;
+
+    bool sync = message.kind == bench::TraceMessage::SYNC;
+    if (verbose)
+      std::cerr << (sync ? "sync> " : "> ") << message.body << "\n";
+
+    uint64_t handler_start_ns = NowNs();
+    if (sync) {
+      std::string reply =
+          runtime->SendSyncMessage(it->second, message.body.c_str());
+      uint64_t elapsed_ns = NowNs() - handler_start_ns;
+      (*latencies)[std::make_pair(message.cmd, sync)].push_back(elapsed_ns);
+      if (verbose)
+        std::cerr << "sync< " << reply << "\n";
+    } else {
+      runtime->PostMessage(it->second, message.body.c_str());
+      uint64_t elapsed_ns = NowNs() - handler_start_ns;
+      (*latencies)[std::make_pair(message.cmd, sync)].push_back(elapsed_ns);
+    }
+    ++messages;
+  }
+  return messages;
+}
+
+int DumpTrace(const char* path) {
+  static const char* kTypeNames[] = {
+    "created", "destroyed", "async", "sync", "reply", "post", "post-bin",
+  };
+
+  std::string error;
+  common::TraceReader reader;
+  if (!reader.Open(path, &error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+  common::TraceRecord record;
+  while (reader.Next(&record, &error)) {
+    printf("%12.3f %-9s %4d ", record.time_ns / 1e6,
+           kTypeNames[record.type], record.instance);
+    if (record.type == common::TRACE_POST_BINARY_MESSAGE) {
+      // Only the header of binary messages is printable.
+      printf("%s (%zu bytes)\n", record.data.c_str(), record.data.size());
+    } else {
+      printf("%s\n", record.data.c_str());
+    }
+  }
+  if (!error.empty()) {
+    std::cerr << path << ": " << error << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned iterations = 1;
+  unsigned settle_ms = 100;
+  bool verbose = false;
+  bool paced = false;
+  bool binary_messaging = true;
+  std::vector<std::pair<std::string, std::string> > runtime_variables;
+  std::vector<const char*> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--iterations=")) {
+      iterations = atoi(arg + strlen("--iterations="));
+    } else if (StartsWith(arg, "--settle-ms=")) {
+      settle_ms = atoi(arg + strlen("--settle-ms="));
+    } else if (StartsWith(arg, "--runtime-var=")) {
+      std::string var(arg + strlen("--runtime-var="));
+      std::string::size_type equal = var.find('=');
+      if (equal == std::string::npos) {
+        std::cerr << kUsage;
+        return 1;
+      }
+      runtime_variables.push_back(
+          std::make_pair(var.substr(0, equal), var.substr(equal + 1)));
+    } else if (!strcmp(arg, "--verbose")) {
+      verbose = true;
+    } else if (!strcmp(arg, "--paced")) {
+      paced = true;
+    } else if (!strcmp(arg, "--no-binary")) {
+      binary_messaging = false;
+    } else if (!strcmp(arg, "--dump") && i + 2 == argc) {
+      return DumpTrace(argv[i + 1]);
+    } else if (arg[0] == '-') {
+      std::cerr << kUsage;
+      return 1;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2 || !iterations) {
+    std::cerr << kUsage;
+    return 1;
+  }
+
+  std::string error;
+  std::vector<bench::TraceMessage> trace;
+  if (!bench::ReadTrace(paths[1], &trace, &error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+  if (trace.empty()) {
+    std::cerr << paths[1] << ": no messages\n";
+    return 1;
+  }
+
+  bench::FakeRuntime runtime;
+  runtime.SetBinaryMessagingEnabled(binary_messaging);
+  for (size_t i = 0; i < runtime_variables.size(); ++i)
+    runtime.SetRuntimeVariable(runtime_variables[i].first,
+                               runtime_variables[i].second);
+  if (verbose) {
+    runtime.SetPostMessageObserver([](XW_Instance, const char* msg) {
+      std::cerr << "< " << msg << "\n";
+    });
+  }
+  if (!runtime.Load(paths[0], &error)) {
+    std::cerr << paths[0] << ": " << error << "\n";
+    return 1;
+  }
+
+  InstanceMap instances;
+  LatencyMap latencies;
+  uint64_t messages = 0;
+  uint64_t start_ns = NowNs();
+  for (unsigned iteration = 0; iteration < iterations; ++iteration)
+    messages += Replay(trace, paced, verbose, &runtime, &instances, &latencies);
+  uint64_t replay_ns = NowNs() - start_ns;
+  runtime.WaitUntilQuiet(settle_ms);
+  // The quiet period itself isn't part of the work.
+  uint64_t total_ns = NowNs() - start_ns - settle_ms * 1000000ULL;
+
+  PrintReport(&latencies, messages, replay_ns, total_ns,
+              runtime.posted_messages(), runtime.posted_bytes());
+
+  for (InstanceMap::iterator it = instances.begin(); it != instances.end();
+       ++it)
+    runtime.DestroyInstance(it->second);
+  runtime.Shutdown();
+  return 0;
+}
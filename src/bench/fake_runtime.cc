@@ -0,0 +1,295 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "bench/fake_runtime.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "common/XW_Extension_EntryPoints.h"
+#include "common/XW_Extension_Permissions.h"
+#include "common/XW_Extension_Runtime.h"
+#include "common/XW_Extension_SyncMessage.h"
+
+namespace bench {
+
+namespace {
+
+const XW_Extension kExtension = 1;
+
+FakeRuntime* g_runtime = NULL;
+
+}  // namespace
+
+// The XW interface implementations, forwarding to the loaded runtime.
+struct Callbacks {
+  static void SetExtensionName(XW_Extension, const char* name) {
+    g_runtime->extension_name_ = name;
+  }
+
+  static void SetJavaScriptAPI(XW_Extension, const char*) {}
+
+  static void RegisterInstanceCallbacks(
+      XW_Extension, XW_CreatedInstanceCallback created,
+      XW_DestroyedInstanceCallback destroyed) {
+    g_runtime->created_callback_ = created;
+    g_runtime->destroyed_callback_ = destroyed;
+  }
+
+  static void RegisterShutdownCallback(XW_Extension,
+                                       XW_ShutdownCallback callback) {
+    g_runtime->shutdown_callback_ = callback;
+  }
+
+  static void SetInstanceData(XW_Instance instance, void* data) {
+    std::lock_guard<std::mutex> lock(g_runtime->mutex_);
+    g_runtime->instance_data_[instance] = data;
+  }
+
+  static void* GetInstanceData(XW_Instance instance) {
+    std::lock_guard<std::mutex> lock(g_runtime->mutex_);
+    std::map<XW_Instance, void*>::const_iterator it =
+        g_runtime->instance_data_.find(instance);
+    return it != g_runtime->instance_data_.end() ? it->second : NULL;
+  }
+
+  static void RegisterMessageCallback(XW_Extension,
+                                      XW_HandleMessageCallback callback) {
+    g_runtime->message_callback_ = callback;
+  }
+
+  static void PostMessage(XW_Instance instance, const char* msg) {
+    FakeRuntime::PostMessageObserver observer;
+    {
+      std::lock_guard<std::mutex> lock(g_runtime->mutex_);
+      ++g_runtime->posted_messages_;
+      g_runtime->posted_bytes_ += strlen(msg);
+      observer = g_runtime->observer_;
+    }
+    g_runtime->posted_cond_.notify_all();
+    if (observer)
+      observer(instance, msg);
+  }
+
+  static void RegisterBinaryMessageCallback(
+      XW_Extension, XW_HandleBinaryMessageCallback) {}
+
+  static void PostBinaryMessage(XW_Instance, const char*, const size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(g_runtime->mutex_);
+      ++g_runtime->posted_messages_;
+      g_runtime->posted_bytes_ += size;
+    }
+    g_runtime->posted_cond_.notify_all();
+  }
+
+  static void RegisterSyncMessageCallback(
+      XW_Extension, XW_HandleSyncMessageCallback callback) {
+    g_runtime->sync_message_callback_ = callback;
+  }
+
+  static void SetSyncReply(XW_Instance, const char* reply) {
+    g_runtime->sync_reply_ = reply;
+  }
+
+  static void SetExtraJSEntryPoints(XW_Extension, const char**) {}
+
+  static void GetRuntimeVariableString(XW_Extension, const char* key,
+                                       char* value, size_t value_len) {
+    std::map<std::string, std::string>::const_iterator it =
+        g_runtime->runtime_variables_.find(key);
+    if (!value_len)
+      return;
+    std::string result =
+        it != g_runtime->runtime_variables_.end() ? it->second : "";
+    strncpy(value, result.c_str(), value_len - 1);
+    value[value_len - 1] = '\0';
+  }
+
+  // Everything is allowed.
+  static int CheckAPIAccessControl(XW_Extension, const char*) {
+    return 1;
+  }
+
+  static int RegisterPermissions(XW_Extension, const char*) {
+    return 1;
+  }
+
+  static const void* GetInterface(const char* name) {
+    static const XW_CoreInterface_1 core = {
+      SetExtensionName,
+      SetJavaScriptAPI,
+      RegisterInstanceCallbacks,
+      RegisterShutdownCallback,
+      SetInstanceData,
+      GetInstanceData,
+    };
+    static const XW_MessagingInterface_1 messaging = {
+      RegisterMessageCallback,
+      PostMessage,
+    };
+    static const XW_MessagingInterface_2 binary_messaging = {
+      RegisterMessageCallback,
+      PostMessage,
+      RegisterBinaryMessageCallback,
+      PostBinaryMessage,
+    };
+    static const XW_Internal_SyncMessagingInterface_1 sync_messaging = {
+      RegisterSyncMessageCallback,
+      SetSyncReply,
+    };
+    static const XW_Internal_EntryPointsInterface_1 entry_points = {
+      SetExtraJSEntryPoints,
+    };
+    static const XW_Internal_RuntimeInterface_1 runtime = {
+      GetRuntimeVariableString,
+    };
+    static const XW_Internal_PermissionsInterface_1 permissions = {
+      CheckAPIAccessControl,
+      RegisterPermissions,
+    };
+
+    if (!strcmp(name, XW_CORE_INTERFACE_1))
+      return &core;
+    if (!strcmp(name, XW_MESSAGING_INTERFACE_1))
+      return &messaging;
+    if (!strcmp(name, XW_MESSAGING_INTERFACE_2))
+      return g_runtime->binary_messaging_ ? &binary_messaging : NULL;
+    if (!strcmp(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE_1))
+      return &sync_messaging;
+    if (!strcmp(name, XW_INTERNAL_ENTRY_POINTS_INTERFACE_1))
+      return &entry_points;
+    if (!strcmp(name, XW_INTERNAL_RUNTIME_INTERFACE_1))
+      return &runtime;
+    if (!strcmp(name, XW_INTERNAL_PERMISSIONS_INTERFACE_1))
+      return &permissions;
+    std::cerr << "Interface not available in the bench runtime: " << name
+              << "\n";
+    return NULL;
+  }
+};
+
+FakeRuntime::FakeRuntime()
+    : module_(NULL),
+      created_callback_(NULL),
+      destroyed_callback_(NULL),
+      shutdown_callback_(NULL),
+      message_callback_(NULL),
+      sync_message_callback_(NULL),
+      binary_messaging_(true),
+      next_instance_(1),
+      posted_messages_(0),
+      posted_bytes_(0) {}
+
+FakeRuntime::~FakeRuntime() {
+  Shutdown();
+}
+
+bool FakeRuntime::Load(const std::string& path, std::string* error) {
+  if (g_runtime) {
+    *error = "an extension is already loaded";
+    return false;
+  }
+
+  module_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!module_) {
+    *error = dlerror();
+    return false;
+  }
+
+  XW_Initialize_Func initialize = reinterpret_cast<XW_Initialize_Func>(
+      dlsym(module_, "XW_Initialize"));
+  if (!initialize) {
+    *error = "XW_Initialize not found in " + path;
+    dlclose(module_);
+    module_ = NULL;
+    return false;
+  }
+
+  g_runtime = this;
+  if (initialize(kExtension, Callbacks::GetInterface) != XW_OK) {
+    *error = "XW_Initialize failed";
+    Shutdown();
+    return false;
+  }
+  return true;
+}
+
+void FakeRuntime::SetRuntimeVariable(const std::string& key,
+                                     const std::string& value) {
+  runtime_variables_[key] = value;
+}
+
+void FakeRuntime::SetBinaryMessagingEnabled(bool enabled) {
+  binary_messaging_ = enabled;
+}
+
+void FakeRuntime::SetPostMessageObserver(
+    const PostMessageObserver& observer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  observer_ = observer;
+}
+
+XW_Instance FakeRuntime::CreateInstance() {
+  XW_Instance instance = next_instance_++;
+  if (created_callback_)
+    created_callback_(instance);
+  return instance;
+}
+
+void FakeRuntime::DestroyInstance(XW_Instance instance) {
+  if (destroyed_callback_)
+    destroyed_callback_(instance);
+  std::lock_guard<std::mutex> lock(mutex_);
+  instance_data_.erase(instance);
+}
+
+void FakeRuntime::PostMessage(XW_Instance instance, const char* msg) {
+  if (message_callback_)
+    message_callback_(instance, msg);
+}
+
+std::string FakeRuntime::SendSyncMessage(XW_Instance instance,
+                                         const char* msg) {
+  sync_reply_.clear();
+  if (sync_message_callback_)
+    sync_message_callback_(instance, msg);
+  return sync_reply_;
+}
+
+uint64_t FakeRuntime::posted_messages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return posted_messages_;
+}
+
+uint64_t FakeRuntime::posted_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return posted_bytes_;
+}
+
+void FakeRuntime::WaitUntilQuiet(unsigned quiet_ms) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    uint64_t posted = posted_messages_;
+    if (!posted_cond_.wait_for(lock, std::chrono::milliseconds(quiet_ms),
+                               [&]() { return posted_messages_ != posted; }))
+      return;
+  }
+}
+
+void FakeRuntime::Shutdown() {
+  if (g_runtime != this)
+    return;
+  if (shutdown_callback_)
+    shutdown_callback_(kExtension);
+  if (module_)
+    dlclose(module_);
+  module_ = NULL;
+  g_runtime = NULL;
+}
+
+}  // namespace bench
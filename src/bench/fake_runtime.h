@@ -0,0 +1,95 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BENCH_FAKE_RUNTIME_H_
+#define BENCH_FAKE_RUNTIME_H_
+
+// A stand-in for the Crosswalk runtime, implementing just enough of the XW
+// interfaces to load an extension and exchange messages with its instances.
+//
+// Only one extension can be loaded per process, as the interfaces are plain
+// C function tables without a user data pointer.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "common/XW_Extension.h"
+#include "common/utils.h"
+
+namespace bench {
+
+class FakeRuntime {
+ public:
+  // Called for every message posted by the extension, from any thread.
+  typedef std::function<void(XW_Instance, const char*)> PostMessageObserver;
+
+  FakeRuntime();
+  ~FakeRuntime();
+
+  // Loads the extension module at |path| and calls its XW_Initialize().
+  bool Load(const std::string& path, std::string* error);
+
+  // Values returned by the runtime variables interface.
+  void SetRuntimeVariable(const std::string& key, const std::string& value);
+
+  // Whether XW_MESSAGING_INTERFACE_2 is offered, true by default. Must be
+  // set before Load().
+  void SetBinaryMessagingEnabled(bool enabled);
+
+  // Not called for binary messages.
+  void SetPostMessageObserver(const PostMessageObserver& observer);
+
+  XW_Instance CreateInstance();
+  void DestroyInstance(XW_Instance instance);
+
+  void PostMessage(XW_Instance instance, const char* msg);
+  std::string SendSyncMessage(XW_Instance instance, const char* msg);
+
+  // Number and total size of the messages posted by the extension so far.
+  uint64_t posted_messages() const;
+  uint64_t posted_bytes() const;
+
+  // Blocks until the extension didn't post anything for |quiet_ms|.
+  void WaitUntilQuiet(unsigned quiet_ms);
+
+  // Calls the shutdown callback and unloads the module.
+  void Shutdown();
+
+ private:
+  friend struct Callbacks;
+
+  void* module_;
+  std::string extension_name_;
+
+  XW_CreatedInstanceCallback created_callback_;
+  XW_DestroyedInstanceCallback destroyed_callback_;
+  XW_ShutdownCallback shutdown_callback_;
+  XW_HandleMessageCallback message_callback_;
+  XW_HandleMessageCallback sync_message_callback_;
+
+  std::map<std::string, std::string> runtime_variables_;
+  bool binary_messaging_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable posted_cond_;
+  std::map<XW_Instance, void*> instance_data_;
+  XW_Instance next_instance_;
+  // The reply set by the sync handler running on the calling thread.
+  std::string sync_reply_;
+  uint64_t posted_messages_;
+  uint64_t posted_bytes_;
+  PostMessageObserver observer_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeRuntime);
+};
+
+}  // namespace bench
+
+#endif  // BENCH_FAKE_RUNTIME_H_
@@ -0,0 +1,127 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "bench/trace.h"
+
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "common/message_trace.h"
+#include "common/picojson.h"
+
+namespace bench {
+
+namespace {
+
+std::string GetCommand(const std::string& body) {
+  picojson::value v;
+  std::string err;
+  picojson::parse(v, body.begin(), body.end(), &err);
+  if (!err.empty() || !v.is<picojson::object>())
+    return "(invalid)";
+  const picojson::value& cmd = v.get("cmd");
+  return cmd.is<std::string>() ? cmd.get<std::string>() : "(none)";
+}
+
+bool IsBinaryTrace(const std::string& path) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  char magic[16];
+  file.read(magic, common::kTraceMagicLength);
+  return file && !memcmp(magic, common::kTraceMagic,
+                         common::kTraceMagicLength);
+}
+
+bool ReadBinaryTrace(const std::string& path,
+                     std::vector<TraceMessage>* trace, std::string* error) {
+  common::TraceReader reader;
+  if (!reader.Open(path, error))
+    return false;
+
+  common::TraceRecord record;
+  while (reader.Next(&record, error)) {
+    TraceMessage message;
+    switch (record.type) {
+      case common::TRACE_INSTANCE_CREATED:
+        message.kind = TraceMessage::CREATE_INSTANCE;
+        break;
+      case common::TRACE_INSTANCE_DESTROYED:
+        message.kind = TraceMessage::DESTROY_INSTANCE;
+        break;
+      case common::TRACE_MESSAGE:
+        message.kind = TraceMessage::ASYNC;
+        break;
+      case common::TRACE_SYNC_MESSAGE:
+        message.kind = TraceMessage::SYNC;
+        break;
+      default:
+        // Replies and posted messages come from the extension.
+        continue;
+    }
+    message.instance = record.instance;
+    message.time_ns = record.time_ns;
+    if (message.kind == TraceMessage::ASYNC ||
+        message.kind == TraceMessage::SYNC) {
+      message.body.swap(record.data);
+      message.cmd = GetCommand(message.body);
+    }
+    trace->push_back(message);
+  }
+  if (!error->empty()) {
+    // The tail of a trace is lost if the process recording it crashed,
+    // replay what made it to the disk.
+    std::cerr << path << ": " << *error << ", ignoring the rest\n";
+    error->clear();
+  }
+  return true;
+}
+
+bool ReadTextTrace(const std::string& path, std::vector<TraceMessage>* trace,
+                   std::string* error) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    *error = "can't open " + path;
+    return false;
+  }
+
+  std::string line;
+  for (int line_number = 1; std::getline(file, line); ++line_number) {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::string::size_type space = line.find(' ');
+    std::string kind = line.substr(0, space);
+    TraceMessage message;
+    message.instance = 0;
+    message.time_ns = 0;
+    if (kind == "async") {
+      message.kind = TraceMessage::ASYNC;
+    } else if (kind == "sync") {
+      message.kind = TraceMessage::SYNC;
+    } else {
+      std::ostringstream ss;
+      ss << path << ":" << line_number << ": unknown message kind '" << kind
+         << "'";
+      *error = ss.str();
+      return false;
+    }
+    message.body = space == std::string::npos ? "" : line.substr(space + 1);
+    message.cmd = GetCommand(message.body);
+    trace->push_back(message);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadTrace(const std::string& path, std::vector<TraceMessage>* trace,
+               std::string* error) {
+  if (IsBinaryTrace(path))
+    return ReadBinaryTrace(path, trace, error);
+  return ReadTextTrace(path, trace, error);
+}
+
+}  // namespace bench
@@ -0,0 +1,51 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BENCH_TRACE_H_
+#define BENCH_TRACE_H_
+
+// Message traces replayed by the bench tool.
+//
+// Traces are either recorded by the extensions themselves, see
+// common/message_trace.h, or written by hand as text with one message per
+// line, prefixed by its kind:
+//
+//   # Lines starting with '#' and empty lines are ignored.
+//   async {"cmd":"FileListFiles","fullPath":"documents","reply_id":1}
+//   sync {"cmd":"FileStat","fullPath":"documents/a.txt"}
+//
+// All the messages of a text trace go to the same instance.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct TraceMessage {
+  enum Kind {
+    ASYNC,
+    SYNC,
+    CREATE_INSTANCE,
+    DESTROY_INSTANCE,
+  };
+
+  Kind kind;
+  // The instance as recorded, zero in text traces.
+  int32_t instance;
+  // Since the start of the recording, zero in text traces.
+  uint64_t time_ns;
+  std::string body;
+  // Value of the "cmd" key, for grouping the results.
+  std::string cmd;
+};
+
+// Reads the messages sent to the extension, in either format.
+bool ReadTrace(const std::string& path, std::vector<TraceMessage>* trace,
+               std::string* error);
+
+}  // namespace bench
+
+#endif  // BENCH_TRACE_H_
@@ -25,7 +25,7 @@ function checkPostError(msg, errorCallback) {
 }
 
 extension.setMessageListener(function(json) {
-  var msg = JSON.parse(json);
+  var msg = xwalk.utils.parseMessage(json);
   if (msg.cmd == 'BondedDevice')
     handleBondedDevice(msg);
   else if (msg.cmd == 'DeviceFound')
@@ -260,7 +260,7 @@ var handleSocketHasData = function(msg) {
   for (var i in adapter.sockets) {
     var socket = adapter.sockets[i];
     if (socket.socket_fd === msg.socket_fd) {
-      socket.data = msg.data;
+      socket.data = Array.prototype.slice.call(msg.binary);
 
       if (socket.onmessage && typeof socket.onmessage === 'function')
         socket.onmessage();
@@ -759,9 +759,10 @@ gboolean BluetoothInstance::OnSocketHasData(GSocket* client, GIOCondition cond,
 
   o["cmd"] = picojson::value("SocketHasData");
   o["socket_fd"] = picojson::value(static_cast<double>(fd));
-  o["data"] = picojson::value(buf, len);
 
-  handler->InternalPostMessage(picojson::value(o));
+  // Sockets are only made once the JavaScript context is initialized, so
+  // there is nothing to queue behind.
+  handler->PostBinaryMessage(picojson::value(o).serialize(), buf, len);
 
   return true;
 }
@@ -395,9 +395,10 @@ void BluetoothInstance::OnSocketHasData(bt_socket_received_data_s* data,
   }
 
   picojson::value::object o;
+  o["cmd"] = picojson::value("SocketHasData");
   o["socket_fd"] = picojson::value(static_cast<double>(data->socket_fd));
-  o["data"] = picojson::value(static_cast<std::string>(data->data));
-  obj->SendCmdToJs("SocketHasData", o);
+  obj->PostBinaryMessage(picojson::value(o).serialize(), data->data,
+                         data->data_size);
 }
 
 void BluetoothInstance::OnHdpConnected(int result, const char* remote_address,
@@ -116,20 +116,37 @@ void CallHistoryInstance::HandleMessage(const char* msg) {
   }
 
   std::string cmd = js_cmd.get("cmd").to_str();
-  if (cmd == "find")
-    err = HandleFind(js_cmd, js_reply);  // returns results in js_reply
-  else if (cmd == "remove")
+  if (cmd == "find") {
+    // Results are streamed into the reply as they are read from the
+    // database, the reply is only built from js_reply on errors.
+    common::JsonWriter writer;
+    writer.BeginObject();
+    writer.Key("cmd");
+    writer.String("reply");
+    writer.Key("reply_id");
+    writer.Value(js_cmd.get("reply_id"));
+    writer.Key("result");
+    err = HandleFind(js_cmd, &writer);
+    if (err == NO_ERROR) {
+      writer.Key("errorCode");
+      writer.Number(err);
+      writer.EndObject();
+      PostMessage(writer.c_str());
+      return;
+    }
+  } else if (cmd == "remove") {
     err = HandleRemove(js_cmd);  // only success/error
-  else if (cmd == "removeBatch")
+  } else if (cmd == "removeBatch") {
     err = HandleRemoveBatch(js_cmd);  // only success/error
-  else if (cmd == "removeAll")
+  } else if (cmd == "removeAll") {
     err = HandleRemoveAll(js_cmd);  // only success/error
-  else if (cmd == "addListener")
+  } else if (cmd == "addListener") {
     err = HandleAddListener();
-  else if (cmd == "removeListener")
+  } else if (cmd == "removeListener") {
     err = HandleRemoveListener();
-  else
+  } else {
     err = INVALID_STATE_ERR;
+  }
 
   js_reply["errorCode"] = picojson::value(static_cast<double>(err));
   SendReply(js_reply);
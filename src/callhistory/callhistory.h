@@ -9,6 +9,7 @@
 #include <string>
 #include <iostream>
 #include "common/extension.h"
+#include "common/json_writer.h"
 #include "common/picojson.h"
 #include "tizen/tizen.h"  // for errors and filter definitions
 
@@ -45,7 +46,7 @@ class CallHistoryInstance : public common::Instance {
 
   // Tizen API backend-specific call handlers
   int HandleFind(const picojson::value& msg,
-                 picojson::value::object& reply);
+                 common::JsonWriter* result);
   int HandleRemove(const picojson::value& msg);
   int HandleRemoveBatch(const picojson::value& msg);
   int HandleRemoveAll(const picojson::value& msg);
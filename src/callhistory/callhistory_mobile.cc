@@ -13,6 +13,8 @@
 #include <memory>
 #include <sstream>
 
+#include "common/json_writer.h"
+
 namespace {
 
 // Wrapper for logging; currently cout/cerr is used in Tizen extensions.
@@ -119,11 +121,7 @@ inline ScopeGuard<contacts_query_h>::~ScopeGuard() {
     return MapContactErrors(_er); } } while (0)
 
 
-picojson::value JsonFromInt(int val) {
-  return picojson::value(static_cast<double>(val));
-}
-
-picojson::value JsonFromTime(time_t val) {
+std::string TimeStringFromInt(int val) {
   char timestr[40];
   // Instead "struct tm* tms = localtime(&val);" use the reentrant version.
   time_t tme = time(nullptr);
@@ -132,12 +130,7 @@ picojson::value JsonFromTime(time_t val) {
   struct tm* tms = &tm_s;
 
   strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S.%06u GMT%z", tms);
-  return picojson::value(std::string(timestr));
-}
-
-picojson::value JsonTimeFromInt(int val) {
-  time_t tval = static_cast<time_t>(val);
-  return JsonFromTime(tval);
+  return timestr;
 }
 
 // Needed because v.get() asserts if type is wrong, this one fails gracefully.
@@ -148,94 +141,108 @@ bool IntFromJson(const picojson::value& v, int* result) {
   return true;
 }
 
-// Read Contacts record, and prepare JSON array element for the "result"
+// Read Contacts record, and write a JSON array element for the "result"
 // property used in setMessageListener() JS function in callhistory_api.js.
-int SerializeEntry(contacts_record_h record, picojson::value::object& o) {
-  int int_val;
-  char* string_val;
-
-  o["type"] = picojson::value("TEL");  // for now, only "TEL" is supported
-
-  CHK(contacts_record_get_int(record, CALLH_ATTR_UID, &int_val));
-  o["uid"] = JsonFromInt(int_val);
-
-  CHK(contacts_record_get_int(record, CALLH_ATTR_DURATION, &int_val));
-  o["duration"] = JsonFromInt(int_val);
-
-  CHK(contacts_record_get_int(record, CALLH_ATTR_STARTTIME, &int_val));
-  o["startTime"] = JsonTimeFromInt(int_val);
-
-  picojson::value::array features;
-  features.push_back(picojson::value("CALL"));  // common to all
-
-  CHK(contacts_record_get_int(record, CALLH_ATTR_DIRECTION, &int_val));
-  switch (int_val) {
+// Nothing is written if the record can't be read.
+int SerializeEntry(contacts_record_h record, common::JsonWriter* writer) {
+  int uid, duration, start_time, direction, person_id;
+  char* address;
+
+  CHK(contacts_record_get_int(record, CALLH_ATTR_UID, &uid));
+  CHK(contacts_record_get_int(record, CALLH_ATTR_DURATION, &duration));
+  CHK(contacts_record_get_int(record, CALLH_ATTR_STARTTIME, &start_time));
+  CHK(contacts_record_get_int(record, CALLH_ATTR_DIRECTION, &direction));
+  CHK(contacts_record_get_str_p(record, CALLH_ATTR_ADDRESS, &address));
+  CHK(contacts_record_get_int(record, CALLH_ATTR_PERSONID, &person_id));
+
+  const char* feature = nullptr;
+  const char* direction_str = nullptr;
+  switch (direction) {
     case CONTACTS_PLOG_TYPE_VIDEO_INCOMMING:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("RECEIVED");
+      feature = "VIDEOCALL";
+      direction_str = "RECEIVED";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_INCOMMING:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("RECEIVED");
+      feature = "VOICECALL";
+      direction_str = "RECEIVED";
       break;
     case CONTACTS_PLOG_TYPE_VIDEO_OUTGOING:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("DIALED");
+      feature = "VIDEOCALL";
+      direction_str = "DIALED";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_OUTGOING:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("DIALED");
+      feature = "VOICECALL";
+      direction_str = "DIALED";
       break;
     case CONTACTS_PLOG_TYPE_VIDEO_INCOMMING_UNSEEN:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("MISSEDNEW");
+      feature = "VIDEOCALL";
+      direction_str = "MISSEDNEW";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_INCOMMING_UNSEEN:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("MISSEDNEW");
+      feature = "VOICECALL";
+      direction_str = "MISSEDNEW";
       break;
     case CONTACTS_PLOG_TYPE_VIDEO_INCOMMING_SEEN:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("MISSED");
+      feature = "VIDEOCALL";
+      direction_str = "MISSED";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_INCOMMING_SEEN:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("MISSED");
+      feature = "VOICECALL";
+      direction_str = "MISSED";
       break;
     case CONTACTS_PLOG_TYPE_VIDEO_REJECT:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("REJECTED");
+      feature = "VIDEOCALL";
+      direction_str = "REJECTED";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_REJECT:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("REJECTED");
+      feature = "VOICECALL";
+      direction_str = "REJECTED";
       break;
     case CONTACTS_PLOG_TYPE_VIDEO_BLOCKED:
-      features.push_back(picojson::value("VIDEOCALL"));
-      o["direction"] = picojson::value("BLOCKED");
+      feature = "VIDEOCALL";
+      direction_str = "BLOCKED";
       break;
     case CONTACTS_PLOG_TYPE_VOICE_BLOCKED:
-      features.push_back(picojson::value("VOICECALL"));
-      o["direction"] = picojson::value("BLOCKED");
+      feature = "VOICECALL";
+      direction_str = "BLOCKED";
       break;
     default:
       LOG_ERR("SerializeEntry(): invalid 'direction'");
       break;
   }
 
-  o["features"] = picojson::value(features);
-
-  picojson::value::array rp_list;
-  picojson::value::object r_party;
-  CHK(contacts_record_get_str_p(record, CALLH_ATTR_ADDRESS, &string_val));
-  r_party["remoteParty"] = picojson::value(string_val);
-
-  CHK(contacts_record_get_int(record, CALLH_ATTR_PERSONID, &int_val));
-  r_party["personId"] = JsonFromInt(int_val);
-
-  rp_list.push_back(picojson::value(r_party));
-  o["remoteParties"] = picojson::value(rp_list);
+  writer->BeginObject();
+  writer->Key("type");
+  writer->String("TEL");  // for now, only "TEL" is supported
+  writer->Key("uid");
+  writer->Number(uid);
+  writer->Key("duration");
+  writer->Number(duration);
+  writer->Key("startTime");
+  writer->String(TimeStringFromInt(start_time));
+  if (direction_str) {
+    writer->Key("direction");
+    writer->String(direction_str);
+  }
 
+  writer->Key("features");
+  writer->BeginArray();
+  writer->String("CALL");  // common to all
+  if (feature)
+    writer->String(feature);
+  writer->EndArray();
+
+  writer->Key("remoteParties");
+  writer->BeginArray();
+  writer->BeginObject();
+  writer->Key("remoteParty");
+  writer->String(address);
+  writer->Key("personId");
+  writer->Number(person_id);
+  writer->EndObject();
+  writer->EndArray();
+
+  writer->EndObject();
   return CONTACTS_ERROR_NONE;
 }
 
@@ -566,22 +573,20 @@ int ParseFilter(contacts_filter_h& filter,
   return CONTACTS_ERROR_NONE;
 }
 
-// Prepare JSON for setMessageListener() JS function in callhistory_api.js.
-int HandleFindResults(contacts_list_h list, picojson::value::object& resp) {
+// Write the JSON array for the "result" property used in
+// setMessageListener() JS function in callhistory_api.js.
+int HandleFindResults(contacts_list_h list, common::JsonWriter* writer) {
   int err = CONTACTS_ERROR_DB;
   unsigned int total = 0;
 
   contacts_list_get_count(list, &total);
-  picojson::value::array result;
+  writer->BeginArray();
 
   for (unsigned int i = 0; i < total; i++) {
     contacts_record_h record = nullptr;
     CHK(contacts_list_get_current_record_p(list, &record));
-    if (record) {  // read the fields and create JSON attributes
-      picojson::value::object o;
-      CHK(SerializeEntry(record, o));
-      result.push_back(picojson::value(o));
-    }
+    if (record)  // read the fields and write JSON attributes
+      CHK(SerializeEntry(record, writer));
 
     err = contacts_list_next(list);  // move the current record
     if (err != CONTACTS_ERROR_NONE && err != CONTACTS_ERROR_NO_DATA) {
@@ -589,7 +594,7 @@ int HandleFindResults(contacts_list_h list, picojson::value::object& resp) {
       return CONTACTS_ERROR_DB;
     }
   }
-  resp["result"] = picojson::value(result);  // as used in callhistory_api.js
+  writer->EndArray();
   return CONTACTS_ERROR_NONE;
 }
 
@@ -602,10 +607,12 @@ void NotifyDatabaseChange(const char* view, char* changes, void* user_data) {
     return;
   }
 
-  picojson::value::object out;  // output JSON object
-  picojson::value::array added;  // full records
-  picojson::value::array changed;  // full records
-  picojson::value::array deleted;  // only id's
+  common::JsonWriter added;  // full records
+  common::JsonWriter changed;  // full records
+  common::JsonWriter deleted;  // only id's
+  added.BeginArray();
+  changed.BeginArray();
+  deleted.BeginArray();
 
   char  delim[] = ",:";
   char* rest;
@@ -625,18 +632,12 @@ void NotifyDatabaseChange(const char* view, char* changes, void* user_data) {
       case CONTACTS_CHANGE_UPDATED:
         contacts_record_h record = nullptr;
         if (check(contacts_db_get_record(CALLH_VIEW_URI, uid, &record))) {
-          picojson::value::object val;
-          if (check(SerializeEntry(record, val))) {
-            if (ins)
-              added.push_back(picojson::value(val));
-            else
-              changed.push_back(picojson::value(val));
-          }
+          SerializeEntry(record, ins ? &added : &changed);
           contacts_record_destroy(record, true);
         }
         break;
       case CONTACTS_CHANGE_DELETED:
-        deleted.push_back(JsonFromInt(uid));
+        deleted.Number(uid);
         break;
       default:
         LOG_ERR("CallHistory: invalid database change: " << chtype);
@@ -645,15 +646,25 @@ void NotifyDatabaseChange(const char* view, char* changes, void* user_data) {
     }
     chtype = strtok_r(nullptr, delim, &rest);
   }
-
-  out["cmd"] = picojson::value("notif");
-  out["errorCode"] = picojson::value(static_cast<double>(err));
-  out["added"]   = picojson::value(added);
-  out["changed"] = picojson::value(changed);
-  out["deleted"] = picojson::value(deleted);
-  picojson::value v(out);
-
-  chi->PostMessage(v.serialize().c_str());
+  added.EndArray();
+  changed.EndArray();
+  deleted.EndArray();
+
+  common::JsonWriter out;  // output JSON object
+  out.BeginObject();
+  out.Key("cmd");
+  out.String("notif");
+  out.Key("errorCode");
+  out.Number(err);
+  out.Key("added");
+  out.RawValue(added.str());
+  out.Key("changed");
+  out.RawValue(changed.str());
+  out.Key("deleted");
+  out.RawValue(deleted.str());
+  out.EndObject();
+
+  chi->PostMessage(out.c_str());
 }
 
 }  // namespace
@@ -711,9 +722,9 @@ int CallHistoryInstance::UnregisterListener() {
 }
 
 // Take a JSON query, translate to contacts query, collect the results, and
-// return a JSON string via the callback.
+// write the JSON array of results into |result|.
 int CallHistoryInstance::HandleFind(const picojson::value& input,
-                                    picojson::value::object& reply) {
+                                    common::JsonWriter* result) {
   int limit = 0;
   IntFromJson(input.get("limit"), &limit);  // no change on error
 
@@ -754,7 +765,7 @@ int CallHistoryInstance::HandleFind(const picojson::value& input,
     CHK_MAP(contacts_db_get_records_with_query(*pquery, offset, limit, &list));
   }
   contacts_list_h* plist = &list;
-  CHK_MAP(HandleFindResults(*plist, reply));
+  CHK_MAP(HandleFindResults(*plist, result));
   return NO_ERROR;
 }
 
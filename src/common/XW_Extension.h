@@ -33,6 +33,7 @@ extern "C" {
 #define XW_EXPORT __declspec(dllexport)
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -178,6 +179,36 @@ struct XW_MessagingInterface_1 {
 
 typedef struct XW_MessagingInterface_1 XW_MessagingInterface;
 
+//
+// XW_MESSAGING_INTERFACE_2: Same as above, plus messages carrying arbitrary
+// bytes. Binary messages are received by JavaScript as ArrayBuffers.
+//
+
+#define XW_MESSAGING_INTERFACE_2 "XW_MessagingInterface_2"
+
+typedef void (*XW_HandleBinaryMessageCallback)(XW_Instance instance,
+                                               const char* message,
+                                               const size_t size);
+
+struct XW_MessagingInterface_2 {
+  void (*Register)(XW_Extension extension,
+                   XW_HandleMessageCallback handle_message);
+
+  void (*PostMessage)(XW_Instance instance, const char* message);
+
+  // Register a callback to be called when the JavaScript code associated
+  // with the extension posts an ArrayBuffer.
+  void (*RegisterBinaryMessageCallback)(
+      XW_Extension extension,
+      XW_HandleBinaryMessageCallback handle_message);
+
+  // Post |size| bytes of |message| to the web content associated with the
+  // instance. This function is thread-safe and can be called until the
+  // instance is destroyed.
+  void (*PostBinaryMessage)(XW_Instance instance, const char* message,
+                            const size_t size);
+};
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
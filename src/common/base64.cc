@@ -0,0 +1,502 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/base64.h"
+
+#include <stdint.h>
+
+// The x86 vector code paths need intrinsics usable from functions with a
+// target attribute, so that the rest of the build keeps the baseline
+// instruction set. They are picked at runtime according to the CPU. NEON is
+// used when the build targets it, ARM CPUs having it or not by toolchain.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BASE64_X86_SIMD 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BASE64_ARM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace common {
+namespace base64 {
+
+namespace {
+
+const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const uint8_t kInvalid = 0xff;
+const uint8_t kSpace = 0xfe;
+const uint8_t kPad = 0xfd;
+
+// Slack at the end of the decoding buffer, as the vector code stores whole
+// registers of which only the first 3/4 are meaningful.
+const size_t kDecodeSlack = 16;
+
+struct DecodeTable {
+  DecodeTable() {
+    for (int i = 0; i < 256; ++i)
+      values[i] = kInvalid;
+    for (int i = 0; i < 64; ++i)
+      values[static_cast<uint8_t>(kAlphabet[i])] = i;
+    values[static_cast<uint8_t>(' ')] = kSpace;
+    values[static_cast<uint8_t>('\t')] = kSpace;
+    values[static_cast<uint8_t>('\n')] = kSpace;
+    values[static_cast<uint8_t>('\r')] = kSpace;
+    values[static_cast<uint8_t>('=')] = kPad;
+  }
+
+  uint8_t values[256];
+};
+
+const DecodeTable kDecodeTable;
+
+// The vector functions consume as much of the input as they can in whole
+// blocks and return how many bytes they did; the scalar code does the rest.
+typedef size_t (*EncodeBlocksFunc)(const uint8_t* src, size_t size,
+                                   char* dest);
+typedef size_t (*DecodeBlocksFunc)(const uint8_t* src, size_t size,
+                                   char* dest);
+
+size_t EncodeBlocksNone(const uint8_t*, size_t, char*) {
+  return 0;
+}
+
+size_t DecodeBlocksNone(const uint8_t*, size_t, char*) {
+  return 0;
+}
+
+void EncodeScalar(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    uint32_t triple = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+    *dest++ = kAlphabet[triple >> 18];
+    *dest++ = kAlphabet[(triple >> 12) & 0x3f];
+    *dest++ = kAlphabet[(triple >> 6) & 0x3f];
+    *dest++ = kAlphabet[triple & 0x3f];
+  }
+  if (i < size) {
+    uint32_t triple = src[i] << 16;
+    if (i + 1 < size)
+      triple |= src[i + 1] << 8;
+    *dest++ = kAlphabet[triple >> 18];
+    *dest++ = kAlphabet[(triple >> 12) & 0x3f];
+    *dest++ = i + 1 < size ? kAlphabet[(triple >> 6) & 0x3f] : '=';
+    *dest++ = '=';
+  }
+}
+
+// Returns the end of the decoded data, or NULL if the input is invalid.
+char* DecodeScalar(const uint8_t* src, size_t size, char* dest) {
+  uint32_t bits = 0;
+  int count = 0;
+  int padding = 0;
+  for (size_t i = 0; i < size; ++i) {
+    uint8_t value = kDecodeTable.values[src[i]];
+    if (value == kSpace)
+      continue;
+    if (value == kInvalid)
+      return NULL;
+    if (value == kPad) {
+      // Only "x==" or "xx=" may end a quantum.
+      if (count < 2 || ++padding + count > 4)
+        return NULL;
+      continue;
+    }
+    if (padding)
+      return NULL;
+    bits = (bits << 6) | value;
+    if (++count == 4) {
+      *dest++ = static_cast<char>(bits >> 16);
+      *dest++ = static_cast<char>(bits >> 8);
+      *dest++ = static_cast<char>(bits);
+      bits = 0;
+      count = 0;
+    }
+  }
+
+  if (padding && padding + count != 4)
+    return NULL;
+  if (count == 1)
+    return NULL;
+  if (count == 2) {
+    *dest++ = static_cast<char>(bits >> 4);
+  } else if (count == 3) {
+    *dest++ = static_cast<char>(bits >> 10);
+    *dest++ = static_cast<char>(bits >> 2);
+  }
+  return dest;
+}
+
+#if defined(BASE64_X86_SIMD)
+
+// Vector versions of the codec, after Wojciech Muła's SSE/AVX2 base64
+// algorithms. The 128 bit steps work within lanes, so the AVX2 functions
+// run the same sequence on two 12 or 16 byte blocks at once.
+
+#define BASE64_TARGET(isa) __attribute__((target(isa)))
+
+// Spreads 12 bytes into 16 6-bit indices, one per byte.
+BASE64_TARGET("ssse3")
+__m128i SplitSSSE3(__m128i in) {
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+// Maps 6-bit indices to their characters by adding an offset depending on
+// the range they fall in.
+BASE64_TARGET("ssse3")
+__m128i TranslateSSSE3(__m128i indices) {
+  __m128i ranges = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  ranges = _mm_or_si128(ranges, _mm_and_si128(less, _mm_set1_epi8(13)));
+  __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, ranges));
+}
+
+// Maps characters back to 6-bit values. Sets |invalid| to a non zero mask
+// if any byte is not in the alphabet.
+BASE64_TARGET("ssse3")
+__m128i UntranslateSSSE3(__m128i in, int* invalid) {
+  __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4),
+                                     _mm_set1_epi8(0x0f));
+  __m128i lo_nibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+
+  // Valid characters by low nibble, as a bit set of their high nibbles.
+  __m128i valid_his = _mm_setr_epi8(
+      0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x54,
+      0x50, 0x50, 0x50, 0x54);
+  __m128i hi_bits = _mm_setr_epi8(
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i matches = _mm_and_si128(_mm_shuffle_epi8(valid_his, lo_nibbles),
+                                  _mm_shuffle_epi8(hi_bits, hi_nibbles));
+  *invalid = _mm_movemask_epi8(_mm_cmpeq_epi8(matches, _mm_setzero_si128()));
+
+  // Offsets by high nibble, '/' being the only character needing another
+  // one than the rest of its range.
+  __m128i offsets = _mm_setr_epi8(
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i shift = _mm_shuffle_epi8(offsets, hi_nibbles);
+  __m128i slashes = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+  shift = _mm_add_epi8(shift, _mm_and_si128(slashes, _mm_set1_epi8(-3)));
+  return _mm_add_epi8(in, shift);
+}
+
+// Packs 16 6-bit values into the first 12 bytes.
+BASE64_TARGET("ssse3")
+__m128i PackSSSE3(__m128i values) {
+  __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  return _mm_shuffle_epi8(quads, _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+BASE64_TARGET("ssse3")
+size_t EncodeBlocksSSSE3(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  // Loads 16 bytes to use 12.
+  for (; i + 16 <= size; i += 12, dest += 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                     TranslateSSSE3(SplitSSSE3(in)));
+  }
+  return i;
+}
+
+BASE64_TARGET("ssse3")
+size_t DecodeBlocksSSSE3(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16, dest += 12) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    int invalid;
+    __m128i values = UntranslateSSSE3(in, &invalid);
+    // Padding, whitespace and errors are left to the scalar code.
+    if (invalid)
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), PackSSSE3(values));
+  }
+  return i;
+}
+
+BASE64_TARGET("avx2")
+__m256i SplitAVX2(__m256i in) {
+  in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+  __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+  __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+  __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+  return _mm256_or_si256(t1, t3);
+}
+
+BASE64_TARGET("avx2")
+__m256i TranslateAVX2(__m256i indices) {
+  __m256i ranges = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+  __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+  ranges = _mm256_or_si256(ranges,
+                           _mm256_and_si256(less, _mm256_set1_epi8(13)));
+  __m256i offsets = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, ranges));
+}
+
+BASE64_TARGET("avx2")
+__m256i UntranslateAVX2(__m256i in, int* invalid) {
+  __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4),
+                                        _mm256_set1_epi8(0x0f));
+  __m256i lo_nibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+
+  __m256i valid_his = _mm256_setr_epi8(
+      0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x54,
+      0x50, 0x50, 0x50, 0x54,
+      0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x54,
+      0x50, 0x50, 0x50, 0x54);
+  __m256i hi_bits = _mm256_setr_epi8(
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0,
+      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m256i matches = _mm256_and_si256(
+      _mm256_shuffle_epi8(valid_his, lo_nibbles),
+      _mm256_shuffle_epi8(hi_bits, hi_nibbles));
+  *invalid = _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(matches, _mm256_setzero_si256()));
+
+  __m256i offsets = _mm256_setr_epi8(
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m256i shift = _mm256_shuffle_epi8(offsets, hi_nibbles);
+  __m256i slashes = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+  shift = _mm256_add_epi8(shift,
+                          _mm256_and_si256(slashes, _mm256_set1_epi8(-3)));
+  return _mm256_add_epi8(in, shift);
+}
+
+// Packs 32 6-bit values into the first 24 bytes.
+BASE64_TARGET("avx2")
+__m256i PackAVX2(__m256i values) {
+  __m256i pairs = _mm256_maddubs_epi16(values,
+                                       _mm256_set1_epi32(0x01400140));
+  __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+  __m256i packed = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  return _mm256_permutevar8x32_epi32(packed,
+                                     _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+
+BASE64_TARGET("avx2")
+size_t EncodeBlocksAVX2(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  // Each lane loads 16 bytes to use 12, the second one starting 12 bytes
+  // after the first.
+  for (; i + 28 <= size; i += 24, dest += 32) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i hi =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest),
+                        TranslateAVX2(SplitAVX2(in)));
+  }
+  return i + EncodeBlocksSSSE3(src + i, size - i, dest);
+}
+
+BASE64_TARGET("avx2")
+size_t DecodeBlocksAVX2(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32, dest += 24) {
+    __m256i in =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    int invalid;
+    __m256i values = UntranslateAVX2(in, &invalid);
+    if (invalid)
+      break;
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), PackAVX2(values));
+  }
+  return i + DecodeBlocksSSSE3(src + i, size - i, dest);
+}
+
+#elif defined(BASE64_ARM_NEON)
+
+// NEON versions of the codec. The structure loads and stores spread 16
+// blocks of 3 bytes, or of 4 characters, over as many registers, so the
+// bits move within bytes only.
+
+// Maps 6-bit indices to their characters.
+uint8x16_t TranslateNEON(uint8x16_t indices) {
+  uint8x16_t offsets = vdupq_n_u8('A');
+  offsets = vbslq_u8(vcgeq_u8(indices, vdupq_n_u8(26)),
+                     vdupq_n_u8('a' - 26), offsets);
+  offsets = vbslq_u8(vcgeq_u8(indices, vdupq_n_u8(52)),
+                     vdupq_n_u8('0' - 52), offsets);
+  offsets = vbslq_u8(vceqq_u8(indices, vdupq_n_u8(62)),
+                     vdupq_n_u8('+' - 62), offsets);
+  offsets = vbslq_u8(vceqq_u8(indices, vdupq_n_u8(63)),
+                     vdupq_n_u8('/' - 63), offsets);
+  return vaddq_u8(indices, offsets);
+}
+
+// Maps characters back to 6-bit values. Clears the bytes of |valid| which
+// are not in the alphabet.
+uint8x16_t UntranslateNEON(uint8x16_t in, uint8x16_t* valid) {
+  uint8x16_t upper = vsubq_u8(in, vdupq_n_u8('A'));
+  uint8x16_t lower = vsubq_u8(in, vdupq_n_u8('a'));
+  uint8x16_t digit = vsubq_u8(in, vdupq_n_u8('0'));
+  uint8x16_t is_upper = vcltq_u8(upper, vdupq_n_u8(26));
+  uint8x16_t is_lower = vcltq_u8(lower, vdupq_n_u8(26));
+  uint8x16_t is_digit = vcltq_u8(digit, vdupq_n_u8(10));
+  uint8x16_t is_plus = vceqq_u8(in, vdupq_n_u8('+'));
+  uint8x16_t is_slash = vceqq_u8(in, vdupq_n_u8('/'));
+  *valid = vandq_u8(*valid, vorrq_u8(vorrq_u8(is_upper, is_lower),
+                                     vorrq_u8(vorrq_u8(is_digit, is_plus),
+                                              is_slash)));
+
+  uint8x16_t values = vandq_u8(is_upper, upper);
+  values = vorrq_u8(values,
+                    vandq_u8(is_lower, vaddq_u8(lower, vdupq_n_u8(26))));
+  values = vorrq_u8(values,
+                    vandq_u8(is_digit, vaddq_u8(digit, vdupq_n_u8(52))));
+  values = vorrq_u8(values, vandq_u8(is_plus, vdupq_n_u8(62)));
+  return vorrq_u8(values, vandq_u8(is_slash, vdupq_n_u8(63)));
+}
+
+bool AllSetNEON(uint8x16_t mask) {
+#if defined(__aarch64__)
+  return vminvq_u8(mask) == 0xff;
+#else
+  uint8x8_t min = vpmin_u8(vget_low_u8(mask), vget_high_u8(mask));
+  min = vpmin_u8(min, min);
+  min = vpmin_u8(min, min);
+  min = vpmin_u8(min, min);
+  return vget_lane_u8(min, 0) == 0xff;
+#endif
+}
+
+size_t EncodeBlocksNEON(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  for (; i + 48 <= size; i += 48, dest += 64) {
+    uint8x16x3_t in = vld3q_u8(src + i);
+    uint8x16x4_t out;
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(in.val[0], 4),
+                                   vdupq_n_u8(0x30)),
+                          vshrq_n_u8(in.val[1], 4));
+    out.val[2] = vorrq_u8(vandq_u8(vshlq_n_u8(in.val[1], 2),
+                                   vdupq_n_u8(0x3c)),
+                          vshrq_n_u8(in.val[2], 6));
+    out.val[3] = vandq_u8(in.val[2], vdupq_n_u8(0x3f));
+    for (int j = 0; j < 4; ++j)
+      out.val[j] = TranslateNEON(out.val[j]);
+    vst4q_u8(reinterpret_cast<uint8_t*>(dest), out);
+  }
+  return i;
+}
+
+size_t DecodeBlocksNEON(const uint8_t* src, size_t size, char* dest) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64, dest += 48) {
+    uint8x16x4_t in = vld4q_u8(src + i);
+    uint8x16_t valid = vdupq_n_u8(0xff);
+    for (int j = 0; j < 4; ++j)
+      in.val[j] = UntranslateNEON(in.val[j], &valid);
+    // Padding, whitespace and errors are left to the scalar code.
+    if (!AllSetNEON(valid))
+      break;
+    uint8x16x3_t out;
+    out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2),
+                          vshrq_n_u8(in.val[1], 4));
+    out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4),
+                          vshrq_n_u8(in.val[2], 2));
+    out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+    vst3q_u8(reinterpret_cast<uint8_t*>(dest), out);
+  }
+  return i;
+}
+
+#endif  // defined(BASE64_X86_SIMD)
+
+struct Codec {
+  Codec()
+      : encode_blocks(EncodeBlocksNone),
+        decode_blocks(DecodeBlocksNone) {
+#if defined(BASE64_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      encode_blocks = EncodeBlocksAVX2;
+      decode_blocks = DecodeBlocksAVX2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+      encode_blocks = EncodeBlocksSSSE3;
+      decode_blocks = DecodeBlocksSSSE3;
+    }
+#elif defined(BASE64_ARM_NEON)
+    encode_blocks = EncodeBlocksNEON;
+    decode_blocks = DecodeBlocksNEON;
+#endif
+  }
+
+  EncodeBlocksFunc encode_blocks;
+  DecodeBlocksFunc decode_blocks;
+};
+
+const Codec& GetCodec() {
+  static const Codec codec;
+  return codec;
+}
+
+}  // namespace
+
+std::string Encode(const char* data, size_t size) {
+  std::string out;
+  EncodeAppend(data, size, &out);
+  return out;
+}
+
+std::string Encode(const std::string& data) {
+  return Encode(data.data(), data.size());
+}
+
+void EncodeAppend(const char* data, size_t size, std::string* out) {
+  size_t offset = out->size();
+  out->resize(offset + EncodedSize(size));
+  char* dest = &(*out)[0] + offset;
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+
+  // Blocks are multiples of 3 bytes, so the vector part never needs
+  // padding.
+  size_t done = GetCodec().encode_blocks(src, size, dest);
+  EncodeScalar(src + done, size - done, dest + done / 3 * 4);
+}
+
+bool Decode(const char* input, size_t size, std::string* out) {
+  out->resize(size / 4 * 3 + kDecodeSlack);
+  char* dest = &(*out)[0];
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(input);
+
+  // The vector part stops at the first block with anything else than
+  // alphabet characters, and the rest is decoded from there.
+  size_t done = GetCodec().decode_blocks(src, size, dest);
+  char* end = DecodeScalar(src + done, size - done, dest + done / 4 * 3);
+  if (!end)
+    return false;
+  out->resize(end - dest);
+  return true;
+}
+
+bool Decode(const std::string& input, std::string* out) {
+  return Decode(input.data(), input.size(), out);
+}
+
+}  // namespace base64
+}  // namespace common
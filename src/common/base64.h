@@ -0,0 +1,37 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_BASE64_H_
+#define COMMON_BASE64_H_
+
+// Standard base64 (RFC 4648, with padding), for passing bytes through the
+// string based messaging.
+
+#include <stddef.h>
+
+#include <string>
+
+namespace common {
+namespace base64 {
+
+// Size of the encoding of |size| bytes.
+inline size_t EncodedSize(size_t size) {
+  return (size + 2) / 3 * 4;
+}
+
+std::string Encode(const char* data, size_t size);
+std::string Encode(const std::string& data);
+
+// Appends the encoding to |out|.
+void EncodeAppend(const char* data, size_t size, std::string* out);
+
+// ASCII whitespace is skipped. Returns false if |input| is not valid base64,
+// leaving |out| unspecified.
+bool Decode(const char* input, size_t size, std::string* out);
+bool Decode(const std::string& input, std::string* out);
+
+}  // namespace base64
+}  // namespace common
+
+#endif  // COMMON_BASE64_H_
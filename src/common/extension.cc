@@ -5,9 +5,21 @@
 #include "common/extension.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
+#include "common/base64.h"
+#include "common/message_batcher.h"
+#include "common/message_stats.h"
+#include "common/message_trace.h"
+#include "common/task_runner.h"
+#include "common/utils.h"
+
 namespace {
 
 common::Extension* g_extension = NULL;
@@ -15,11 +27,45 @@ XW_Extension g_xw_extension = 0;
 
 const XW_CoreInterface* g_core = NULL;
 const XW_MessagingInterface* g_messaging = NULL;
+const XW_MessagingInterface_2* g_binary_messaging = NULL;
 const XW_Internal_SyncMessagingInterface* g_sync_messaging = NULL;
 const XW_Internal_EntryPointsInterface* g_entry_points = NULL;
 const XW_Internal_RuntimeInterface* g_runtime = NULL;
 const XW_Internal_PermissionsInterface* g_permission = NULL;
 
+// Set when the traffic of the extension is being recorded.
+common::TraceWriter* g_trace = NULL;
+
+const char kTraceEnvironmentVariable[] = "XWALK_EXTENSION_TRACE";
+
+// Several extensions can share a process, so each writes its own file, named
+// after the prefix given in the environment.
+void StartTracing(const char* extension_name) {
+  const char* prefix = getenv(kTraceEnvironmentVariable);
+  if (!prefix || g_trace)
+    return;
+  std::string path = std::string(prefix) + extension_name + "." +
+      std::to_string(getpid()) + ".xwtrace";
+  g_trace = new common::TraceWriter;
+  if (!g_trace->Open(path)) {
+    std::cerr << "Can't open message trace " << path << "\n";
+    delete g_trace;
+    g_trace = NULL;
+  }
+}
+
+void Trace(common::TraceRecordType type, XW_Instance xw_instance,
+           const char* data, size_t size) {
+  if (g_trace)
+    g_trace->Write(type, xw_instance, data, size);
+}
+
+void Trace(common::TraceRecordType type, XW_Instance xw_instance,
+           const char* data) {
+  if (g_trace)
+    g_trace->Write(type, xw_instance, data, data ? strlen(data) : 0);
+}
+
 bool InitializeInterfaces(XW_GetInterface get_interface) {
   g_core = reinterpret_cast<const XW_CoreInterface*>(
       get_interface(XW_CORE_INTERFACE));
@@ -36,6 +82,13 @@ bool InitializeInterfaces(XW_GetInterface get_interface) {
     return false;
   }
 
+  g_binary_messaging = reinterpret_cast<const XW_MessagingInterface_2*>(
+      get_interface(XW_MESSAGING_INTERFACE_2));
+  if (!g_binary_messaging) {
+    std::cerr << "NOTE: binary messaging not available in this version "
+              << "of Crosswalk, binary messages are sent as base64.\n";
+  }
+
   g_sync_messaging =
       reinterpret_cast<const XW_Internal_SyncMessagingInterface*>(
           get_interface(XW_INTERNAL_SYNC_MESSAGING_INTERFACE));
@@ -69,8 +122,152 @@ bool InitializeInterfaces(XW_GetInterface get_interface) {
   return true;
 }
 
+const char* SkipSpace(const char* p) {
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+    ++p;
+  return p;
+}
+
+// Returns a pointer to the closing quote of the string starting at |p|, or
+// NULL if the string is not terminated.
+const char* SkipString(const char* p) {
+  while (*p && *p != '"') {
+    if (*p == '\\' && !*++p)
+      return NULL;
+    ++p;
+  }
+  return *p ? p : NULL;
+}
+
+// FNV-1a, good enough for the short command names used by extensions.
+uint32_t HashCommand(const char* cmd, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(cmd[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
 }  // namespace
 
+namespace common {
+
+// Open addressing hash table from command names to their handlers. Lookups
+// take the command as a pointer and length into the message being handled,
+// so no string is built for them.
+class CommandTable {
+ public:
+  struct Entry {
+    std::string cmd;
+    uint32_t hash;
+    Instance::MessageHandler handler;
+    Instance::SyncMessageHandler sync_handler;
+    Instance::ArenaMessageHandler arena_handler;
+    Instance::ArenaSyncMessageHandler arena_sync_handler;
+
+    bool HasHandler(bool sync) const {
+      if (sync)
+        return sync_handler || arena_sync_handler;
+      return handler || arena_handler;
+    }
+  };
+
+  CommandTable() {}
+
+  Entry* Find(const char* cmd, size_t length) {
+    if (slots_.empty())
+      return NULL;
+    uint32_t hash = HashCommand(cmd, length);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask; slots_[i]; i = (i + 1) & mask) {
+      Entry& entry = entries_[slots_[i] - 1];
+      if (entry.hash == hash && entry.cmd.size() == length &&
+          !memcmp(entry.cmd.data(), cmd, length))
+        return &entry;
+    }
+    return NULL;
+  }
+
+  Entry* FindOrInsert(const char* cmd) {
+    size_t length = strlen(cmd);
+    if (Entry* entry = Find(cmd, length))
+      return entry;
+
+    Entry entry;
+    entry.cmd.assign(cmd, length);
+    entry.hash = HashCommand(cmd, length);
+    entries_.push_back(entry);
+
+    // Keep the load factor under 1/2 so probe sequences stay short.
+    if (entries_.size() * 2 > slots_.size())
+      Rehash(std::max<size_t>(16, slots_.size() * 2));
+    else
+      Place(entries_.size() - 1);
+    return &entries_.back();
+  }
+
+ private:
+  void Rehash(size_t size) {
+    slots_.assign(size, 0);
+    for (size_t i = 0; i < entries_.size(); ++i)
+      Place(i);
+  }
+
+  void Place(size_t index) {
+    size_t mask = slots_.size() - 1;
+    size_t i = entries_[index].hash & mask;
+    while (slots_[i])
+      i = (i + 1) & mask;
+    slots_[i] = index + 1;
+  }
+
+  std::vector<Entry> entries_;
+  // Indexes into entries_ plus one, zero marks a free slot.
+  std::vector<size_t> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(CommandTable);
+};
+
+bool ExtractCommand(const char* msg, const char** cmd, size_t* length) {
+  int depth = 0;
+  const char* p = msg;
+  while (*p) {
+    if (*p == '"') {
+      const char* key = p + 1;
+      const char* key_end = SkipString(key);
+      if (!key_end)
+        return false;
+      p = key_end + 1;
+      if (depth != 1 || key_end - key != 3 || memcmp(key, "cmd", 3))
+        continue;
+      const char* q = SkipSpace(p);
+      if (*q != ':')
+        continue;
+      q = SkipSpace(q + 1);
+      if (*q != '"')
+        return false;
+      const char* value = q + 1;
+      const char* value_end = value;
+      while (*value_end && *value_end != '"' && *value_end != '\\')
+        ++value_end;
+      if (*value_end != '"')
+        return false;
+      *cmd = value;
+      *length = value_end - value;
+      return true;
+    }
+    if (*p == '{' || *p == '[')
+      ++depth;
+    else if ((*p == '}' || *p == ']') && --depth <= 0)
+      return false;
+    ++p;
+  }
+  return false;
+}
+
+}  // namespace common
+
 int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
   assert(extension);
   g_xw_extension = extension;
@@ -103,6 +300,8 @@ Extension::~Extension() {}
 
 void Extension::SetExtensionName(const char* name) {
   g_core->SetExtensionName(g_xw_extension, name);
+  message_stats::SetExtensionName(name);
+  StartTracing(name);
 }
 
 void Extension::SetJavaScriptAPI(const char* api) {
@@ -141,13 +340,17 @@ std::string Extension::GetRuntimeVariable(const char* var_name, unsigned len) {
 
 // static
 void Extension::OnShutdown(XW_Extension) {
+  message_stats::Dump();
   delete g_extension;
   g_extension = NULL;
+  delete g_trace;
+  g_trace = NULL;
 }
 
 // static
 void Extension::OnInstanceCreated(XW_Instance xw_instance) {
   assert(!g_core->GetInstanceData(xw_instance));
+  Trace(TRACE_INSTANCE_CREATED, xw_instance, NULL);
   Instance* instance = g_extension->CreateInstance();
   if (!instance)
     return;
@@ -162,8 +365,18 @@ void Extension::OnInstanceDestroyed(XW_Instance xw_instance) {
       reinterpret_cast<Instance*>(g_core->GetInstanceData(xw_instance));
   if (!instance)
     return;
+  // Tasks may still post messages and use the subclass, so they must be
+  // done before anything is torn down.
+  instance->task_runner_->CancelAndWait();
+  // The batcher lives on until ~Instance(), since the event sources of the
+  // subclasses may post until their destructors remove them. What they post
+  // from now on is dropped.
+  instance->FlushMessages();
   instance->xw_instance_ = 0;
   delete instance;
+  Trace(TRACE_INSTANCE_DESTROYED, xw_instance, NULL);
+  if (g_trace)
+    g_trace->Flush();
 }
 
 // static
@@ -172,7 +385,11 @@ void Extension::HandleMessage(XW_Instance xw_instance, const char* msg) {
       reinterpret_cast<Instance*>(g_core->GetInstanceData(xw_instance));
   if (!instance)
     return;
+  Trace(TRACE_MESSAGE, xw_instance, msg);
+  message_stats::DumpIfRequested();
+  message_stats::ScopedRecord record(msg, false);
   instance->HandleMessage(msg);
+  instance->FlushMessages();
 }
 
 // static
@@ -181,14 +398,33 @@ void Extension::HandleSyncMessage(XW_Instance xw_instance, const char* msg) {
       reinterpret_cast<Instance*>(g_core->GetInstanceData(xw_instance));
   if (!instance)
     return;
+  Trace(TRACE_SYNC_MESSAGE, xw_instance, msg);
+  message_stats::DumpIfRequested();
+  if (message_stats::IsEnabled()) {
+    const char* cmd;
+    size_t length;
+    if (ExtractCommand(msg, &cmd, &length) &&
+        length == strlen(message_stats::kStatsCommand) &&
+        !strncmp(cmd, message_stats::kStatsCommand, length)) {
+      instance->SendSyncReply(message_stats::Report().c_str());
+      return;
+    }
+  }
+  message_stats::ScopedRecord record(msg, true);
   instance->HandleSyncMessage(msg);
+  instance->FlushMessages();
 }
 
 Instance::Instance()
-    : xw_instance_(0) {}
+    : xw_instance_(0),
+      handlers_(new CommandTable),
+      task_runner_(new TaskRunner) {}
 
 Instance::~Instance() {
   assert(xw_instance_ == 0);
+  // The subclass is gone, and with it whatever could post. Unschedules the
+  // pending flush.
+  batcher_.reset();
 }
 
 void Instance::PostMessage(const char* msg) {
@@ -197,16 +433,186 @@ void Instance::PostMessage(const char* msg) {
               << "instance was destroyed.";
     return;
   }
+  if (message_stats::IsEnabled())
+    message_stats::AddBytesOut(strlen(msg));
+  Trace(TRACE_POST_MESSAGE, xw_instance_, msg);
+  if (batcher_) {
+    batcher_->Post(msg);
+    return;
+  }
   g_messaging->PostMessage(xw_instance_, msg);
 }
 
+void Instance::PostBinaryMessage(const std::string& header, const char* data,
+                                 size_t size) {
+  if (!xw_instance_) {
+    std::cerr << "Ignoring PostBinaryMessage() in the constructor or after "
+              << "the instance was destroyed.";
+    return;
+  }
+  if (header.empty() || header[header.size() - 1] != '}') {
+    std::cerr << "Ignoring PostBinaryMessage() with a header which is not a "
+              << "JSON object.\n";
+    return;
+  }
+
+  if (!g_binary_messaging) {
+    std::string msg(header, 0, header.size() - 1);
+    msg.reserve(msg.size() + base64::EncodedSize(size) + 16);
+    if (header.find_first_not_of("{ \t\r\n") != header.size() - 1)
+      msg += ',';
+    msg += "\"binary\":\"";
+    base64::EncodeAppend(data, size, &msg);
+    msg += "\"}";
+    PostMessage(msg.c_str());
+    return;
+  }
+
+  // Earlier messages held back by batching must get there first.
+  FlushMessages();
+  std::string msg;
+  msg.reserve(header.size() + 1 + size);
+  msg += header;
+  msg += '\0';
+  msg.append(data, size);
+  if (message_stats::IsEnabled())
+    message_stats::AddBytesOut(msg.size());
+  Trace(TRACE_POST_BINARY_MESSAGE, xw_instance_, msg.data(), msg.size());
+  g_binary_messaging->PostBinaryMessage(xw_instance_, msg.data(), msg.size());
+}
+
+void Instance::FlushMessages() {
+  if (batcher_)
+    batcher_->Flush();
+}
+
+void Instance::PostTask(const std::function<void()>& task) {
+  task_runner_->PostTask(task);
+}
+
+void Instance::PostLongTask(const std::function<void()>& task) {
+  task_runner_->PostLongTask(task);
+}
+
+bool Instance::TasksCancelled() const {
+  return task_runner_->IsCancelled();
+}
+
+void Instance::EnableMessageBatching(unsigned window_ms, size_t max_bytes) {
+  batcher_.reset(new MessageBatcher([this](const char* msg) {
+    // A flush may still be due after the instance was destroyed.
+    if (xw_instance_)
+      g_messaging->PostMessage(xw_instance_, msg);
+  }, window_ms, max_bytes));
+}
+
 void Instance::SendSyncReply(const char* reply) {
   if (!xw_instance_) {
     std::cerr << "Ignoring SendSyncReply() in the constructor or after the "
               << "instance was destroyed.";
     return;
   }
+  if (message_stats::IsEnabled())
+    message_stats::AddBytesOut(strlen(reply));
+  Trace(TRACE_SYNC_REPLY, xw_instance_, reply);
   g_sync_messaging->SetSyncReply(xw_instance_, reply);
 }
 
+void Instance::HandleMessage(const char* msg) {
+  DispatchMessage(msg, NULL);
+}
+
+void Instance::HandleSyncMessage(const char* msg) {
+  std::string reply;
+  // The caller waits for a reply, even to a message which was dropped.
+  if (!DispatchMessage(msg, &reply))
+    reply = "{\"error\":true}";
+  if (!reply.empty())
+    SendSyncReply(reply.c_str());
+}
+
+void Instance::RegisterHandler(const char* cmd,
+                               const MessageHandler& handler) {
+  handlers_->FindOrInsert(cmd)->handler = handler;
+}
+
+void Instance::RegisterSyncHandler(const char* cmd,
+                                   const SyncMessageHandler& handler) {
+  handlers_->FindOrInsert(cmd)->sync_handler = handler;
+}
+
+void Instance::RegisterArenaHandler(const char* cmd,
+                                    const ArenaMessageHandler& handler) {
+  handlers_->FindOrInsert(cmd)->arena_handler = handler;
+}
+
+void Instance::RegisterArenaSyncHandler(
+    const char* cmd, const ArenaSyncMessageHandler& handler) {
+  handlers_->FindOrInsert(cmd)->arena_sync_handler = handler;
+}
+
+bool Instance::DispatchMessage(const char* msg, std::string* reply) {
+  picojson::value v;
+  bool parsed = false;
+  std::string err;
+
+  const char* cmd;
+  size_t length;
+  std::string cmd_str;
+  if (!ExtractCommand(msg, &cmd, &length)) {
+    // Fall back to a full parse, e.g. for commands with escaped characters.
+    picojson::parse(v, msg, msg + strlen(msg), &err);
+    if (!err.empty() || !v.is<picojson::object>()) {
+      std::cerr << "Ignoring message.\n";
+      return false;
+    }
+    parsed = true;
+    cmd_str = v.get("cmd").to_str();
+    cmd = cmd_str.data();
+    length = cmd_str.size();
+  }
+
+  CommandTable::Entry* entry = handlers_->Find(cmd, length);
+  if (!entry || !entry->HasHandler(reply != NULL)) {
+    std::cerr << "Ignoring unknown command: "
+              << std::string(cmd, length) << "\n";
+    return false;
+  }
+
+  bool use_arena = reply ? static_cast<bool>(entry->arena_sync_handler) :
+                          static_cast<bool>(entry->arena_handler);
+  if (use_arena) {
+    if (!arena_)
+      arena_.reset(new JsonArena);
+    const JsonValue* root =
+        ParseJson(msg, msg + strlen(msg), arena_.get(), &err);
+    if (root) {
+      if (reply)
+        entry->arena_sync_handler(*root, *reply);
+      else
+        entry->arena_handler(*root);
+    } else {
+      std::cerr << "Ignoring message.\n";
+    }
+    arena_->Reset();
+    return root != NULL;
+  }
+
+  if (!parsed) {
+    picojson::parse(v, msg, msg + strlen(msg), &err);
+    if (!err.empty()) {
+      std::cerr << "Ignoring message.\n";
+      return false;
+    }
+  }
+
+  if (reply) {
+    if (entry->sync_handler)
+      entry->sync_handler(v, *reply);
+  } else if (entry->handler) {
+    entry->handler(v);
+  }
+  return true;
+}
+
 }  // namespace common
@@ -18,6 +18,8 @@
 
 #include <sys/types.h>
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include "common/XW_Extension.h"
@@ -25,10 +27,15 @@
 #include "common/XW_Extension_Permissions.h"
 #include "common/XW_Extension_Runtime.h"
 #include "common/XW_Extension_SyncMessage.h"
+#include "common/json_arena.h"
+#include "common/picojson.h"
 
 namespace common {
 
+class CommandTable;
 class Instance;
+class MessageBatcher;
+class TaskRunner;
 class Extension;
 
 }  // namespace common
@@ -71,6 +78,12 @@ class Extension {
   static void HandleSyncMessage(XW_Instance xw_instance, const char* msg);
 };
 
+// Finds the value of the top-level "cmd" key of the JSON message |msg|
+// without parsing the rest of it. On success |cmd| points inside |msg| and
+// |length| is set to the length of the value. Values containing escape
+// sequences are not handled and make this function return false.
+bool ExtractCommand(const char* msg, const char** cmd, size_t* length);
+
 class Instance {
  public:
   Instance();
@@ -79,16 +92,82 @@ class Instance {
   void PostMessage(const char* msg);
   void SendSyncReply(const char* reply);
 
+  // Posts |size| bytes of |data| along with |header|, a serialized JSON
+  // object. Runtimes supporting binary messages deliver the header, a NUL
+  // byte and the data as one ArrayBuffer. Otherwise |header| is posted as a
+  // string, with the data added under "binary" in base64, which is 4/3 of
+  // the size instead of 4-5 times as a JSON array of numbers. JavaScript
+  // gets either back with xwalk.utils.parseMessage().
+  void PostBinaryMessage(const std::string& header, const char* data,
+                         size_t size);
+
+  // Sends the messages held back by batching, if enabled. This is done
+  // after every message handled by the instance, so replies are not delayed.
+  void FlushMessages();
+
   virtual void Initialize() {}
-  virtual void HandleMessage(const char* msg) = 0;
-  virtual void HandleSyncMessage(const char* msg) {}
+
+  // The default implementations dispatch |msg| to the handler registered for
+  // its "cmd" with RegisterHandler() or RegisterSyncHandler(). Instances doing
+  // their own parsing can still override them. Sync messages which cannot be
+  // parsed or have no handler are answered with {"error":true}.
+  virtual void HandleMessage(const char* msg);
+  virtual void HandleSyncMessage(const char* msg);
 
   XW_Instance xw_instance() const { return xw_instance_; }
 
+ protected:
+  typedef std::function<void(const picojson::value&)> MessageHandler;
+  typedef std::function<void(const picojson::value&, std::string&)>
+      SyncMessageHandler;
+
+  // These should be called in the subclass constructor. The command name is
+  // looked up in a hash table before the message is fully parsed, so unknown
+  // commands are dropped cheaply. A sync handler fills in the reply, which is
+  // sent back if it is not empty.
+  void RegisterHandler(const char* cmd, const MessageHandler& handler);
+  void RegisterSyncHandler(const char* cmd, const SyncMessageHandler& handler);
+
+  typedef std::function<void(const JsonValue&)> ArenaMessageHandler;
+  typedef std::function<void(const JsonValue&, std::string&)>
+      ArenaSyncMessageHandler;
+
+  // Same as above, but the message is parsed into an arena which is released
+  // as soon as the handler returns. Meant for hot commands; the handler must
+  // not keep references to the message.
+  void RegisterArenaHandler(const char* cmd,
+                            const ArenaMessageHandler& handler);
+  void RegisterArenaSyncHandler(const char* cmd,
+                                const ArenaSyncMessageHandler& handler);
+
+  // Opt-in for instances posting bursts of events. Messages posted within
+  // |window_ms| of the first pending one are sent together as a JSON array,
+  // or earlier if they add up to |max_bytes|. The JavaScript side must
+  // unpack arrays, see xwalk.utils.dispatchMessages().
+  void EnableMessageBatching(unsigned window_ms, size_t max_bytes);
+
+  // Runs |task| on a worker thread, for handlers doing slow work. The reply
+  // is posted from the task. When the instance is destroyed, tasks not
+  // started yet are dropped and running ones are waited for before any
+  // destructor runs; long tasks should poll TasksCancelled() to stop early.
+  void PostTask(const std::function<void()>& task);
+  // Same as PostTask(), but for tasks running as long as the user asks, such
+  // as copies of whole trees, which would hold a shared worker meanwhile.
+  void PostLongTask(const std::function<void()>& task);
+  bool TasksCancelled() const;
+
  private:
+  friend class CommandTable;
   friend class Extension;
 
+  // Returns false if the message was dropped.
+  bool DispatchMessage(const char* msg, std::string* reply);
+
   XW_Instance xw_instance_;
+  std::unique_ptr<CommandTable> handlers_;
+  std::unique_ptr<JsonArena> arena_;
+  std::unique_ptr<MessageBatcher> batcher_;
+  std::unique_ptr<TaskRunner> task_runner_;
 };
 
 }  // namespace common
@@ -0,0 +1,287 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/json_arena.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+namespace {
+
+const size_t kMinBlockSize = 8 * 1024;
+// Don't keep more than this around between messages.
+const size_t kMaxRetainedSize = 1024 * 1024;
+const size_t kAlignment = sizeof(double);
+
+size_t Align(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+namespace common {
+
+JsonArena::JsonArena()
+    : first_block_size_(kMinBlockSize),
+      used_(0),
+      cursor_(NULL),
+      end_(NULL) {}
+
+JsonArena::~JsonArena() {
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    delete[] blocks_[i];
+}
+
+void JsonArena::AddBlock(size_t size) {
+  char* block = new char[size];
+  blocks_.push_back(block);
+  cursor_ = block;
+  end_ = block + size;
+}
+
+void* JsonArena::Allocate(size_t size) {
+  size = Align(size);
+  if (static_cast<size_t>(end_ - cursor_) < size) {
+    size_t block_size = blocks_.empty() ? first_block_size_ : kMinBlockSize;
+    AddBlock(std::max(block_size, size));
+  }
+  void* result = cursor_;
+  cursor_ += size;
+  used_ += size;
+  return result;
+}
+
+void JsonArena::Reset() {
+  if (blocks_.size() > 1) {
+    // Merge into one block big enough for the peak usage.
+    for (size_t i = 0; i < blocks_.size(); ++i)
+      delete[] blocks_[i];
+    blocks_.clear();
+    first_block_size_ = std::min(std::max(Align(used_), kMinBlockSize),
+                                 kMaxRetainedSize);
+    AddBlock(first_block_size_);
+  } else if (!blocks_.empty()) {
+    cursor_ = blocks_[0];
+  }
+  used_ = 0;
+}
+
+JsonValue::JsonValue()
+    : type_(picojson::null_type),
+      size_(0) {
+  u_.number_ = 0;
+}
+
+bool JsonValue::evaluate_as_boolean() const {
+  switch (type_) {
+    case picojson::null_type:
+      return false;
+    case picojson::boolean_type:
+      return u_.boolean_;
+    case picojson::number_type:
+      return u_.number_ != 0;
+    case picojson::string_type:
+      return size_ != 0;
+    default:
+      return true;
+  }
+}
+
+const JsonValue& JsonValue::get(size_t idx) const {
+  static const JsonValue s_null;
+  if (!is<picojson::array>() || idx >= size_)
+    return s_null;
+  return u_.array_[idx];
+}
+
+bool JsonValue::contains(size_t idx) const {
+  return is<picojson::array>() && idx < size_;
+}
+
+const JsonMember* JsonValue::FindMember(const char* key) const {
+  if (!is<picojson::object>())
+    return NULL;
+  size_t key_length = strlen(key);
+  for (size_t i = size_; i-- > 0;) {
+    const JsonMember& member = u_.object_[i];
+    if (member.key_length == key_length &&
+        !memcmp(member.key, key, key_length))
+      return &member;
+  }
+  return NULL;
+}
+
+const JsonValue& JsonValue::get(const char* key) const {
+  static const JsonValue s_null;
+  const JsonMember* member = FindMember(key);
+  return member ? member->value : s_null;
+}
+
+bool JsonValue::contains(const char* key) const {
+  return FindMember(key) != NULL;
+}
+
+bool JsonValue::equals(const char* str) const {
+  return is<std::string>() && strlen(str) == size_ &&
+      !memcmp(u_.string_, str, size_);
+}
+
+std::string JsonValue::to_str() const {
+  switch (type_) {
+    case picojson::string_type:
+      return std::string(u_.string_, size_);
+    case picojson::number_type:
+      return picojson::value(u_.number_).to_str();
+    case picojson::boolean_type:
+      return u_.boolean_ ? "true" : "false";
+    case picojson::array_type:
+      return "array";
+    case picojson::object_type:
+      return "object";
+    default:
+      return "null";
+  }
+}
+
+// Glue between picojson's tokenizer and the arena. Parsing a value pushes
+// its items or members to the scratch vectors of the arena, which are moved
+// into a contiguous arena allocation once the value is complete.
+class JsonArenaParser {
+ public:
+  explicit JsonArenaParser(JsonArena* arena) : arena_(arena) {
+    // Leftovers of a failed parse.
+    arena_->items_.clear();
+    arena_->members_.clear();
+  }
+
+  typedef picojson::input<const char*> Input;
+
+  bool Parse(JsonValue* out, Input& in) {
+    size_t item_base = arena_->items_.size();
+    size_t member_base = arena_->members_.size();
+    Context ctx(out, this);
+    if (!picojson::_parse(ctx, in))
+      return false;
+
+    if (out->type_ == picojson::array_type) {
+      std::vector<JsonValue>& items = arena_->items_;
+      out->size_ = items.size() - item_base;
+      JsonValue* array = static_cast<JsonValue*>(
+          arena_->Allocate(out->size_ * sizeof(JsonValue)));
+      std::copy(items.begin() + item_base, items.end(), array);
+      items.resize(item_base);
+      out->u_.array_ = array;
+    } else if (out->type_ == picojson::object_type) {
+      std::vector<JsonMember>& members = arena_->members_;
+      out->size_ = members.size() - member_base;
+      JsonMember* object = static_cast<JsonMember*>(
+          arena_->Allocate(out->size_ * sizeof(JsonMember)));
+      std::copy(members.begin() + member_base, members.end(), object);
+      members.resize(member_base);
+      out->u_.object_ = object;
+    }
+    return true;
+  }
+
+ private:
+  class Context {
+   public:
+    Context(JsonValue* out, JsonArenaParser* parser)
+        : out_(out), parser_(parser) {}
+
+    bool set_null() {
+      out_->type_ = picojson::null_type;
+      return true;
+    }
+    bool set_bool(bool b) {
+      out_->type_ = picojson::boolean_type;
+      out_->u_.boolean_ = b;
+      return true;
+    }
+    bool set_number(double f) {
+      out_->type_ = picojson::number_type;
+      out_->u_.number_ = f;
+      return true;
+    }
+    bool parse_string(Input& in) {
+      // The opening quote has just been consumed.
+      const char* begin = in.cur();
+      std::string& scratch = parser_->arena_->scratch_;
+      scratch.clear();
+      if (!picojson::_parse_string(scratch, in))
+        return false;
+
+      out_->type_ = picojson::string_type;
+      out_->size_ = scratch.size();
+      // Escape sequences always decode to fewer bytes, so an unchanged
+      // length means the string can be used in place.
+      if (static_cast<size_t>(in.cur() - 1 - begin) == scratch.size()) {
+        out_->u_.string_ = begin;
+      } else {
+        char* copy = static_cast<char*>(
+            parser_->arena_->Allocate(scratch.size()));
+        memcpy(copy, scratch.data(), scratch.size());
+        out_->u_.string_ = copy;
+      }
+      return true;
+    }
+    bool parse_array_start() {
+      out_->type_ = picojson::array_type;
+      return true;
+    }
+    bool parse_array_item(Input& in, size_t) {
+      JsonValue item;
+      if (!parser_->Parse(&item, in))
+        return false;
+      parser_->arena_->items_.push_back(item);
+      return true;
+    }
+    bool parse_object_start() {
+      out_->type_ = picojson::object_type;
+      return true;
+    }
+    bool parse_object_item(Input& in, const std::string& key) {
+      JsonMember member;
+      if (!parser_->Parse(&member.value, in))
+        return false;
+      char* key_copy = static_cast<char*>(
+          parser_->arena_->Allocate(key.size()));
+      memcpy(key_copy, key.data(), key.size());
+      member.key = key_copy;
+      member.key_length = key.size();
+      parser_->arena_->members_.push_back(member);
+      return true;
+    }
+
+   private:
+    JsonValue* out_;
+    JsonArenaParser* parser_;
+  };
+
+  JsonArena* arena_;
+};
+
+const JsonValue* ParseJson(const char* begin, const char* end,
+                           JsonArena* arena, std::string* err) {
+  JsonValue* root = new (arena->Allocate(sizeof(JsonValue))) JsonValue;
+  JsonArenaParser parser(arena);
+  JsonArenaParser::Input in(begin, end);
+  if (parser.Parse(root, in))
+    return root;
+
+  // Same error format as picojson::parse().
+  char buf[64];
+  snprintf(buf, sizeof(buf), "syntax error at line %d near: ", in.line());
+  *err = buf;
+  for (int ch = in.getc(); ch != -1 && ch != '\n'; ch = in.getc()) {
+    if (ch >= ' ')
+      err->push_back(ch);
+  }
+  return NULL;
+}
+
+}  // namespace common
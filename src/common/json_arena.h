@@ -0,0 +1,144 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_JSON_ARENA_H_
+#define COMMON_JSON_ARENA_H_
+
+// An allocation-free alternative to picojson::parse() for inbound messages.
+//
+// Every node of the parsed document is placed into a JsonArena, a bump
+// allocator which is released in one shot with Reset() once the message has
+// been handled. Objects are stored as flat arrays of members instead of
+// std::map, and strings without escape sequences point directly into the
+// message being parsed, so the message must outlive the parsed values.
+//
+// JsonValue mimics the read-only part of the picojson::value interface so
+// handlers can be moved from one to the other with few changes.
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "common/picojson.h"
+#include "common/utils.h"
+
+namespace common {
+
+class JsonValue;
+struct JsonMember;
+
+class JsonArena {
+ public:
+  JsonArena();
+  ~JsonArena();
+
+  // Returns |size| bytes aligned for any JSON node.
+  void* Allocate(size_t size);
+
+  // Releases everything allocated since the last call. The memory is kept
+  // in a single block sized after the peak usage, so the next messages of
+  // similar size don't allocate at all.
+  void Reset();
+
+ private:
+  friend class JsonArenaParser;
+
+  void AddBlock(size_t size);
+
+  std::vector<char*> blocks_;
+  size_t first_block_size_;
+  size_t used_;
+  char* cursor_;
+  char* end_;
+
+  // Scratch space reused by the parser across messages.
+  std::vector<JsonValue> items_;
+  std::vector<JsonMember> members_;
+  std::string scratch_;
+
+  DISALLOW_COPY_AND_ASSIGN(JsonArena);
+};
+
+class JsonValue {
+ public:
+  JsonValue();
+
+  template <typename T> bool is() const;
+  template <typename T> T get() const;
+  bool evaluate_as_boolean() const;
+
+  // Arrays.
+  const JsonValue& get(size_t idx) const;
+  bool contains(size_t idx) const;
+
+  // Objects. Like picojson, the last of duplicated keys wins.
+  const JsonValue& get(const char* key) const;
+  bool contains(const char* key) const;
+  const JsonMember* members() const { return u_.object_; }
+
+  // Strings are not NUL terminated.
+  const char* data() const { return u_.string_; }
+  // Length of strings, number of items of arrays or members of objects.
+  size_t size() const { return size_; }
+  bool equals(const char* str) const;
+
+  std::string to_str() const;
+
+ private:
+  friend class JsonArenaParser;
+
+  const JsonMember* FindMember(const char* key) const;
+
+  int type_;
+  size_t size_;
+  union {
+    bool boolean_;
+    double number_;
+    const char* string_;
+    const JsonValue* array_;
+    const JsonMember* object_;
+  } u_;
+};
+
+struct JsonMember {
+  const char* key;
+  size_t key_length;
+  JsonValue value;
+};
+
+// Parses the JSON text in [begin, end) into |arena|. Returns NULL and fills
+// |err| on syntax errors.
+const JsonValue* ParseJson(const char* begin, const char* end,
+                           JsonArena* arena, std::string* err);
+
+template <> inline bool JsonValue::is<picojson::null>() const {
+  return type_ == picojson::null_type;
+}
+template <> inline bool JsonValue::is<bool>() const {
+  return type_ == picojson::boolean_type;
+}
+template <> inline bool JsonValue::is<double>() const {
+  return type_ == picojson::number_type;
+}
+template <> inline bool JsonValue::is<std::string>() const {
+  return type_ == picojson::string_type;
+}
+template <> inline bool JsonValue::is<picojson::array>() const {
+  return type_ == picojson::array_type;
+}
+template <> inline bool JsonValue::is<picojson::object>() const {
+  return type_ == picojson::object_type;
+}
+
+template <> inline bool JsonValue::get<bool>() const {
+  return is<bool>() && u_.boolean_;
+}
+template <> inline double JsonValue::get<double>() const {
+  return is<double>() ? u_.number_ : 0;
+}
+
+}  // namespace common
+
+#endif  // COMMON_JSON_ARENA_H_
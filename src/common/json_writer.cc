@@ -0,0 +1,157 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/json_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <iterator>
+
+namespace {
+
+// Whether the character needs an escape sequence, following the rules of
+// picojson::serialize_str().
+inline bool NeedsEscape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\' || c == '/' || c == 0x7f;
+}
+
+}  // namespace
+
+namespace common {
+
+JsonWriter::JsonWriter()
+    : needs_comma_(false) {}
+
+void JsonWriter::Reset() {
+  buffer_.clear();
+  needs_comma_ = false;
+}
+
+void JsonWriter::Separate() {
+  if (needs_comma_)
+    buffer_.push_back(',');
+  needs_comma_ = true;
+}
+
+void JsonWriter::BeginObject() {
+  Separate();
+  buffer_.push_back('{');
+  needs_comma_ = false;
+}
+
+void JsonWriter::EndObject() {
+  buffer_.push_back('}');
+  needs_comma_ = true;
+}
+
+void JsonWriter::BeginArray() {
+  Separate();
+  buffer_.push_back('[');
+  needs_comma_ = false;
+}
+
+void JsonWriter::EndArray() {
+  buffer_.push_back(']');
+  needs_comma_ = true;
+}
+
+void JsonWriter::Key(const char* key) {
+  Separate();
+  AppendEscaped(key, strlen(key));
+  buffer_.push_back(':');
+  needs_comma_ = false;
+}
+
+void JsonWriter::Key(const std::string& key) {
+  Separate();
+  AppendEscaped(key.data(), key.size());
+  buffer_.push_back(':');
+  needs_comma_ = false;
+}
+
+void JsonWriter::String(const char* str, size_t length) {
+  Separate();
+  AppendEscaped(str, length);
+}
+
+void JsonWriter::String(const char* str) {
+  String(str, strlen(str));
+}
+
+void JsonWriter::String(const std::string& str) {
+  String(str.data(), str.size());
+}
+
+void JsonWriter::Number(double number) {
+  Separate();
+  if (!isfinite(number)) {
+    // JSON has no representation for these.
+    buffer_.append("null");
+    return;
+  }
+  char buf[64];
+  double integral;
+  snprintf(buf, sizeof(buf),
+           fabs(number) < (1ULL << 53) && modf(number, &integral) == 0 ?
+               "%.f" : "%.17g",
+           number);
+  buffer_.append(buf);
+}
+
+void JsonWriter::Bool(bool b) {
+  Separate();
+  buffer_.append(b ? "true" : "false");
+}
+
+void JsonWriter::Null() {
+  Separate();
+  buffer_.append("null");
+}
+
+void JsonWriter::Value(const picojson::value& value) {
+  Separate();
+  value.serialize(std::back_inserter(buffer_));
+}
+
+void JsonWriter::RawValue(const std::string& json) {
+  Separate();
+  buffer_.append(json);
+}
+
+void JsonWriter::AppendEscaped(const char* str, size_t length) {
+  buffer_.push_back('"');
+  const char* end = str + length;
+  while (str != end) {
+    // Copy runs of characters which don't need escaping in one go.
+    const char* run = str;
+    while (str != end && !NeedsEscape(*str))
+      ++str;
+    buffer_.append(run, str - run);
+    if (str == end)
+      break;
+
+    unsigned char c = *str++;
+    switch (c) {
+      case '"': buffer_.append("\\\""); break;
+      case '\\': buffer_.append("\\\\"); break;
+      case '/': buffer_.append("\\/"); break;
+      case '\b': buffer_.append("\\b"); break;
+      case '\f': buffer_.append("\\f"); break;
+      case '\n': buffer_.append("\\n"); break;
+      case '\r': buffer_.append("\\r"); break;
+      case '\t': buffer_.append("\\t"); break;
+      default: {
+        char buf[7];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        buffer_.append(buf, 6);
+        break;
+      }
+    }
+  }
+  buffer_.push_back('"');
+}
+
+}  // namespace common
@@ -0,0 +1,80 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_JSON_WRITER_H_
+#define COMMON_JSON_WRITER_H_
+
+// Serializes JSON straight into a buffer, without building a picojson::value
+// tree first. Meant for big outbound replies, which can be handed to
+// Instance::PostMessage() with c_str() once complete:
+//
+//   common::JsonWriter writer;
+//   writer.BeginObject();
+//   writer.Key("replyId");
+//   writer.Number(reply_id);
+//   writer.Key("value");
+//   writer.BeginArray();
+//   for (...)
+//     writer.String(item);
+//   writer.EndArray();
+//   writer.EndObject();
+//   PostMessage(writer.c_str());
+//
+// Strings are escaped and numbers are formatted exactly like picojson does.
+// The writer does not validate the structure, callers are expected to balance
+// Begin/End calls and to precede every member value with Key().
+
+#include <stddef.h>
+
+#include <string>
+
+#include "common/picojson.h"
+#include "common/utils.h"
+
+namespace common {
+
+class JsonWriter {
+ public:
+  JsonWriter();
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void Key(const char* key);
+  void Key(const std::string& key);
+
+  void String(const char* str, size_t length);
+  void String(const char* str);
+  void String(const std::string& str);
+  void Number(double number);
+  void Bool(bool b);
+  void Null();
+  // For the parts of a reply which already exist as a picojson tree.
+  void Value(const picojson::value& value);
+  // Appends |json| as is. It must be a complete serialized value.
+  void RawValue(const std::string& json);
+
+  const char* c_str() const { return buffer_.c_str(); }
+  size_t size() const { return buffer_.size(); }
+  const std::string& str() const { return buffer_; }
+
+  void Reserve(size_t size) { buffer_.reserve(size); }
+  // Starts a new document, keeping the allocated buffer around.
+  void Reset();
+
+ private:
+  void Separate();
+  void AppendEscaped(const char* str, size_t length);
+
+  std::string buffer_;
+  bool needs_comma_;
+
+  DISALLOW_COPY_AND_ASSIGN(JsonWriter);
+};
+
+}  // namespace common
+
+#endif  // COMMON_JSON_WRITER_H_
@@ -0,0 +1,128 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/message_batcher.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Wakes up when the window of a batcher expires and flushes it. Batchers are
+// flushed with the scheduler lock held, so once Cancel() returns the batcher
+// is guaranteed not to be used by the thread anymore.
+class FlushScheduler {
+ public:
+  static FlushScheduler* GetInstance() {
+    // Leaked on purpose, the thread runs until the process exits.
+    static FlushScheduler* instance = new FlushScheduler;
+    return instance;
+  }
+
+  void Schedule(common::MessageBatcher* batcher, Clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_started_) {
+      std::thread(&FlushScheduler::Run, this).detach();
+      thread_started_ = true;
+    }
+    deadlines_.push_back(std::make_pair(deadline, batcher));
+    cond_.notify_one();
+  }
+
+  void Cancel(common::MessageBatcher* batcher) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = deadlines_.size(); i-- > 0;) {
+      if (deadlines_[i].second == batcher)
+        deadlines_.erase(deadlines_.begin() + i);
+    }
+  }
+
+ private:
+  typedef std::pair<Clock::time_point, common::MessageBatcher*> Deadline;
+
+  FlushScheduler() : thread_started_(false) {}
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      if (deadlines_.empty()) {
+        cond_.wait(lock);
+        continue;
+      }
+      std::vector<Deadline>::iterator next =
+          std::min_element(deadlines_.begin(), deadlines_.end());
+      if (Clock::now() < next->first) {
+        cond_.wait_until(lock, next->first);
+        continue;
+      }
+      common::MessageBatcher* batcher = next->second;
+      deadlines_.erase(next);
+      batcher->Flush();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<Deadline> deadlines_;
+  bool thread_started_;
+};
+
+}  // namespace
+
+namespace common {
+
+MessageBatcher::MessageBatcher(const Sender& sender, unsigned window_ms,
+                               size_t max_bytes)
+    : sender_(sender),
+      window_(window_ms),
+      max_bytes_(max_bytes),
+      count_(0) {}
+
+MessageBatcher::~MessageBatcher() {
+  FlushScheduler::GetInstance()->Cancel(this);
+}
+
+void MessageBatcher::Post(const char* msg) {
+  bool schedule;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_.push_back(count_ ? ',' : '[');
+    batch_.append(msg);
+    schedule = ++count_ == 1;
+    if (batch_.size() >= max_bytes_) {
+      FlushLocked();
+      schedule = false;
+    }
+  }
+  // Outside of our lock, the scheduler takes it while flushing.
+  if (schedule)
+    FlushScheduler::GetInstance()->Schedule(this, Clock::now() + window_);
+}
+
+void MessageBatcher::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FlushLocked();
+}
+
+void MessageBatcher::FlushLocked() {
+  if (!count_)
+    return;
+  if (count_ == 1) {
+    // Skip the opening bracket.
+    sender_(batch_.c_str() + 1);
+  } else {
+    batch_.push_back(']');
+    sender_(batch_.c_str());
+  }
+  // Keeps the capacity for the next batch.
+  batch_.clear();
+  count_ = 0;
+}
+
+}  // namespace common
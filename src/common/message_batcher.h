@@ -0,0 +1,59 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_MESSAGE_BATCHER_H_
+#define COMMON_MESSAGE_BATCHER_H_
+
+// Coalesces outbound messages of an instance to save IPC round trips.
+//
+// Messages posted within a time window of the first pending one are joined
+// into a single JSON array and sent together, either when the window expires
+// or when the batch grows past a size limit. A batch holding a single message
+// is sent as is. The receiving JavaScript has to unpack arrays, so all the
+// messages must be JSON values other than arrays.
+//
+// Expired windows are flushed from a background thread shared by all the
+// batchers, so the sender must be callable from any thread.
+
+#include <stddef.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "common/utils.h"
+
+namespace common {
+
+class MessageBatcher {
+ public:
+  typedef std::function<void(const char*)> Sender;
+
+  MessageBatcher(const Sender& sender, unsigned window_ms, size_t max_bytes);
+  // Pending messages are dropped.
+  ~MessageBatcher();
+
+  void Post(const char* msg);
+  // Sends the pending messages right away.
+  void Flush();
+
+ private:
+  void FlushLocked();
+
+  Sender sender_;
+  std::chrono::milliseconds window_;
+  size_t max_bytes_;
+
+  std::mutex mutex_;
+  // The opening bracket followed by the comma separated messages.
+  std::string batch_;
+  size_t count_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageBatcher);
+};
+
+}  // namespace common
+
+#endif  // COMMON_MESSAGE_BATCHER_H_
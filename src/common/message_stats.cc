@@ -0,0 +1,321 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/message_stats.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "common/extension.h"
+
+namespace common {
+namespace message_stats {
+
+const char kStatsCommand[] = "__xwalk_extension_stats";
+
+namespace {
+
+const char kEnvironmentVariable[] = "XWALK_EXTENSION_STATS";
+
+// Latencies are bucketed HDR-style: exact below 8ns, then 8 linear
+// sub-buckets per power of two, which bounds the error to 12.5%. Latencies
+// over 2^40ns (18 minutes) land in the last bucket.
+const int kSubBucketBits = 3;
+const int kSubBuckets = 1 << kSubBucketBits;
+const int kMaxExponent = 40;
+const int kBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+// Distinct commands tracked per thread; the rest are accounted together.
+const size_t kSlots = 256;
+
+int BucketIndex(uint64_t ns) {
+  if (ns < static_cast<uint64_t>(kSubBuckets))
+    return ns;
+  ns = std::min<uint64_t>(ns, (1ULL << (kMaxExponent + 1)) - 1);
+  int msb = 63 - __builtin_clzll(ns);
+  int shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets +
+      static_cast<int>((ns >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t BucketLowerBound(int index) {
+  if (index < kSubBuckets)
+    return index;
+  int shift = index / kSubBuckets - 1;
+  return static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+}
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Only the owning thread writes, readers building a report may run on any
+// thread, hence the relaxed atomics.
+struct CommandStats {
+  CommandStats(const char* cmd, size_t length, bool is_sync)
+      : name(cmd, length),
+        sync(is_sync),
+        count(0),
+        bytes_in(0),
+        bytes_out(0),
+        total_ns(0),
+        max_ns(0) {
+    for (int i = 0; i < kBuckets; ++i)
+      buckets[i] = 0;
+  }
+
+  const std::string name;
+  const bool sync;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> bytes_in;
+  std::atomic<uint64_t> bytes_out;
+  std::atomic<uint64_t> total_ns;
+  std::atomic<uint64_t> max_ns;
+  std::atomic<uint64_t> buckets[kBuckets];
+};
+
+void Add(std::atomic<uint64_t>* counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+// Open addressing table, never shrinks. Slots are published with release
+// semantics once the entry is constructed.
+struct ThreadStats {
+  ThreadStats() {
+    for (size_t i = 0; i < kSlots; ++i)
+      slots[i] = NULL;
+  }
+
+  CommandStats* Find(const char* cmd, size_t length, bool sync) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+      hash = (hash ^ static_cast<unsigned char>(cmd[i])) * 16777619u;
+    hash ^= sync;
+
+    for (size_t probe = 0; probe < kSlots; ++probe) {
+      std::atomic<CommandStats*>& slot = slots[(hash + probe) % kSlots];
+      CommandStats* stats = slot.load(std::memory_order_relaxed);
+      if (!stats) {
+        stats = new CommandStats(cmd, length, sync);
+        slot.store(stats, std::memory_order_release);
+        return stats;
+      }
+      if (stats->sync == sync && stats->name.size() == length &&
+          !memcmp(stats->name.data(), cmd, length))
+        return stats;
+    }
+    return NULL;
+  }
+
+  std::atomic<CommandStats*> slots[kSlots];
+  // For the messages not fitting in the table.
+  CommandStats* other[2];
+};
+
+std::mutex g_threads_mutex;
+std::vector<ThreadStats*>* g_threads = NULL;
+std::string* g_extension_name = NULL;
+volatile sig_atomic_t g_dump_requested = 0;
+
+__thread ThreadStats* t_stats = NULL;
+// Bytes posted back while handling the current message of the thread.
+__thread size_t t_bytes_out = 0;
+
+ThreadStats* GetThreadStats() {
+  if (!t_stats) {
+    // Leaked when the thread exits, so its numbers remain in the report.
+    t_stats = new ThreadStats;
+    t_stats->other[0] = new CommandStats("(other)", 7, false);
+    t_stats->other[1] = new CommandStats("(other)", 7, true);
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    g_threads->push_back(t_stats);
+  }
+  return t_stats;
+}
+
+void OnDumpSignal(int) {
+  g_dump_requested = 1;
+}
+
+bool Initialize() {
+  if (!getenv(kEnvironmentVariable))
+    return false;
+  g_threads = new std::vector<ThreadStats*>;
+  g_extension_name = new std::string;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnDumpSignal;
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR2, &action, NULL);
+  return true;
+}
+
+// Percentile of the histogram, as the lower bound of its bucket.
+uint64_t Percentile(const std::vector<uint64_t>& buckets, uint64_t count,
+                    double fraction) {
+  uint64_t rank = static_cast<uint64_t>(count * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen > rank)
+      return BucketLowerBound(i);
+  }
+  return BucketLowerBound(kBuckets - 1);
+}
+
+struct Totals {
+  Totals()
+      : count(0), bytes_in(0), bytes_out(0), total_ns(0), max_ns(0),
+        buckets(kBuckets) {}
+
+  void Merge(const CommandStats& stats) {
+    count += stats.count.load(std::memory_order_relaxed);
+    bytes_in += stats.bytes_in.load(std::memory_order_relaxed);
+    bytes_out += stats.bytes_out.load(std::memory_order_relaxed);
+    total_ns += stats.total_ns.load(std::memory_order_relaxed);
+    max_ns = std::max(max_ns, stats.max_ns.load(std::memory_order_relaxed));
+    for (int i = 0; i < kBuckets; ++i)
+      buckets[i] += stats.buckets[i].load(std::memory_order_relaxed);
+  }
+
+  uint64_t count;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  std::vector<uint64_t> buckets;
+};
+
+}  // namespace
+
+bool IsEnabled() {
+  static const bool enabled = Initialize();
+  return enabled;
+}
+
+void SetExtensionName(const char* name) {
+  if (IsEnabled())
+    *g_extension_name = name;
+}
+
+ScopedRecord::ScopedRecord(const char* msg, bool sync)
+    : msg_(IsEnabled() ? msg : NULL),
+      sync_(sync),
+      start_ns_(0) {
+  if (!msg_)
+    return;
+  t_bytes_out = 0;
+  start_ns_ = NowNs();
+}
+
+ScopedRecord::~ScopedRecord() {
+  if (!msg_)
+    return;
+  uint64_t elapsed_ns = NowNs() - start_ns_;
+
+  const char* cmd;
+  size_t length;
+  if (!ExtractCommand(msg_, &cmd, &length)) {
+    cmd = "(unknown)";
+    length = 9;
+  }
+  ThreadStats* thread_stats = GetThreadStats();
+  CommandStats* stats = thread_stats->Find(cmd, length, sync_);
+  if (!stats)
+    stats = thread_stats->other[sync_];
+
+  Add(&stats->count, 1);
+  Add(&stats->bytes_in, strlen(msg_));
+  Add(&stats->bytes_out, t_bytes_out);
+  Add(&stats->total_ns, elapsed_ns);
+  if (elapsed_ns > stats->max_ns.load(std::memory_order_relaxed))
+    stats->max_ns.store(elapsed_ns, std::memory_order_relaxed);
+  Add(&stats->buckets[BucketIndex(elapsed_ns)], 1);
+}
+
+void AddBytesOut(size_t bytes) {
+  t_bytes_out += bytes;
+}
+
+std::string Report() {
+  if (!IsEnabled())
+    return std::string();
+
+  typedef std::map<std::pair<std::string, bool>, Totals> TotalsMap;
+  TotalsMap totals;
+  {
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    for (size_t t = 0; t < g_threads->size(); ++t) {
+      ThreadStats* thread_stats = (*g_threads)[t];
+      for (size_t i = 0; i < kSlots + 2; ++i) {
+        const CommandStats* stats = i < kSlots ?
+            thread_stats->slots[i].load(std::memory_order_acquire) :
+            thread_stats->other[i - kSlots];
+        if (stats && stats->count.load(std::memory_order_relaxed))
+          totals[std::make_pair(stats->name, stats->sync)].Merge(*stats);
+      }
+    }
+  }
+
+  std::string report = "Message stats for extension '" + *g_extension_name +
+      "' (latencies in microseconds):\n";
+  char line[256];
+  snprintf(line, sizeof(line),
+           "%-40s %-5s %9s %11s %11s %9s %9s %9s %9s %9s\n",
+           "cmd", "type", "count", "bytes_in", "bytes_out",
+           "mean", "p50", "p90", "p99", "max");
+  report += line;
+  for (TotalsMap::const_iterator it = totals.begin(); it != totals.end();
+       ++it) {
+    const Totals& t = it->second;
+    snprintf(line, sizeof(line),
+             "%-40s %-5s %9llu %11llu %11llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+             it->first.first.c_str(), it->first.second ? "sync" : "async",
+             static_cast<unsigned long long>(t.count),  // NOLINT
+             static_cast<unsigned long long>(t.bytes_in),  // NOLINT
+             static_cast<unsigned long long>(t.bytes_out),  // NOLINT
+             t.total_ns / 1000.0 / t.count,
+             Percentile(t.buckets, t.count, 0.5) / 1000.0,
+             Percentile(t.buckets, t.count, 0.9) / 1000.0,
+             Percentile(t.buckets, t.count, 0.99) / 1000.0,
+             t.max_ns / 1000.0);
+    report += line;
+  }
+  return report;
+}
+
+void Dump() {
+  if (!IsEnabled())
+    return;
+  std::string report = Report();
+  const char* path = getenv(kEnvironmentVariable);
+  FILE* file = strcmp(path, "1") ? fopen(path, "a") : NULL;
+  fputs(report.c_str(), file ? file : stderr);
+  if (file)
+    fclose(file);
+}
+
+void DumpIfRequested() {
+  if (!g_dump_requested)
+    return;
+  g_dump_requested = 0;
+  Dump();
+}
+
+}  // namespace message_stats
+}  // namespace common
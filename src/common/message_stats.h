@@ -0,0 +1,66 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_MESSAGE_STATS_H_
+#define COMMON_MESSAGE_STATS_H_
+
+// Per-command latency and size statistics of the messages handled by the
+// extension, for finding hot paths without rebuilding.
+//
+// Collection is enabled by setting XWALK_EXTENSION_STATS in the environment
+// of the extension process. The report is written when the extension shuts
+// down, and on the next message handled after the process gets SIGUSR2; it
+// goes to stderr, or is appended to the file named by the variable if its
+// value is not "1". It can also be fetched from JavaScript as the reply of a
+// sync message whose "cmd" is kStatsCommand.
+//
+// Each thread records into its own table, so handlers running concurrently
+// never contend on a lock.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace common {
+
+namespace message_stats {
+
+extern const char kStatsCommand[];
+
+// Checks the environment the first time it is called.
+bool IsEnabled();
+
+void SetExtensionName(const char* name);
+
+// Times one message handled on the calling thread. Bytes posted back by the
+// handler on the same thread are accounted to the message.
+class ScopedRecord {
+ public:
+  ScopedRecord(const char* msg, bool sync);
+  ~ScopedRecord();
+
+ private:
+  const char* msg_;
+  bool sync_;
+  uint64_t start_ns_;
+};
+
+// Accounts |bytes| sent back to JavaScript to the message being handled.
+void AddBytesOut(size_t bytes);
+
+// Human readable report of everything recorded so far.
+std::string Report();
+
+// Writes the report where configured.
+void Dump();
+
+// Dumps if SIGUSR2 was received since the last call.
+void DumpIfRequested();
+
+}  // namespace message_stats
+
+}  // namespace common
+
+#endif  // COMMON_MESSAGE_STATS_H_
@@ -0,0 +1,154 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/message_trace.h"
+
+#include <string.h>
+#include <time.h>
+
+namespace common {
+
+const char kTraceMagic[] = "XWTRACE1";
+const size_t kTraceMagicLength = sizeof(kTraceMagic) - 1;
+
+namespace {
+
+// Records are small, let stdio gather them into large writes.
+const size_t kWriteBufferSize = 64 * 1024;
+
+// Longest LEB128 encoding of a 64 bit value.
+const size_t kMaxVarintLength = 10;
+
+uint64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+size_t PutVarint(uint64_t value, unsigned char* out) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = static_cast<unsigned char>(value) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = static_cast<unsigned char>(value);
+  return length;
+}
+
+}  // namespace
+
+TraceWriter::TraceWriter()
+    : file_(NULL),
+      last_ns_(0) {}
+
+TraceWriter::~TraceWriter() {
+  if (file_)
+    fclose(file_);
+}
+
+bool TraceWriter::Open(const std::string& path) {
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_)
+    return false;
+  setvbuf(file_, NULL, _IOFBF, kWriteBufferSize);
+  fwrite(kTraceMagic, 1, kTraceMagicLength, file_);
+  return true;
+}
+
+void TraceWriter::Write(TraceRecordType type, int32_t instance,
+                        const char* data, size_t length) {
+  unsigned char header[1 + 3 * kMaxVarintLength];
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_)
+    return;
+
+  // Taken under the lock so that deltas are never negative.
+  uint64_t now_ns = NowNs();
+  uint64_t delta_ns = last_ns_ ? now_ns - last_ns_ : 0;
+  last_ns_ = now_ns;
+
+  size_t header_length = 0;
+  header[header_length++] = static_cast<unsigned char>(type);
+  header_length += PutVarint(static_cast<uint32_t>(instance),
+                             header + header_length);
+  header_length += PutVarint(delta_ns, header + header_length);
+  header_length += PutVarint(length, header + header_length);
+  fwrite(header, 1, header_length, file_);
+  fwrite(data, 1, length, file_);
+}
+
+void TraceWriter::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_)
+    fflush(file_);
+}
+
+TraceReader::TraceReader()
+    : file_(NULL),
+      time_ns_(0) {}
+
+TraceReader::~TraceReader() {
+  if (file_)
+    fclose(file_);
+}
+
+bool TraceReader::Open(const std::string& path, std::string* error) {
+  file_ = fopen(path.c_str(), "rb");
+  if (!file_) {
+    *error = "can't open " + path;
+    return false;
+  }
+  char magic[sizeof(kTraceMagic) - 1];
+  if (fread(magic, 1, kTraceMagicLength, file_) != kTraceMagicLength ||
+      memcmp(magic, kTraceMagic, kTraceMagicLength)) {
+    *error = path + " is not a message trace";
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::Next(TraceRecord* record, std::string* error) {
+  int type = fgetc(file_);
+  if (type == EOF)
+    return false;
+  if (type > TRACE_POST_BINARY_MESSAGE) {
+    *error = "unknown record type";
+    return false;
+  }
+
+  uint64_t instance;
+  uint64_t delta_ns;
+  uint64_t length;
+  if (!ReadVarint(&instance) || !ReadVarint(&delta_ns) ||
+      !ReadVarint(&length)) {
+    *error = "truncated record";
+    return false;
+  }
+
+  record->type = static_cast<TraceRecordType>(type);
+  record->instance = static_cast<int32_t>(instance);
+  time_ns_ += delta_ns;
+  record->time_ns = time_ns_;
+  record->data.resize(length);
+  if (length && fread(&record->data[0], 1, length, file_) != length) {
+    *error = "truncated record";
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::ReadVarint(uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = fgetc(file_);
+    if (byte == EOF)
+      return false;
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+}  // namespace common
@@ -0,0 +1,96 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_MESSAGE_TRACE_H_
+#define COMMON_MESSAGE_TRACE_H_
+
+// Compact binary log of the traffic between an extension and its JavaScript
+// side, written by common::Extension when XWALK_EXTENSION_TRACE is set, and
+// replayed by the bench tool (src/bench).
+//
+// The file starts with kTraceMagic, followed by records of:
+//
+//   type       1 byte, a TraceRecordType
+//   instance   varint, the XW_Instance
+//   time       varint, nanoseconds since the previous record
+//   length     varint
+//   data       |length| bytes, the message without its terminator
+//
+// Varints are unsigned LEB128.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <mutex>
+#include <string>
+
+#include "common/utils.h"
+
+namespace common {
+
+extern const char kTraceMagic[];
+extern const size_t kTraceMagicLength;
+
+enum TraceRecordType {
+  TRACE_INSTANCE_CREATED = 0,
+  TRACE_INSTANCE_DESTROYED = 1,
+  TRACE_MESSAGE = 2,
+  TRACE_SYNC_MESSAGE = 3,
+  TRACE_SYNC_REPLY = 4,
+  TRACE_POST_MESSAGE = 5,
+  TRACE_POST_BINARY_MESSAGE = 6,
+};
+
+struct TraceRecord {
+  TraceRecordType type;
+  int32_t instance;
+  // Since the first record of the trace.
+  uint64_t time_ns;
+  std::string data;
+};
+
+class TraceWriter {
+ public:
+  TraceWriter();
+  ~TraceWriter();
+
+  bool Open(const std::string& path);
+
+  // Can be called from any thread.
+  void Write(TraceRecordType type, int32_t instance, const char* data,
+             size_t length);
+  void Flush();
+
+ private:
+  std::mutex mutex_;
+  FILE* file_;
+  uint64_t last_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceWriter);
+};
+
+class TraceReader {
+ public:
+  TraceReader();
+  ~TraceReader();
+
+  bool Open(const std::string& path, std::string* error);
+
+  // Returns false at the end of the trace, setting |error| if the trace is
+  // corrupted or truncated.
+  bool Next(TraceRecord* record, std::string* error);
+
+ private:
+  bool ReadVarint(uint64_t* value);
+
+  FILE* file_;
+  uint64_t time_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceReader);
+};
+
+}  // namespace common
+
+#endif  // COMMON_MESSAGE_TRACE_H_
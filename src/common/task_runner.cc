@@ -0,0 +1,138 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "common/task_runner.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace {
+
+const size_t kMinThreads = 2;
+const size_t kMaxThreads = 4;
+
+}  // namespace
+
+namespace common {
+
+// Threads are started on demand, up to one per core within the limits above,
+// and then wait for more work until the process exits.
+// Long tasks get a thread of their own, which exits with them.
+class WorkerPool {
+ public:
+  static WorkerPool* GetInstance() {
+    // Leaked on purpose, the threads never exit.
+    static WorkerPool* instance = new WorkerPool;
+    return instance;
+  }
+
+  void PostTask(TaskRunner* runner, const TaskRunner::Task& task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (runner->cancelled_)
+      return;
+    queue_.push_back(std::make_pair(runner, task));
+    if (!idle_threads_ && threads_ < max_threads_) {
+      std::thread(&WorkerPool::Run, this).detach();
+      ++threads_;
+    } else {
+      work_cond_.notify_one();
+    }
+  }
+
+  void PostLongTask(TaskRunner* runner, const TaskRunner::Task& task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (runner->cancelled_)
+      return;
+    // Counted as running right away, since it is never queued.
+    ++runner->running_;
+    std::thread(&WorkerPool::RunLong, this, runner, task).detach();
+  }
+
+  void CancelAndWait(TaskRunner* runner) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    runner->cancelled_ = true;
+    for (size_t i = queue_.size(); i-- > 0;) {
+      if (queue_[i].first == runner)
+        queue_.erase(queue_.begin() + i);
+    }
+    while (runner->running_)
+      done_cond_.wait(lock);
+  }
+
+ private:
+  typedef std::pair<TaskRunner*, TaskRunner::Task> QueuedTask;
+
+  WorkerPool()
+      : threads_(0),
+        idle_threads_(0) {
+    max_threads_ = std::min(std::max<size_t>(
+        std::thread::hardware_concurrency(), kMinThreads), kMaxThreads);
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      while (queue_.empty()) {
+        ++idle_threads_;
+        work_cond_.wait(lock);
+        --idle_threads_;
+      }
+      QueuedTask task = queue_.front();
+      queue_.pop_front();
+      ++task.first->running_;
+
+      lock.unlock();
+      task.second();
+      lock.lock();
+
+      if (!--task.first->running_)
+        done_cond_.notify_all();
+    }
+  }
+
+  void RunLong(TaskRunner* runner, TaskRunner::Task task) {
+    task();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!--runner->running_)
+      done_cond_.notify_all();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable work_cond_;
+  std::condition_variable done_cond_;
+  std::deque<QueuedTask> queue_;
+  size_t threads_;
+  size_t idle_threads_;
+  size_t max_threads_;
+};
+
+TaskRunner::TaskRunner()
+    : cancelled_(false),
+      running_(0) {}
+
+TaskRunner::~TaskRunner() {
+  CancelAndWait();
+}
+
+void TaskRunner::PostTask(const Task& task) {
+  WorkerPool::GetInstance()->PostTask(this, task);
+}
+
+void TaskRunner::PostLongTask(const Task& task) {
+  WorkerPool::GetInstance()->PostLongTask(this, task);
+}
+
+void TaskRunner::CancelAndWait() {
+  WorkerPool::GetInstance()->CancelAndWait(this);
+}
+
+bool TaskRunner::IsCancelled() const {
+  return cancelled_;
+}
+
+}  // namespace common
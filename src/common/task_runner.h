@@ -0,0 +1,59 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMMON_TASK_RUNNER_H_
+#define COMMON_TASK_RUNNER_H_
+
+// Runs tasks on a small pool of worker threads shared by every TaskRunner of
+// the extension process, so slow operations don't hold the extension thread.
+//
+// Each instance owns a TaskRunner, see Instance::PostTask(). Tasks of a single
+// runner may run concurrently and in any order. Results are expected to be
+// sent back with Instance::PostMessage(), which is thread-safe.
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+
+#include "common/utils.h"
+
+namespace common {
+
+class TaskRunner {
+ public:
+  typedef std::function<void()> Task;
+
+  TaskRunner();
+  // Calls CancelAndWait().
+  ~TaskRunner();
+
+  // Does nothing once the runner is cancelled.
+  void PostTask(const Task& task);
+  // Runs |task| on a thread of its own, so that tasks which may take minutes
+  // don't keep the few shared workers from the other runners.
+  void PostLongTask(const Task& task);
+
+  // Drops the tasks not started yet and blocks until the running ones are
+  // done. Must not be called from a task of this runner.
+  void CancelAndWait();
+
+  // Long tasks should poll this and bail out early once it returns true.
+  bool IsCancelled() const;
+
+ private:
+  friend class WorkerPool;
+
+  // Only set with the lock of the pool held, but read without it by
+  // IsCancelled().
+  std::atomic<bool> cancelled_;
+  // Guarded by the lock of the pool.
+  size_t running_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskRunner);
+};
+
+}  // namespace common
+
+#endif  // COMMON_TASK_RUNNER_H_
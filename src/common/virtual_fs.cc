@@ -5,6 +5,8 @@
 #include "common/virtual_fs.h"
 
 #include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -50,35 +52,67 @@ const char kLocationWgtPrivateTmp[] = "wgt-private-tmp";
 
 }  // namespace vfs_const
 
-VirtualFS::VirtualFS() {
+std::shared_ptr<VirtualFS> VirtualFS::Get() {
+  // The extensions keep it for the instances to come, it goes with the last
+  // of them otherwise.
+  static std::mutex mutex;
+  static std::weak_ptr<VirtualFS> instance;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<VirtualFS> vfs = instance.lock();
+  if (!vfs) {
+    vfs.reset(new VirtualFS);
+    instance = vfs;
+  }
+  return vfs;
+}
+
+VirtualFS::VirtualFS()
+    : state_(new State) {
+}
+
+VirtualFS::~VirtualFS() {
+  for (size_t i = 0; i < watched_storages_.size(); ++i)
+    storage_unset_state_changed_cb(watched_storages_[i],
+                                   OnStorageStateChanged);
+}
+
+std::shared_ptr<const VirtualFS::State> VirtualFS::GetState() const {
+  std::call_once(initialize_flag_,
+                 &VirtualFS::Initialize, const_cast<VirtualFS*>(this));
+  std::lock_guard<std::mutex> lock(mutex_);
+  return state_;
+}
+
+void VirtualFS::Initialize() {
+  // Looking the application up and making the directories takes a while,
+  // it is done once for all the instances.
+  std::shared_ptr<State> state(new State);
   std::string app_path = GetApplicationPath();
   if (!app_path.empty()) {
-    AddInternalStorage(vfs_const::kLocationWgtPackage, app_path);
-    AddInternalStorage(vfs_const::kLocationWgtPrivate,
+    AddInternalStorage(state.get(), vfs_const::kLocationWgtPackage, app_path);
+    AddInternalStorage(state.get(), vfs_const::kLocationWgtPrivate,
                        JoinPath(app_path, "private"));
-    AddInternalStorage(vfs_const::kLocationWgtPrivateTmp,
+    AddInternalStorage(state.get(), vfs_const::kLocationWgtPrivateTmp,
                        JoinPath(app_path, "tmp"));
   }
 
-  AddInternalStorage(vfs_const::kLocationCamera,
+  AddInternalStorage(state.get(), vfs_const::kLocationCamera,
                      tzplatform_getenv(TZ_USER_CAMERA));
-  AddInternalStorage(vfs_const::kLocationMusic,
+  AddInternalStorage(state.get(), vfs_const::kLocationMusic,
                      tzplatform_getenv(TZ_USER_SOUNDS));
-  AddInternalStorage(vfs_const::kLocationImages,
+  AddInternalStorage(state.get(), vfs_const::kLocationImages,
                      tzplatform_getenv(TZ_USER_IMAGES));
-  AddInternalStorage(vfs_const::kLocationVideos,
+  AddInternalStorage(state.get(), vfs_const::kLocationVideos,
                      tzplatform_getenv(TZ_USER_VIDEOS));
-  AddInternalStorage(vfs_const::kLocationDownloads,
+  AddInternalStorage(state.get(), vfs_const::kLocationDownloads,
                      tzplatform_getenv(TZ_USER_DOWNLOADS));
-  AddInternalStorage(vfs_const::kLocationDocuments,
+  AddInternalStorage(state.get(), vfs_const::kLocationDocuments,
                      tzplatform_getenv(TZ_USER_DOCUMENTS));
-  AddInternalStorage(vfs_const::kLocationRingtones,
+  AddInternalStorage(state.get(), vfs_const::kLocationRingtones,
                      tzplatform_mkpath(TZ_USER_SHARE, "settings/Ringtones"));
-  storage_changed_cb_ = NULL;
-  cb_user_data_ = NULL;
-}
 
-VirtualFS::~VirtualFS() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  state_ = state;
 }
 
 std::string VirtualFS::JoinPath(const std::string& one,
@@ -193,23 +227,25 @@ std::string VirtualFS::GetExecPath(const std::string& app_id) {
 }
 
 bool VirtualFS::GetStorageByLabel(const std::string& label, Storage& storage) {
-  storage_foreach_device_supported(OnStorageDeviceSupported, this);
-  Storages::const_iterator it = storages_.find(label);
+  UpdateStorages();
+  std::shared_ptr<const State> state = GetState();
+  Storages::const_iterator it = state->storages.find(label);
 
-  if (it == storages_.end()) {
+  if (it == state->storages.end()) {
     return false;
   }
   storage = it->second;
   return true;
 }
 
-Storages::iterator VirtualFS::begin() {
-  storage_foreach_device_supported(OnStorageDeviceSupported, this);
-  return storages_.begin();
+Storages VirtualFS::GetStorages() {
+  UpdateStorages();
+  return GetState()->storages;
 }
 
-Storages::const_iterator VirtualFS::end() const {
-  return storages_.end();
+void VirtualFS::UpdateStorages() {
+  GetState();
+  storage_foreach_device_supported(OnStorageDeviceSupported, this);
 }
 
 std::string VirtualFS::GetApplicationPath() {
@@ -231,26 +267,67 @@ std::string VirtualFS::GetApplicationPath() {
 }
 
 std::string VirtualFS::GetRealPath(const std::string& fullPath) const {
-  std::size_t pos = fullPath.find_first_of('/');
-  Storages::const_iterator it = storages_.find(fullPath.substr(0, pos));
-
-  if (it == storages_.end())
+  std::shared_ptr<const State> state = GetState();
+  // Labels are a single component, the rest of the path is kept as is.
+  size_t label_length;
+  int root = state->labels.Find(fullPath, &label_length);
+  if (root < 0)
     return std::string();
 
-  if (pos != std::string::npos)
-    return it->second.GetFullPath() + fullPath.substr(pos);
+  const std::string& path = state->roots[root].path;
+  std::string real_path;
+  real_path.reserve(path.size() + fullPath.size() - label_length);
+  real_path.append(path).append(fullPath, label_length, std::string::npos);
+  return real_path;
+}
+
+std::string VirtualFS::GetVirtualPath(const std::string& realPath) const {
+  std::shared_ptr<const State> state = GetState();
+  size_t path_length;
+  int root = state->real_paths.Find(realPath, &path_length);
+  if (root < 0)
+    return std::string();
 
-  return it->second.GetFullPath();
+  const std::string& label = state->roots[root].label;
+  std::string full_path;
+  full_path.reserve(label.size() + realPath.size() - path_length);
+  full_path.append(label).append(realPath, path_length, std::string::npos);
+  return full_path;
 }
 
-void VirtualFS::AddInternalStorage(
+void VirtualFS::AddInternalStorage(State* state,
     const std::string& label, const std::string& path) {
-  if (MakePath(path, vfs_const::kDefaultFileMode))
-    storages_.insert(StorageLabelPair(label,
-                                      Storage(-1,
-                                      Storage::STORAGE_TYPE_INTERNAL,
-                                      Storage::STORAGE_STATE_MOUNTED,
-                                      path)));
+  if (MakePath(path, vfs_const::kDefaultFileMode)) {
+    state->storages.insert(StorageLabelPair(label,
+                                            Storage(-1,
+                                            Storage::STORAGE_TYPE_INTERNAL,
+                                            Storage::STORAGE_STATE_MOUNTED,
+                                            path)));
+    AddRoot(state, label, path);
+  }
+}
+
+void VirtualFS::AddRoot(State* state, const std::string& label,
+    const std::string& path) {
+  size_t label_length;
+  if (state->labels.Find(label, &label_length) >= 0 &&
+      label_length == label.size())
+    return;
+
+  int index = state->roots.size();
+  Root root;
+  root.label = label;
+  root.path = path;
+  state->roots.push_back(root);
+  state->labels.Insert(label, index);
+  state->real_paths.Insert(path, index);
+  // Paths resolved with realpath() are found too.
+  char* resolved_path = realpath(path.c_str(), NULL);
+  if (resolved_path) {
+    if (path != resolved_path)
+      state->real_paths.Insert(resolved_path, index);
+    free(resolved_path);
+  }
 }
 
 void VirtualFS::AddStorage(int id,
@@ -263,33 +340,63 @@ void VirtualFS::AddStorage(int id,
   else if (type == STORAGE_TYPE_EXTERNAL)
     label = kRemovableStorage + std::to_string(id);
 
-  storages_.insert(StorageLabelPair(label,
-                                    Storage(id,
-                                    type,
-                                    state,
-                                    path)));
-  if (std::find(watched_storages_.begin(),
-                watched_storages_.end(), id) != watched_storages_.end()) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_->storages.count(label))
+      return;
+    std::shared_ptr<State> new_state(new State(*state_));
+    new_state->storages.insert(StorageLabelPair(label,
+                                                Storage(id,
+                                                type,
+                                                state,
+                                                path)));
+    AddRoot(new_state.get(), label, path);
+    state_ = new_state;
+
+    if (std::find(watched_storages_.begin(),
+                  watched_storages_.end(), id) != watched_storages_.end())
+      return;
     watched_storages_.push_back(id);
-    storage_set_state_changed_cb(id, OnStorageStateChanged, this);
   }
+  storage_set_state_changed_cb(id, OnStorageStateChanged, this);
+}
+
+void VirtualFS::AddStorageChangedCb(CallBackFunctionPtr cb, void* user_data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  storage_changed_cbs_.push_back(StorageChangedCb(cb, user_data));
 }
 
-void VirtualFS::SetOnStorageChangedCb(CallBackFunctionPtr cb, void* user_data) {
-  storage_changed_cb_ = cb;
-  cb_user_data_ = user_data;
+void VirtualFS::RemoveStorageChangedCb(CallBackFunctionPtr cb,
+    void* user_data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  storage_changed_cbs_.erase(
+      std::remove(storage_changed_cbs_.begin(), storage_changed_cbs_.end(),
+                  StorageChangedCb(cb, user_data)),
+      storage_changed_cbs_.end());
 }
 
 void VirtualFS::NotifyStorageStateChanged(int id, storage_state_e state) {
-  for (Storages::iterator it = storages_.begin(); it != storages_.end(); ++it) {
-    if (it->second.GetId() == id) {
-      it->second.SetState(state);
-      if (storage_changed_cb_) {
-        storage_changed_cb_(it->first, it->second, cb_user_data_);
-      }
-      break;
-    }
+  std::string label;
+  Storage storage;
+  std::vector<StorageChangedCb> cbs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<State> new_state(new State(*state_));
+    Storages::iterator it = new_state->storages.begin();
+    while (it != new_state->storages.end() && it->second.GetId() != id)
+      ++it;
+    if (it == new_state->storages.end())
+      return;
+    it->second.SetState(state);
+    label = it->first;
+    storage = it->second;
+    state_ = new_state;
+    cbs = storage_changed_cbs_;
   }
+
+  // Called without the lock, the subscribers may look the storages up.
+  for (size_t i = 0; i < cbs.size(); ++i)
+    cbs[i].first(label, storage, cbs[i].second);
 }
 
 bool VirtualFS::OnStorageDeviceSupported(
@@ -306,6 +413,100 @@ void VirtualFS::OnStorageStateChanged(
       id, state);
 }
 
+/*
+ * PathPrefixIndex Class
+ */
+
+PathPrefixIndex::PathPrefixIndex() {
+  Clear();
+}
+
+void PathPrefixIndex::Clear() {
+  nodes_.assign(1, Node());
+  nodes_[0].value = -1;
+}
+
+void PathPrefixIndex::Insert(const std::string& prefix, int value) {
+  std::string::size_type end = prefix.find_last_not_of('/');
+  size_t length = end == std::string::npos ? prefix.size() : end + 1;
+
+  size_t node = 0;
+  size_t start = 0;
+  for (;;) {
+    size_t slash = prefix.find('/', start);
+    if (slash == std::string::npos || slash > length)
+      slash = length;
+    size_t position;
+    int child = FindChild(node, prefix.data() + start, slash - start,
+                          &position);
+    if (child < 0) {
+      child = nodes_.size();
+      nodes_[node].children.insert(
+          nodes_[node].children.begin() + position,
+          std::make_pair(prefix.substr(start, slash - start), child));
+      nodes_.push_back(Node());
+      nodes_.back().value = -1;
+    }
+    node = child;
+    if (slash == length)
+      break;
+    start = slash + 1;
+  }
+  if (nodes_[node].value < 0)
+    nodes_[node].value = value;
+}
+
+int PathPrefixIndex::Find(const std::string& path,
+                          size_t* prefix_length) const {
+  const char* data = path.data();
+  size_t size = path.size();
+  int value = -1;
+  size_t node = 0;
+  size_t start = 0;
+  for (;;) {
+    const char* slash_ptr =
+        static_cast<const char*>(memchr(data + start, '/', size - start));
+    size_t slash = slash_ptr ? slash_ptr - data : size;
+    size_t position;
+    int child = FindChild(node, data + start, slash - start, &position);
+    if (child < 0)
+      break;
+    node = child;
+    if (nodes_[node].value >= 0) {
+      value = nodes_[node].value;
+      *prefix_length = slash;
+    }
+    if (slash == size)
+      break;
+    start = slash + 1;
+  }
+  return value;
+}
+
+int PathPrefixIndex::FindChild(size_t node, const char* name, size_t length,
+                               size_t* position) const {
+  const std::vector<std::pair<std::string, int> >& children =
+      nodes_[node].children;
+  // Binary search, comparing in place.
+  size_t low = 0;
+  size_t high = children.size();
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    const std::string& child = children[middle].first;
+    int result = memcmp(child.data(), name, std::min(child.size(), length));
+    if (!result && child.size() != length)
+      result = child.size() < length ? -1 : 1;
+    if (!result)
+      return children[middle].second;
+    if (result < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  *position = low;
+  return -1;
+}
+
 /*
  * Storage Class
  */
@@ -8,6 +8,8 @@
 #include <appfw/app_storage.h>
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <utility>
@@ -63,16 +65,60 @@ class Storage {
 typedef std::map<std::string, Storage> Storages;
 typedef void(*CallBackFunctionPtr)(const std::string&, Storage, void*);
 
+/**
+ * A trie of paths by whole components, finding the longest prefix of a path
+ * without allocating.
+ */
+class PathPrefixIndex {
+ public:
+  PathPrefixIndex();
+
+  void Clear();
+  /**
+   * Keeps the value given first for a prefix.
+   */
+  void Insert(const std::string& prefix, int value);
+  /**
+   * @return the value of the longest prefix of 'path' which ends before a
+   *    '/' or at the end of 'path', or -1 if there is none. Its length is
+   *    set in 'prefix_length'.
+   */
+  int Find(const std::string& path, size_t* prefix_length) const;
+
+ private:
+  // The child of 'node' named 'name', or -1 with the position it would
+  // have in 'position'.
+  int FindChild(size_t node, const char* name, size_t length,
+                size_t* position) const;
+
+  struct Node {
+    // Sorted by name.
+    std::vector<std::pair<std::string, int> > children;
+    int value;
+  };
+
+  std::vector<Node> nodes_;
+};
+
 /**
  * The VirtualFS class provide an abstraction of the TIZEN virtual filesystem.
  * It manages mounted storages and virtual roots, creating missing directories
  * if needed.
  * Convenient functions are also provided for working with paths (real or
  * virtual).
+ *
+ * There is one VirtualFS shared by the instances, set up on first use. Its
+ * methods can be called from any thread; the storages and roots are
+ * published as snapshots which lookups use without further locking.
  */
 class VirtualFS {
  public:
-  VirtualFS();
+  /**
+   * @return the VirtualFS of the process, which lives as long as someone
+   *    holds it.
+   */
+  static std::shared_ptr<VirtualFS> Get();
+
   ~VirtualFS();
   /**
    * Resolve the given fullpath within the virtual filesystem to an absolute
@@ -83,10 +129,24 @@ class VirtualFS {
    * @return full Linux path.
    */
   std::string GetRealPath(const std::string& fullPath) const;
+  /**
+   * The reverse of GetRealPath().
+   * @param realPath: absolute path within the real filesystem.
+   * @return the virtual path of the innermost root containing 'realPath',
+   *    or an empty string if none does.
+   */
+  std::string GetVirtualPath(const std::string& realPath) const;
   bool GetStorageByLabel(const std::string& label, Storage& storage);
-  Storages::iterator begin();
-  Storages::const_iterator end() const;
-  void SetOnStorageChangedCb(CallBackFunctionPtr cb, void* user_data);
+  /**
+   * @return a snapshot of the storages, by label.
+   */
+  Storages GetStorages();
+  /**
+   * Subscribe to the changes of the storage states. 'cb' is called with
+   * 'user_data' on the thread of the storage service, until it is removed.
+   */
+  void AddStorageChangedCb(CallBackFunctionPtr cb, void* user_data);
+  void RemoveStorageChangedCb(CallBackFunctionPtr cb, void* user_data);
 
   /**
    * Concatenate two paths.
@@ -110,20 +170,49 @@ class VirtualFS {
   static std::string GetApplicationPath();
 
  private:
-  void AddInternalStorage(const std::string& label, const std::string& path);
+  struct Root {
+    std::string label;
+    std::string path;
+  };
+
+  // What lookups read, replaced as a whole when storages come or change.
+  struct State {
+    Storages storages;
+    // The roots in the order they were added, indexed by their label and
+    // by their real paths, both as given and without links.
+    std::vector<Root> roots;
+    PathPrefixIndex labels;
+    PathPrefixIndex real_paths;
+  };
+
+  typedef std::pair<std::string, Storage> StorageLabelPair;
+  typedef std::pair<CallBackFunctionPtr, void*> StorageChangedCb;
+
+  VirtualFS();
+
+  // Sets up the internal storages the first time.
+  std::shared_ptr<const State> GetState() const;
+  void Initialize();
+  // Enumerates the storage devices, some may be new.
+  void UpdateStorages();
+  void AddInternalStorage(State* state, const std::string& label,
+      const std::string& path);
   void AddStorage(int storage, storage_type_e type, storage_state_e state,
       const std::string& path);
+  // Adds the storage to the indexes of the roots, unless already there.
+  static void AddRoot(State* state, const std::string& label,
+      const std::string& path);
   void NotifyStorageStateChanged(int id, storage_state_e state);
   static bool OnStorageDeviceSupported(int id, storage_type_e type,
       storage_state_e state, const char* path, void* user_data);
   static void OnStorageStateChanged(int id, storage_state_e state,
       void* user_data);
 
-  CallBackFunctionPtr storage_changed_cb_;
-  void* cb_user_data_;
-
-  typedef std::pair<std::string, Storage> StorageLabelPair;
-  Storages storages_;
+  mutable std::once_flag initialize_flag_;
+  // Guards the members below. The State is not changed once published.
+  mutable std::mutex mutex_;
+  std::shared_ptr<const State> state_;
+  std::vector<StorageChangedCb> storage_changed_cbs_;
   std::vector<int> watched_storages_;
 };
 
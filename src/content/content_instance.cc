@@ -132,6 +132,19 @@ void ContentInstance::PostAsyncSuccessReply(const picojson::value& msg,
   PostMessage(v.serialize().c_str());
 }
 
+void ContentInstance::BeginAsyncSuccessReply(const picojson::value& msg,
+    common::JsonWriter* writer) {
+  writer->BeginObject();
+  writer->Key("isError");
+  writer->Bool(false);
+  writer->Key("replyId");
+  writer->Number(msg.get("replyId").get<double>());
+  if (msg.contains(STR_EVENT_TYPE)) {
+    writer->Key(STR_EVENT_TYPE);
+    writer->Value(msg.get(STR_EVENT_TYPE));
+  }
+}
+
 void ContentInstance::PostAsyncSuccessReply(const picojson::value& msg) {
   picojson::value::object reply;
   PostAsyncSuccessReply(msg, reply);
@@ -359,82 +372,114 @@ void ContentInstance::HandleFindReply(
     ContentItemList* itemList) {
   const std::vector<ContentItem*> &results = itemList->getAllItems();
 
-  picojson::value::array items;
+  // Results can run into thousands of items, so they are written straight
+  // into the reply instead of going through a picojson tree.
+  common::JsonWriter writer;
+  BeginAsyncSuccessReply(msg, &writer);
+  writer.Key("value");
+  writer.BeginArray();
 
   for (unsigned i = 0; i < results.size(); i++) {
     ContentItem* item = results[i];
 
-    picojson::value::object o;
+    writer.BeginObject();
 
-    picojson::value::array editableAttributesJson;
-    std::vector<std::string> editableAttributes = item->editable_attributes();
+    writer.Key("editableAttributes");
+    writer.BeginArray();
+    const std::vector<std::string>& editableAttributes =
+        item->editable_attributes();
     for (unsigned i = 0; i < editableAttributes.size(); i++)
-      editableAttributesJson.push_back(picojson::value(editableAttributes[i]));
-    o["editableAttributes"] = picojson::value(editableAttributesJson);
-    o[STR_ID] = picojson::value(item->id());
-    o[STR_NAME] = picojson::value(item->name());
-    o["type"] = picojson::value(item->type());
-    o["mimeType"] = picojson::value(item->mime_type());
-    o["title"] = picojson::value(item->title());
-    o["contentURI"] = picojson::value(item->content_uri());
-    picojson::value::array uris;
-    uris.push_back(picojson::value(item->thumbnail_uris()));
-    o["thumbnailURIs"] = picojson::value(uris);
-    o["releaseDate"] = picojson::value(item->release_date());
-    o["modifiedDate"] =
-      picojson::value(item->modified_date());
-    o["size"] = picojson::value(static_cast<double>(item->size()));
-    o[STR_DESCRIPTION] = picojson::value(item->description());
-    o[STR_RATING] = picojson::value(static_cast<double>(item->rating()));
+      writer.String(editableAttributes[i]);
+    writer.EndArray();
+    writer.Key(STR_ID);
+    writer.String(item->id());
+    writer.Key(STR_NAME);
+    writer.String(item->name());
+    writer.Key("type");
+    writer.String(item->type());
+    writer.Key("mimeType");
+    writer.String(item->mime_type());
+    writer.Key("title");
+    writer.String(item->title());
+    writer.Key("contentURI");
+    writer.String(item->content_uri());
+    writer.Key("thumbnailURIs");
+    writer.BeginArray();
+    writer.String(item->thumbnail_uris());
+    writer.EndArray();
+    writer.Key("releaseDate");
+    writer.String(item->release_date());
+    writer.Key("modifiedDate");
+    writer.String(item->modified_date());
+    writer.Key("size");
+    writer.Number(static_cast<double>(item->size()));
+    writer.Key(STR_DESCRIPTION);
+    writer.String(item->description());
+    writer.Key(STR_RATING);
+    writer.Number(static_cast<double>(item->rating()));
 
     if (item->type() == "AUDIO") {
-      o["album"] = picojson::value(item->album());
-      picojson::value::array genres;
-      genres.push_back(picojson::value(item->genres()));
-      o["genres"] = picojson::value(genres);
-      picojson::value::array artists;
-      artists.push_back(picojson::value(item->artists()));
-      o["artists"] = picojson::value(artists);
-      picojson::value::array composers;
-      composers.push_back(picojson::value(item->composer()));
-      o["composers"] = picojson::value(composers);
-      o["copyright"] = picojson::value(item->copyright());
-      o["bitrate"] = picojson::value(static_cast<double>(item->bitrate()));
-      o["trackNumber"] = picojson::value(
-          static_cast<double>(item->track_number()));
-      o["duration"] = picojson::value(static_cast<double>(item->duration()));
+      writer.Key("album");
+      writer.String(item->album());
+      writer.Key("genres");
+      writer.BeginArray();
+      writer.String(item->genres());
+      writer.EndArray();
+      writer.Key("artists");
+      writer.BeginArray();
+      writer.String(item->artists());
+      writer.EndArray();
+      writer.Key("composers");
+      writer.BeginArray();
+      writer.String(item->composer());
+      writer.EndArray();
+      writer.Key("copyright");
+      writer.String(item->copyright());
+      writer.Key("bitrate");
+      writer.Number(static_cast<double>(item->bitrate()));
+      writer.Key("trackNumber");
+      writer.Number(static_cast<double>(item->track_number()));
+      writer.Key("duration");
+      writer.Number(static_cast<double>(item->duration()));
     } else if (item->type() == "IMAGE") {
-      o["width"] = picojson::value(static_cast<double>(item->width()));
-      o["height"] = picojson::value(static_cast<double>(item->height()));
-      o["orientation"] = picojson::value(item->orientation());
-      o["latitude"] =
-          picojson::value(static_cast<double>(item->latitude()));
-      o["longitude"] =
-          picojson::value(static_cast<double>(item->longitude()));
+      writer.Key("width");
+      writer.Number(static_cast<double>(item->width()));
+      writer.Key("height");
+      writer.Number(static_cast<double>(item->height()));
+      writer.Key("orientation");
+      writer.String(item->orientation());
+      writer.Key("latitude");
+      writer.Number(item->latitude());
+      writer.Key("longitude");
+      writer.Number(item->longitude());
     } else if (item->type() == "VIDEO") {
-      o["album"] = picojson::value(item->album());
-      picojson::value::array artists;
-      artists.push_back(picojson::value(item->artists()));
-      o["artists"] = picojson::value(artists);
-      o["duration"] = picojson::value(static_cast<double>(item->duration()));
-      o["width"] = picojson::value(static_cast<double>(item->width()));
-      o["height"] = picojson::value(static_cast<double>(item->height()));
-      o["latitude"] =
-          picojson::value(static_cast<double>(item->latitude()));
-      o["longitude"] =
-          picojson::value(static_cast<double>(item->longitude()));
+      writer.Key("album");
+      writer.String(item->album());
+      writer.Key("artists");
+      writer.BeginArray();
+      writer.String(item->artists());
+      writer.EndArray();
+      writer.Key("duration");
+      writer.Number(static_cast<double>(item->duration()));
+      writer.Key("width");
+      writer.Number(static_cast<double>(item->width()));
+      writer.Key("height");
+      writer.Number(static_cast<double>(item->height()));
+      writer.Key("latitude");
+      writer.Number(item->latitude());
+      writer.Key("longitude");
+      writer.Number(item->longitude());
     }
 
-    picojson::value v(o);
-
-    items.push_back(picojson::value(o));
+    writer.EndObject();
   }
-  picojson::value value(items);
+
+  writer.EndArray();
+  writer.EndObject();
 #ifdef DEBUG_JSON_REPLY
-  std::cout << "JSON reply: " << std::endl <<
-     value.serialize().c_str() << std::endl;
+  std::cout << "JSON reply: " << std::endl << writer.c_str() << std::endl;
 #endif
-  PostAsyncSuccessReply(msg, value);
+  PostMessage(writer.c_str());
 }
 
 bool ContentInstance::MediaInfoCallback(media_info_h handle, void* user_data) {
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "common/extension.h"
+#include "common/json_writer.h"
 #include "common/picojson.h"
 #include "tizen/tizen.h"
 
@@ -48,6 +49,10 @@ class ContentInstance : public common::Instance {
   void PostAsyncSuccessReply(const picojson::value&, picojson::value&);
   void PostAsyncSuccessReply(const picojson::value&, WebApiAPIErrors);
   void PostAsyncSuccessReply(const picojson::value&);
+  // Opens the reply object of the PostAsyncSuccessReply() family in
+  // |writer|, for replies too big to build as a picojson tree. The caller
+  // adds its own members and closes the object.
+  void BeginAsyncSuccessReply(const picojson::value&, common::JsonWriter*);
 
   // Tizen CAPI helpers
   static bool MediaFolderCallback(media_folder_h handle, void *user_data);
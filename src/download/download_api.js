@@ -169,8 +169,7 @@ var AllowDownloadOnNetworkType = {
   'WIFI': 2
 };
 
-extension.setMessageListener(function(msg) {
-  var m = JSON.parse(msg);
+var handleMessage = function(m) {
   var id = parseInt(m.uid);
   if (isNaN(id) || typeof startListeners[id] === 'undefined') {
     return;
@@ -202,6 +201,10 @@ extension.setMessageListener(function(msg) {
                               errorMap[m.errorCode].message,
                               errorMap[m.errorCode].name));
   }
+};
+
+extension.setMessageListener(function(msg) {
+  xwalk.utils.dispatchMessages(msg, handleMessage);
 });
 
 tizen.DownloadRequest = function(url, destination, fileName, networkType) {
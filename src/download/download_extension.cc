@@ -13,7 +13,8 @@ common::Extension* CreateExtension() {
 // This will be generated from download_api.js.
 extern const char kSource_download_api[];
 
-DownloadExtension::DownloadExtension() {
+DownloadExtension::DownloadExtension()
+    : vfs_(VirtualFS::Get()) {
   const char* entry_points[] = { "tizen.DownloadRequest", NULL };
   SetExtraJSEntryPoints(entry_points);
   SetExtensionName("tizen.download");
@@ -23,5 +24,5 @@ DownloadExtension::DownloadExtension() {
 DownloadExtension::~DownloadExtension() {}
 
 common::Instance* DownloadExtension::CreateInstance() {
-  return new DownloadInstance;
+  return new DownloadInstance(vfs_);
 }
@@ -5,7 +5,10 @@
 #ifndef DOWNLOAD_DOWNLOAD_EXTENSION_H_
 #define DOWNLOAD_DOWNLOAD_EXTENSION_H_
 
+#include <memory>
+
 #include "common/extension.h"
+#include "common/virtual_fs.h"
 
 class DownloadExtension : public common::Extension {
  public:
@@ -15,6 +18,9 @@ class DownloadExtension : public common::Extension {
  private:
   // common::Extension implementation.
   virtual common::Instance* CreateInstance();
+
+  // Kept for the instances to come, which would set it up again otherwise.
+  std::shared_ptr<VirtualFS> vfs_;
 };
 
 #endif  // DOWNLOAD_DOWNLOAD_EXTENSION_H_
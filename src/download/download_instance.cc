@@ -30,7 +30,17 @@ using download_utils::ToString;
   } \
 } while (0)
 
-DownloadInstance::DownloadInstance() {
+namespace {
+
+// Progress callbacks of parallel downloads come in bursts.
+const unsigned kMessageBatchWindowMs = 100;
+const size_t kMaxMessageBatchBytes = 64 * 1024;
+
+}  // namespace
+
+DownloadInstance::DownloadInstance(const std::shared_ptr<VirtualFS>& vfs)
+    : vfs_(vfs) {
+  EnableMessageBatching(kMessageBatchWindowMs, kMaxMessageBatchBytes);
 }
 
 DownloadInstance::~DownloadInstance() {
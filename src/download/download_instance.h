@@ -7,6 +7,7 @@
 
 #include <tr1/memory>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -24,11 +25,12 @@ class value;
 
 class DownloadInstance : public common::Instance {
  public:
-  DownloadInstance();
+  // |vfs| is shared with the other instances.
+  explicit DownloadInstance(const std::shared_ptr<VirtualFS>& vfs);
   ~DownloadInstance();
 
  private:
-  VirtualFS vfs_;
+  std::shared_ptr<VirtualFS> vfs_;
   virtual void HandleMessage(const char* msg);
   virtual void HandleSyncMessage(const char* msg);
 
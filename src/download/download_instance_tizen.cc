@@ -13,8 +13,8 @@ const std::string DownloadInstance::GetFullDestinationPath(
     const std::string destination) const {
   std::string real_path;
   if (destination.empty())
-    real_path = vfs_.GetRealPath(vfs_const::kLocationDownloads);
+    real_path = vfs_->GetRealPath(vfs_const::kLocationDownloads);
   else
-    real_path = vfs_.GetRealPath(destination);
+    real_path = vfs_->GetRealPath(destination);
   return real_path;
 }
@@ -0,0 +1,1269 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/archive_engine.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "common/virtual_fs.h"
+#include "filesystem/directory_reader.h"
+
+namespace {
+
+const size_t kBufferSize = 256 * 1024;
+const int64_t kProgressIntervalMs = 250;
+
+const uint32_t kZipLocalHeader = 0x04034b50;
+const uint32_t kZipCentralHeader = 0x02014b50;
+const uint32_t kZipEnd = 0x06054b50;
+const uint32_t kZip64End = 0x06064b50;
+const uint32_t kZip64EndLocator = 0x07064b50;
+const uint16_t kZipUtf8Flag = 0x800;
+const uint16_t kZipStored = 0;
+const uint16_t kZipDeflated = 8;
+const uint16_t kZipVersion = 20;
+const uint16_t kZip64Version = 45;
+const uint16_t kZipUnix = 3;
+const uint16_t kZip64Extra = 0x0001;
+const uint16_t kZipTimeExtra = 0x5455;
+// Deflate may make incompressible data a little bigger, the entries close
+// to 4 GB get zip64 sizes too.
+const uint64_t kZip64Threshold = 0xf0000000ULL;
+const uint64_t kZip64Marker = 0xffffffffULL;
+const uint64_t kMaxCentralDirectorySize = 256 * 1024 * 1024;
+
+const size_t kTarBlockSize = 512;
+const uint64_t kMaxTarMetadataSize = 1024 * 1024;
+
+// Files which deflate would not make smaller, stored as they are in zips.
+const char* const kCompressedExtensions[] = {
+  ".3gp", ".7z", ".aac", ".apk", ".avi", ".bz2", ".gif", ".gz", ".jpeg",
+  ".jpg", ".m4a", ".mkv", ".mov", ".mp3", ".mp4", ".ogg", ".png", ".tgz",
+  ".tpk", ".webm", ".webp", ".wgt", ".xz", ".zip",
+};
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool EndsWith(const std::string& s, const char* suffix) {
+  size_t size = strlen(suffix);
+  if (s.size() < size)
+    return false;
+  for (size_t i = 0; i < size; ++i) {
+    if (tolower(s[s.size() - size + i]) != suffix[i])
+      return false;
+  }
+  return true;
+}
+
+bool IsCompressed(const std::string& name) {
+  for (size_t i = 0;
+       i < sizeof(kCompressedExtensions) / sizeof(kCompressedExtensions[0]);
+       ++i) {
+    if (EndsWith(name, kCompressedExtensions[i]))
+      return true;
+  }
+  return false;
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool PWriteAll(int fd, const char* data, size_t size, uint64_t offset) {
+  while (size) {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+// Returns the number of bytes read, less than |size| at the end of the file
+// only, or -1 on errors.
+ssize_t ReadAll(int fd, char* data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t result = read(fd, data + done, size - done);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      return -1;
+    if (!result)
+      break;
+    done += result;
+  }
+  return done;
+}
+
+bool PReadAll(int fd, char* data, size_t size, uint64_t offset) {
+  while (size) {
+    ssize_t result = pread(fd, data, size, offset);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    data += result;
+    size -= result;
+    offset += result;
+  }
+  return true;
+}
+
+void Put16(std::string* out, uint16_t value) {
+  out->push_back(value & 0xff);
+  out->push_back(value >> 8);
+}
+
+void Put32(std::string* out, uint32_t value) {
+  Put16(out, value & 0xffff);
+  Put16(out, value >> 16);
+}
+
+void Put64(std::string* out, uint64_t value) {
+  Put32(out, value & 0xffffffff);
+  Put32(out, value >> 32);
+}
+
+uint16_t Get16(const char* p) {
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+  return u[0] | (u[1] << 8);
+}
+
+uint32_t Get32(const char* p) {
+  return Get16(p) | (static_cast<uint32_t>(Get16(p + 2)) << 16);
+}
+
+uint64_t Get64(const char* p) {
+  return Get32(p) | (static_cast<uint64_t>(Get32(p + 4)) << 32);
+}
+
+// The relative path an entry of an archive extracts to, with the "." and
+// empty components dropped. Returns false for the names which would leave
+// the destination.
+bool GetRelativePath(const std::string& name, std::string* path) {
+  path->clear();
+  if (name.empty() || name[0] == '/' || name[0] == '\\' ||
+      name.find('\0') != std::string::npos)
+    return false;
+  std::string::size_type start = 0;
+  while (start <= name.size()) {
+    std::string::size_type end = name.find_first_of("/\\", start);
+    if (end == std::string::npos)
+      end = name.size();
+    std::string component = name.substr(start, end - start);
+    if (component == "..")
+      return false;
+    if (!component.empty() && component != ".") {
+      if (!path->empty())
+        path->push_back('/');
+      path->append(component);
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+}  // namespace
+
+// Buffered output to the archive, which keeps track of the offset.
+class ArchiveWriter {
+ public:
+  explicit ArchiveWriter(int fd) : fd_(fd), offset_(0) {
+    buffer_.reserve(kBufferSize);
+  }
+
+  bool Write(const char* data, size_t size) {
+    offset_ += size;
+    if (buffer_.size() + size > kBufferSize && !Flush())
+      return false;
+    if (size >= kBufferSize)
+      return WriteAll(fd_, data, size);
+    buffer_.insert(buffer_.end(), data, data + size);
+    return true;
+  }
+
+  bool Write(const std::string& data) {
+    return Write(data.data(), data.size());
+  }
+
+  bool Flush() {
+    bool result = WriteAll(fd_, buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return result;
+  }
+
+  // Replaces what was written at |offset|, for the sizes in zip headers
+  // which are known after the data.
+  bool Rewrite(uint64_t offset, const std::string& data) {
+    uint64_t buffer_offset = offset_ - buffer_.size();
+    if (offset >= buffer_offset) {
+      memcpy(&buffer_[offset - buffer_offset], data.data(), data.size());
+      return true;
+    }
+    return Flush() && PWriteAll(fd_, data.data(), data.size(), offset);
+  }
+
+  uint64_t offset() const { return offset_; }
+
+ private:
+  int fd_;
+  uint64_t offset_;
+  std::vector<char> buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArchiveWriter);
+};
+
+namespace {
+
+// Compresses to an ArchiveWriter, in the raw deflate format of zip entries
+// or as a gzip file.
+class Deflater {
+ public:
+  Deflater(int level, bool gzip) : output_(kBufferSize) {
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ = deflateInit2(&stream_, level, Z_DEFLATED,
+                                gzip ? 15 + 16 : -15, 8,
+                                Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+
+  ~Deflater() {
+    if (initialized_)
+      deflateEnd(&stream_);
+  }
+
+  // Starts another stream with the same settings.
+  bool Reset() {
+    return initialized_ && deflateReset(&stream_) == Z_OK;
+  }
+
+  // Compresses |data|, and writes all of what is left if |finish|.
+  bool Deflate(const char* data, size_t size, bool finish,
+               ArchiveWriter* out) {
+    if (!initialized_)
+      return false;
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = size;
+    for (;;) {
+      stream_.next_out = reinterpret_cast<Bytef*>(&output_[0]);
+      stream_.avail_out = output_.size();
+      int result = deflate(&stream_, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (result == Z_STREAM_ERROR)
+        return false;
+      size_t produced = output_.size() - stream_.avail_out;
+      if (produced && !out->Write(&output_[0], produced))
+        return false;
+      if (finish ? result == Z_STREAM_END :
+                   !stream_.avail_in && stream_.avail_out)
+        return true;
+    }
+  }
+
+ private:
+  z_stream stream_;
+  bool initialized_;
+  std::vector<char> output_;
+
+  DISALLOW_COPY_AND_ASSIGN(Deflater);
+};
+
+// Sequential input from a tar archive, gzipped or not.
+class ArchiveReader {
+ public:
+  ArchiveReader(int fd, bool gzip)
+      : fd_(fd), gzip_(gzip), input_(kBufferSize), position_(0), size_(0),
+        at_end_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ = !gzip_ || inflateInit2(&stream_, 15 + 16) == Z_OK;
+  }
+
+  ~ArchiveReader() {
+    if (gzip_ && initialized_)
+      inflateEnd(&stream_);
+  }
+
+  // Reads exactly |size| bytes. Returns false at the end of the archive,
+  // then at_end() tells whether it was reached cleanly, before any byte.
+  bool Read(char* data, size_t size) {
+    at_end_ = false;
+    if (!initialized_)
+      return false;
+    if (!gzip_) {
+      size_t done = 0;
+      while (done < size) {
+        if (position_ == size_ && !Fill()) {
+          at_end_ = !done && !size_;
+          return false;
+        }
+        size_t n = std::min(size - done, size_ - position_);
+        memcpy(data + done, &input_[position_], n);
+        position_ += n;
+        done += n;
+      }
+      return true;
+    }
+
+    stream_.next_out = reinterpret_cast<Bytef*>(data);
+    stream_.avail_out = size;
+    while (stream_.avail_out) {
+      if (!stream_.avail_in) {
+        if (!Fill()) {
+          at_end_ = stream_.avail_out == size && !size_;
+          return false;
+        }
+        stream_.next_in = reinterpret_cast<Bytef*>(&input_[0]);
+        stream_.avail_in = size_;
+      }
+      int result = inflate(&stream_, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        // Another gzip member may follow.
+        if (inflateReset(&stream_) != Z_OK)
+          return false;
+        continue;
+      }
+      if (result != Z_OK && result != Z_BUF_ERROR)
+        return false;
+    }
+    return true;
+  }
+
+  bool Skip(uint64_t size) {
+    char buffer[4096];
+    while (size) {
+      size_t n = std::min<uint64_t>(size, sizeof(buffer));
+      if (!Read(buffer, n))
+        return false;
+      size -= n;
+    }
+    return true;
+  }
+
+  bool at_end() const { return at_end_; }
+
+ private:
+  // Sets |size_| to 0 at the end of the file.
+  bool Fill() {
+    ssize_t result = ReadAll(fd_, &input_[0], input_.size());
+    size_ = result > 0 ? result : 0;
+    position_ = 0;
+    return result > 0;
+  }
+
+  int fd_;
+  bool gzip_;
+  bool initialized_;
+  z_stream stream_;
+  std::vector<char> input_;
+  size_t position_;
+  size_t size_;
+  bool at_end_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArchiveReader);
+};
+
+// Tar headers.
+
+void PutTarNumber(char* field, size_t width, uint64_t value) {
+  if (value < (1ULL << (3 * (width - 1)))) {
+    snprintf(field, width, "%0*llo", static_cast<int>(width - 1),
+             static_cast<unsigned long long>(value));  // NOLINT
+    return;
+  }
+  // The base-256 extension, for sizes of 8 GB and more.
+  memset(field, 0, width);
+  for (size_t i = width - 1; i > 0 && value; --i, value >>= 8)
+    field[i] = value & 0xff;
+  field[0] = static_cast<char>(0x80);
+}
+
+bool GetTarNumber(const char* field, size_t width, uint64_t* value) {
+  *value = 0;
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(field);
+  if (u[0] & 0x80) {
+    if (u[0] != 0x80)
+      return false;
+    for (size_t i = 1; i < width; ++i) {
+      if (*value >> 56)
+        return false;
+      *value = (*value << 8) | u[i];
+    }
+    return true;
+  }
+  size_t i = 0;
+  while (i < width && field[i] == ' ')
+    ++i;
+  for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i)
+    *value = (*value << 3) | (field[i] - '0');
+  return i == width || field[i] == ' ' || field[i] == '\0';
+}
+
+std::string GetTarString(const char* field, size_t width) {
+  return std::string(field, strnlen(field, width));
+}
+
+unsigned TarChecksum(const char* header) {
+  unsigned sum = 0;
+  for (size_t i = 0; i < kTarBlockSize; ++i) {
+    bool checksum_field = i >= 148 && i < 156;
+    sum += checksum_field ? ' ' : static_cast<unsigned char>(header[i]);
+  }
+  return sum;
+}
+
+std::string TarHeader(const std::string& name, char type, mode_t mode,
+                      uint64_t size, time_t mtime) {
+  char header[kTarBlockSize];
+  memset(header, 0, sizeof(header));
+  memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+  PutTarNumber(header + 100, 8, mode & 07777);
+  PutTarNumber(header + 108, 8, 0);
+  PutTarNumber(header + 116, 8, 0);
+  PutTarNumber(header + 124, 12, size);
+  PutTarNumber(header + 136, 12, mtime > 0 ? mtime : 0);
+  header[156] = type;
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+  snprintf(header + 148, 7, "%06o", TarChecksum(header));
+  header[155] = ' ';
+  return std::string(header, sizeof(header));
+}
+
+// A pax record, "<length> <key>=<value>\n" where the length counts itself.
+std::string PaxRecord(const std::string& key, const std::string& value) {
+  size_t rest = 1 + key.size() + 1 + value.size() + 1;
+  size_t length = rest + 1;
+  while (snprintf(NULL, 0, "%zu", length) + rest != length)
+    length = snprintf(NULL, 0, "%zu", length) + rest;
+  char prefix[32];
+  snprintf(prefix, sizeof(prefix), "%zu ", length);
+  return prefix + key + "=" + value + "\n";
+}
+
+// Finds the "path" and "size" of pax extended headers.
+void ParsePaxRecords(const std::string& data, std::string* path,
+                     uint64_t* size, bool* has_size) {
+  size_t position = 0;
+  while (position < data.size()) {
+    size_t length = 0;
+    size_t i = position;
+    for (; i < data.size() && data[i] >= '0' && data[i] <= '9'; ++i)
+      length = length * 10 + data[i] - '0';
+    if (i == data.size() || data[i] != ' ' || i + 1 >= position + length ||
+        length > data.size() - position)
+      return;
+    std::string record = data.substr(i + 1, position + length - i - 2);
+    position += length;
+    std::string::size_type equals = record.find('=');
+    if (equals == std::string::npos)
+      continue;
+    std::string key = record.substr(0, equals);
+    std::string value = record.substr(equals + 1);
+    if (key == "path") {
+      *path = value;
+    } else if (key == "size") {
+      *size = strtoull(value.c_str(), NULL, 10);
+      *has_size = true;
+    }
+  }
+}
+
+// Zip.
+
+void GetDosTime(time_t time, uint16_t* dos_time, uint16_t* dos_date) {
+  struct tm tm;
+  if (!localtime_r(&time, &tm) || tm.tm_year < 80) {
+    *dos_time = 0;
+    *dos_date = (1 << 5) | 1;
+    return;
+  }
+  *dos_time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+  *dos_date = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+}
+
+time_t FromDosTime(uint16_t dos_time, uint16_t dos_date) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = (dos_date >> 9) + 80;
+  tm.tm_mon = ((dos_date >> 5) & 0xf) - 1;
+  tm.tm_mday = dos_date & 0x1f;
+  tm.tm_hour = dos_time >> 11;
+  tm.tm_min = (dos_time >> 5) & 0x3f;
+  tm.tm_sec = (dos_time & 0x1f) * 2;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+struct ZipEntry {
+  std::string name;
+  uint16_t flags;
+  uint16_t method;
+  uint32_t crc;
+  uint64_t compressed_size;
+  uint64_t size;
+  uint64_t offset;
+  mode_t mode;
+  time_t mtime;
+};
+
+bool ParseCentralDirectory(const std::vector<char>& data, uint64_t count,
+                           std::vector<ZipEntry>* entries) {
+  const size_t kFixedSize = 46;
+  entries->reserve(std::min<uint64_t>(count, data.size() / kFixedSize));
+  size_t position = 0;
+  for (uint64_t n = 0; n < count; ++n) {
+    if (data.size() - position < kFixedSize)
+      return false;
+    const char* p = &data[position];
+    if (Get32(p) != kZipCentralHeader)
+      return false;
+    size_t name_size = Get16(p + 28);
+    size_t extra_size = Get16(p + 30);
+    size_t comment_size = Get16(p + 32);
+    if (data.size() - position - kFixedSize <
+        name_size + extra_size + comment_size)
+      return false;
+
+    ZipEntry entry;
+    entry.name.assign(p + kFixedSize, name_size);
+    entry.flags = Get16(p + 8);
+    entry.method = Get16(p + 10);
+    entry.crc = Get32(p + 16);
+    entry.compressed_size = Get32(p + 20);
+    entry.size = Get32(p + 24);
+    entry.offset = Get32(p + 42);
+    entry.mtime = FromDosTime(Get16(p + 12), Get16(p + 14));
+    uint32_t attributes = Get32(p + 38);
+    entry.mode = (Get16(p + 4) >> 8) == kZipUnix ? attributes >> 16 : 0;
+
+    const char* extra = p + kFixedSize + name_size;
+    const char* extra_end = extra + extra_size;
+    while (extra_end - extra >= 4) {
+      uint16_t id = Get16(extra);
+      size_t size = Get16(extra + 2);
+      const char* field = extra + 4;
+      if (static_cast<size_t>(extra_end - field) < size)
+        break;
+      const char* field_end = field + size;
+      if (id == kZip64Extra) {
+        // Only the values which did not fit are there, in this order.
+        uint64_t* values[] =
+            { &entry.size, &entry.compressed_size, &entry.offset };
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+          if (*values[i] != kZip64Marker)
+            continue;
+          if (field_end - field < 8)
+            return false;
+          *values[i] = Get64(field);
+          field += 8;
+        }
+      } else if (id == kZipTimeExtra && size >= 5 && (field[0] & 1)) {
+        entry.mtime = static_cast<int32_t>(Get32(field + 1));
+      }
+      extra = field_end;
+    }
+
+    entries->push_back(entry);
+    position += kFixedSize + name_size + extra_size + comment_size;
+  }
+  return true;
+}
+
+// Passes the uncompressed data of the zip entry at |offset| on to |write|.
+// The buffers are kept from one entry to the next.
+bool ReadZipData(int fd, uint64_t offset, const ZipEntry& entry,
+                 std::vector<char>* input_buffer,
+                 std::vector<char>* output_buffer,
+                 const std::function<bool(const char*, size_t)>& write) {
+  std::vector<char>& input = *input_buffer;
+  uint64_t left = entry.compressed_size;
+  if (entry.method == kZipStored) {
+    while (left) {
+      size_t n = std::min<uint64_t>(left, input.size());
+      if (!PReadAll(fd, &input[0], n, offset) || !write(&input[0], n))
+        return false;
+      offset += n;
+      left -= n;
+    }
+    return true;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, -15) != Z_OK)
+    return false;
+  std::vector<char>& output = *output_buffer;
+  output.resize(kBufferSize);
+  bool result = false;
+  for (;;) {
+    if (!stream.avail_in && left) {
+      size_t n = std::min<uint64_t>(left, input.size());
+      if (!PReadAll(fd, &input[0], n, offset))
+        break;
+      stream.next_in = reinterpret_cast<Bytef*>(&input[0]);
+      stream.avail_in = n;
+      offset += n;
+      left -= n;
+    }
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = output.size();
+    int status = inflate(&stream, Z_NO_FLUSH);
+    size_t produced = output.size() - stream.avail_out;
+    if (produced && !write(&output[0], produced))
+      break;
+    if (status == Z_STREAM_END) {
+      result = true;
+      break;
+    }
+    if (status == Z_BUF_ERROR && !stream.avail_in && !left)
+      break;  // Truncated.
+    if (status != Z_OK && status != Z_BUF_ERROR)
+      break;
+  }
+  inflateEnd(&stream);
+  return result;
+}
+
+}  // namespace
+
+ArchiveEngine::ArchiveEngine(const CopyEngine::ProgressCallback& progress,
+                             const CopyEngine::CancelledCallback& cancelled)
+    : progress_callback_(progress),
+      cancelled_callback_(cancelled),
+      stopped_(false),
+      buffer_(kBufferSize),
+      next_progress_(0) {
+  memset(&progress_, 0, sizeof(progress_));
+}
+
+bool ArchiveEngine::GetFormat(const std::string& path, Format* format) {
+  if (EndsWith(path, ".zip")) {
+    *format = FORMAT_ZIP;
+  } else if (EndsWith(path, ".tar")) {
+    *format = FORMAT_TAR;
+  } else if (EndsWith(path, ".tar.gz") || EndsWith(path, ".tgz")) {
+    *format = FORMAT_TAR_GZ;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+CopyEngine::Result ArchiveEngine::Create(const std::string& from,
+    const std::string& archive, Format format) {
+  std::string::size_type end = from.find_last_not_of('/');
+  std::string::size_type slash =
+      end == std::string::npos ? end : from.rfind('/', end);
+  std::string name = end == std::string::npos ? std::string() :
+      from.substr(slash == std::string::npos ? 0 : slash + 1, end - slash);
+
+  std::vector<Entry> entries;
+  if (name.empty() || !Walk(from, name, &entries))
+    return stopped() ? CopyEngine::COPY_CANCELLED : CopyEngine::COPY_FAILED;
+
+  int fd = open(archive.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0666);
+  if (fd < 0)
+    return CopyEngine::COPY_FAILED;
+  ArchiveWriter out(fd);
+  bool result = format == FORMAT_ZIP ? WriteZip(entries, &out) :
+      WriteTar(entries, &out, format == FORMAT_TAR_GZ);
+  result = out.Flush() && result;
+  result = close(fd) == 0 && result;
+  if (!result) {
+    unlink(archive.c_str());
+    return stopped() ? CopyEngine::COPY_CANCELLED : CopyEngine::COPY_FAILED;
+  }
+  if (progress_callback_)
+    progress_callback_(progress_);
+  return CopyEngine::COPY_OK;
+}
+
+CopyEngine::Result ArchiveEngine::Extract(const std::string& archive,
+    const std::string& to, bool overwrite) {
+  int fd = open(archive.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return CopyEngine::COPY_FAILED;
+  bool result = false;
+  char magic[4];
+  ssize_t size = ReadAll(fd, magic, sizeof(magic));
+  if (size >= 0 && lseek(fd, 0, SEEK_SET) == 0 &&
+      (mkdir(to.c_str(), vfs_const::kDefaultFileMode) == 0 ||
+       errno == EEXIST)) {
+    if (size == 4 && (Get32(magic) == kZipLocalHeader ||
+                      Get32(magic) == kZipEnd)) {
+      result = ExtractZip(fd, to, overwrite);
+    } else {
+      bool gzip = size >= 2 && magic[0] == '\x1f' && magic[1] == '\x8b';
+      result = ExtractTar(fd, gzip, to, overwrite);
+    }
+  }
+  close(fd);
+  if (!result)
+    return stopped() ? CopyEngine::COPY_CANCELLED : CopyEngine::COPY_FAILED;
+  if (progress_callback_)
+    progress_callback_(progress_);
+  return CopyEngine::COPY_OK;
+}
+
+void ArchiveEngine::Cancel() {
+  stopped_ = true;
+}
+
+bool ArchiveEngine::Walk(const std::string& path, const std::string& name,
+                         std::vector<Entry>* entries) {
+  if (stopped())
+    return false;
+  Entry entry;
+  entry.path = path;
+  entry.name = name;
+  if (stat(path.c_str(), &entry.st) < 0)
+    return false;
+  if (S_ISREG(entry.st.st_mode)) {
+    entries->push_back(entry);
+    AddTotals(1, entry.st.st_size);
+    return true;
+  }
+  if (!S_ISDIR(entry.st.st_mode))
+    return true;  // Devices, FIFOs and sockets have no data to archive.
+
+  entry.name.push_back('/');
+  entries->push_back(entry);
+  // Sorted, for archives which do not depend on the order of the
+  // directories.
+  std::vector<std::string> children;
+  DirectoryReader reader;
+  if (!reader.Open(path))
+    return false;
+  DirectoryReader::Entry dirent;
+  while (reader.Next(&dirent))
+    children.push_back(dirent.name);
+  if (reader.error())
+    return false;
+  std::sort(children.begin(), children.end());
+  for (size_t i = 0; i < children.size(); ++i) {
+    if (!Walk(path + "/" + children[i], entry.name + children[i], entries))
+      return false;
+  }
+  return true;
+}
+
+bool ArchiveEngine::ReadFile(const Entry& entry,
+    const std::function<bool(const char*, size_t)>& write) {
+  int fd = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  // Exactly the size archived in the header, which was written first.
+  uint64_t left = entry.st.st_size;
+  bool result = true;
+  while (left && result) {
+    size_t n = std::min<uint64_t>(left, buffer_.size());
+    result = ReadAll(fd, &buffer_[0], n) == static_cast<ssize_t>(n) &&
+        write(&buffer_[0], n) && AddProgress(0, n);
+    left -= n;
+  }
+  close(fd);
+  return result && AddProgress(1, 0);
+}
+
+bool ArchiveEngine::WriteTar(const std::vector<Entry>& entries,
+                             ArchiveWriter* out, bool gzip) {
+  std::unique_ptr<Deflater> deflater;
+  if (gzip)
+    deflater.reset(new Deflater(Z_DEFAULT_COMPRESSION, true));
+  std::function<bool(const char*, size_t)> write =
+      [out, &deflater](const char* data, size_t size) {
+    return deflater ? deflater->Deflate(data, size, false, out) :
+                      out->Write(data, size);
+  };
+  const char kZeros[kTarBlockSize] = {};
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (stopped())
+      return false;
+    const Entry& entry = entries[i];
+    bool directory = S_ISDIR(entry.st.st_mode);
+    uint64_t size = directory ? 0 : entry.st.st_size;
+    if (entry.name.size() > 100) {
+      std::string records = PaxRecord("path", entry.name);
+      std::string header = TarHeader("././@PaxHeader", 'x', 0644,
+                                     records.size(), entry.st.st_mtime);
+      records.resize((records.size() + kTarBlockSize - 1) /
+                     kTarBlockSize * kTarBlockSize);
+      if (!write(header.data(), header.size()) ||
+          !write(records.data(), records.size()))
+        return false;
+    }
+    std::string header = TarHeader(entry.name, directory ? '5' : '0',
+                                   entry.st.st_mode, size, entry.st.st_mtime);
+    if (!write(header.data(), header.size()))
+      return false;
+    if (directory)
+      continue;
+    if (!ReadFile(entry, write) ||
+        !write(kZeros, (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize))
+      return false;
+  }
+
+  // The end of the archive is two empty blocks.
+  if (!write(kZeros, sizeof(kZeros)) || !write(kZeros, sizeof(kZeros)))
+    return false;
+  return !deflater || deflater->Deflate(NULL, 0, true, out);
+}
+
+bool ArchiveEngine::WriteZip(const std::vector<Entry>& entries,
+                             ArchiveWriter* out) {
+  Deflater deflater(Z_DEFAULT_COMPRESSION, false);
+  std::string central_directory;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (stopped())
+      return false;
+    const Entry& entry = entries[i];
+    bool directory = S_ISDIR(entry.st.st_mode);
+    uint64_t size = directory ? 0 : entry.st.st_size;
+    uint16_t method = !size || IsCompressed(entry.name) ?
+        kZipStored : kZipDeflated;
+    bool zip64 = size >= kZip64Threshold;
+    uint16_t version = zip64 ? kZip64Version : kZipVersion;
+    uint16_t dos_time, dos_date;
+    GetDosTime(entry.st.st_mtime, &dos_time, &dos_date);
+    std::string time_extra;
+    Put16(&time_extra, kZipTimeExtra);
+    Put16(&time_extra, 5);
+    time_extra.push_back(1);
+    Put32(&time_extra, entry.st.st_mtime);
+
+    // The local header, whose CRC and sizes are filled in after the data.
+    uint64_t offset = out->offset();
+    std::string header;
+    Put32(&header, kZipLocalHeader);
+    Put16(&header, version);
+    Put16(&header, kZipUtf8Flag);
+    Put16(&header, method);
+    Put16(&header, dos_time);
+    Put16(&header, dos_date);
+    Put32(&header, 0);
+    Put32(&header, zip64 ? kZip64Marker : 0);
+    Put32(&header, zip64 ? kZip64Marker : 0);
+    Put16(&header, entry.name.size());
+    Put16(&header, (zip64 ? 20 : 0) + time_extra.size());
+    header.append(entry.name);
+    uint64_t zip64_offset = offset + header.size() + 4;
+    if (zip64) {
+      Put16(&header, kZip64Extra);
+      Put16(&header, 16);
+      Put64(&header, 0);
+      Put64(&header, 0);
+    }
+    header.append(time_extra);
+    if (!out->Write(header))
+      return false;
+
+    uint32_t crc = crc32(0, NULL, 0);
+    uint64_t data_offset = out->offset();
+    if (!directory) {
+      bool deflate = method == kZipDeflated;
+      if (deflate && !deflater.Reset())
+        return false;
+      bool written = ReadFile(entry,
+          [out, deflate, &deflater, &crc](const char* data, size_t size) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), size);
+        return deflate ? deflater.Deflate(data, size, false, out) :
+                         out->Write(data, size);
+      });
+      if (!written || (deflate && !deflater.Deflate(NULL, 0, true, out)))
+        return false;
+    }
+    uint64_t compressed_size = out->offset() - data_offset;
+
+    std::string sizes;
+    Put32(&sizes, crc);
+    Put32(&sizes, zip64 ? kZip64Marker : compressed_size);
+    Put32(&sizes, zip64 ? kZip64Marker : size);
+    if (!out->Rewrite(offset + 14, sizes))
+      return false;
+    if (zip64) {
+      sizes.clear();
+      Put64(&sizes, size);
+      Put64(&sizes, compressed_size);
+      if (!out->Rewrite(zip64_offset, sizes))
+        return false;
+    }
+
+    std::string extra;
+    if (size >= kZip64Marker)
+      Put64(&extra, size);
+    if (compressed_size >= kZip64Marker)
+      Put64(&extra, compressed_size);
+    if (offset >= kZip64Marker)
+      Put64(&extra, offset);
+    if (!extra.empty()) {
+      std::string field;
+      Put16(&field, kZip64Extra);
+      Put16(&field, extra.size());
+      extra.insert(0, field);
+      version = kZip64Version;
+    }
+    extra.append(time_extra);
+
+    std::string& record = central_directory;
+    Put32(&record, kZipCentralHeader);
+    Put16(&record, (kZipUnix << 8) | version);
+    Put16(&record, version);
+    Put16(&record, kZipUtf8Flag);
+    Put16(&record, method);
+    Put16(&record, dos_time);
+    Put16(&record, dos_date);
+    Put32(&record, crc);
+    Put32(&record, std::min(compressed_size, kZip64Marker));
+    Put32(&record, std::min(size, kZip64Marker));
+    Put16(&record, entry.name.size());
+    Put16(&record, extra.size());
+    Put16(&record, 0);
+    Put16(&record, 0);
+    Put16(&record, 0);
+    // The MS-DOS directory attribute, and the Unix mode.
+    Put32(&record, (static_cast<uint32_t>(entry.st.st_mode & 0xffff) << 16) |
+                   (directory ? 0x10 : 0));
+    Put32(&record, std::min(offset, kZip64Marker));
+    record.append(entry.name);
+    record.append(extra);
+  }
+
+  uint64_t count = entries.size();
+  uint64_t offset = out->offset();
+  uint64_t size = central_directory.size();
+  std::string end;
+  if (count >= 0xffff || offset >= kZip64Marker || size >= kZip64Marker) {
+    uint64_t zip64_end_offset = offset + size;
+    Put32(&end, kZip64End);
+    Put64(&end, 44);
+    Put16(&end, (kZipUnix << 8) | kZip64Version);
+    Put16(&end, kZip64Version);
+    Put32(&end, 0);
+    Put32(&end, 0);
+    Put64(&end, count);
+    Put64(&end, count);
+    Put64(&end, size);
+    Put64(&end, offset);
+    Put32(&end, kZip64EndLocator);
+    Put32(&end, 0);
+    Put64(&end, zip64_end_offset);
+    Put32(&end, 1);
+  }
+  Put32(&end, kZipEnd);
+  Put16(&end, 0);
+  Put16(&end, 0);
+  Put16(&end, std::min<uint64_t>(count, 0xffff));
+  Put16(&end, std::min<uint64_t>(count, 0xffff));
+  Put32(&end, std::min(size, kZip64Marker));
+  Put32(&end, std::min(offset, kZip64Marker));
+  Put16(&end, 0);
+  return out->Write(central_directory) && out->Write(end);
+}
+
+bool ArchiveEngine::ExtractTar(int fd, bool gzip, const std::string& to,
+                               bool overwrite) {
+  ArchiveReader in(fd, gzip);
+  std::string long_name;
+  std::string pax_path;
+  uint64_t pax_size = 0;
+  bool has_pax_size = false;
+  char header[kTarBlockSize];
+
+  for (bool first = true;; first = false) {
+    if (stopped())
+      return false;
+    // Some writers leave out the empty blocks at the end.
+    if (!in.Read(header, sizeof(header)))
+      return !first && in.at_end();
+    if (std::count(header, header + sizeof(header), '\0') ==
+        static_cast<ptrdiff_t>(sizeof(header)))
+      return true;
+
+    uint64_t checksum, size, mode, mtime;
+    if (!GetTarNumber(header + 148, 8, &checksum) ||
+        checksum != TarChecksum(header) ||
+        !GetTarNumber(header + 124, 12, &size) ||
+        !GetTarNumber(header + 100, 8, &mode) ||
+        !GetTarNumber(header + 136, 12, &mtime))
+      return false;
+    uint64_t padding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+    char type = header[156];
+
+    // Metadata for the next entry: pax headers and GNU long names.
+    if (type == 'x' || type == 'g' || type == 'L') {
+      if (size > kMaxTarMetadataSize)
+        return false;
+      std::string data(size, '\0');
+      if ((size && !in.Read(&data[0], size)) || !in.Skip(padding))
+        return false;
+      if (type == 'x')
+        ParsePaxRecords(data, &pax_path, &pax_size, &has_pax_size);
+      else if (type == 'L')
+        long_name = GetTarString(data.data(), data.size());
+      continue;
+    }
+
+    std::string name;
+    if (!pax_path.empty()) {
+      name = pax_path;
+    } else if (!long_name.empty()) {
+      name = long_name;
+    } else {
+      name = GetTarString(header, 100);
+      std::string prefix = GetTarString(header + 345, 155);
+      if (!memcmp(header + 257, "ustar", 5) && !prefix.empty())
+        name = prefix + "/" + name;
+    }
+    if (has_pax_size) {
+      size = pax_size;
+      padding = (kTarBlockSize - size % kTarBlockSize) % kTarBlockSize;
+    }
+    pax_path.clear();
+    long_name.clear();
+    has_pax_size = false;
+
+    bool directory = type == '5';
+    bool file = type == '0' || type == '\0' || type == '7';
+    if (file && !name.empty() && *name.rbegin() == '/')
+      directory = true;  // Directories of the old tar format.
+    if (!directory && !file) {
+      // Links, devices and FIFOs are left out.
+      if (!in.Skip(size + padding))
+        return false;
+      continue;
+    }
+    if (file && !directory)
+      AddTotals(1, size);
+
+    std::string path;
+    int out_fd = OpenEntry(to, name, directory, mode & 0777, overwrite,
+                           &path);
+    if (out_fd == -1)
+      return false;
+    if (out_fd < 0 || directory) {
+      if (!in.Skip(size + padding))
+        return false;
+      continue;
+    }
+
+    bool result = true;
+    uint64_t left = size;
+    while (left && result) {
+      size_t n = std::min<uint64_t>(left, buffer_.size());
+      result = in.Read(&buffer_[0], n) && WriteAll(out_fd, &buffer_[0], n) &&
+          AddProgress(0, n);
+      left -= n;
+    }
+    result = result && in.Skip(padding);
+    if (!CloseEntry(out_fd, path, mtime, result) || !AddProgress(1, 0))
+      return false;
+  }
+}
+
+bool ArchiveEngine::ExtractZip(int fd, const std::string& to,
+                               bool overwrite) {
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    return false;
+  uint64_t file_size = st.st_size;
+
+  // The end of central directory record, followed by a comment of up to
+  // 64 KB.
+  const size_t kEndSize = 22;
+  size_t tail_size = std::min<uint64_t>(file_size, kEndSize + 0xffff);
+  if (tail_size < kEndSize)
+    return false;
+  std::vector<char> tail(tail_size);
+  uint64_t tail_offset = file_size - tail_size;
+  if (!PReadAll(fd, &tail[0], tail_size, tail_offset))
+    return false;
+  size_t end = tail_size - kEndSize + 1;
+  while (end-- > 0 && Get32(&tail[end]) != kZipEnd) {}
+  if (end == static_cast<size_t>(-1))
+    return false;
+  uint64_t count = Get16(&tail[end + 10]);
+  uint64_t size = Get32(&tail[end + 12]);
+  uint64_t offset = Get32(&tail[end + 16]);
+
+  const size_t kLocatorSize = 20;
+  const size_t kZip64EndSize = 56;
+  uint64_t end_offset = tail_offset + end;
+  char locator[kLocatorSize];
+  if ((count == 0xffff || size == kZip64Marker || offset == kZip64Marker) &&
+      end_offset >= kLocatorSize &&
+      PReadAll(fd, locator, sizeof(locator), end_offset - kLocatorSize) &&
+      Get32(locator) == kZip64EndLocator) {
+    char zip64_end[kZip64EndSize];
+    if (!PReadAll(fd, zip64_end, sizeof(zip64_end), Get64(locator + 8)) ||
+        Get32(zip64_end) != kZip64End)
+      return false;
+    count = Get64(zip64_end + 32);
+    size = Get64(zip64_end + 40);
+    offset = Get64(zip64_end + 48);
+  }
+  if (size > kMaxCentralDirectorySize || offset > file_size ||
+      size > file_size - offset)
+    return false;
+
+  std::vector<char> central_directory(size);
+  std::vector<ZipEntry> entries;
+  if ((size && !PReadAll(fd, &central_directory[0], size, offset)) ||
+      !ParseCentralDirectory(central_directory, count, &entries))
+    return false;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (!entries[i].name.empty() && *entries[i].name.rbegin() != '/')
+      AddTotals(1, entries[i].size);
+  }
+
+  const size_t kLocalHeaderSize = 30;
+  std::vector<char> output;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (stopped())
+      return false;
+    const ZipEntry& entry = entries[i];
+    bool directory = (!entry.name.empty() && *entry.name.rbegin() == '/') ||
+        S_ISDIR(entry.mode);
+    if (S_ISLNK(entry.mode))
+      continue;
+    // Encryption is not supported.
+    if (entry.flags & 1 ||
+        (entry.method != kZipStored && entry.method != kZipDeflated))
+      return false;
+
+    std::string path;
+    int out_fd = OpenEntry(to, entry.name, directory, entry.mode & 0777,
+                           overwrite, &path);
+    if (out_fd == -1)
+      return false;
+    if (out_fd < 0 || directory)
+      continue;
+
+    char header[kLocalHeaderSize];
+    bool result = PReadAll(fd, header, sizeof(header), entry.offset) &&
+        Get32(header) == kZipLocalHeader;
+    uint64_t data_offset = entry.offset + sizeof(header) + Get16(header + 26) +
+        Get16(header + 28);
+    uint32_t crc = crc32(0, NULL, 0);
+    uint64_t written = 0;
+    result = result && ReadZipData(fd, data_offset, entry, &buffer_, &output,
+        [this, out_fd, &entry, &crc, &written](const char* data, size_t n) {
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(data), n);
+      written += n;
+      // No more than the size announced, whatever the compressed data says.
+      return written <= entry.size && WriteAll(out_fd, data, n) &&
+          AddProgress(0, n);
+    });
+    result = result && crc == entry.crc && written == entry.size;
+    if (!CloseEntry(out_fd, path, entry.mtime, result) || !AddProgress(1, 0))
+      return false;
+  }
+  return true;
+}
+
+int ArchiveEngine::OpenEntry(const std::string& to, const std::string& name,
+    bool directory, mode_t mode, bool overwrite, std::string* path) {
+  std::string relative;
+  if (!GetRelativePath(name, &relative))
+    return -1;
+  if (relative.empty())
+    return -2;
+
+  // The directories leading to the entry, which must not be links out of
+  // the destination either.
+  std::string::size_type slash = 0;
+  while ((slash = relative.find('/', slash)) != std::string::npos) {
+    std::string directory_path = to + "/" + relative.substr(0, slash);
+    ++slash;
+    if (directories_.count(directory_path))
+      continue;
+    struct stat st;
+    if (mkdir(directory_path.c_str(), vfs_const::kDefaultFileMode) < 0 &&
+        (errno != EEXIST || lstat(directory_path.c_str(), &st) < 0 ||
+         !S_ISDIR(st.st_mode)))
+      return -1;
+    directories_.insert(directory_path);
+  }
+
+  *path = to + "/" + relative;
+  if (directory) {
+    struct stat st;
+    if (mkdir(path->c_str(), (mode ? mode : vfs_const::kDefaultFileMode) |
+              S_IRWXU) < 0 &&
+        (errno != EEXIST || lstat(path->c_str(), &st) < 0 ||
+         !S_ISDIR(st.st_mode)))
+      return -1;
+    directories_.insert(*path);
+    return 0;
+  }
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | O_NOFOLLOW |
+      (overwrite ? O_TRUNC : O_EXCL);
+  return open(path->c_str(), flags, mode ? mode | S_IRUSR | S_IWUSR : 0666);
+}
+
+bool ArchiveEngine::CloseEntry(int fd, const std::string& path, time_t mtime,
+                               bool ok) {
+  if (ok) {
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = mtime;
+    times[1].tv_nsec = 0;
+    futimens(fd, times);
+  }
+  ok = close(fd) == 0 && ok;
+  if (!ok)
+    unlink(path.c_str());
+  return ok;
+}
+
+bool ArchiveEngine::stopped() {
+  return stopped_.load(std::memory_order_relaxed);
+}
+
+void ArchiveEngine::AddTotals(uint64_t files, uint64_t bytes) {
+  progress_.total_files += files;
+  progress_.total_bytes += bytes;
+}
+
+bool ArchiveEngine::AddProgress(uint64_t files, uint64_t bytes) {
+  progress_.files += files;
+  progress_.bytes += bytes;
+  int64_t now = NowMs();
+  if (now >= next_progress_) {
+    next_progress_ = now + kProgressIntervalMs;
+    if (cancelled_callback_ && cancelled_callback_())
+      Cancel();
+    else if (progress_callback_ && progress_.files + progress_.bytes)
+      progress_callback_(progress_);
+  }
+  return !stopped();
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_ARCHIVE_ENGINE_H_
+#define FILESYSTEM_ARCHIVE_ENGINE_H_
+
+// Creates and extracts zip, tar and gzipped tar archives for
+// File.archiveTo() and extractTo(), streaming between the files and the
+// archive on the calling thread. Progress and cancellation work as for the
+// copies, see CopyEngine.
+//
+// Zip archives are written with deflate, or stored for the media formats
+// which are compressed already, and use the zip64 extensions past 4 GB.
+// Tar archives are ustar, with pax headers for the longer names. Only
+// directories and regular files are archived and extracted; entries which
+// would land outside of the destination are refused.
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+#include "filesystem/copy_engine.h"
+
+class ArchiveWriter;
+
+class ArchiveEngine {
+ public:
+  enum Format {
+    FORMAT_ZIP,
+    FORMAT_TAR,
+    FORMAT_TAR_GZ,
+  };
+
+  ArchiveEngine(const CopyEngine::ProgressCallback& progress,
+                const CopyEngine::CancelledCallback& cancelled);
+
+  // The format of an archive named |path|, from its extension: .zip, .tar,
+  // .tar.gz or .tgz. Returns false for other names.
+  static bool GetFormat(const std::string& path, Format* format);
+
+  // Archives the file or directory |from| to |archive|, which is replaced.
+  // The entries are named after |from| and what is below it.
+  CopyEngine::Result Create(const std::string& from,
+                            const std::string& archive, Format format);
+
+  // Extracts |archive| into the directory |to|, merging the directories
+  // which exist. Existing files are replaced if |overwrite|, otherwise they
+  // fail the extraction. The format is found from the content.
+  CopyEngine::Result Extract(const std::string& archive,
+                             const std::string& to, bool overwrite);
+
+  // Stops Create() or Extract() as soon as possible. Can be called from any
+  // thread.
+  void Cancel();
+
+ private:
+  struct Entry {
+    std::string path;
+    // Relative, with '/' after directories.
+    std::string name;
+    struct stat st;
+  };
+
+  bool Walk(const std::string& path, const std::string& name,
+            std::vector<Entry>* entries);
+  // Passes the data of the file |entry| on to |write|.
+  bool ReadFile(const Entry& entry,
+                const std::function<bool(const char*, size_t)>& write);
+  bool WriteTar(const std::vector<Entry>& entries, ArchiveWriter* out,
+                bool gzip);
+  bool WriteZip(const std::vector<Entry>& entries, ArchiveWriter* out);
+  bool ExtractTar(int fd, bool gzip, const std::string& to, bool overwrite);
+  bool ExtractZip(int fd, const std::string& to, bool overwrite);
+
+  // Creates the directory or opens the file |name| below |to|, with the
+  // directories leading to it. Returns -2 for the entries to skip, -1 on
+  // errors and the descriptor of the file otherwise; 0 for directories.
+  int OpenEntry(const std::string& to, const std::string& name,
+                bool directory, mode_t mode, bool overwrite,
+                std::string* path);
+  // Closes the file extracted to |path| and sets its time, or removes it
+  // if |ok| is false.
+  bool CloseEntry(int fd, const std::string& path, time_t mtime, bool ok);
+
+  bool stopped();
+  void AddTotals(uint64_t files, uint64_t bytes);
+  // Reports the progress every now and then, and polls the cancellation.
+  // Returns false once stopped.
+  bool AddProgress(uint64_t files, uint64_t bytes);
+
+  CopyEngine::ProgressCallback progress_callback_;
+  CopyEngine::CancelledCallback cancelled_callback_;
+
+  std::atomic<bool> stopped_;
+  std::vector<char> buffer_;
+  CopyEngine::Progress progress_;
+  int64_t next_progress_;
+  // The directories made or checked by OpenEntry().
+  std::set<std::string> directories_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArchiveEngine);
+};
+
+#endif  // FILESYSTEM_ARCHIVE_ENGINE_H_
@@ -0,0 +1,324 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/copy_engine.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "common/virtual_fs.h"
+
+namespace {
+
+// Work done by a single copy_file_range() or sendfile() call, so that
+// cancellation is noticed quickly.
+const size_t kChunkSize = 8 * 1024 * 1024;
+// For read() and write(), when the file can't be copied in the kernel.
+const size_t kBufferSize = 1024 * 1024;
+// For all the copies together.
+const unsigned kMaxWorkers = 4;
+const std::chrono::milliseconds kProgressInterval(250);
+
+enum CopyMethod {
+  COPY_FILE_RANGE,
+  SENDFILE,
+  READ_WRITE,
+};
+
+// glibc only has a wrapper since 2.27.
+ssize_t CopyFileRange(int in_fd, int out_fd, size_t size) {
+#ifdef SYS_copy_file_range
+  return syscall(SYS_copy_file_range, in_fd, NULL, out_fd, NULL, size, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+// The workers of concurrent copies share the same few cores and disks, so
+// they are counted together. A copy which gets none waits for one to be
+// released by another copy.
+std::mutex g_workers_mutex;
+unsigned g_workers = 0;
+
+bool AcquireWorker() {
+  static const unsigned max_workers = std::max(
+      1u, std::min(kMaxWorkers, std::thread::hardware_concurrency()));
+  std::lock_guard<std::mutex> lock(g_workers_mutex);
+  if (g_workers >= max_workers)
+    return false;
+  ++g_workers;
+  return true;
+}
+
+void ReleaseWorker() {
+  std::lock_guard<std::mutex> lock(g_workers_mutex);
+  --g_workers;
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+  while (size) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+}  // namespace
+
+CopyEngine::CopyEngine(const ProgressCallback& progress,
+                       const CancelledCallback& cancelled)
+    : progress_callback_(progress),
+      cancelled_callback_(cancelled),
+      stopped_(false),
+      failed_(false),
+      files_(0),
+      bytes_(0),
+      total_files_(0),
+      total_bytes_(0),
+      walk_done_(false),
+      busy_workers_(0) {}
+
+CopyEngine::~CopyEngine() {
+  Stop(false);
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i].join();
+}
+
+CopyEngine::Result CopyEngine::Copy(const std::string& from,
+                                    const std::string& to) {
+  struct stat st;
+  bool walked = false;
+  if (stat(from.c_str(), &st) == 0) {
+    if (S_ISREG(st.st_mode)) {
+      AddJob(from, to, st.st_size);
+      walked = true;
+    } else if (S_ISDIR(st.st_mode)) {
+      walked = Walk(from, to);
+    }
+  }
+  if (!walked && !stopped())
+    Stop(true);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  walk_done_ = true;
+  cond_.notify_all();
+
+  // The workers finish the queue, reporting progress in the meantime.
+  for (;;) {
+    bool done = cond_.wait_for(lock, kProgressInterval, [this]() {
+      return (jobs_.empty() || stopped()) && !busy_workers_;
+    });
+    if (done)
+      break;
+    StartWorkerIfNeeded();
+    lock.unlock();
+    if (cancelled_callback_ && cancelled_callback_())
+      Stop(false);
+    else if (progress_callback_)
+      progress_callback_(GetProgress());
+    lock.lock();
+  }
+  lock.unlock();
+
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i].join();
+  workers_.clear();
+
+  if (failed_)
+    return COPY_FAILED;
+  if (stopped())
+    return COPY_CANCELLED;
+  if (progress_callback_)
+    progress_callback_(GetProgress());
+  return COPY_OK;
+}
+
+void CopyEngine::Cancel() {
+  Stop(false);
+}
+
+bool CopyEngine::Walk(const std::string& from, const std::string& to) {
+  if (mkdir(to.c_str(), vfs_const::kDefaultFileMode) < 0 && errno != EEXIST)
+    return false;
+
+  DIR* dir = opendir(from.c_str());
+  if (!dir)
+    return false;
+
+  bool result = true;
+  while (dirent* entry = readdir(dir)) {
+    if (stopped() || (cancelled_callback_ && cancelled_callback_())) {
+      Stop(false);
+      result = false;
+      break;
+    }
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      continue;
+
+    std::string child_from = from + "/" + entry->d_name;
+    std::string child_to = to + "/" + entry->d_name;
+    struct stat st;
+    if (stat(child_from.c_str(), &st) < 0) {
+      result = false;
+      break;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      if (!Walk(child_from, child_to)) {
+        result = false;
+        break;
+      }
+    } else if (S_ISREG(st.st_mode)) {
+      AddJob(child_from, child_to, st.st_size);
+    }
+    // Devices, FIFOs and sockets have no data to copy.
+  }
+
+  closedir(dir);
+  return result;
+}
+
+void CopyEngine::AddJob(const std::string& from, const std::string& to,
+                        uint64_t size) {
+  total_files_ += 1;
+  total_bytes_ += size;
+
+  Job job;
+  job.from = from;
+  job.to = to;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(job);
+  StartWorkerIfNeeded();
+  cond_.notify_one();
+}
+
+void CopyEngine::StartWorkerIfNeeded() {
+  size_t idle_workers = workers_.size() - busy_workers_;
+  if (jobs_.size() > idle_workers && !stopped() && AcquireWorker())
+    workers_.push_back(std::thread(&CopyEngine::RunWorker, this));
+}
+
+void CopyEngine::RunWorker() {
+  std::vector<char> buffer;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_.wait(lock, [this]() {
+      return !jobs_.empty() || walk_done_ || stopped();
+    });
+    if (jobs_.empty() || stopped())
+      break;
+
+    Job job = jobs_.front();
+    jobs_.pop_front();
+    ++busy_workers_;
+    lock.unlock();
+    if (!CopyFile(job, &buffer) && !stopped())
+      Stop(true);
+    lock.lock();
+    --busy_workers_;
+    // Copy() waits for the workers to be idle.
+    cond_.notify_all();
+  }
+  ReleaseWorker();
+}
+
+bool CopyEngine::CopyFile(const Job& job, std::vector<char>* buffer) {
+  int in_fd = open(job.from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in_fd < 0)
+    return false;
+  int out_fd = open(job.to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    vfs_const::kDefaultFileMode);
+  if (out_fd < 0) {
+    close(in_fd);
+    return false;
+  }
+
+  bool result = CopyData(in_fd, out_fd, buffer);
+  close(in_fd);
+  if (close(out_fd) < 0)
+    result = false;
+
+  if (!result)
+    unlink(job.to.c_str());
+  else
+    files_ += 1;
+  return result;
+}
+
+bool CopyEngine::CopyData(int in_fd, int out_fd, std::vector<char>* buffer) {
+  CopyMethod method = COPY_FILE_RANGE;
+  for (;;) {
+    if (stopped())
+      return false;
+
+    ssize_t copied = 0;
+    switch (method) {
+      case COPY_FILE_RANGE:
+        copied = CopyFileRange(in_fd, out_fd, kChunkSize);
+        // Old kernels, and filesystems which can't do it. Both file
+        // offsets moved with what was copied, so the next method
+        // continues from there.
+        if (copied < 0 && (errno == ENOSYS || errno == EXDEV ||
+                           errno == EINVAL || errno == EOPNOTSUPP)) {
+          method = SENDFILE;
+          continue;
+        }
+        break;
+      case SENDFILE:
+        copied = sendfile(out_fd, in_fd, NULL, kChunkSize);
+        if (copied < 0 && (errno == ENOSYS || errno == EINVAL)) {
+          method = READ_WRITE;
+          posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+          continue;
+        }
+        break;
+      case READ_WRITE:
+        buffer->resize(kBufferSize);
+        copied = read(in_fd, &(*buffer)[0], buffer->size());
+        if (copied > 0 && !WriteAll(out_fd, &(*buffer)[0], copied))
+          return false;
+        break;
+    }
+
+    if (copied < 0 && errno == EINTR)
+      continue;
+    if (copied < 0)
+      return false;
+    if (!copied)
+      return true;
+    bytes_ += copied;
+  }
+}
+
+void CopyEngine::Stop(bool failed) {
+  if (failed)
+    failed_ = true;
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  cond_.notify_all();
+}
+
+CopyEngine::Progress CopyEngine::GetProgress() const {
+  Progress progress;
+  progress.files = files_;
+  progress.total_files = total_files_;
+  progress.bytes = bytes_;
+  progress.total_bytes = total_bytes_;
+  return progress;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_COPY_ENGINE_H_
+#define FILESYSTEM_COPY_ENGINE_H_
+
+// Copies files and directory trees for File.copyTo() and moveTo() across
+// storages. The calling thread walks the tree and creates the directories,
+// while a few threads, shared with the other copies, copy the files found
+// so far. File data is copied in
+// the kernel when possible: copy_file_range() lets the filesystem share or
+// copy extents itself, sendfile() at least avoids going through user space.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/utils.h"
+
+class CopyEngine {
+ public:
+  struct Progress {
+    uint64_t files;
+    uint64_t total_files;
+    uint64_t bytes;
+    uint64_t total_bytes;
+  };
+
+  enum Result {
+    COPY_OK,
+    COPY_CANCELLED,
+    COPY_FAILED,
+  };
+
+  typedef std::function<void(const Progress&)> ProgressCallback;
+  typedef std::function<bool()> CancelledCallback;
+
+  // |progress| is called from the thread calling Copy() every now and then,
+  // and once at the end of a successful copy. The copy stops when
+  // |cancelled| returns true; it is polled from the same thread. Both may be
+  // empty.
+  CopyEngine(const ProgressCallback& progress,
+             const CancelledCallback& cancelled);
+  ~CopyEngine();
+
+  // Copies the file or directory |from| to |to|. Existing files are
+  // overwritten and existing directories merged. Files which were partly
+  // copied when an error or cancellation stopped the copy are removed.
+  Result Copy(const std::string& from, const std::string& to);
+
+  // Stops Copy() as soon as possible. Can be called from any thread.
+  void Cancel();
+
+ private:
+  struct Job {
+    std::string from;
+    std::string to;
+  };
+
+  bool Walk(const std::string& from, const std::string& to);
+  void AddJob(const std::string& from, const std::string& to, uint64_t size);
+  // Called with |mutex_| held.
+  void StartWorkerIfNeeded();
+  void RunWorker();
+  bool CopyFile(const Job& job, std::vector<char>* buffer);
+  bool CopyData(int in_fd, int out_fd, std::vector<char>* buffer);
+
+  bool stopped() const { return stopped_.load(std::memory_order_relaxed); }
+  void Stop(bool failed);
+  Progress GetProgress() const;
+
+  ProgressCallback progress_callback_;
+  CancelledCallback cancelled_callback_;
+
+  std::atomic<bool> stopped_;
+  std::atomic<bool> failed_;
+  std::atomic<uint64_t> files_;
+  std::atomic<uint64_t> bytes_;
+  // Only changed by the walking thread.
+  std::atomic<uint64_t> total_files_;
+  std::atomic<uint64_t> total_bytes_;
+
+  std::mutex mutex_;
+  // Signaled when a job is queued, the walk is done or a worker finishes.
+  std::condition_variable cond_;
+  std::deque<Job> jobs_;
+  bool walk_done_;
+  size_t busy_workers_;
+  std::vector<std::thread> workers_;
+
+  DISALLOW_COPY_AND_ASSIGN(CopyEngine);
+};
+
+#endif  // FILESYSTEM_COPY_ENGINE_H_
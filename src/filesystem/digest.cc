@@ -0,0 +1,399 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/digest.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+uint32_t RotateLeft(uint32_t value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+uint32_t RotateRight(uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+uint64_t RotateLeft64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint32_t LoadBigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) |
+      p[3];
+}
+
+uint32_t LoadLittleEndian32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+      (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t LoadLittleEndian64(const uint8_t* p) {
+  return LoadLittleEndian32(p) |
+      (static_cast<uint64_t>(LoadLittleEndian32(p + 4)) << 32);
+}
+
+void AppendHex(uint64_t value, int bytes, std::string* out) {
+  const char kDigits[] = "0123456789abcdef";
+  for (int shift = bytes * 8 - 4; shift >= 0; shift -= 4)
+    out->push_back(kDigits[(value >> shift) & 0xf]);
+}
+
+// SHA-1 and SHA-256 work on 64 byte blocks, padded the same way.
+class BlockDigest : public Digest {
+ public:
+  BlockDigest() : length_(0), buffered_(0) {}
+
+  virtual void Update(const char* data, size_t size) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+    length_ += size;
+    if (buffered_) {
+      size_t count = std::min(size, sizeof(buffer_) - buffered_);
+      memcpy(buffer_ + buffered_, src, count);
+      buffered_ += count;
+      src += count;
+      size -= count;
+      if (buffered_ < sizeof(buffer_))
+        return;
+      Transform(buffer_);
+      buffered_ = 0;
+    }
+    for (; size >= sizeof(buffer_); size -= sizeof(buffer_)) {
+      Transform(src);
+      src += sizeof(buffer_);
+    }
+    memcpy(buffer_, src, size);
+    buffered_ = size;
+  }
+
+ protected:
+  // A 1 bit, zeros, and the length in bits as a big-endian number.
+  void Pad() {
+    uint64_t bits = length_ * 8;
+    uint8_t padding[72] = { 0x80 };
+    size_t size = (buffered_ < 56 ? 56 : 120) - buffered_;
+    for (int i = 0; i < 8; ++i)
+      padding[size + i] = bits >> (56 - i * 8);
+    Update(reinterpret_cast<const char*>(padding), size + 8);
+  }
+
+  virtual void Transform(const uint8_t* block) = 0;
+
+ private:
+  uint64_t length_;
+  uint8_t buffer_[64];
+  size_t buffered_;
+};
+
+class Sha256 : public BlockDigest {
+ public:
+  Sha256() {
+    const uint32_t kInitial[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(state_, kInitial, sizeof(state_));
+  }
+
+  virtual std::string Finish() {
+    Pad();
+    std::string out;
+    for (int i = 0; i < 8; ++i)
+      AppendHex(state_[i], 4, &out);
+    return out;
+  }
+
+ private:
+  virtual void Transform(const uint8_t* block) {
+    static const uint32_t kRounds[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+      0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+      0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+      0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+      0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+      0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i)
+      w[i] = LoadBigEndian32(block + i * 4);
+    for (int i = 16; i < 64; ++i) {
+      uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^
+          (w[i - 15] >> 3);
+      uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^
+          (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+      uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^
+          RotateRight(e, 25);
+      uint32_t choice = (e & f) ^ (~e & g);
+      uint32_t t1 = h + s1 + choice + kRounds[i] + w[i];
+      uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^
+          RotateRight(a, 22);
+      uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+      uint32_t t2 = s0 + majority;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+  }
+
+  uint32_t state_[8];
+};
+
+class Sha1 : public BlockDigest {
+ public:
+  Sha1() {
+    const uint32_t kInitial[5] = {
+      0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+    };
+    memcpy(state_, kInitial, sizeof(state_));
+  }
+
+  virtual std::string Finish() {
+    Pad();
+    std::string out;
+    for (int i = 0; i < 5; ++i)
+      AppendHex(state_[i], 4, &out);
+    return out;
+  }
+
+ private:
+  virtual void Transform(const uint8_t* block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+      w[i] = LoadBigEndian32(block + i * 4);
+    for (int i = 16; i < 80; ++i)
+      w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      uint32_t t = RotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = t;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+  }
+
+  uint32_t state_[5];
+};
+
+// Slicing-by-8: eight bytes per step, with a table for each byte position.
+struct Crc32Tables {
+  Crc32Tables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+      values[0][i] = crc;
+    }
+    for (int table = 1; table < 8; ++table) {
+      for (int i = 0; i < 256; ++i) {
+        uint32_t previous = values[table - 1][i];
+        values[table][i] = (previous >> 8) ^ values[0][previous & 0xff];
+      }
+    }
+  }
+
+  uint32_t values[8][256];
+};
+
+const Crc32Tables kCrc32Tables;
+
+class Crc32 : public Digest {
+ public:
+  Crc32() : crc_(0xffffffff) {}
+
+  virtual void Update(const char* data, size_t size) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+    const uint32_t (*t)[256] = kCrc32Tables.values;
+    uint32_t crc = crc_;
+    for (; size >= 8; size -= 8, src += 8) {
+      uint32_t low = LoadLittleEndian32(src) ^ crc;
+      uint32_t high = LoadLittleEndian32(src + 4);
+      crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^
+          t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+          t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^
+          t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+    for (; size; --size, ++src)
+      crc = (crc >> 8) ^ t[0][(crc ^ *src) & 0xff];
+    crc_ = crc;
+  }
+
+  virtual std::string Finish() {
+    std::string out;
+    AppendHex(~crc_, 4, &out);
+    return out;
+  }
+
+ private:
+  uint32_t crc_;
+};
+
+class XxHash64 : public Digest {
+ public:
+  XxHash64() : length_(0), buffered_(0) {
+    accumulators_[0] = kPrime1 + kPrime2;
+    accumulators_[1] = kPrime2;
+    accumulators_[2] = 0;
+    accumulators_[3] = -kPrime1;
+  }
+
+  virtual void Update(const char* data, size_t size) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+    length_ += size;
+    if (buffered_) {
+      size_t count = std::min(size, sizeof(buffer_) - buffered_);
+      memcpy(buffer_ + buffered_, src, count);
+      buffered_ += count;
+      src += count;
+      size -= count;
+      if (buffered_ < sizeof(buffer_))
+        return;
+      Stripe(buffer_);
+      buffered_ = 0;
+    }
+    for (; size >= sizeof(buffer_); size -= sizeof(buffer_)) {
+      Stripe(src);
+      src += sizeof(buffer_);
+    }
+    memcpy(buffer_, src, size);
+    buffered_ = size;
+  }
+
+  virtual std::string Finish() {
+    uint64_t hash;
+    if (length_ >= sizeof(buffer_)) {
+      hash = RotateLeft64(accumulators_[0], 1) +
+          RotateLeft64(accumulators_[1], 7) +
+          RotateLeft64(accumulators_[2], 12) +
+          RotateLeft64(accumulators_[3], 18);
+      for (int i = 0; i < 4; ++i) {
+        hash ^= Round(0, accumulators_[i]);
+        hash = hash * kPrime1 + kPrime4;
+      }
+    } else {
+      hash = kPrime5;
+    }
+    hash += length_;
+
+    const uint8_t* p = buffer_;
+    const uint8_t* end = buffer_ + buffered_;
+    for (; p + 8 <= end; p += 8) {
+      hash ^= Round(0, LoadLittleEndian64(p));
+      hash = RotateLeft64(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+      hash ^= LoadLittleEndian32(p) * kPrime1;
+      hash = RotateLeft64(hash, 23) * kPrime2 + kPrime3;
+      p += 4;
+    }
+    for (; p < end; ++p) {
+      hash ^= *p * kPrime5;
+      hash = RotateLeft64(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+
+    std::string out;
+    AppendHex(hash, 8, &out);
+    return out;
+  }
+
+ private:
+  static const uint64_t kPrime1 = 11400714785074694791ULL;
+  static const uint64_t kPrime2 = 14029467366897019727ULL;
+  static const uint64_t kPrime3 = 1609587929392839161ULL;
+  static const uint64_t kPrime4 = 9650029242287828579ULL;
+  static const uint64_t kPrime5 = 2870177450012600261ULL;
+
+  static uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    return RotateLeft64(accumulator, 31) * kPrime1;
+  }
+
+  void Stripe(const uint8_t* stripe) {
+    for (int i = 0; i < 4; ++i) {
+      accumulators_[i] =
+          Round(accumulators_[i], LoadLittleEndian64(stripe + i * 8));
+    }
+  }
+
+  uint64_t accumulators_[4];
+  uint64_t length_;
+  uint8_t buffer_[32];
+  size_t buffered_;
+};
+
+}  // namespace
+
+Digest* Digest::Create(const std::string& name) {
+  if (name == "SHA-256")
+    return new Sha256;
+  if (name == "SHA-1")
+    return new Sha1;
+  if (name == "CRC32")
+    return new Crc32;
+  if (name == "XXH64")
+    return new XxHash64;
+  return NULL;
+}
@@ -0,0 +1,29 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_DIGEST_H_
+#define FILESYSTEM_DIGEST_H_
+
+// Hashes and checksums of file contents, fed with the data as it is read:
+// SHA-256, SHA-1, CRC32 (as computed by zlib) and XXH64 with a seed of 0.
+
+#include <stddef.h>
+
+#include <string>
+
+class Digest {
+ public:
+  // |name| is one of "SHA-256", "SHA-1", "CRC32" and "XXH64". Returns NULL
+  // for other names.
+  static Digest* Create(const std::string& name);
+
+  virtual ~Digest() {}
+
+  virtual void Update(const char* data, size_t size) = 0;
+  // The digest in lower case hexadecimal, big-endian for the checksums.
+  // Can only be called once.
+  virtual std::string Finish() = 0;
+};
+
+#endif  // FILESYSTEM_DIGEST_H_
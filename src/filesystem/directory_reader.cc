@@ -0,0 +1,211 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/directory_reader.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <limits>
+
+#include "common/picojson.h"
+
+namespace {
+
+// Room for a few hundred entries per getdents64() call.
+const size_t kBufferSize = 32 * 1024;
+
+// Not exported by glibc.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  uint16_t d_reclen;
+  uint8_t d_type;
+  char d_name[1];
+};
+
+char ToLower(char c) {
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// |pattern| is lower case.
+bool MatchPattern(const char* pattern, const char* name) {
+  const char* wildcard = NULL;
+  const char* wildcard_name = NULL;
+  while (*name) {
+    if (*pattern == '%') {
+      wildcard = ++pattern;
+      wildcard_name = name;
+    } else if (*pattern && *pattern == ToLower(*name)) {
+      ++pattern;
+      ++name;
+    } else if (wildcard) {
+      // Let the wildcard take one more character.
+      pattern = wildcard;
+      name = ++wildcard_name;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '%')
+    ++pattern;
+  return !*pattern;
+}
+
+// Dates are serialized by JSON.stringify() as ISO 8601 strings in UTC.
+bool ParseDate(const picojson::value& value, int64_t* seconds) {
+  if (value.is<picojson::null>())
+    return true;
+  if (value.is<double>()) {
+    *seconds = static_cast<int64_t>(value.get<double>() / 1000);
+    return true;
+  }
+  if (!value.is<std::string>())
+    return false;
+
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  if (sscanf(value.get<std::string>().c_str(), "%d-%d-%dT%d:%d:%d",
+             &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+             &tm.tm_sec) != 6)
+    return false;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  *seconds = timegm(&tm);
+  return true;
+}
+
+}  // namespace
+
+DirectoryReader::DirectoryReader()
+    : fd_(-1),
+      position_(0),
+      size_(0),
+      error_(false) {}
+
+DirectoryReader::~DirectoryReader() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool DirectoryReader::Open(const std::string& path) {
+  fd_ = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_ < 0)
+    return false;
+  buffer_.resize(kBufferSize);
+  return true;
+}
+
+bool DirectoryReader::Next(Entry* entry) {
+  for (;;) {
+    if (position_ >= size_) {
+      if (fd_ < 0 || error_)
+        return false;
+      ssize_t result;
+      do {
+        result = syscall(SYS_getdents64, fd_, &buffer_[0], buffer_.size());
+      } while (result < 0 && errno == EINTR);
+      if (result < 0)
+        error_ = true;
+      if (result <= 0)
+        return false;
+      position_ = 0;
+      size_ = result;
+    }
+
+    const LinuxDirent64* dirent =
+        reinterpret_cast<const LinuxDirent64*>(&buffer_[position_]);
+    position_ += dirent->d_reclen;
+
+    const char* name = dirent->d_name;
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+      continue;
+
+    entry->name = name;
+    switch (dirent->d_type) {
+      case DT_REG:
+        entry->type = TYPE_FILE;
+        break;
+      case DT_DIR:
+        entry->type = TYPE_DIRECTORY;
+        break;
+      case DT_UNKNOWN:
+      // Links are reported as what they point to, like stat() does.
+      case DT_LNK:
+        entry->type = TYPE_UNKNOWN;
+        break;
+      default:
+        entry->type = TYPE_OTHER;
+    }
+    return true;
+  }
+}
+
+bool DirectoryReader::Stat(Entry* entry, struct stat* st) {
+  if (fstatat(fd_, entry->name, st, 0) < 0)
+    return false;
+  if (S_ISREG(st->st_mode))
+    entry->type = TYPE_FILE;
+  else if (S_ISDIR(st->st_mode))
+    entry->type = TYPE_DIRECTORY;
+  else
+    entry->type = TYPE_OTHER;
+  return true;
+}
+
+ListFilter::ListFilter()
+    : needs_stat_(false),
+      start_modified_(std::numeric_limits<int64_t>::min()),
+      end_modified_(std::numeric_limits<int64_t>::max()),
+      start_created_(std::numeric_limits<int64_t>::min()),
+      end_created_(std::numeric_limits<int64_t>::max()) {}
+
+bool ListFilter::Parse(const std::string& json) {
+  if (json.empty())
+    return true;
+
+  picojson::value filter;
+  std::string error;
+  picojson::parse(filter, json.begin(), json.end(), &error);
+  if (!error.empty() || !filter.is<picojson::object>())
+    return false;
+
+  if (filter.contains("name")) {
+    const picojson::value& name = filter.get("name");
+    if (!name.is<std::string>())
+      return false;
+    name_ = name.get<std::string>();
+    for (size_t i = 0; i < name_.size(); ++i)
+      name_[i] = ToLower(name_[i]);
+  }
+
+  if (!ParseDate(filter.get("startModified"), &start_modified_) ||
+      !ParseDate(filter.get("endModified"), &end_modified_) ||
+      !ParseDate(filter.get("startCreated"), &start_created_) ||
+      !ParseDate(filter.get("endCreated"), &end_created_))
+    return false;
+
+  needs_stat_ = start_modified_ != std::numeric_limits<int64_t>::min() ||
+      end_modified_ != std::numeric_limits<int64_t>::max() ||
+      start_created_ != std::numeric_limits<int64_t>::min() ||
+      end_created_ != std::numeric_limits<int64_t>::max();
+  return true;
+}
+
+bool ListFilter::MatchName(const char* name) const {
+  return name_.empty() || MatchPattern(name_.c_str(), name);
+}
+
+bool ListFilter::MatchStat(const struct stat& st) const {
+  // Created is the change time, as in FileStat replies.
+  return st.st_mtime >= start_modified_ && st.st_mtime <= end_modified_ &&
+      st.st_ctime >= start_created_ && st.st_ctime <= end_created_;
+}
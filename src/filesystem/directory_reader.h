@@ -0,0 +1,82 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_DIRECTORY_READER_H_
+#define FILESYSTEM_DIRECTORY_READER_H_
+
+// Reads directories with getdents64(), many entries per system call. The
+// type of the entries comes from d_type, so listing a directory doesn't
+// need a stat() per entry unless the filter looks at dates.
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+
+class DirectoryReader {
+ public:
+  enum Type {
+    TYPE_UNKNOWN,
+    TYPE_FILE,
+    TYPE_DIRECTORY,
+    TYPE_OTHER,
+  };
+
+  struct Entry {
+    // Valid until the next call to Next().
+    const char* name;
+    Type type;
+  };
+
+  DirectoryReader();
+  ~DirectoryReader();
+
+  bool Open(const std::string& path);
+  // Skips "." and "..". Returns false at the end of the directory, or on
+  // errors.
+  bool Next(Entry* entry);
+  bool error() const { return error_; }
+
+  // Stats an entry of the directory. Fills in |entry->type| if unknown.
+  bool Stat(Entry* entry, struct stat* st);
+
+ private:
+  int fd_;
+  std::vector<char> buffer_;
+  size_t position_;
+  size_t size_;
+  bool error_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectoryReader);
+};
+
+// The FileFilter of File.listFiles(). Names match case-insensitively, with
+// '%' standing for any sequence of characters; dates are inclusive bounds.
+class ListFilter {
+ public:
+  ListFilter();
+
+  // |json| is the serialized FileFilter, empty for none. Returns false if
+  // it is not an object or has invalid members.
+  bool Parse(const std::string& json);
+
+  bool MatchName(const char* name) const;
+  // Whether MatchStat() has anything to check.
+  bool needs_stat() const { return needs_stat_; }
+  bool MatchStat(const struct stat& st) const;
+
+ private:
+  // Lower case.
+  std::string name_;
+  bool needs_stat_;
+  int64_t start_modified_;
+  int64_t end_modified_;
+  int64_t start_created_;
+  int64_t end_created_;
+};
+
+#endif  // FILESYSTEM_DIRECTORY_READER_H_
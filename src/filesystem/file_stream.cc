@@ -0,0 +1,394 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/file_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+// Read ahead for small reads, and alignment of the buffer.
+const size_t kReadBufferSize = 64 * 1024;
+const size_t kBufferAlignment = 4096;
+
+// The open(2) flags std::fstream uses for |mode|.
+int OpenFlags(std::ios_base::openmode mode) {
+  bool in = mode & std::ios_base::in;
+  bool out = mode & std::ios_base::out;
+  if (mode & std::ios_base::app)
+    return (in ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+  if (in && out) {
+    if (mode & std::ios_base::trunc)
+      return O_RDWR | O_CREAT | O_TRUNC;
+    return O_RDWR;
+  }
+  if (out)
+    return O_WRONLY | O_CREAT | O_TRUNC;
+  return O_RDONLY;
+}
+
+}  // namespace
+
+// static
+FileStream* FileStream::Open(const std::string& path,
+                             std::ios_base::openmode mode) {
+  int flags = OpenFlags(mode);
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0666);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if ((flags & O_ACCMODE) == O_RDONLY && fstat(fd, &st) == 0 &&
+      S_ISREG(st.st_mode) && st.st_size > 0) {
+    if (FileStream* stream = MappedFileStream::Create(fd))
+      return stream;
+  }
+  // Also for files too big for the address space.
+  return new FdFileStream(fd);
+}
+
+// static
+MappedFileStream* MappedFileStream::Create(int fd) {
+  MappedFileStream* stream = new MappedFileStream(fd);
+  if (!stream->UpdateMapping() || !stream->data_) {
+    stream->fd_ = -1;
+    delete stream;
+    return NULL;
+  }
+  return stream;
+}
+
+MappedFileStream::MappedFileStream(int fd)
+    : fd_(fd),
+      data_(NULL),
+      size_(0),
+      position_(0) {}
+
+MappedFileStream::~MappedFileStream() {
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool MappedFileStream::UpdateMapping() {
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+    return false;
+  if (static_cast<uint64_t>(st.st_size) == size_)
+    return true;
+  if (static_cast<uint64_t>(st.st_size) > SIZE_MAX)
+    return false;
+
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+  data_ = NULL;
+  size_ = 0;
+  if (!st.st_size)
+    return true;
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (data == MAP_FAILED)
+    return false;
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  data_ = static_cast<const char*>(data);
+  size_ = st.st_size;
+  return true;
+}
+
+bool MappedFileStream::Read(size_t count, const char** data, size_t* size) {
+  if (!UpdateMapping())
+    return false;
+  size_t available = position_ < size_ ? size_ - position_ : 0;
+  *size = std::min(count, available);
+  *data = data_ + position_;
+  position_ += *size;
+  eof_ = *size < count;
+  return true;
+}
+
+bool MappedFileStream::Write(const char*, size_t) {
+  return false;
+}
+
+int64_t MappedFileStream::Position() {
+  return position_;
+}
+
+bool MappedFileStream::SetPosition(int64_t position) {
+  if (position < 0)
+    return false;
+  position_ = position;
+  eof_ = false;
+  return true;
+}
+
+int64_t MappedFileStream::BytesAvailable() {
+  if (!UpdateMapping())
+    return 0;
+  return position_ < size_ ? size_ - position_ : 0;
+}
+
+bool MappedFileStream::SetWriteBufferSize(size_t) {
+  return true;
+}
+
+bool MappedFileStream::Flush(bool) {
+  return true;
+}
+
+FdFileStream::FdFileStream(int fd)
+    : fd_(fd),
+      seekable_(lseek(fd, 0, SEEK_CUR) >= 0),
+      append_(fcntl(fd, F_GETFL) & O_APPEND),
+      position_(0),
+      buffer_(NULL),
+      capacity_(0),
+      buffer_start_(0),
+      buffer_size_(0),
+      write_start_(0),
+      write_size_(0) {}
+
+FdFileStream::~FdFileStream() {
+  // Whoever cares about errors flushes before.
+  FlushWriteBuffer();
+  free(buffer_);
+  close(fd_);
+}
+
+bool FdFileStream::Reserve(size_t size) {
+  if (size <= capacity_)
+    return true;
+  size_t capacity =
+      (size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+  void* buffer;
+  if (posix_memalign(&buffer, kBufferAlignment, capacity))
+    return false;
+  if (buffer_size_)
+    memcpy(buffer, buffer_, buffer_size_);
+  free(buffer_);
+  buffer_ = static_cast<char*>(buffer);
+  capacity_ = capacity;
+  return true;
+}
+
+bool FdFileStream::Fill(size_t min_size) {
+  while (buffer_size_ < min_size) {
+    char* end = buffer_ + buffer_size_;
+    size_t room = capacity_ - buffer_size_;
+    ssize_t result = seekable_ ?
+        pread(fd_, end, room, buffer_start_ + buffer_size_) :
+        read(fd_, end, room);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      return false;
+    if (!result)
+      break;
+    buffer_size_ += result;
+  }
+  return true;
+}
+
+bool FdFileStream::Read(size_t count, const char** data, size_t* size) {
+  if (!FlushWriteBuffer())
+    return false;
+
+  bool buffered = position_ >= buffer_start_ &&
+      position_ - buffer_start_ + count <= buffer_size_;
+  if (!buffered) {
+    // Keep what is left, it can't be read again from pipes.
+    size_t kept = 0;
+    if (position_ >= buffer_start_ &&
+        position_ < buffer_start_ + static_cast<int64_t>(buffer_size_)) {
+      kept = buffer_start_ + buffer_size_ - position_;
+      memmove(buffer_, buffer_ + (position_ - buffer_start_), kept);
+    }
+    buffer_start_ = position_;
+    buffer_size_ = kept;
+
+    // Pipes only return what they have, don't wait for more than asked.
+    if (!Reserve(std::max(count, kReadBufferSize)) || !Fill(count)) {
+      buffer_size_ = 0;
+      return false;
+    }
+  }
+
+  size_t offset = position_ - buffer_start_;
+  *data = buffer_ + offset;
+  *size = std::min(count, buffer_size_ - offset);
+  position_ += *size;
+  eof_ = *size < count;
+  return true;
+}
+
+bool FdFileStream::Write(const char* data, size_t size) {
+  // Simpler than patching the buffered data. Data read ahead from pipes
+  // is not in the way of writes, and stays.
+  if (seekable_)
+    buffer_size_ = 0;
+
+  // In append mode everything goes to the end of the file, in order.
+  bool follows = append_ || !seekable_ ||
+      position_ == write_start_ + static_cast<int64_t>(write_size_);
+  if (write_size_ &&
+      (!follows || write_size_ + size > write_buffer_.size())) {
+    if (!FlushWriteBuffer())
+      return false;
+  }
+
+  if (size < write_buffer_.size()) {
+    if (!write_size_)
+      write_start_ = position_;
+    memcpy(&write_buffer_[write_size_], data, size);
+    write_size_ += size;
+    position_ += size;
+  } else {
+    if (!WriteFully(data, size, position_))
+      return false;
+    if (append_ && seekable_)
+      position_ = lseek(fd_, 0, SEEK_CUR);
+    else
+      position_ += size;
+  }
+
+  if (!seekable_)
+    buffer_start_ += size;
+  eof_ = false;
+  return true;
+}
+
+bool FdFileStream::WriteFully(const char* data, size_t size,
+                              int64_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    // pwrite() ignores the offset with O_APPEND.
+    ssize_t result = seekable_ && !append_ ?
+        pwrite(fd_, data + done, size - done, offset + done) :
+        write(fd_, data + done, size - done);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result < 0)
+      return false;
+    done += result;
+  }
+  return true;
+}
+
+bool FdFileStream::FlushWriteBuffer() {
+  if (!write_size_)
+    return true;
+  // The data is dropped on errors, which are reported once.
+  size_t size = write_size_;
+  write_size_ = 0;
+  if (!WriteFully(&write_buffer_[0], size, write_start_))
+    return false;
+  if (append_ && seekable_)
+    position_ = lseek(fd_, 0, SEEK_CUR);
+  return true;
+}
+
+bool FdFileStream::SetWriteBufferSize(size_t size) {
+  if (size > kMaxWriteBufferSize || !FlushWriteBuffer())
+    return false;
+  std::vector<char>(size).swap(write_buffer_);
+  return true;
+}
+
+bool FdFileStream::Flush(bool durable) {
+  if (!FlushWriteBuffer())
+    return false;
+  // Pipes and the like have nothing to sync, and say EINVAL.
+  return !durable || !fdatasync(fd_) || errno == EINVAL;
+}
+
+int64_t FdFileStream::Position() {
+  return position_;
+}
+
+bool FdFileStream::SetPosition(int64_t position) {
+  if (!seekable_ || position < 0)
+    return false;
+  position_ = position;
+  eof_ = false;
+  return true;
+}
+
+int64_t FdFileStream::BytesAvailable() {
+  struct stat st;
+  if (!FlushWriteBuffer() || fstat(fd_, &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size < position_)
+    return 0;
+  return st.st_size - position_;
+}
+
+FileStreamTable::FileStreamTable() {}
+
+FileStreamTable::~FileStreamTable() {
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    delete slots_[i].entry.stream;
+    delete slots_[i].entry.decoder;
+  }
+}
+
+bool FileStreamTable::Add(FileStream* stream, std::ios_base::openmode mode,
+                          const std::string& encoding, unsigned* id) {
+  size_t index;
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (slots_.size() <= 0xffff) {
+    index = slots_.size();
+    Slot slot;
+    slot.entry.stream = NULL;
+    slot.entry.decoder = NULL;
+    // Generations start at 1 so that IDs are never 0.
+    slot.generation = 1;
+    slots_.push_back(slot);
+  } else {
+    return false;
+  }
+
+  Slot& slot = slots_[index];
+  slot.entry.mode = mode;
+  slot.entry.stream = stream;
+  slot.entry.encoding = encoding;
+  slot.entry.durable = false;
+  *id = (static_cast<unsigned>(slot.generation) << 16) | index;
+  return true;
+}
+
+FileStreamTable::Entry* FileStreamTable::Get(unsigned id) {
+  size_t index = id & 0xffff;
+  if (index >= slots_.size())
+    return NULL;
+  Slot& slot = slots_[index];
+  if (slot.generation != id >> 16 || !slot.entry.stream)
+    return NULL;
+  return &slot.entry;
+}
+
+void FileStreamTable::Remove(unsigned id) {
+  Entry* entry = Get(id);
+  if (!entry)
+    return;
+  delete entry->stream;
+  entry->stream = NULL;
+  entry->encoding.clear();
+  delete entry->decoder;
+  entry->decoder = NULL;
+
+  size_t index = id & 0xffff;
+  if (!++slots_[index].generation)
+    slots_[index].generation = 1;
+  free_slots_.push_back(index);
+}
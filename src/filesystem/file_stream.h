@@ -0,0 +1,182 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_FILE_STREAM_H_
+#define FILESYSTEM_FILE_STREAM_H_
+
+// The files opened by FileStream objects in JavaScript. Reads hand out
+// pointers to the data instead of copying it, so the replies can be encoded
+// straight from the page cache when the file is mapped.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#include <ios>
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+#include "filesystem/text_decoder.h"
+
+class FileStream {
+ public:
+  // Read-only regular files are mapped in memory, other files are accessed
+  // through their descriptor. |mode| is interpreted like std::fstream does.
+  // Returns NULL on errors.
+  static FileStream* Open(const std::string& path,
+                          std::ios_base::openmode mode);
+
+  virtual ~FileStream() {}
+
+  // Reads up to |count| bytes from the position, fewer at the end of the
+  // file. |data| remains valid until the next call on the stream. Returns
+  // false on errors.
+  virtual bool Read(size_t count, const char** data, size_t* size) = 0;
+  virtual bool Write(const char* data, size_t size) = 0;
+
+  // Returns -1 on errors.
+  virtual int64_t Position() = 0;
+  virtual bool SetPosition(int64_t position) = 0;
+  // From the position to the end of the file, 0 if unknown.
+  virtual int64_t BytesAvailable() = 0;
+
+  // Write-behind: writes are kept in a buffer of |size| bytes, at most
+  // kMaxWriteBufferSize, until it is full, the stream is read, flushed or
+  // closed. 0, the default, writes through. Errors of buffered writes are
+  // reported by the call which writes them out.
+  static const size_t kMaxWriteBufferSize = 16 * 1024 * 1024;
+  virtual bool SetWriteBufferSize(size_t size) = 0;
+  // Writes out the buffered data. With |durable|, also waits for the data
+  // to reach the storage.
+  virtual bool Flush(bool durable) = 0;
+
+  // Whether a read reached the end of the file. Cleared when the position
+  // is set.
+  bool eof() const { return eof_; }
+
+ protected:
+  FileStream() : eof_(false) {}
+
+  bool eof_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileStream);
+};
+
+// Read-only stream over a memory mapping of the whole file.
+class MappedFileStream : public FileStream {
+ public:
+  // Takes ownership of |fd|.
+  static MappedFileStream* Create(int fd);
+  ~MappedFileStream();
+
+  bool Read(size_t count, const char** data, size_t* size);
+  bool Write(const char* data, size_t size);
+  int64_t Position();
+  bool SetPosition(int64_t position);
+  int64_t BytesAvailable();
+  bool SetWriteBufferSize(size_t size);
+  bool Flush(bool durable);
+
+ private:
+  explicit MappedFileStream(int fd);
+
+  // Follows the size of the file, which may change while it is open.
+  // Touching the mapping past the end of a truncated file would crash.
+  bool UpdateMapping();
+
+  int fd_;
+  const char* data_;
+  size_t size_;
+  size_t position_;
+};
+
+// Stream over a file descriptor, for the files which are written or can't
+// be mapped. Reads go through a buffer kept for the life of the stream, so
+// that small reads in a loop mostly don't reach the kernel. Seekable files
+// are accessed with pread()/pwrite() at the stream position, which doesn't
+// need to be synced with the kernel's. Consecutive writes are gathered in
+// the write buffer if there is one, any other access writes it out first.
+class FdFileStream : public FileStream {
+ public:
+  // Takes ownership of |fd|.
+  explicit FdFileStream(int fd);
+  ~FdFileStream();
+
+  bool Read(size_t count, const char** data, size_t* size);
+  bool Write(const char* data, size_t size);
+  int64_t Position();
+  bool SetPosition(int64_t position);
+  int64_t BytesAvailable();
+  bool SetWriteBufferSize(size_t size);
+  bool Flush(bool durable);
+
+ private:
+  // Makes room for |size| bytes in the buffer, keeping its data.
+  bool Reserve(size_t size);
+  // Reads until the buffer holds |min_size| bytes or the end of the file.
+  bool Fill(size_t min_size);
+  // Writes all of |data| at |offset|, or at the end of the file in append
+  // mode and for pipes.
+  bool WriteFully(const char* data, size_t size, int64_t offset);
+  bool FlushWriteBuffer();
+
+  int fd_;
+  bool seekable_;
+  bool append_;
+  int64_t position_;
+
+  char* buffer_;
+  size_t capacity_;
+  // The file data in the buffer, starting at |buffer_start_|.
+  int64_t buffer_start_;
+  size_t buffer_size_;
+
+  std::vector<char> write_buffer_;
+  // The pending data, to be written at |write_start_|.
+  int64_t write_start_;
+  size_t write_size_;
+};
+
+// The streams of an instance, by the IDs handed to JavaScript. IDs combine
+// a slot index and the generation of the slot, so lookups are a bounds check
+// and stale IDs never reach a stream which reused their slot.
+class FileStreamTable {
+ public:
+  struct Entry {
+    std::ios_base::openmode mode;
+    FileStream* stream;
+    std::string encoding;
+    // Whether flushing and closing wait for the data to reach the storage.
+    bool durable;
+    // Created by the first text read, NULL until then.
+    TextDecoder* decoder;
+  };
+
+  FileStreamTable();
+  ~FileStreamTable();
+
+  // Takes ownership of |stream|. Returns false if the table is full.
+  bool Add(FileStream* stream, std::ios_base::openmode mode,
+           const std::string& encoding, unsigned* id);
+  // Returns NULL if |id| is not open.
+  Entry* Get(unsigned id);
+  // Closes the stream.
+  void Remove(unsigned id);
+
+ private:
+  struct Slot {
+    Entry entry;
+    uint16_t generation;
+  };
+
+  std::vector<Slot> slots_;
+  std::vector<uint16_t> free_slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileStreamTable);
+};
+
+#endif  // FILESYSTEM_FILE_STREAM_H_
@@ -10,15 +10,30 @@
         'packages': [
           'capi-appfw-application',
           'pkgmgr-info',
+          'zlib',
         ],
       },
       'sources': [
         # filesystem_api.js is generated by inject_encodings action below
         '<(INTERMEDIATE_DIR)/filesystem_api.js',
+        'archive_engine.cc',
+        'archive_engine.h',
+        'copy_engine.cc',
+        'copy_engine.h',
+        'digest.cc',
+        'digest.h',
+        'directory_reader.cc',
+        'directory_reader.h',
+        'file_stream.cc',
+        'file_stream.h',
         'filesystem_extension.cc',
         'filesystem_extension.h',
         'filesystem_instance.cc',
         'filesystem_instance.h',
+        'metadata_cache.cc',
+        'metadata_cache.h',
+        'text_decoder.cc',
+        'text_decoder.h',
         '../common/virtual_fs.cc',
         '../common/virtual_fs.h',
       ],
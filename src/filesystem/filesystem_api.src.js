@@ -14,17 +14,25 @@ var getNextReplyId = function() {
 
 var encodings = {'UTF-8' : 1, 'ISO8859-1' : 1}; // gyp injection here
 
+// Messages sent while a request is being handled, by its reply_id.
+var _event_callbacks = {};
+
 var postMessage = function(msg, callback) {
   var reply_id = getNextReplyId();
   _callbacks[reply_id] = callback;
   msg.reply_id = reply_id;
   extension.postMessage(JSON.stringify(msg));
+  return reply_id;
 };
 
 extension.setMessageListener(function(json) {
   var msg = JSON.parse(json);
   if (msg.cmd === 'storageChanged') {
     handleStorageChanged(msg);
+  } else if (msg.cmd === 'copyProgress' || msg.cmd === 'listFilesChunk') {
+    var event_callback = _event_callbacks[msg.reply_id];
+    if (event_callback)
+      event_callback(msg);
   } else {
     var reply_id = msg.reply_id;
     var callback = _callbacks[reply_id];
@@ -62,6 +70,53 @@ var getFileParent = function(childPath) {
 
 function is_string(value) { return typeof(value) === 'string' || value instanceof String; }
 function is_integer(value) { return isFinite(value) && !isNaN(parseInt(value)); }
+
+// Bytes go through the messaging as base64, a JSON array of numbers being
+// several times bigger.
+var base64_chars =
+    'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/';
+var base64_values = (function() {
+  var values = {};
+  for (var i = 0; i < base64_chars.length; i++)
+    values[base64_chars.charCodeAt(i)] = i;
+  return values;
+})();
+
+function base64_to_bytes(data) {
+  var length = data.length;
+  while (length > 0 && data.charAt(length - 1) === '=')
+    length--;
+  var bytes = new Array(Math.floor(length * 3 / 4));
+  var bits = 0;
+  var count = 0;
+  var j = 0;
+  for (var i = 0; i < length; i++) {
+    bits = (bits << 6) | base64_values[data.charCodeAt(i)];
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      bytes[j++] = (bits >> count) & 0xff;
+    }
+  }
+  return bytes;
+}
+
+function bytes_to_base64(bytes) {
+  var parts = [];
+  var length = bytes.length;
+  for (var i = 0; i < length; i += 3) {
+    var triple = (bytes[i] & 0xff) << 16;
+    if (i + 1 < length)
+      triple |= (bytes[i + 1] & 0xff) << 8;
+    if (i + 2 < length)
+      triple |= bytes[i + 2] & 0xff;
+    parts.push(base64_chars.charAt(triple >> 18) +
+               base64_chars.charAt((triple >> 12) & 0x3f) +
+               (i + 1 < length ? base64_chars.charAt((triple >> 6) & 0x3f) : '=') +
+               (i + 2 < length ? base64_chars.charAt(triple & 0x3f) : '='));
+  }
+  return parts.join('');
+}
 function get_valid_mode(mode) {
   if (mode === null)
     return 'rw';
@@ -227,10 +282,22 @@ function FileStream(streamID) {
   });
 }
 
+// Buffered writes which fail are only reported when the buffer is written
+// out, which close() and flush() do.
 FileStream.prototype.close = function() {
-  sendSyncMessage('FileStreamClose', {
+  var result = sendSyncMessage('FileStreamClose', {
+    streamID: this.streamID
+  });
+  if (result.isError)
+    throw new tizen.WebAPIException(result.errorCode);
+};
+
+FileStream.prototype.flush = function() {
+  var result = sendSyncMessage('FileStreamFlush', {
     streamID: this.streamID
   });
+  if (result.isError)
+    throw new tizen.WebAPIException(result.errorCode);
 };
 
 FileStream.prototype.read = function(charCount) {
@@ -260,7 +327,7 @@ FileStream.prototype.readBytes = function(byteCount) {
   if (result.isError)
     throw new tizen.WebAPIException(result.errorCode);
   else
-    return result.value;
+    return base64_to_bytes(result.value);
 };
 
 FileStream.prototype.readBase64 = function(byteCount) {
@@ -297,8 +364,8 @@ FileStream.prototype.writeBytes = function(byteData) {
 
   var result = sendSyncMessage('FileStreamWrite', {
     streamID: this.streamID,
-    type: 'Bytes',
-    data: byteData
+    type: 'Base64',
+    data: bytes_to_base64(byteData)
   });
   if (result.isError)
     throw new tizen.WebAPIException(result.errorCode);
@@ -317,12 +384,61 @@ FileStream.prototype.writeBase64 = function(base64Data) {
     throw new tizen.WebAPIException(result.errorCode);
 };
 
-function File(fullPath, parent) {
+// The asynchronous writes are an extension of the Tizen API. They return
+// right away, and are done in order with the other calls on the stream.
+var postStreamWrite = function(stream, type, data, onsuccess, onerror) {
+  if (onsuccess !== null && onsuccess !== undefined &&
+      !(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && onerror !== undefined &&
+      !(onerror instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  postMessage({
+    cmd: 'FileStreamWriteAsync',
+    streamID: stream.streamID,
+    type: type,
+    data: data
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else if (onsuccess) {
+      onsuccess();
+    }
+  });
+};
+
+FileStream.prototype.writeAsync = function(stringData, onsuccess, onerror) {
+  if (!(is_string(stringData)))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  postStreamWrite(this, 'Default', stringData, onsuccess, onerror);
+};
+
+FileStream.prototype.writeBytesAsync = function(byteData, onsuccess,
+                                                onerror) {
+  if (!Array.isArray(byteData))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  postStreamWrite(this, 'Base64', bytes_to_base64(byteData), onsuccess,
+                  onerror);
+};
+
+FileStream.prototype.writeBase64Async = function(base64Data, onsuccess,
+                                                 onerror) {
+  if (!(is_string(base64Data)))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  postStreamWrite(this, 'Base64', base64Data, onsuccess, onerror);
+};
+
+// |type| is 'f' or 'd' when known to be a file or a directory, as listFiles()
+// tells, to answer isFile and isDirectory without a stat.
+function File(fullPath, parent, type, status) {
   this.fullPath = fullPath;
   this.parent = parent;
 
-  var stat_cached = undefined;
-  var stat_last_time = undefined;
+  // |status| is the value of a FileStat reply already at hand.
+  var stat_cached = status ? { isError: false, value: status } : undefined;
+  var stat_last_time = status ? Date.now() : undefined;
 
   function stat() {
     var now = Date.now();
@@ -349,12 +465,16 @@ function File(fullPath, parent) {
     return status.readOnly;
   };
   var getIsFile = function() {
+    if (stat_cached === undefined && (type === 'f' || type === 'd'))
+      return type === 'f';
     var status = stat();
     if (status.isError)
       return false;
     return status.isFile;
   };
   var getIsDirectory = function() {
+    if (stat_cached === undefined && (type === 'f' || type === 'd'))
+      return type === 'd';
     var status = stat();
     if (status.isError)
       return false;
@@ -427,7 +547,11 @@ File.prototype.toURI = function() {
   return status.value;
 };
 
-File.prototype.listFiles = function(onsuccess, onerror, filter) {
+// With |onchunk|, an extension of the Tizen API, the files are passed to it
+// in arrays as the directory is read, and |onsuccess| gets an empty array
+// once done. |filter| may have |offset| and |limit| members besides those of
+// FileFilter, to list part of the files matching it.
+File.prototype.listFiles = function(onsuccess, onerror, filter, onchunk) {
   if (!(onsuccess instanceof Function))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
@@ -435,27 +559,50 @@ File.prototype.listFiles = function(onsuccess, onerror, filter) {
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (filter !== null && typeof(filter) !== 'object' && arguments.length > 2)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onchunk !== null && onchunk !== undefined &&
+      !(onchunk instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  postMessage({
+  var parent = this;
+  var toFiles = function(result) {
+    var file_list = [];
+    for (var i = 0; i < result.value.length; i++)
+      file_list.push(new File(result.value[i], parent, result.types.charAt(i)));
+    return file_list;
+  };
+
+  var reply_id = postMessage({
     cmd: 'FileListFiles',
     fullPath: this.fullPath,
-    filter: filter ? JSON.stringify(filter) : ''
+    filter: filter ? JSON.stringify(filter) : '',
+    offset: filter && is_integer(filter.offset) ? filter.offset : 0,
+    limit: filter && is_integer(filter.limit) ? filter.limit : 0,
+    chunkSize: onchunk ? 256 : 0
   }, function(result) {
+    delete _event_callbacks[reply_id];
     if (result.isError) {
       if (onerror)
         onerror(new tizen.WebAPIError(result.errorCode));
-    } else if (onsuccess) {
-      var file_list = [];
-
-      for (var i = 0; i < result.value.length; i++)
-        file_list.push(new File(result.value[i], getFileParent(result.value[i])));
-
-      onsuccess(file_list);
+    } else if (onchunk) {
+      if (result.value.length)
+        onchunk(toFiles(result));
+      onsuccess([]);
+    } else {
+      onsuccess(toFiles(result));
     }
-  }.bind(this));
+  });
+  if (onchunk) {
+    _event_callbacks[reply_id] = function(msg) {
+      onchunk(toFiles(msg));
+    };
+  }
 };
 
-File.prototype.openStream = function(mode, onsuccess, onerror, encoding) {
+// |options| is an extension of the Tizen API: writeBufferSize is the size of
+// the write-behind buffer of the stream in bytes, 0 by default, and with
+// durable the data is synced to the storage by flush() and close().
+File.prototype.openStream = function(mode, onsuccess, onerror, encoding,
+                                     options) {
   if (!(onsuccess instanceof Function))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
   if (onerror !== null && !(onerror instanceof Function) &&
@@ -467,12 +614,19 @@ File.prototype.openStream = function(mode, onsuccess, onerror, encoding) {
   encoding = encoding || 'UTF-8';
   if (!is_string(encoding) || !(encoding.toUpperCase() in encodings))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  options = options || {};
+  if (typeof(options) !== 'object' ||
+      (options.writeBufferSize !== undefined &&
+       !is_integer(options.writeBufferSize)))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   postMessage({
     cmd: 'FileOpenStream',
     fullPath: this.fullPath,
     mode: mode,
-    encoding: encoding
+    encoding: encoding,
+    writeBufferSize: options.writeBufferSize || 0,
+    durable: !!options.durable
   }, function(result) {
     if (result.isError) {
       if (onerror)
@@ -511,8 +665,48 @@ File.prototype.readAsText = function(onsuccess, onerror, encoding) {
   this.openStream('r', streamOpened, streamError, encoding);
 };
 
+// Copies run on a worker of the extension. |onprogress| is an extension of
+// the Tizen API: it is called every now and then with the number of files
+// and bytes copied so far, and the totals found so far. The returned object
+// can cancel the copy, which then fails with an ABORT_ERR.
+var postCopyMessage = function(cmd, originFilePath, destinationFilePath,
+    overwrite, onsuccess, onerror, onprogress) {
+  var reply_id = postMessage({
+    cmd: cmd,
+    originFilePath: originFilePath,
+    destinationFilePath: destinationFilePath,
+    overwrite: overwrite,
+    progress: onprogress instanceof Function
+  }, function(result) {
+    delete _event_callbacks[reply_id];
+    if (result.isError) {
+      if (onerror) {
+        onerror(new tizen.WebAPIException(result.errorCode));
+      }
+    } else if (onsuccess) {
+      onsuccess();
+    }
+  });
+  if (onprogress instanceof Function) {
+    _event_callbacks[reply_id] = function(msg) {
+      onprogress({
+        files: msg.files,
+        totalFiles: msg.totalFiles,
+        bytes: msg.bytes,
+        totalBytes: msg.totalBytes
+      });
+    };
+  }
+
+  return {
+    cancel: function() {
+      sendSyncMessage('FileCopyCancel', { copyId: reply_id });
+    }
+  };
+};
+
 File.prototype.copyTo = function(originFilePath, destinationFilePath,
-    overwrite, onsuccess, onerror) {
+    overwrite, onsuccess, onerror, onprogress) {
   if (!this.isDirectory)
     onerror(new tizen.WebAPIException(tizen.WebAPIException.IO_ERR));
   // originFilePath, destinationFilePath - full virtual file path
@@ -538,24 +732,12 @@ File.prototype.copyTo = function(originFilePath, destinationFilePath,
     return;
   }
 
-  postMessage({
-    cmd: 'FileCopyTo',
-    originFilePath: originFilePath,
-    destinationFilePath: destinationFilePath,
-    overwrite: overwrite
-  }, function(result) {
-    if (result.isError) {
-      if (onerror) {
-        onerror(new tizen.WebAPIException(result.errorCode));
-      }
-    } else if (onsuccess) {
-      onsuccess();
-    }
-  });
+  return postCopyMessage('FileCopyTo', originFilePath, destinationFilePath,
+                         overwrite, onsuccess, onerror, onprogress);
 };
 
 File.prototype.moveTo = function(originFilePath, destinationFilePath,
-    overwrite, onsuccess, onerror) {
+    overwrite, onsuccess, onerror, onprogress) {
   if (!this.isDirectory)
     onerror(new tizen.WebAPIException(tizen.WebAPIException.IO_ERR));
   // originFilePath, destinationFilePath - full virtual file path
@@ -581,20 +763,75 @@ File.prototype.moveTo = function(originFilePath, destinationFilePath,
     return;
   }
 
-  postMessage({
-    cmd: 'FileMoveTo',
-    originFilePath: originFilePath,
-    destinationFilePath: destinationFilePath,
-    overwrite: overwrite
-  }, function(result) {
-    if (result.isError) {
-      if (onerror) {
-        onerror(new tizen.WebAPIException(result.errorCode));
-      }
-    } else if (onsuccess) {
-      onsuccess();
-    }
-  });
+  return postCopyMessage('FileMoveTo', originFilePath, destinationFilePath,
+                         overwrite, onsuccess, onerror, onprogress);
+};
+
+// The archive formats are zip, tar and gzipped tar, named .zip, .tar and
+// .tar.gz or .tgz. Progress and cancellation work as for copyTo().
+File.prototype.createArchive = function(originFilePath, archiveFilePath,
+    overwrite, onsuccess, onerror, onprogress) {
+  if (onsuccess !== null && !(onsuccess instanceof Function) &&
+      arguments.length > 3)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 4)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onprogress !== undefined && onprogress !== null &&
+      !(onprogress instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var error = null;
+  if (!this.isDirectory)
+    error = tizen.WebAPIException.IO_ERR;
+  else if (!is_string(originFilePath) || !is_string(archiveFilePath) ||
+           originFilePath.indexOf('./') >= 0 ||
+           archiveFilePath.indexOf('./') >= 0 ||
+           originFilePath.indexOf(this.fullPath) < 0)
+    error = tizen.WebAPIException.NOT_FOUND_ERR;
+  else if (!/\.(zip|tar|tar\.gz|tgz)$/i.test(archiveFilePath))
+    error = tizen.WebAPIException.INVALID_VALUES_ERR;
+  if (error !== null) {
+    if (onerror)
+      onerror(new tizen.WebAPIException(error));
+    return;
+  }
+
+  return postCopyMessage('FileCreateArchive', originFilePath, archiveFilePath,
+                         overwrite, onsuccess, onerror, onprogress);
+};
+
+// Extracts into destinationPath, which is created in an existing directory
+// if needed. Entries leading outside of it fail the extraction.
+File.prototype.extractArchive = function(archiveFilePath, destinationPath,
+    overwrite, onsuccess, onerror, onprogress) {
+  if (onsuccess !== null && !(onsuccess instanceof Function) &&
+      arguments.length > 3)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && !(onerror instanceof Function) &&
+      arguments.length > 4)
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onprogress !== undefined && onprogress !== null &&
+      !(onprogress instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+
+  var error = null;
+  if (!this.isDirectory)
+    error = tizen.WebAPIException.IO_ERR;
+  else if (!is_string(archiveFilePath) || !is_string(destinationPath) ||
+           archiveFilePath.indexOf('./') >= 0 ||
+           destinationPath.indexOf('./') >= 0 ||
+           archiveFilePath.indexOf(this.fullPath) < 0)
+    error = tizen.WebAPIException.NOT_FOUND_ERR;
+  if (error !== null) {
+    if (onerror)
+      onerror(new tizen.WebAPIException(error));
+    return;
+  }
+
+  return postCopyMessage('FileExtractArchive', archiveFilePath,
+                         destinationPath, overwrite, onsuccess, onerror,
+                         onprogress);
 };
 
 File.prototype.createDirectory = function(relativeDirPath) {
@@ -704,6 +941,132 @@ File.prototype.deleteFile = function(filePath, onsuccess, onerror) {
   });
 };
 
+// An extension of the Tizen API: computes digests of the file without
+// reading it into JavaScript. |algorithms| is one of, or an array of,
+// 'SHA-256', 'SHA-1', 'CRC32' and 'XXH64'. |onsuccess| gets the digest in
+// hexadecimal, or an object of the digests by algorithm for an array, all
+// computed in a single pass. |range| optionally limits the data to
+// { offset: bytes, length: bytes }.
+File.prototype.computeHash = function(algorithms, onsuccess, onerror,
+                                      range) {
+  var single = is_string(algorithms);
+  var names = single ? [algorithms] : algorithms;
+  if (!(names instanceof Array) || !names.length ||
+      !(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && onerror !== undefined &&
+      !(onerror instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  for (var i = 0; i < names.length; i++) {
+    if (!is_string(names[i]))
+      throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  }
+  range = range || {};
+  if ((range.offset !== undefined && !is_integer(range.offset)) ||
+      (range.length !== undefined && !is_integer(range.length)))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (this.isDirectory) {
+    if (onerror)
+      onerror(new tizen.WebAPIError(tizen.WebAPIException.IO_ERR));
+    return;
+  }
+
+  postMessage({
+    cmd: 'FileHash',
+    fullPath: this.fullPath,
+    algorithms: names.map(function(name) { return name.toUpperCase(); }),
+    offset: range.offset,
+    length: range.length
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+    } else if (single) {
+      onsuccess(result.value[algorithms.toUpperCase()]);
+    } else {
+      onsuccess(result.value);
+    }
+  });
+};
+
+// Batches are an extension of the Tizen API, for the apps which stat,
+// delete or create many files in a row: a single request does them all on
+// the workers of the extension. |onsuccess| gets an array with the result
+// for each path, or the WebAPIError of that path. |onerror| is only called
+// if the request itself is invalid. Paths are relative to |fullPath|, full
+// paths if it is null.
+var postBatchMessage = function(op, fullPath, paths, onsuccess, onerror,
+                                toResult) {
+  if (!(paths instanceof Array) || !(onsuccess instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  if (onerror !== null && onerror !== undefined &&
+      !(onerror instanceof Function))
+    throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+  for (var i = 0; i < paths.length; i++) {
+    if (!is_string(paths[i]))
+      throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
+    if (fullPath !== null && paths[i].indexOf('./') >= 0)
+      throw new tizen.WebAPIException(tizen.WebAPIException.INVALID_VALUES_ERR);
+  }
+
+  postMessage({
+    cmd: 'FileBatch',
+    op: op,
+    fullPath: fullPath,
+    paths: paths
+  }, function(result) {
+    if (result.isError) {
+      if (onerror)
+        onerror(new tizen.WebAPIError(result.errorCode));
+      return;
+    }
+    var results = [];
+    for (var i = 0; i < result.value.length; i++) {
+      var value = result.value[i];
+      if (value !== null && value.errorCode !== undefined)
+        results.push(new tizen.WebAPIError(value.errorCode));
+      else
+        results.push(toResult(value, i));
+    }
+    onsuccess(results);
+  });
+};
+
+// |filePaths| are full virtual paths, the results are Files.
+File.prototype.statFiles = function(filePaths, onsuccess, onerror) {
+  postBatchMessage('stat', null, filePaths, onsuccess, onerror,
+      function(status, i) {
+        return new File(filePaths[i], getFileParent(filePaths[i]),
+                        undefined, status);
+      });
+};
+
+// |filePaths| are full virtual paths, the results are null.
+File.prototype.deleteFiles = function(filePaths, onsuccess, onerror) {
+  postBatchMessage('delete', null, filePaths, onsuccess, onerror,
+      function() {
+        return null;
+      });
+};
+
+// |relativeFilePaths| are relative to this directory, the results are
+// Files.
+File.prototype.createFiles = function(relativeFilePaths, onsuccess,
+                                      onerror) {
+  postBatchMessage('createFile', this.fullPath, relativeFilePaths, onsuccess,
+      onerror, function(fullPath) {
+        return new File(fullPath, getFileParent(fullPath));
+      });
+};
+
+File.prototype.createDirectories = function(relativeDirPaths, onsuccess,
+                                            onerror) {
+  postBatchMessage('createDirectory', this.fullPath, relativeDirPaths,
+      onsuccess, onerror, function(fullPath) {
+        return new File(fullPath, getFileParent(fullPath));
+      });
+};
+
 (function() {
   exports = new FileSystemManager();
 })();
@@ -11,7 +11,8 @@ common::Extension* CreateExtension() {
 
 extern const char kSource_filesystem_api[];
 
-FilesystemExtension::FilesystemExtension() {
+FilesystemExtension::FilesystemExtension()
+    : vfs_(VirtualFS::Get()) {
   SetExtensionName("tizen.filesystem");
   SetJavaScriptAPI(kSource_filesystem_api);
 }
@@ -19,5 +20,5 @@ FilesystemExtension::FilesystemExtension() {
 FilesystemExtension::~FilesystemExtension() {}
 
 common::Instance* FilesystemExtension::CreateInstance() {
-  return new FilesystemInstance();
+  return new FilesystemInstance(&metadata_cache_, vfs_);
 }
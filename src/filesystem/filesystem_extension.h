@@ -5,7 +5,11 @@
 #ifndef FILESYSTEM_FILESYSTEM_EXTENSION_H_
 #define FILESYSTEM_FILESYSTEM_EXTENSION_H_
 
+#include <memory>
+
 #include "common/extension.h"
+#include "common/virtual_fs.h"
+#include "filesystem/metadata_cache.h"
 
 class FilesystemExtension : public common::Extension {
  public:
@@ -15,6 +19,10 @@ class FilesystemExtension : public common::Extension {
  private:
   // common::Extension implementation.
   virtual common::Instance* CreateInstance();
+
+  MetadataCache metadata_cache_;
+  // Kept for the instances to come, which would set it up again otherwise.
+  std::shared_ptr<VirtualFS> vfs_;
 };
 
 #endif  // FILESYSTEM_FILESYSTEM_EXTENSION_H_
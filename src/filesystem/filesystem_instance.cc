@@ -13,17 +13,24 @@
 #include <tzplatform_config.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <utility>
 
+#include "common/base64.h"
+#include "common/json_writer.h"
+
 namespace {
 
 const char kPlatformEncoding[] = "UTF-8";
 const size_t kBufferSize = 1024 * 4;
 
-unsigned int lastStreamId = 0;
-
 bool IsWritable(const struct stat& st) {
   if (st.st_mode & S_IWOTH)
     return true;
@@ -34,6 +41,69 @@ bool IsWritable(const struct stat& st) {
   return false;
 }
 
+// The error of a failed unlink().
+WebApiAPIErrors GetDeleteFileError(int error) {
+  switch (error) {
+  case EACCES:
+  case EBUSY:
+  case EIO:
+  case EPERM:
+    return IO_ERR;
+  case ENOENT:
+    return NOT_FOUND_ERR;
+  case EISDIR:
+    return INVALID_VALUES_ERR;
+  default:
+    return UNKNOWN_ERR;
+  }
+}
+
+// Whether the member |key| of |msg| is absent, or a count of things: a
+// finite, non-negative number.
+bool IsValidCount(const picojson::value& msg, const char* key) {
+  if (!msg.contains(key))
+    return true;
+  const picojson::value& value = msg.get(key);
+  return value.is<double>() && std::isfinite(value.get<double>()) &&
+      value.get<double>() >= 0;
+}
+
+// 2^63, the first count too large for an int64_t.
+const double kInt64Limit = 9223372036854775808.0;
+
+// Reads the count |key| of |msg| into |count|, if present. False if it is not
+// a valid count, or doesn't fit in an int64_t.
+bool GetInt64Count(const picojson::value& msg, const char* key,
+    int64_t* count) {
+  if (!IsValidCount(msg, key))
+    return false;
+  if (msg.contains(key)) {
+    double value = msg.get(key).get<double>();
+    if (value >= kInt64Limit)
+      return false;
+    *count = value;
+  }
+  return true;
+}
+
+bool CreateFile(const std::string& real_path) {
+  int fd = open(real_path.c_str(), O_CREAT | O_WRONLY | O_EXCL | O_CLOEXEC,
+      vfs_const::kDefaultFileMode);
+  if (fd < 0)
+    return false;
+  close(fd);
+  return true;
+}
+
+// The paths of a FileBatch request and the results of its slices, which
+// run on several workers. The last slice done sends the reply.
+struct Batch {
+  std::vector<std::string> full_paths;
+  std::vector<std::string> real_paths;
+  std::vector<std::string> results;
+  std::atomic<size_t> pending;
+};
+
 picojson::object StorageToJSON(Storage storage,
     const std::string& label) {
   picojson::object storage_object;
@@ -45,53 +115,69 @@ picojson::object StorageToJSON(Storage storage,
 
 }  // namespace
 
-FilesystemInstance::FilesystemInstance() {
+FilesystemInstance::FilesystemInstance(MetadataCache* metadata_cache,
+    const std::shared_ptr<VirtualFS>& vfs)
+    : metadata_cache_(metadata_cache),
+      vfs_(vfs) {
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+
+#define REGISTER_ASYNC(c, x) \
+  RegisterHandler(c, std::bind(&FilesystemInstance::x, this, _1));
+#define REGISTER_SYNC(c, x) \
+  RegisterSyncHandler(c, std::bind(&FilesystemInstance::x, this, _1, _2));
+#define REGISTER_ARENA_SYNC(c, x) \
+  RegisterArenaSyncHandler(c, std::bind(&FilesystemInstance::x, this, _1, _2));
+#define REGISTER_ARENA_ASYNC(c, x) \
+  RegisterArenaHandler(c, std::bind(&FilesystemInstance::x, this, _1));
+
+  REGISTER_ASYNC("FileSystemManagerResolve", HandleFileSystemManagerResolve);
+  REGISTER_ASYNC("FileSystemManagerGetStorage",
+                 HandleFileSystemManagerGetStorage);
+  REGISTER_ASYNC("FileSystemManagerListStorages",
+                 HandleFileSystemManagerListStorages);
+  REGISTER_ASYNC("FileOpenStream", HandleFileOpenStream);
+  REGISTER_ASYNC("FileDeleteDirectory", HandleFileDeleteDirectory);
+  REGISTER_ASYNC("FileDeleteFile", HandleFileDeleteFile);
+  REGISTER_ASYNC("FileBatch", HandleFileBatch);
+  REGISTER_ASYNC("FileHash", HandleFileHash);
+  REGISTER_ASYNC("FileListFiles", HandleFileListFiles);
+  REGISTER_ASYNC("FileCopyTo", HandleFileCopyTo);
+  REGISTER_ASYNC("FileMoveTo", HandleFileMoveTo);
+  REGISTER_ASYNC("FileCreateArchive", HandleFileCreateArchive);
+  REGISTER_ASYNC("FileExtractArchive", HandleFileExtractArchive);
+
+  REGISTER_SYNC("FileSystemManagerGetMaxPathLength",
+                HandleFileSystemManagerGetMaxPathLength);
+  REGISTER_SYNC("FileCreateDirectory", HandleFileCreateDirectory);
+  REGISTER_SYNC("FileCreateFile", HandleFileCreateFile);
+  REGISTER_SYNC("FileGetURI", HandleFileGetURI);
+  REGISTER_SYNC("FileResolve", HandleFileResolve);
+  REGISTER_SYNC("FileCopyCancel", HandleFileCopyCancel);
+
+  // Stream operations and stat are called in tight loops, skip building a
+  // picojson tree for them.
+  REGISTER_ARENA_SYNC("FileStreamClose", HandleFileStreamClose);
+  REGISTER_ARENA_SYNC("FileStreamRead", HandleFileStreamRead);
+  REGISTER_ARENA_SYNC("FileStreamWrite", HandleFileStreamWrite);
+  REGISTER_ARENA_SYNC("FileStreamFlush", HandleFileStreamFlush);
+  REGISTER_ARENA_ASYNC("FileStreamWriteAsync", HandleFileStreamWriteAsync);
+  REGISTER_ARENA_SYNC("FileStat", HandleFileStat);
+  REGISTER_ARENA_SYNC("FileStreamStat", HandleFileStreamStat);
+  REGISTER_ARENA_SYNC("FileStreamSetPosition", HandleFileStreamSetPosition);
+
+#undef REGISTER_ASYNC
+#undef REGISTER_SYNC
+#undef REGISTER_ARENA_SYNC
+#undef REGISTER_ARENA_ASYNC
 }
 
 void FilesystemInstance::Initialize() {
-  vfs_.SetOnStorageChangedCb(OnStorageStateChanged, this);
+  vfs_->AddStorageChangedCb(OnStorageStateChanged, this);
 }
 
 FilesystemInstance::~FilesystemInstance() {
-  FStreamMap::iterator it;
-
-  for (it = fstream_map_.begin(); it != fstream_map_.end(); it++) {
-    std::fstream* fs = std::get<1>(it->second);
-    fs->close();
-    delete(fs);
-  }
-}
-
-void FilesystemInstance::HandleMessage(const char* message) {
-  picojson::value v;
-  std::string err;
-  picojson::parse(v, message, message + strlen(message), &err);
-  if (!err.empty()) {
-    std::cout << "Ignoring message.\n";
-    return;
-  }
-
-  std::string cmd = v.get("cmd").to_str();
-  if (cmd == "FileSystemManagerResolve")
-    HandleFileSystemManagerResolve(v);
-  else if (cmd == "FileSystemManagerGetStorage")
-    HandleFileSystemManagerGetStorage(v);
-  else if (cmd == "FileSystemManagerListStorages")
-    HandleFileSystemManagerListStorages(v);
-  else if (cmd == "FileOpenStream")
-    HandleFileOpenStream(v);
-  else if (cmd == "FileDeleteDirectory")
-    HandleFileDeleteDirectory(v);
-  else if (cmd == "FileDeleteFile")
-    HandleFileDeleteFile(v);
-  else if (cmd == "FileListFiles")
-    HandleFileListFiles(v);
-  else if (cmd == "FileCopyTo")
-    HandleFileCopyTo(v);
-  else if (cmd == "FileMoveTo")
-    HandleFileMoveTo(v);
-  else
-    std::cout << "Ignoring unknown command: " << cmd;
+  vfs_->RemoveStorageChangedCb(OnStorageStateChanged, this);
 }
 
 void FilesystemInstance::PostAsyncErrorReply(const picojson::value& msg,
@@ -156,11 +242,12 @@ void FilesystemInstance::HandleFileSystemManagerResolve(
     check_if_inside_default = false;
 
   std::string real_path;
-  if (location.find("file://") == 0) {
+  bool is_uri = location.find("file://") == 0;
+  if (is_uri) {
     real_path = location.substr(sizeof("file://") - 1);
     check_if_inside_default = false;
   } else {
-    real_path = vfs_.GetRealPath(location);
+    real_path = vfs_->GetRealPath(location);
   }
 
   if (real_path.empty()) {
@@ -199,8 +286,16 @@ void FilesystemInstance::HandleFileSystemManagerResolve(
     PostAsyncErrorReply(msg, IO_ERR);
     return;
   }
+  // The other operations take virtual paths, which the files of the roots
+  // have.
+  std::string full_path = location;
+  if (is_uri) {
+    std::string virtual_path = vfs_->GetVirtualPath(real_path_ack);
+    if (!virtual_path.empty())
+      full_path = virtual_path;
+  }
   picojson::value::object o;
-  o["fullPath"] = picojson::value(location);
+  o["fullPath"] = picojson::value(full_path);
   PostAsyncSuccessReply(msg, o);
 }
 
@@ -208,7 +303,7 @@ void FilesystemInstance::HandleFileSystemManagerGetStorage(
       const picojson::value& msg) {
   Storage storage;
   std::string label = msg.get("label").to_str();
-  if (!vfs_.GetStorageByLabel(label, storage)) {
+  if (!vfs_->GetStorageByLabel(label, storage)) {
     PostAsyncErrorReply(msg, NOT_FOUND_ERR);
     return;
   }
@@ -220,8 +315,9 @@ void FilesystemInstance::HandleFileSystemManagerGetStorage(
 void FilesystemInstance::HandleFileSystemManagerListStorages(
       const picojson::value& msg) {
   picojson::array storage_objects;
-  Storages::const_iterator it = vfs_.begin();
-  while (it != vfs_.end()) {
+  Storages storages = vfs_->GetStorages();
+  Storages::const_iterator it = storages.begin();
+  while (it != storages.end()) {
     picojson::object storage_object = StorageToJSON(it->second, it->first);
     storage_objects.push_back(picojson::value(storage_object));
     ++it;
@@ -271,7 +367,7 @@ void FilesystemInstance::HandleFileOpenStream(const picojson::value& msg) {
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(msg.get("fullPath").to_str());
+  std::string real_path = vfs_->GetRealPath(msg.get("fullPath").to_str());
   char* real_path_cstr = realpath(real_path.c_str(), NULL);
   if (!real_path_cstr) {
     free(real_path_cstr);
@@ -291,20 +387,38 @@ void FilesystemInstance::HandleFileOpenStream(const picojson::value& msg) {
     PostAsyncErrorReply(msg, IO_ERR);
     return;
   }
-  std::fstream* fs = new std::fstream(real_path_cstr, open_mode);
-  if (!(*fs) || !fs->is_open()) {
+  FileStream* fs = FileStream::Open(real_path_cstr, open_mode);
+  if (!fs) {
     free(real_path_cstr);
-    delete fs;
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
   free(real_path_cstr);
 
-  fstream_map_[lastStreamId] = FStream(open_mode, fs, encoding);
+  // Write-behind and durability are options of the stream.
+  bool valid = IsValidCount(msg, "writeBufferSize");
+  if (valid && msg.contains("writeBufferSize")) {
+    // Checked while a double, which may not fit in a size_t.
+    double size = msg.get("writeBufferSize").get<double>();
+    valid = size <= FileStream::kMaxWriteBufferSize &&
+        fs->SetWriteBufferSize(size);
+  }
+  if (!valid) {
+    delete fs;
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  unsigned int stream_id;
+  if (!streams_.Add(fs, open_mode, encoding, &stream_id)) {
+    delete fs;
+    PostAsyncErrorReply(msg, IO_ERR);
+    return;
+  }
+  streams_.Get(stream_id)->durable = msg.get("durable").evaluate_as_boolean();
 
   picojson::value::object o;
-  o["streamID"] = picojson::value(static_cast<double>(lastStreamId));
-  lastStreamId++;
+  o["streamID"] = picojson::value(static_cast<double>(stream_id));
   PostAsyncSuccessReply(msg, o);
 }
 
@@ -351,23 +465,25 @@ void FilesystemInstance::HandleFileDeleteDirectory(const picojson::value& msg) {
   }
 
   bool recursive = msg.get("recursive").evaluate_as_boolean();
-  std::string real_path = vfs_.GetRealPath(msg.get("directoryPath").to_str());
+  std::string real_path = vfs_->GetRealPath(msg.get("directoryPath").to_str());
   if (real_path.empty()) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  if (recursive) {
-    if (!RecursiveDeleteDirectory(real_path)) {
-      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+  PostTask([=]() {
+    if (recursive) {
+      if (!RecursiveDeleteDirectory(real_path)) {
+        PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+        return;
+      }
+    } else if (rmdir(real_path.c_str()) < 0) {
+      PostAsyncErrorReply(msg, IO_ERR);
       return;
     }
-  } else if (rmdir(real_path.c_str()) < 0) {
-    PostAsyncErrorReply(msg, IO_ERR);
-    return;
-  }
 
-  PostAsyncSuccessReply(msg);
+    PostAsyncSuccessReply(msg);
+  });
 }
 
 void FilesystemInstance::HandleFileDeleteFile(const picojson::value& msg) {
@@ -376,31 +492,224 @@ void FilesystemInstance::HandleFileDeleteFile(const picojson::value& msg) {
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(msg.get("filePath").to_str());
+  std::string real_path = vfs_->GetRealPath(msg.get("filePath").to_str());
   if (real_path.empty()) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  if (unlink(real_path.c_str()) < 0) {
-    switch (errno) {
-    case EACCES:
-    case EBUSY:
-    case EIO:
-    case EPERM:
-      PostAsyncErrorReply(msg, IO_ERR);
-      break;
-    case ENOENT:
-      PostAsyncErrorReply(msg, NOT_FOUND_ERR);
-      break;
-    case EISDIR:
+  if (unlink(real_path.c_str()) < 0)
+    PostAsyncErrorReply(msg, GetDeleteFileError(errno));
+  else
+    PostAsyncSuccessReply(msg);
+}
+
+void FilesystemInstance::HandleFileBatch(const picojson::value& msg) {
+  // Small slices spread big batches over the workers.
+  const size_t kSliceSize = 64;
+
+  std::string op = msg.get("op").to_str();
+  BatchOperation operation;
+  if (op == "stat") {
+    operation = BATCH_STAT;
+  } else if (op == "delete") {
+    operation = BATCH_DELETE;
+  } else if (op == "createFile") {
+    operation = BATCH_CREATE_FILE;
+  } else if (op == "createDirectory") {
+    operation = BATCH_CREATE_DIRECTORY;
+  } else {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+  // Files and directories are created relative to the directory of the
+  // request, the other operations take full paths.
+  bool relative = operation == BATCH_CREATE_FILE ||
+      operation == BATCH_CREATE_DIRECTORY;
+  if (!msg.get("paths").is<picojson::array>() ||
+      (relative && !msg.contains("fullPath"))) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  const picojson::array& paths = msg.get("paths").get<picojson::array>();
+  std::shared_ptr<Batch> batch(new Batch);
+  batch->full_paths.reserve(paths.size());
+  batch->real_paths.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!paths[i].is<std::string>()) {
       PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
-      break;
-    default:
-      PostAsyncErrorReply(msg, UNKNOWN_ERR);
+      return;
+    }
+    std::string full_path = paths[i].get<std::string>();
+    if (relative)
+      full_path = VirtualFS::JoinPath(msg.get("fullPath").to_str(), full_path);
+    // Invalid paths fail on their own, see RunBatchOperation().
+    batch->full_paths.push_back(full_path);
+    batch->real_paths.push_back(
+        full_path.empty() ? full_path : vfs_->GetRealPath(full_path));
+  }
+
+  size_t slices = (paths.size() + kSliceSize - 1) / kSliceSize;
+  if (!slices) {
+    picojson::value value = picojson::value(picojson::array());
+    PostAsyncSuccessReply(msg, value);
+    return;
+  }
+  batch->results.resize(slices);
+  batch->pending = slices;
+  // Not |msg|, which would copy the paths into every task.
+  double reply_id = msg.get("reply_id").get<double>();
+
+  for (size_t slice = 0; slice < slices; ++slice) {
+    PostTask([=]() {
+      size_t end = std::min((slice + 1) * kSliceSize,
+                            batch->full_paths.size());
+      common::JsonWriter writer;
+      for (size_t i = slice * kSliceSize; i < end; ++i) {
+        if (TasksCancelled())
+          return;
+        RunBatchOperation(operation, batch->full_paths[i],
+                          batch->real_paths[i], &writer);
+      }
+      batch->results[slice] = writer.str();
+      if (--batch->pending)
+        return;
+
+      writer.Reset();
+      writer.BeginObject();
+      writer.Key("isError");
+      writer.Bool(false);
+      writer.Key("reply_id");
+      writer.Number(reply_id);
+      writer.Key("value");
+      writer.BeginArray();
+      for (size_t i = 0; i < slices; ++i)
+        writer.RawValue(batch->results[i]);
+      writer.EndArray();
+      writer.EndObject();
+      PostMessage(writer.c_str());
+    });
+  }
+}
+
+void FilesystemInstance::HandleFileHash(const picojson::value& msg) {
+  if (!msg.contains("fullPath") ||
+      !msg.get("algorithms").is<picojson::array>()) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  std::vector<std::string> algorithms;
+  const picojson::array& names = msg.get("algorithms").get<picojson::array>();
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::unique_ptr<Digest> digest(Digest::Create(names[i].to_str()));
+    if (!digest) {
+      PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+      return;
+    }
+    algorithms.push_back(names[i].to_str());
+  }
+
+  // The whole file by default, or with a length of -1.
+  int64_t offset = 0;
+  int64_t length = -1;
+  bool to_end = msg.get("length").is<double>() &&
+      msg.get("length").get<double>() == -1;
+  std::string real_path = vfs_->GetRealPath(msg.get("fullPath").to_str());
+  if (real_path.empty() || !GetInt64Count(msg, "offset", &offset) ||
+      (!to_end && !GetInt64Count(msg, "length", &length))) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  PostTask([=]() {
+    HashFile(msg, real_path, algorithms, offset, length);
+  });
+}
+
+void FilesystemInstance::HashFile(const picojson::value& msg,
+    const std::string& real_path, const std::vector<std::string>& algorithms,
+    int64_t offset, int64_t length) {
+  // Every digest goes over a chunk while it is in the cache.
+  const size_t kChunkSize = 1024 * 1024;
+
+  std::unique_ptr<FileStream> file(
+      FileStream::Open(real_path, std::ios_base::in));
+  if (!file) {
+    PostAsyncErrorReply(msg, errno == ENOENT ? NOT_FOUND_ERR : IO_ERR);
+    return;
+  }
+  if (!file->SetPosition(offset)) {
+    PostAsyncErrorReply(msg, IO_ERR);
+    return;
+  }
+
+  std::vector<std::unique_ptr<Digest>> digests;
+  for (size_t i = 0; i < algorithms.size(); ++i)
+    digests.push_back(std::unique_ptr<Digest>(Digest::Create(algorithms[i])));
+
+  int64_t left = length;
+  while (left) {
+    if (TasksCancelled())
+      return;
+    size_t count = left < 0 ? kChunkSize :
+        std::min<int64_t>(left, kChunkSize);
+    const char* data;
+    size_t size;
+    if (!file->Read(count, &data, &size)) {
+      PostAsyncErrorReply(msg, IO_ERR);
+      return;
     }
+    for (size_t i = 0; i < digests.size(); ++i)
+      digests[i]->Update(data, size);
+    if (size < count)
+      break;
+    if (left > 0)
+      left -= size;
+  }
+
+  picojson::object values;
+  for (size_t i = 0; i < digests.size(); ++i)
+    values[algorithms[i]] = picojson::value(digests[i]->Finish());
+  picojson::value value(values);
+  PostAsyncSuccessReply(msg, value);
+}
+
+void FilesystemInstance::RunBatchOperation(BatchOperation operation,
+    const std::string& full_path, const std::string& real_path,
+    common::JsonWriter* writer) {
+  WebApiAPIErrors error = NO_ERROR;
+  struct stat st;
+  if (real_path.empty()) {
+    error = INVALID_VALUES_ERR;
+  } else if (operation == BATCH_STAT) {
+    if (metadata_cache_->Stat(real_path, &st))
+      WriteStat(real_path, st, writer);
+    else
+      error = errno == ENOENT || errno == ENOTDIR ? NOT_FOUND_ERR : IO_ERR;
+  } else if (operation == BATCH_DELETE) {
+    if (!unlink(real_path.c_str()))
+      writer->Null();
+    else
+      error = GetDeleteFileError(errno);
+  } else if (operation == BATCH_CREATE_FILE) {
+    if (CreateFile(real_path))
+      writer->String(full_path);
+    else
+      error = IO_ERR;
   } else {
-    PostAsyncSuccessReply(msg);
+    if (VirtualFS::MakePath(real_path, vfs_const::kDefaultFileMode))
+      writer->String(full_path);
+    else
+      error = IO_ERR;
+  }
+
+  if (error != NO_ERROR) {
+    writer->BeginObject();
+    writer->Key("errorCode");
+    writer->Number(error);
+    writer->EndObject();
   }
 }
 
@@ -410,35 +719,159 @@ void FilesystemInstance::HandleFileListFiles(const picojson::value& msg) {
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(msg.get("fullPath").to_str());
+  std::string real_path = vfs_->GetRealPath(msg.get("fullPath").to_str());
   if (real_path.empty()) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  DIR* directory = opendir(real_path.c_str());
-  if (!directory) {
-    PostAsyncErrorReply(msg, IO_ERR);
+  ListFilter filter;
+  if (msg.contains("filter") && !filter.Parse(msg.get("filter").to_str())) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  picojson::value::array a;
+  if (!IsValidCount(msg, "offset") || !IsValidCount(msg, "limit") ||
+      !IsValidCount(msg, "chunkSize")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
 
-  struct dirent entry, *buffer;
-  while (!readdir_r(directory, &entry, &buffer)) {
-    if (!buffer)
+  PostTask([=]() {
+    ListFiles(msg, real_path, filter);
+  });
+}
+
+void FilesystemInstance::PostListFilesReply(const picojson::value& msg,
+    const char* cmd, std::vector<std::string>* paths, std::string* types) {
+  common::JsonWriter writer;
+  writer.BeginObject();
+  if (cmd) {
+    writer.Key("cmd");
+    writer.String(cmd);
+  } else {
+    writer.Key("isError");
+    writer.Bool(false);
+  }
+  writer.Key("reply_id");
+  writer.Number(msg.get("reply_id").get<double>());
+  writer.Key("value");
+  writer.BeginArray();
+  for (size_t i = 0; i < paths->size(); ++i)
+    writer.String((*paths)[i]);
+  writer.EndArray();
+  writer.Key("types");
+  writer.String(*types);
+  writer.EndObject();
+  PostMessage(writer.c_str());
+
+  paths->clear();
+  types->clear();
+}
+
+void FilesystemInstance::ListFiles(const picojson::value& msg,
+    const std::string& real_path, const ListFilter& filter) {
+  // The first chunk is small so that something shows up right away, and
+  // entries found slowly because of the filter are not held back either.
+  const size_t kFirstChunkSize = 32;
+  const std::chrono::milliseconds kChunkInterval(50);
+
+  // Listings read in full are cached, until the directory changes.
+  std::shared_ptr<const MetadataCache::Listing> cached_listing =
+      metadata_cache_->GetListing(real_path);
+  size_t cached_index = 0;
+  DirectoryReader reader;
+  uint64_t cache_token = 0;
+  std::shared_ptr<MetadataCache::Listing> listing;
+  if (!cached_listing) {
+    cache_token = metadata_cache_->PrepareListing(real_path);
+    if (!reader.Open(real_path)) {
+      PostAsyncErrorReply(msg, IO_ERR);
+      return;
+    }
+    if (cache_token)
+      listing.reset(new MetadataCache::Listing);
+  }
+
+  // Checked by HandleFileListFiles().
+  double offset = msg.contains("offset") ? msg.get("offset").get<double>() : 0;
+  double limit = msg.contains("limit") ? msg.get("limit").get<double>() : 0;
+  // Without a chunk size, everything is sent with the reply.
+  size_t chunk_size = msg.contains("chunkSize") ?
+      msg.get("chunkSize").get<double>() : 0;
+  size_t next_chunk_size = std::min(chunk_size, kFirstChunkSize);
+  std::chrono::steady_clock::time_point chunk_time =
+      std::chrono::steady_clock::now();
+
+  const std::string& full_path = msg.get("fullPath").to_str();
+  std::vector<std::string> paths;
+  // A character per entry: 'f'ile, 'd'irectory, 'o'ther or '?' if unknown,
+  // so that File objects don't need a stat() to tell.
+  std::string types;
+
+  double skipped = 0;
+  double listed = 0;
+  DirectoryReader::Entry entry;
+  for (;;) {
+    if (limit && listed >= limit) {
+      // Not read in full.
+      listing.reset();
       break;
-    if (!strcmp(entry.d_name, ".") || !strcmp(entry.d_name, ".."))
+    }
+    if (cached_listing) {
+      if (cached_index == cached_listing->size())
+        break;
+      const MetadataCache::ListingEntry& cached_entry =
+          (*cached_listing)[cached_index++];
+      entry.name = cached_entry.name.c_str();
+      entry.type = cached_entry.type;
+    } else {
+      if (!reader.Next(&entry))
+        break;
+      if (listing) {
+        MetadataCache::ListingEntry listing_entry;
+        listing_entry.name = entry.name;
+        listing_entry.type = entry.type;
+        listing->push_back(listing_entry);
+      }
+    }
+
+    if (TasksCancelled())
+      return;
+    if (!filter.MatchName(entry.name))
+      continue;
+    if (filter.needs_stat()) {
+      struct stat st;
+      bool found = cached_listing ?
+          metadata_cache_->Stat(real_path + "/" + entry.name, &st) :
+          reader.Stat(&entry, &st);
+      if (!found || !filter.MatchStat(st))
+        continue;
+    }
+    if (skipped < offset) {
+      ++skipped;
       continue;
+    }
 
-    a.push_back(picojson::value(VirtualFS::JoinPath(
-        msg.get("fullPath").to_str(), entry.d_name)));
-  }
+    paths.push_back(VirtualFS::JoinPath(full_path, entry.name));
+    types.push_back("?fdo"[entry.type]);
+    ++listed;
 
-  closedir(directory);
+    if (chunk_size && (paths.size() >= next_chunk_size ||
+        std::chrono::steady_clock::now() - chunk_time >= kChunkInterval)) {
+      PostListFilesReply(msg, "listFilesChunk", &paths, &types);
+      next_chunk_size = chunk_size;
+      chunk_time = std::chrono::steady_clock::now();
+    }
+  }
+  if (reader.error()) {
+    PostAsyncErrorReply(msg, IO_ERR);
+    return;
+  }
+  if (listing)
+    metadata_cache_->PutListing(real_path, cache_token, listing);
 
-  picojson::value v(a);
-  PostAsyncSuccessReply(msg, v);
+  PostListFilesReply(msg, NULL, &paths, &types);
 }
 
 std::string FilesystemInstance::ResolveImplicitDestination(
@@ -512,8 +945,9 @@ bool FilesystemInstance::CopyAndRenameSanityChecks(const picojson::value& msg,
     return false;
   }
 
-  // don't copy or move into itself
-  if (to.length() >= from.length() && to.compare(0, from.length(), from) == 0) {
+  // don't copy or move into itself, "dir" into "dir2" is fine though
+  if (to.length() >= from.length() && to.compare(0, from.length(), from) == 0 &&
+      (to.length() == from.length() || to[from.length()] == '/')) {
     PostAsyncErrorReply(msg, IO_ERR);
     std::cerr << "won't copy/move into itself\n";
     return false;
@@ -522,132 +956,63 @@ bool FilesystemInstance::CopyAndRenameSanityChecks(const picojson::value& msg,
   return true;
 }
 
-namespace {
-
-class PosixFile {
- private:
-  int fd_;
-  int mode_;
-  std::string path_;
-  bool unlink_when_done_;
- public:
-  PosixFile(const std::string& path, int mode)
-      : fd_(open(path.c_str(), mode, vfs_const::kDefaultFileMode))
-      , mode_(mode)
-      , path_(path)
-      , unlink_when_done_(mode & O_CREAT) {}
-  ~PosixFile();
-
-  bool is_valid() { return fd_ >= 0; }
-
-  void UnlinkWhenDone(bool setting) { unlink_when_done_ = setting; }
-
-  ssize_t Read(char* buffer, size_t count);
-  ssize_t Write(char* buffer, size_t count);
-};
-
-PosixFile::~PosixFile() {
-  if (fd_ < 0)
-    return;
-
-  close(fd_);
-  if (unlink_when_done_)
-    unlink(path_.c_str());
+CopyEngine::ProgressCallback FilesystemInstance::GetCopyProgressCallback(
+    const picojson::value& msg) {
+  if (!msg.get("progress").evaluate_as_boolean())
+    return CopyEngine::ProgressCallback();
+  double reply_id = msg.get("reply_id").get<double>();
+  return [this, reply_id](const CopyEngine::Progress& done) {
+    picojson::value::object o;
+    o["cmd"] = picojson::value("copyProgress");
+    o["reply_id"] = picojson::value(reply_id);
+    o["files"] = picojson::value(static_cast<double>(done.files));
+    o["totalFiles"] =
+        picojson::value(static_cast<double>(done.total_files));
+    o["bytes"] = picojson::value(static_cast<double>(done.bytes));
+    o["totalBytes"] =
+        picojson::value(static_cast<double>(done.total_bytes));
+    picojson::value v(o);
+    PostMessage(v.serialize().c_str());
+  };
 }
 
-ssize_t PosixFile::Read(char* buffer, size_t count) {
-  if (fd_ < 0)
-    return -1;
-
-  while (true) {
-    ssize_t read_bytes = read(fd_, buffer, count);
-    if (read_bytes < 0) {
-      if (errno == EINTR)
-        continue;
-      return -1;
-    }
-    return read_bytes;
-  }
+void FilesystemInstance::AddCopy(const picojson::value& msg,
+    const std::function<void()>& cancel) {
+  // Cancelled with the reply ID of the request, see HandleFileCopyCancel.
+  std::lock_guard<std::mutex> lock(copies_mutex_);
+  copies_[msg.get("reply_id").get<double>()] = cancel;
 }
 
-ssize_t PosixFile::Write(char* buffer, size_t count) {
-  if (fd_ < 0)
-    return -1;
-
-  while (true) {
-    ssize_t written_bytes = write(fd_, buffer, count);
-    if (written_bytes < 0) {
-      if (errno == EINTR)
-        continue;
-      return -1;
-    }
-    return written_bytes;
-  }
+void FilesystemInstance::RemoveCopy(const picojson::value& msg) {
+  std::lock_guard<std::mutex> lock(copies_mutex_);
+  copies_.erase(msg.get("reply_id").get<double>());
 }
 
-bool CopyElement(const std::string &from, const std::string &to) {
-  struct stat from_st;
-  // element is a file
-  if (stat(from.c_str(), &from_st) == 0 && S_ISREG(from_st.st_mode)) {
-    PosixFile origin(from, O_RDONLY);
-    if (!origin.is_valid()) {
-      std::cerr << "from: " << from << " is invalid\n";
-      return false;
-    }
-
-    PosixFile destination(to, O_WRONLY | O_CREAT | O_TRUNC);
-    if (!destination.is_valid()) {
-      std::cerr << "to: " << to << " is invalid\n";
-      return false;
-    }
-
-    while (true) {
-      char buffer[kBufferSize];
-      ssize_t read_bytes = origin.Read(buffer, kBufferSize);
-      if (!read_bytes)
-        break;
-      if (read_bytes < 0) {
-        std::cerr << "read error\n";
-        return false;
-      }
-
-      if (destination.Write(buffer, read_bytes) < 0) {
-        std::cerr << "write error\n";
-        return false;
-      }
-    }
-
-    destination.UnlinkWhenDone(false);
-    return true;
-  }  // end file case
+CopyEngine::Result FilesystemInstance::RunCopy(const picojson::value& msg,
+    const std::string& from, const std::string& to) {
+  CopyEngine engine(GetCopyProgressCallback(msg),
+                    [this]() { return TasksCancelled(); });
+  AddCopy(msg, [&engine]() { engine.Cancel(); });
+  CopyEngine::Result result = engine.Copy(from, to);
+  RemoveCopy(msg);
+  return result;
+}
 
-  // element is a directory, create if not exists
-  int status = mkdir(to.c_str(), vfs_const::kDefaultFileMode);
-  if (status != 0 && errno != EEXIST) {
-    std::cerr << "failed to create destination dir: " << to << std::endl;
-    return false;
-  }
-  // recursively copy content
-  DIR* dir;
-  dir = opendir(from.c_str());
-  dirent* elt;
-  while ((elt = readdir(dir)) != NULL) {
-    if (!strcmp(elt->d_name, ".") || !strcmp(elt->d_name, ".."))
-      continue;
-    const std::string filename = elt->d_name;
-    const std::string full_origin = from + "/" + filename;
-    const std::string full_destination = to + "/" + filename;
-    if (!CopyElement(full_origin, full_destination)) {
-      closedir(dir);
-      return false;
-    }
+void FilesystemInstance::PostCopyResult(const picojson::value& msg,
+    CopyEngine::Result result) {
+  switch (result) {
+    case CopyEngine::COPY_OK:
+      PostAsyncSuccessReply(msg);
+      break;
+    case CopyEngine::COPY_CANCELLED:
+      PostAsyncErrorReply(msg, ABORT_ERR);
+      break;
+    case CopyEngine::COPY_FAILED:
+      PostAsyncErrorReply(msg, IO_ERR);
+      break;
   }
-  closedir(dir);
-  return true;
 }
 
-}  // namespace
-
 void FilesystemInstance::HandleFileCopyTo(const picojson::value& msg) {
   if (!msg.contains("originFilePath")) {
     PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
@@ -660,18 +1025,19 @@ void FilesystemInstance::HandleFileCopyTo(const picojson::value& msg) {
 
   bool overwrite = msg.get("overwrite").evaluate_as_boolean();
   std::string real_origin_path =
-      vfs_.GetRealPath(msg.get("originFilePath").to_str());
+      vfs_->GetRealPath(msg.get("originFilePath").to_str());
   std::string real_destination_path =
-      ResolveImplicitDestination(real_origin_path,
-      vfs_.GetRealPath(msg.get("destinationFilePath").to_str()));
+      vfs_->GetRealPath(msg.get("destinationFilePath").to_str());
 
-  if (!CopyAndRenameSanityChecks(msg, real_origin_path, real_destination_path,
-                                 overwrite))
-    return;
-  if (CopyElement(real_origin_path, real_destination_path))
-    PostAsyncSuccessReply(msg);
-  else
-    PostAsyncErrorReply(msg, IO_ERR);
+  PostLongTask([=]() {
+    std::string explicit_destination_path =
+        ResolveImplicitDestination(real_origin_path, real_destination_path);
+    if (!CopyAndRenameSanityChecks(msg, real_origin_path,
+                                   explicit_destination_path, overwrite))
+      return;
+    PostCopyResult(msg, RunCopy(msg, real_origin_path,
+                                explicit_destination_path));
+  });
 }
 
 void FilesystemInstance::HandleFileMoveTo(const picojson::value& msg) {
@@ -686,61 +1052,129 @@ void FilesystemInstance::HandleFileMoveTo(const picojson::value& msg) {
 
   bool overwrite = msg.get("overwrite").evaluate_as_boolean();
   std::string real_origin_path =
-      vfs_.GetRealPath(msg.get("originFilePath").to_str());
+      vfs_->GetRealPath(msg.get("originFilePath").to_str());
   std::string real_destination_path =
-      ResolveImplicitDestination(real_origin_path,
-      vfs_.GetRealPath(msg.get("destinationFilePath").to_str()));
+      vfs_->GetRealPath(msg.get("destinationFilePath").to_str());
+
+  PostLongTask([=]() {
+    std::string explicit_destination_path =
+        ResolveImplicitDestination(real_origin_path, real_destination_path);
+    if (!CopyAndRenameSanityChecks(msg, real_origin_path,
+                                   explicit_destination_path, overwrite))
+      return;
+
+    if (rename(real_origin_path.c_str(),
+               explicit_destination_path.c_str()) == 0) {
+      PostAsyncSuccessReply(msg);
+      return;
+    }
+    if (errno != EXDEV) {
+      PostAsyncErrorReply(msg, IO_ERR);
+      return;
+    }
+
+    // Moving to another storage, copy and delete the origin.
+    CopyEngine::Result result =
+        RunCopy(msg, real_origin_path, explicit_destination_path);
+    if (result == CopyEngine::COPY_OK) {
+      struct stat st;
+      bool removed = stat(real_origin_path.c_str(), &st) == 0 &&
+          (S_ISDIR(st.st_mode) ? RecursiveDeleteDirectory(real_origin_path) :
+                                 unlink(real_origin_path.c_str()) == 0);
+      if (!removed)
+        result = CopyEngine::COPY_FAILED;
+    }
+    PostCopyResult(msg, result);
+  });
+}
 
-  if (!CopyAndRenameSanityChecks(msg, real_origin_path, real_destination_path,
-                                 overwrite))
+void FilesystemInstance::HandleFileCreateArchive(
+    const picojson::value& msg) {
+  if (!msg.contains("originFilePath") ||
+      !msg.contains("destinationFilePath")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
+  }
 
-  if (rename(real_origin_path.c_str(), real_destination_path.c_str()) < 0) {
-    PostAsyncErrorReply(msg, IO_ERR);
+  bool overwrite = msg.get("overwrite").evaluate_as_boolean();
+  std::string real_origin_path =
+      vfs_->GetRealPath(msg.get("originFilePath").to_str());
+  std::string real_archive_path =
+      vfs_->GetRealPath(msg.get("destinationFilePath").to_str());
+  ArchiveEngine::Format format;
+  if (!ArchiveEngine::GetFormat(real_archive_path, &format)) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
     return;
   }
 
-  PostAsyncSuccessReply(msg);
-}
-
-void FilesystemInstance::HandleSyncMessage(const char* message) {
-  picojson::value v;
-
-  std::string err;
-  picojson::parse(v, message, message + strlen(message), &err);
-  if (!err.empty()) {
-    std::cout << "Ignoring sync message.\n";
-    return;
-  }
-
-  std::string cmd = v.get("cmd").to_str();
-  std::string reply;
-  if (cmd == "FileSystemManagerGetMaxPathLength")
-    HandleFileSystemManagerGetMaxPathLength(v, reply);
-  else if (cmd == "FileStreamClose")
-    HandleFileStreamClose(v, reply);
-  else if (cmd == "FileStreamRead")
-    HandleFileStreamRead(v, reply);
-  else if (cmd == "FileStreamWrite")
-    HandleFileStreamWrite(v, reply);
-  else if (cmd == "FileCreateDirectory")
-    HandleFileCreateDirectory(v, reply);
-  else if (cmd == "FileCreateFile")
-    HandleFileCreateFile(v, reply);
-  else if (cmd == "FileGetURI")
-    HandleFileGetURI(v, reply);
-  else if (cmd == "FileResolve")
-    HandleFileResolve(v, reply);
-  else if (cmd == "FileStat")
-    HandleFileStat(v, reply);
-  else if (cmd == "FileStreamStat")
-    HandleFileStreamStat(v, reply);
-  else if (cmd == "FileStreamSetPosition")
-    HandleFileStreamSetPosition(v, reply);
-  else
-    std::cout << "Ignoring unknown command: " << cmd << std::endl;
-  if (!reply.empty())
-    SendSyncReply(reply.c_str());
+  PostLongTask([=]() {
+    if (!CopyAndRenameSanityChecks(msg, real_origin_path, real_archive_path,
+                                   overwrite))
+      return;
+    ArchiveEngine engine(GetCopyProgressCallback(msg),
+                         [this]() { return TasksCancelled(); });
+    AddCopy(msg, [&engine]() { engine.Cancel(); });
+    CopyEngine::Result result =
+        engine.Create(real_origin_path, real_archive_path, format);
+    RemoveCopy(msg);
+    PostCopyResult(msg, result);
+  });
+}
+
+void FilesystemInstance::HandleFileExtractArchive(
+    const picojson::value& msg) {
+  if (!msg.contains("originFilePath") ||
+      !msg.contains("destinationFilePath")) {
+    PostAsyncErrorReply(msg, INVALID_VALUES_ERR);
+    return;
+  }
+
+  bool overwrite = msg.get("overwrite").evaluate_as_boolean();
+  std::string real_archive_path =
+      vfs_->GetRealPath(msg.get("originFilePath").to_str());
+  std::string real_destination_path =
+      vfs_->GetRealPath(msg.get("destinationFilePath").to_str());
+
+  PostLongTask([=]() {
+    // The destination directory is made if needed, in an existing one.
+    struct stat st;
+    std::string::size_type slash = real_destination_path.find_last_of('/');
+    if (real_archive_path.empty() || real_destination_path.empty() ||
+        stat(real_archive_path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+      PostAsyncErrorReply(msg, NOT_FOUND_ERR);
+      return;
+    }
+    if (slash == std::string::npos ||
+        stat(real_destination_path.substr(0, slash).c_str(), &st) < 0 ||
+        !S_ISDIR(st.st_mode)) {
+      PostAsyncErrorReply(msg, IO_ERR);
+      return;
+    }
+
+    ArchiveEngine engine(GetCopyProgressCallback(msg),
+                         [this]() { return TasksCancelled(); });
+    AddCopy(msg, [&engine]() { engine.Cancel(); });
+    CopyEngine::Result result =
+        engine.Extract(real_archive_path, real_destination_path, overwrite);
+    RemoveCopy(msg);
+    PostCopyResult(msg, result);
+  });
+}
+
+void FilesystemInstance::HandleFileCopyCancel(const picojson::value& msg,
+    std::string& reply) {
+  if (!msg.get("copyId").is<double>()) {
+    SetSyncError(reply, INVALID_VALUES_ERR);
+    return;
+  }
+
+  // The copy may have completed already, there is nothing to report then.
+  std::lock_guard<std::mutex> lock(copies_mutex_);
+  std::map<double, std::function<void()> >::iterator it =
+      copies_.find(msg.get("copyId").get<double>());
+  if (it != copies_.end())
+    it->second();
+  SetSyncSuccess(reply);
 }
 
 void FilesystemInstance::HandleFileSystemManagerGetMaxPathLength(
@@ -753,46 +1187,44 @@ void FilesystemInstance::HandleFileSystemManagerGetMaxPathLength(
   SetSyncSuccess(reply, value);
 }
 
-bool FilesystemInstance::IsKnownFileStream(const picojson::value& msg) {
+bool FilesystemInstance::IsKnownFileStream(const common::JsonValue& msg) {
   if (!msg.contains("streamID"))
     return false;
   unsigned int key = msg.get("streamID").get<double>();
 
-  return fstream_map_.find(key) != fstream_map_.end();
+  return streams_.Get(key) != NULL;
 }
 
-std::fstream* FilesystemInstance::GetFileStream(unsigned int key) {
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it == fstream_map_.end())
+FileStream* FilesystemInstance::GetFileStream(unsigned int key) {
+  FileStreamTable::Entry* entry = streams_.Get(key);
+  if (!entry)
     return NULL;
-  std::fstream* fs = std::get<1>(it->second);
+  return entry->stream;
+}
 
-  if (fs->is_open())
-    return fs;
-  return NULL;
+void FilesystemInstance::ResetTextDecoder(unsigned int key, bool at_start) {
+  FileStreamTable::Entry* entry = streams_.Get(key);
+  if (entry && entry->decoder)
+    entry->decoder->Reset(at_start);
 }
 
-std::string FilesystemInstance::GetFileEncoding(unsigned int key) const {
-  FStreamMap::const_iterator it = fstream_map_.find(key);
-  if (it == fstream_map_.end())
+std::string FilesystemInstance::GetFileEncoding(unsigned int key) {
+  FileStreamTable::Entry* entry = streams_.Get(key);
+  if (!entry)
     return kPlatformEncoding;
-  return std::get<2>(it->second);
+  return entry->encoding;
 }
 
-std::fstream* FilesystemInstance::GetFileStream(unsigned int key,
+FileStream* FilesystemInstance::GetFileStream(unsigned int key,
     std::ios_base::openmode mode) {
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it == fstream_map_.end())
+  FileStreamTable::Entry* entry = streams_.Get(key);
+  if (!entry)
     return NULL;
 
-  if ((std::get<0>(it->second) & mode) != mode)
+  if ((entry->mode & mode) != mode)
     return NULL;
 
-  std::fstream* fs = std::get<1>(it->second);
-
-  if (fs->is_open())
-    return fs;
-  return NULL;
+  return entry->stream;
 }
 
 void FilesystemInstance::SetSyncError(std::string& output,
@@ -836,7 +1268,8 @@ void FilesystemInstance::SetSyncSuccess(std::string& reply,
   reply = v.serialize();
 }
 
-void FilesystemInstance::HandleFileStreamClose(const picojson::value& msg,
+void FilesystemInstance::HandleFileStreamClose(
+    const common::JsonValue& msg,
       std::string& reply) {
   if (!msg.contains("streamID")) {
     SetSyncError(reply, INVALID_VALUES_ERR);
@@ -844,122 +1277,36 @@ void FilesystemInstance::HandleFileStreamClose(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  FStreamMap::iterator it = fstream_map_.find(key);
-  if (it != fstream_map_.end()) {
-    std::fstream* fs = std::get<1>(it->second);
-    if (fs->is_open())
-      fs->close();
-    delete fs;
-    fstream_map_.erase(it);
-  }
-
-  SetSyncSuccess(reply);
-}
-
-namespace {
-namespace base64 {
-
-static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmn" \
-      "opqrstuvwxyz0123456789+/";
-
-std::string ConvertTo(std::string input) {
-  std::string encoded;
-  size_t input_len = input.length();
-
-  for (size_t i = 0; i < input_len;) {
-    unsigned triple = input[i];
-    i++;
-
-    triple <<= 8;
-    if (i < input_len)
-      triple |= input[i];
-    i++;
-
-    triple <<= 8;
-    if (i < input_len)
-      triple |= input[i];
-    i++;
-
-    encoded.push_back(chars[(triple & 0xfc0000) >> 18]);
-    encoded.push_back(chars[(triple & 0x3f000) >> 12]);
-    encoded.push_back((i > input_len + 1) ? '=' : chars[(triple & 0xfc0) >> 6]);
-    encoded.push_back((i > input_len) ? '=' : chars[triple & 0x3f]);
-  }
-
-  return encoded;
-}
+  // The stream is closed even if the data can't be written out.
+  FileStreamTable::Entry* entry = streams_.Get(key);
+  bool flushed = !entry || entry->stream->Flush(entry->durable);
+  streams_.Remove(key);
 
-int DecodeOne(char c) {
-  if (c < '0') {
-    if (c == '+')
-      return 62;
-    if (c == '/')
-      return 63;
-    return -1;
+  if (!flushed) {
+    SetSyncError(reply, IO_ERR);
+    return;
   }
-  if (c <= '9')
-    return c - '0' + 52;
-  if (c >= 'A' && c <= 'Z')
-    return c - 'A';
-  if (c >= 'a' && c <= 'z')
-    return c - 'a' + 26;
-  return -1;
+  SetSyncSuccess(reply);
 }
 
-std::string ConvertFrom(std::string input) {
-  std::string decoded;
-  int input_len = input.length();
-
-  if (input_len % 4)
-    return input;
-
-  int i;
-  int c = 0;
-  int decoded_bits = 0;
-  for (i = 0; i < input_len;) {
-    c = input[i++];
-    if (c == '=')
-      break;
-    if (c > 255)
-      continue;
-    int decoded_byte = DecodeOne(c);
-    if (decoded_byte < 0)
-      continue;
-
-    decoded_bits |= decoded_byte;
-
-    if (i % 4 == 0) {
-      decoded.push_back(static_cast<char>(decoded_bits >> 16));
-      decoded.push_back(static_cast<char>(decoded_bits >> 8));
-      decoded.push_back(static_cast<char>(decoded_bits));
-      decoded_bits = 0;
-    } else {
-      decoded_bits <<= 6;
-    }
+void FilesystemInstance::HandleFileStreamFlush(
+    const common::JsonValue& msg,
+      std::string& reply) {
+  if (!IsKnownFileStream(msg)) {
+    SetSyncError(reply, IO_ERR);
+    return;
   }
-
-  if (c == '=') {
-    switch (input_len - i) {
-    case 0:
-      return input;
-    case 1:
-      decoded.push_back(static_cast<char>(decoded_bits >> 10));
-      break;
-    case 2:
-      decoded.push_back(static_cast<char>(decoded_bits >> 16));
-      decoded.push_back(static_cast<char>(decoded_bits >> 8));
-      break;
-    }
+  FileStreamTable::Entry* entry =
+      streams_.Get(msg.get("streamID").get<double>());
+  if (!entry->stream->Flush(entry->durable)) {
+    SetSyncError(reply, IO_ERR);
+    return;
   }
-
-  return decoded;
+  SetSyncSuccess(reply);
 }
 
-}  // namespace base64
-
-}  // namespace
-
-void FilesystemInstance::HandleFileStreamRead(const picojson::value& msg,
+void FilesystemInstance::HandleFileStreamRead(
+    const common::JsonValue& msg,
       std::string& reply) {
   if (!IsKnownFileStream(msg)) {
     SetSyncError(reply, IO_ERR);
@@ -967,7 +1314,7 @@ void FilesystemInstance::HandleFileStreamRead(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::streamsize count;
+  size_t count;
   if (msg.contains("count")) {
     count = msg.get("count").get<double>();
   } else {
@@ -975,85 +1322,99 @@ void FilesystemInstance::HandleFileStreamRead(const picojson::value& msg,
     SetSyncError(reply, IO_ERR);
     return;
   }
-  std::fstream* fs = GetFileStream(key, std::ios_base::in);
+  FileStream* fs = GetFileStream(key, std::ios_base::in);
   if (!fs) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  if (msg.get("type").to_str() == "Default") {
+  if (msg.get("type").equals("Default")) {
     // we want decoded text data
     // depending on encoding, a character (a.k.a. a glyph) may take
     // one or several bytes in input and in output as well.
-    std::string encoding = GetFileEncoding(key);
-    ReadText(fs, count, encoding.c_str(), reply);
+    ReadText(streams_.Get(key), count, reply);
     return;
   }
-  // we want binary data
-  std::string buffer;
-  buffer.resize(count);
-  fs->read(&buffer[0], count);
-  std::streamsize bytes_read = fs->gcount();
-  fs->clear();
-  if (fs->bad()) {
-    fs->clear();
+  ResetTextDecoder(key, false);
+  // we want binary data, which points into the file mapping for read-only
+  // streams.
+  const char* data;
+  size_t bytes_read;
+  if (!fs->Read(count, &data, &bytes_read)) {
     SetSyncError(reply, IO_ERR);
     return;
   }
-  buffer.resize(bytes_read);
-
-  if (msg.get("type").to_str() == "Bytes") {
-    // return binary data as numeric array
-    picojson::value::array a;
-
-    for (int i = 0; i < bytes_read; i++) {
-        a.push_back(picojson::value(static_cast<double>(buffer[i])));
-    }
-
-    picojson::value v(a);
-    SetSyncSuccess(reply, v);
-    return;
-  }
 
-  if (msg.get("type").to_str() == "Base64") {
-    // return binary data as Base64 encoded string
-    std::string base64_buffer = base64::ConvertTo(buffer);
-    SetSyncSuccess(reply, base64_buffer);
+  if (msg.get("type").equals("Bytes") || msg.get("type").equals("Base64")) {
+    // return binary data as Base64 encoded string, readBytes() turns it into
+    // an array on the JavaScript side as a JSON array of numbers would be
+    // several times bigger. Base64 needs no JSON escaping, so it is written
+    // straight into the reply.
+    reply = "{\"isError\":false,\"value\":\"";
+    reply.reserve(reply.size() + common::base64::EncodedSize(bytes_read) + 2);
+    common::base64::EncodeAppend(data, bytes_read, &reply);
+    reply += "\"}";
     return;
   }
 
+  std::string buffer(data, bytes_read);
   SetSyncSuccess(reply, buffer);
 }
 
-void FilesystemInstance::HandleFileStreamWrite(const picojson::value& msg,
+void FilesystemInstance::HandleFileStreamWrite(
+    const common::JsonValue& msg,
       std::string& reply) {
-  if (!msg.contains("data")) {
-    SetSyncError(reply, INVALID_VALUES_ERR);
-    return;
-  }
+  WebApiAPIErrors error = WriteFileStream(msg);
+  if (error != NO_ERROR)
+    SetSyncError(reply, error);
+  else
+    SetSyncSuccess(reply);
+}
 
-  if (!IsKnownFileStream(msg)) {
-    SetSyncError(reply, IO_ERR);
-    return;
-  }
+void FilesystemInstance::HandleFileStreamWriteAsync(
+    const common::JsonValue& msg) {
+  // Messages are handled in order, so the write is done before anything
+  // else JavaScript does with the stream.
+  WebApiAPIErrors error = WriteFileStream(msg);
+  common::JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("isError");
+  writer.Bool(error != NO_ERROR);
+  if (error != NO_ERROR) {
+    writer.Key("errorCode");
+    writer.Number(error);
+  }
+  writer.Key("reply_id");
+  writer.Number(msg.get("reply_id").get<double>());
+  writer.EndObject();
+  PostMessage(writer.c_str());
+}
+
+WebApiAPIErrors FilesystemInstance::WriteFileStream(
+    const common::JsonValue& msg) {
+  if (!msg.contains("data"))
+    return INVALID_VALUES_ERR;
+
+  if (!IsKnownFileStream(msg))
+    return IO_ERR;
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key, std::ios_base::out);
-  if (!fs) {
-    SetSyncError(reply, IO_ERR);
-    return;
-  }
+  FileStream* fs = GetFileStream(key, std::ios_base::out);
+  if (!fs)
+    return IO_ERR;
 
   std::string buffer;
-  if (msg.get("type").to_str() == "Bytes") {
-    picojson::array a = msg.get("data").get<picojson::array>();
-    for (picojson::array::iterator iter = a.begin(); iter != a.end(); ++iter)
-      buffer.append<int>(1, (*iter).get<double>());
-  } else if (msg.get("type").to_str() == "Base64") {
-    buffer = base64::ConvertFrom(msg.get("data").to_str());
+  const common::JsonValue& data = msg.get("data");
+  if (msg.get("type").equals("Bytes")) {
+    buffer.reserve(data.size());
+    for (size_t i = 0; i < data.size(); ++i)
+      buffer.push_back(static_cast<char>(data.get(i).get<double>()));
+  } else if (msg.get("type").equals("Base64")) {
+    if (!common::base64::Decode(data.to_str(), &buffer))
+      return INVALID_VALUES_ERR;
   } else {
     // text mode
-    std::string text = msg.get("data").to_str();
+    std::string text = data.to_str();
     std::string encoding = GetFileEncoding(key);
     if (encoding != "UTF-8" && encoding != "utf-8") {
       // transcode
@@ -1075,8 +1436,7 @@ void FilesystemInstance::HandleFileStreamWrite(const picojson::value& msg,
             case EILSEQ:
             default:
               iconv_close(cd);
-              SetSyncError(reply, IO_ERR);
-              return;
+              return IO_ERR;
           }
         }
         buffer.append(encode_buf, kBufferSize-out_bytes_free);
@@ -1087,13 +1447,10 @@ void FilesystemInstance::HandleFileStreamWrite(const picojson::value& msg,
     }
   }
 
-  if (!((*fs) << buffer)) {
-    fs->clear();
-    SetSyncError(reply, IO_ERR);
-    return;
-  }
-  fs->flush();
-  SetSyncSuccess(reply);
+  ResetTextDecoder(key, false);
+  if (!fs->Write(buffer.data(), buffer.size()))
+    return IO_ERR;
+  return NO_ERROR;
 }
 
 void FilesystemInstance::HandleFileCreateDirectory(const picojson::value& msg,
@@ -1114,7 +1471,7 @@ void FilesystemInstance::HandleFileCreateDirectory(const picojson::value& msg,
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(full_path);
+  std::string real_path = vfs_->GetRealPath(full_path);
   if (real_path.empty()) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
@@ -1147,20 +1504,17 @@ void FilesystemInstance::HandleFileCreateFile(const picojson::value& msg,
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(full_path);
+  std::string real_path = vfs_->GetRealPath(full_path);
   if (real_path.empty()) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
   }
 
-  int result = open(real_path.c_str(), O_CREAT | O_WRONLY | O_EXCL,
-      vfs_const::kDefaultFileMode);
-  if (result < 0) {
+  if (!CreateFile(real_path)) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  close(result);
   SetSyncSuccess(reply, full_path);
 }
 
@@ -1172,7 +1526,7 @@ void FilesystemInstance::HandleFileGetURI(const picojson::value& msg,
   }
   std::string full_path = msg.get("fullPath").to_str();
 
-  std::string real_path = vfs_.GetRealPath(full_path);
+  std::string real_path = vfs_->GetRealPath(full_path);
   if (real_path.empty()) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
@@ -1208,60 +1562,77 @@ void FilesystemInstance::HandleFileResolve(const picojson::value& msg,
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(full_path);
+  std::string real_path = vfs_->GetRealPath(full_path);
   if (real_path.empty()) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
   }
 
-  char* real_path_c = realpath(real_path.c_str(), NULL);
-  if (!real_path_c) {
+  struct stat st;
+  if (!metadata_cache_->Stat(real_path, &st)) {
     SetSyncError(reply, NOT_FOUND_ERR);
     return;
   }
-  free(real_path_c);
 
   SetSyncSuccess(reply, full_path);
 }
 
-void FilesystemInstance::HandleFileStat(const picojson::value& msg,
+void FilesystemInstance::HandleFileStat(
+    const common::JsonValue& msg,
       std::string& reply) {
   if (!msg.contains("fullPath")) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
   }
 
-  std::string real_path = vfs_.GetRealPath(msg.get("fullPath").to_str());
+  std::string real_path = vfs_->GetRealPath(msg.get("fullPath").to_str());
   if (real_path.empty()) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
   }
 
   struct stat st;
-  if (stat(real_path.c_str(), &st) < 0) {
+  if (!metadata_cache_->Stat(real_path, &st)) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  bool is_directory = !!S_ISDIR(st.st_mode);
-
-  picojson::value::object o;
-  o["size"] = picojson::value(static_cast<double>(st.st_size));
-  o["modified"] = picojson::value(static_cast<double>(st.st_mtime));
-  o["created"] = picojson::value(static_cast<double>(st.st_ctime));  // ?
-  o["readOnly"] = picojson::value(!IsWritable(st));
-  o["isFile"] = picojson::value(!!S_ISREG(st.st_mode));
-  o["isDirectory"] = picojson::value(is_directory);
-  if (is_directory)
-    o["length"] = picojson::value(
-        static_cast<double>(VirtualFS::GetDirEntryCount(real_path.c_str())));
+  common::JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("isError");
+  writer.Bool(false);
+  writer.Key("value");
+  WriteStat(real_path, st, &writer);
+  writer.EndObject();
+  reply = writer.str();
+}
 
+void FilesystemInstance::WriteStat(const std::string& real_path,
+    const struct stat& st, common::JsonWriter* writer) {
+  bool is_directory = !!S_ISDIR(st.st_mode);
 
-  picojson::value v(o);
-  SetSyncSuccess(reply, v);
+  writer->BeginObject();
+  writer->Key("size");
+  writer->Number(st.st_size);
+  writer->Key("modified");
+  writer->Number(st.st_mtime);
+  writer->Key("created");
+  writer->Number(st.st_ctime);
+  writer->Key("readOnly");
+  writer->Bool(!IsWritable(st));
+  writer->Key("isFile");
+  writer->Bool(!!S_ISREG(st.st_mode));
+  writer->Key("isDirectory");
+  writer->Bool(is_directory);
+  if (is_directory) {
+    writer->Key("length");
+    writer->Number(metadata_cache_->GetEntryCount(real_path));
+  }
+  writer->EndObject();
 }
 
-void FilesystemInstance::HandleFileStreamStat(const picojson::value& msg,
+void FilesystemInstance::HandleFileStreamStat(
+    const common::JsonValue& msg,
       std::string& reply) {
   if (!IsKnownFileStream(msg)) {
     SetSyncError(reply, IO_ERR);
@@ -1269,33 +1640,17 @@ void FilesystemInstance::HandleFileStreamStat(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key);
+  FileStream* fs = GetFileStream(key);
   if (!fs) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  std::streampos fsize = 0;
-  if (!fs->eof()) {
-    std::streampos initial_pos = fs->tellg();
-    fs->seekg(0, std::ios::end);
-    fsize = fs->tellg() - initial_pos;
-    if (fs->bad()) {
-      fs->clear();
-      SetSyncError(reply, IO_ERR);
-      return;
-    }
-    // Recover the position.
-    fs->clear();
-    fs->seekg(initial_pos);
-    if (fs->bad()) {
-      fs->clear();
-      SetSyncError(reply, IO_ERR);
-      return;
-    }
-  }
+  int64_t fsize = 0;
+  if (!fs->eof())
+    fsize = fs->BytesAvailable();
   picojson::value::object o;
-  o["position"] = picojson::value(static_cast<double>(fs->tellg()));
+  o["position"] = picojson::value(static_cast<double>(fs->Position()));
   o["eof"] = picojson::value(fs->eof());
   o["bytesAvailable"] = picojson::value(static_cast<double>(fsize));
 
@@ -1303,9 +1658,13 @@ void FilesystemInstance::HandleFileStreamStat(const picojson::value& msg,
   SetSyncSuccess(reply, v);
 }
 
-void FilesystemInstance::HandleFileStreamSetPosition(const picojson::value& msg,
+void FilesystemInstance::HandleFileStreamSetPosition(
+    const common::JsonValue& msg,
       std::string& reply) {
-  if (!msg.contains("position")) {
+  // Checked while a double, which may not fit in an int64_t.
+  const common::JsonValue& position = msg.get("position");
+  if (!position.is<double>() || !std::isfinite(position.get<double>()) ||
+      position.get<double>() < 0 || position.get<double>() >= kInt64Limit) {
     SetSyncError(reply, INVALID_VALUES_ERR);
     return;
   }
@@ -1315,176 +1674,68 @@ void FilesystemInstance::HandleFileStreamSetPosition(const picojson::value& msg,
   }
   unsigned int key = msg.get("streamID").get<double>();
 
-  std::fstream* fs = GetFileStream(key);
+  FileStream* fs = GetFileStream(key);
   if (!fs) {
     SetSyncError(reply, IO_ERR);
     return;
   }
 
-  int position = msg.get("position").get<double>();
-  fs->seekg(position);
-  if (fs->bad()) {
-    fs->clear();
+  if (!fs->SetPosition(position.get<double>())) {
     SetSyncError(reply, IO_ERR);
     return;
   }
+  ResetTextDecoder(key, position.get<double>() == 0);
   SetSyncSuccess(reply);
 }
 
-namespace {
-
-/**
- * Request req_char_num characters (glyphs) from buffer s of length slen.
- * Set actual_char_num to the number of actually available characters
- * (actual_char_num <= req_char_num)
- * Set bytes_num to the number of corresponding bytes in the buffer.
- * Beware! the buffer must contain complete and valid UTF-8 character sequences.
- */
-bool GetCharsFromBytes(char* s, int slen, int req_char_num,
-    size_t* actual_char_num, size_t* bytes_num) {
-  int i = 0;
-  int j = 0;
-  while (i < slen && j < req_char_num) {
-    if (s[i] > 0) {
-      i++;
-    } else if ((s[i] & 0xE0) == 0xC0) {
-      i += 2;
-    } else if ((s[i] & 0xF0) == 0xE0) {
-      i += 3;
-    } else if ((s[i] & 0xF8) == 0xF0) {
-      i += 4;
-    // these should never happen (restriction of unicode under 0x10FFFF)
-    // but belong to the UTF-8 standard yet.
-    } else if ((s[i] & 0xFC) == 0xF8) {
-      i += 5;
-    } else if ((s[i] & 0xFE) == 0xFC) {
-      i += 6;
-    } else {
-      std::cerr << "Invalid UTF-8!" << std::endl;
-      return false;
+void FilesystemInstance::ReadText(FileStreamTable::Entry* stream,
+    size_t num_chars, std::string& reply) {
+  // Each read asks for at most as many bytes as characters are missing, a
+  // character taking at least a byte, so reading never goes past the last
+  // character wanted. Reads are bounded so that asking for a huge count
+  // doesn't allocate as much.
+  const size_t kMaxTextRead = 1024 * 1024;
+
+  if (!stream->decoder) {
+    stream->decoder = TextDecoder::Create(stream->encoding);
+    if (!stream->decoder) {
+      SetSyncError(reply, IO_ERR);
+      return;
     }
-    j++;
   }
-  (*actual_char_num) = j;
-  (*bytes_num) = i;
-  return true;
-}
+  FileStream* file = stream->stream;
+  TextDecoder* decoder = stream->decoder;
 
-}  // namespace
-
-void FilesystemInstance::ReadText(std::fstream* file, size_t num_chars,
-    const char* encoding, std::string& reply) {
-  iconv_t cd = iconv_open("UTF-8", encoding);
-
-  char inbuffer[kBufferSize];
-  char utf8buffer[kBufferSize];
+  int64_t original_pos = file->Position();
   std::string out;
-  int strlength = 0;
-
-  bool out_of_space = false;
-  bool partial_remains = false;
-  // number of bytes already at start of buffer
-  size_t offset = 0;
-  // As we can't predict how much data to read, we may convert more
-  // data than needed. Keep track of excess (converted) bytes in utf8buffer.
-  size_t excess_offset = 0;
-  size_t excess_len = 0;
-  std::streampos original_pos = file->tellg();
-
-  while (strlength < num_chars && !file->eof()) {
-    file->read(inbuffer + offset, kBufferSize - offset);
-    size_t src_bytes_left = file->gcount()+offset;
-
-    char* in_p = inbuffer;
-    do {
-      char* utf8_p = utf8buffer;
-      size_t utf8_bytes_free = kBufferSize;
-      out_of_space = false;
-      partial_remains = false;
-
-      size_t icnv = iconv(cd, &in_p, &src_bytes_left, &utf8_p,
-          &utf8_bytes_free);
-
-      if (icnv == static_cast<size_t>(-1)) {
-        switch (errno) {
-          case E2BIG:
-            out_of_space = true;
-            break;
-          case EINVAL:
-            partial_remains = true;
-            break;
-          case EILSEQ:
-          default:
-            iconv_close(cd);
-            // restore filepos
-            file->clear();
-            file->seekg(original_pos);
-            SetSyncError(reply, IO_ERR);
-            return;
-        }
-      }
-      int missing = num_chars - strlength;
-      size_t available = 0;
-      size_t datalen;
-      size_t utf8load = kBufferSize - utf8_bytes_free;
-      if (!GetCharsFromBytes(utf8buffer, utf8load,
-          missing, &available, &datalen)) {
-        iconv_close(cd);
-        // restore filepos
-        file->clear();
-        file->seekg(original_pos);
-        SetSyncError(reply, IO_ERR);
-        return;
-      }
-      out.append(utf8buffer, datalen);
-      strlength += available;
-      if (datalen < utf8load) {
-        excess_offset = datalen;
-        excess_len = utf8load - datalen;
-        out_of_space = false;
-        partial_remains = (src_bytes_left > 0);
-      }
-    } while (out_of_space);
-
-    if (partial_remains) {
-      // some bytes remains at the end of the buffer that were not converted
-      // move them to the beginning of the inbuffer before completing with data
-      // from disk
-      if (strlength < num_chars)
-        memmove(inbuffer, inbuffer + kBufferSize - src_bytes_left,
-            src_bytes_left);
-      offset = src_bytes_left;
-    } else {
-      offset = 0;
+  size_t length = 0;
+  while (length < num_chars) {
+    const char* data;
+    size_t size;
+    bool read = file->Read(std::min(num_chars - length, kMaxTextRead), &data,
+                           &size);
+    ssize_t decoded = read ? decoder->Decode(data, size, &out) : -1;
+    if (decoded < 0) {
+      file->SetPosition(original_pos);
+      decoder->Reset(original_pos == 0);
+      SetSyncError(reply, IO_ERR);
+      return;
     }
+    length += decoded;
+    // A character cut by the end of the file is left out.
+    if (file->eof() || !size)
+      break;
   }
 
-  iconv_close(cd);
-  std::streampos back_jump = 0;
-  if (offset > 0) {
-    back_jump = offset;
-  }
-  if (excess_len > 0) {
-    // we've read too much, so reposition the file
-    // first, convert back(!) to compute input data size
-    cd = iconv_open(encoding, "UTF-8");
-    char* in_p = utf8buffer + excess_offset;
-    char* out_p = inbuffer;
-    size_t free_bytes = kBufferSize;
-    iconv(cd, &in_p, &excess_len, &out_p, &free_bytes);
-    if (!strcasecmp(encoding, "UTF16") || !strcasecmp(encoding, "UTF-16")) {
-      // don't count the BOM added by iconv
-      free_bytes += 2;
-    }
-    back_jump += (kBufferSize-free_bytes);
-    iconv_close(cd);
-  }
-  if (back_jump > 0) {
-    file->clear();
-    file->seekg(file->tellg()-back_jump);
-  }
-  SetSyncSuccess(reply, out);
-  return;
+  common::JsonWriter writer;
+  writer.Reserve(out.size() + 32);
+  writer.BeginObject();
+  writer.Key("isError");
+  writer.Bool(false);
+  writer.Key("value");
+  writer.String(out);
+  writer.EndObject();
+  reply = writer.str();
 }
 
 void FilesystemInstance::NotifyStorageStateChanged(const std::string& label,
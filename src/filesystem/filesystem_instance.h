@@ -5,28 +5,39 @@
 #ifndef FILESYSTEM_FILESYSTEM_INSTANCE_H_
 #define FILESYSTEM_FILESYSTEM_INSTANCE_H_
 
-#include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
-#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "common/extension.h"
+#include "common/json_arena.h"
+#include "common/json_writer.h"
 #include "common/picojson.h"
 #include "common/virtual_fs.h"
+#include "filesystem/archive_engine.h"
+#include "filesystem/copy_engine.h"
+#include "filesystem/digest.h"
+#include "filesystem/directory_reader.h"
+#include "filesystem/file_stream.h"
+#include "filesystem/metadata_cache.h"
 #include "tizen/tizen.h"
 
 class FilesystemInstance : public common::Instance {
  public:
-  FilesystemInstance();
+  // |metadata_cache| is shared with the other instances, and outlives
+  // them. So is |vfs|.
+  FilesystemInstance(MetadataCache* metadata_cache,
+                     const std::shared_ptr<VirtualFS>& vfs);
   ~FilesystemInstance();
 
   // common::Instance implementation
   void Initialize();
-  void HandleMessage(const char* message);
-  void HandleSyncMessage(const char* message);
 
  private:
   /* Asynchronous messages */
@@ -36,11 +47,36 @@ class FilesystemInstance : public common::Instance {
   void HandleFileOpenStream(const picojson::value& msg);
   void HandleFileDeleteDirectory(const picojson::value& msg);
   void HandleFileDeleteFile(const picojson::value& msg);
+  void HandleFileBatch(const picojson::value& msg);
+  void HandleFileHash(const picojson::value& msg);
+  void HandleFileStreamWriteAsync(const common::JsonValue& msg);
   void HandleFileListFiles(const picojson::value& msg);
   void HandleFileCopyTo(const picojson::value& msg);
   void HandleFileMoveTo(const picojson::value& msg);
+  void HandleFileCreateArchive(const picojson::value& msg);
+  void HandleFileExtractArchive(const picojson::value& msg);
 
   /* Asynchronous message helpers */
+  // Computes the digests of |length| bytes from |offset|, up to the end of
+  // the file if |length| is -1. Runs on a worker.
+  void HashFile(const picojson::value& msg, const std::string& real_path,
+      const std::vector<std::string>& algorithms, int64_t offset,
+      int64_t length);
+  enum BatchOperation {
+    BATCH_STAT,
+    BATCH_DELETE,
+    BATCH_CREATE_FILE,
+    BATCH_CREATE_DIRECTORY,
+  };
+  // Writes the result of |operation| for a path of a FileBatch request, or
+  // {errorCode} if it failed. Runs on workers.
+  void RunBatchOperation(BatchOperation operation,
+      const std::string& full_path, const std::string& real_path,
+      common::JsonWriter* writer);
+  void ListFiles(const picojson::value& msg, const std::string& real_path,
+      const ListFilter& filter);
+  void PostListFilesReply(const picojson::value& msg, const char* cmd,
+      std::vector<std::string>* paths, std::string* types);
   void PostAsyncErrorReply(const picojson::value&, WebApiAPIErrors);
   void PostAsyncSuccessReply(const picojson::value&, picojson::value::object&);
   void PostAsyncSuccessReply(const picojson::value&, picojson::value&);
@@ -50,30 +86,49 @@ class FilesystemInstance : public common::Instance {
   /* Sync messages */
   void HandleFileSystemManagerGetMaxPathLength(const picojson::value& msg,
                                                std::string& reply);
-  void HandleFileStreamClose(const picojson::value& msg, std::string& reply);
-  void HandleFileStreamRead(const picojson::value& msg, std::string& reply);
-  void HandleFileStreamWrite(const picojson::value& msg, std::string& reply);
+  void HandleFileStreamClose(const common::JsonValue& msg, std::string& reply);
+  void HandleFileStreamRead(const common::JsonValue& msg, std::string& reply);
+  void HandleFileStreamWrite(const common::JsonValue& msg, std::string& reply);
+  void HandleFileStreamFlush(const common::JsonValue& msg, std::string& reply);
   void HandleFileCreateDirectory(const picojson::value& msg,
                                  std::string& reply);
   void HandleFileCreateFile(const picojson::value& msg, std::string& reply);
   void HandleFileGetURI(const picojson::value& msg, std::string& reply);
   void HandleFileResolve(const picojson::value& msg, std::string& reply);
-  void HandleFileStat(const picojson::value& msg, std::string& reply);
-  void HandleFileStreamStat(const picojson::value& msg, std::string& reply);
-  void HandleFileStreamSetPosition(const picojson::value& msg,
+  void HandleFileCopyCancel(const picojson::value& msg, std::string& reply);
+  void HandleFileStat(const common::JsonValue& msg, std::string& reply);
+  void HandleFileStreamStat(const common::JsonValue& msg, std::string& reply);
+  void HandleFileStreamSetPosition(const common::JsonValue& msg,
                                    std::string& reply);
 
   /* Sync message helpers */
-  bool IsKnownFileStream(const picojson::value& msg);
-  std::fstream* GetFileStream(unsigned int key);
-  std::fstream* GetFileStream(unsigned int key, std::ios_base::openmode mode);
-  std::string GetFileEncoding(unsigned int key) const;
-  void ReadText(std::fstream* file, size_t num_chars, const char* encoding,
+  bool IsKnownFileStream(const common::JsonValue& msg);
+  // The write of FileStreamWrite and FileStreamWriteAsync.
+  WebApiAPIErrors WriteFileStream(const common::JsonValue& msg);
+  // The value of FileStat replies.
+  void WriteStat(const std::string& real_path, const struct stat& st,
+      common::JsonWriter* writer);
+  FileStream* GetFileStream(unsigned int key);
+  FileStream* GetFileStream(unsigned int key, std::ios_base::openmode mode);
+  std::string GetFileEncoding(unsigned int key);
+  // Text read from the stream after other operations starts afresh.
+  void ResetTextDecoder(unsigned int key, bool at_start);
+  void ReadText(FileStreamTable::Entry* stream, size_t num_chars,
       std::string& reply);
   std::string ResolveImplicitDestination(const std::string& from,
       const std::string& to);
   bool CopyAndRenameSanityChecks(const picojson::value& msg,
       const std::string& from, const std::string& to, bool overwrite);
+  // Posts copyProgress messages if the request wants them.
+  CopyEngine::ProgressCallback GetCopyProgressCallback(
+      const picojson::value& msg);
+  // Makes the copy or archive operation of |msg| cancellable by
+  // FileCopyCancel until it is removed.
+  void AddCopy(const picojson::value& msg, const std::function<void()>& cancel);
+  void RemoveCopy(const picojson::value& msg);
+  CopyEngine::Result RunCopy(const picojson::value& msg,
+      const std::string& from, const std::string& to);
+  void PostCopyResult(const picojson::value& msg, CopyEngine::Result result);
   void SetSyncError(std::string& output, WebApiAPIErrors error_type);
   void SetSyncSuccess(std::string& reply);
   void SetSyncSuccess(std::string& reply, std::string& output);
@@ -83,11 +138,13 @@ class FilesystemInstance : public common::Instance {
   static void OnStorageStateChanged(const std::string& label, Storage storage,
       void* user_data);
 
-  typedef std::tuple<std::ios_base::openmode, std::fstream*,
-      std::string> FStream;
-  typedef std::map<unsigned int, FStream> FStreamMap;
-  FStreamMap fstream_map_;
-  VirtualFS vfs_;
+  MetadataCache* metadata_cache_;
+  FileStreamTable streams_;
+  // Cancels the copies and archive operations running on workers, by the
+  // reply ID of their request.
+  std::mutex copies_mutex_;
+  std::map<double, std::function<void()> > copies_;
+  std::shared_ptr<VirtualFS> vfs_;
 };
 
 #endif  // FILESYSTEM_FILESYSTEM_INSTANCE_H_
@@ -0,0 +1,386 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/metadata_cache.h"
+
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kMaxSize = 4 * 1024 * 1024;
+// Bigger listings are not cached, they would push everything else out.
+const size_t kMaxListingSize = kMaxSize / 4;
+// Watches are a per-user resource, 8192 by default.
+const size_t kMaxWatches = 256;
+// Rough cost of the list and map nodes of an entry.
+const size_t kEntryOverhead = 128;
+
+const uint32_t kWatchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+    IN_DELETE | IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM |
+    IN_MOVED_TO | IN_ONLYDIR;
+
+// Events to the same entries are different paths to the cache, so they
+// are made the same.
+std::string NormalizePath(const std::string& path) {
+  std::string result;
+  result.reserve(path.size());
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (path[i] != '/' || result.empty() || *result.rbegin() != '/')
+      result.push_back(path[i]);
+  }
+  if (result.size() > 1 && *result.rbegin() == '/')
+    result.erase(result.size() - 1);
+  return result;
+}
+
+std::string ChildPath(const std::string& directory, const char* name) {
+  if (directory == "/")
+    return directory + name;
+  return directory + "/" + name;
+}
+
+// Returns an empty string for "/" and relative paths.
+std::string ParentPath(const std::string& path) {
+  std::string::size_type slash = path.rfind('/');
+  if (slash == std::string::npos || path.size() == 1)
+    return std::string();
+  return slash ? path.substr(0, slash) : "/";
+}
+
+size_t ListingSize(const MetadataCache::Listing& listing) {
+  size_t size = 0;
+  for (size_t i = 0; i < listing.size(); ++i)
+    size += sizeof(listing[i]) + listing[i].name.size();
+  return size;
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache()
+    : inotify_fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      size_(0),
+      generation_(1) {}
+
+MetadataCache::~MetadataCache() {
+  // The watches go away with the descriptor.
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+}
+
+bool MetadataCache::Stat(const std::string& path, struct stat* st) {
+  std::string key = NormalizePath(path);
+  uint64_t token = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProcessEvents();
+    Entry* entry = FindOrCreate(key);
+    if (entry && entry->stat_error >= 0) {
+      if (entry->stat_error) {
+        errno = entry->stat_error;
+        return false;
+      }
+      *st = entry->st;
+      return true;
+    }
+    if (entry)
+      token = generation_;
+  }
+
+  // Parallel lookups would queue behind a stat() done with the lock held.
+  // The watches are in place before it, so any change after it shows in
+  // the generation.
+  for (;;) {
+    int result = stat(path.c_str(), st);
+    int error = result < 0 ? errno : 0;
+    if (!token || (error && error != ENOENT && error != ENOTDIR)) {
+      errno = error;
+      return !result;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProcessEvents();
+    std::map<std::string, EntryList::iterator>::iterator it =
+        index_.find(key);
+    if (token != generation_ || it == index_.end()) {
+      errno = error;
+      return !result;
+    }
+    Entry* entry = &*it->second;
+
+    // The time of a directory changes with its content. Its watch must be
+    // in place before the stat() whose result is kept.
+    if (!error && S_ISDIR(st->st_mode) && entry->self_watch < 0) {
+      if (!WatchSelf(entry)) {
+        errno = error;
+        return !result;
+      }
+      token = generation_;
+      continue;
+    }
+    entry->stat_error = error;
+    if (!error)
+      entry->st = *st;
+    errno = error;
+    return !result;
+  }
+}
+
+int MetadataCache::GetEntryCount(const std::string& path) {
+  std::string key = NormalizePath(path);
+  uint64_t token = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ProcessEvents();
+    Entry* entry = FindOrCreate(key);
+    if (entry && entry->entry_count >= 0)
+      return entry->entry_count;
+    if (entry && entry->listing) {
+      int count = 0;
+      for (size_t i = 0; i < entry->listing->size(); ++i) {
+        DirectoryReader::Type type = (*entry->listing)[i].type;
+        if (type == DirectoryReader::TYPE_FILE ||
+            type == DirectoryReader::TYPE_DIRECTORY)
+          ++count;
+      }
+      entry->entry_count = count;
+      return count;
+    }
+    if (entry && WatchSelf(entry))
+      token = generation_;
+  }
+
+  // Big directories take a while, don't hold the lock meanwhile.
+  int count = 0;
+  DirectoryReader reader;
+  if (reader.Open(path)) {
+    DirectoryReader::Entry dirent;
+    while (reader.Next(&dirent)) {
+      if (dirent.type == DirectoryReader::TYPE_FILE ||
+          dirent.type == DirectoryReader::TYPE_DIRECTORY)
+        ++count;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ProcessEvents();
+  std::map<std::string, EntryList::iterator>::iterator it = index_.find(key);
+  if (token && token == generation_ && it != index_.end())
+    it->second->entry_count = count;
+  return count;
+}
+
+std::shared_ptr<const MetadataCache::Listing> MetadataCache::GetListing(
+    const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ProcessEvents();
+  std::map<std::string, EntryList::iterator>::iterator it =
+      index_.find(NormalizePath(path));
+  if (it == index_.end())
+    return std::shared_ptr<const Listing>();
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->listing;
+}
+
+uint64_t MetadataCache::PrepareListing(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ProcessEvents();
+  Entry* entry = FindOrCreate(NormalizePath(path));
+  if (!entry || !WatchSelf(entry))
+    return 0;
+  return generation_;
+}
+
+void MetadataCache::PutListing(const std::string& path, uint64_t token,
+    const std::shared_ptr<const Listing>& listing) {
+  size_t size = ListingSize(*listing);
+  if (!token || size > kMaxListingSize)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ProcessEvents();
+  std::map<std::string, EntryList::iterator>::iterator it =
+      index_.find(NormalizePath(path));
+  if (token != generation_ || it == index_.end())
+    return;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  Entry* entry = &*it->second;
+  size_t old_size = entry->listing ? ListingSize(*entry->listing) : 0;
+  entry->listing = listing;
+  Resize(entry, entry->size - old_size + size);
+}
+
+MetadataCache::Entry* MetadataCache::FindOrCreate(const std::string& path) {
+  std::map<std::string, EntryList::iterator>::iterator it = index_.find(path);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &*it->second;
+  }
+
+  if (inotify_fd_ < 0 || ParentPath(path).empty())
+    return NULL;
+
+  // Renaming or removing any directory above the path changes where it
+  // leads, and only the directory holding that one is told. The watches of
+  // the directories up to the root are shared by all the entries below
+  // them, so those near the root cost one watch for the whole cache.
+  std::vector<int> watches;
+  for (std::string directory = ParentPath(path); !directory.empty();
+       directory = ParentPath(directory)) {
+    int watch = AddWatch(directory);
+    if (watch < 0) {
+      for (size_t i = 0; i < watches.size(); ++i)
+        ReleaseWatch(watches[i]);
+      return NULL;
+    }
+    watches.push_back(watch);
+  }
+
+  Entry entry;
+  entry.path = path;
+  entry.stat_error = -1;
+  entry.entry_count = -1;
+  entry.self_watch = -1;
+  entry.size = 0;
+  entries_.push_front(entry);
+  entries_.front().ancestor_watches.swap(watches);
+  index_[path] = entries_.begin();
+  Resize(&entries_.front(), sizeof(Entry) + kEntryOverhead + path.size() +
+         entries_.front().ancestor_watches.size() * sizeof(int));
+  return &entries_.front();
+}
+
+bool MetadataCache::WatchSelf(Entry* entry) {
+  if (entry->self_watch < 0)
+    entry->self_watch = AddWatch(entry->path);
+  return entry->self_watch >= 0;
+}
+
+int MetadataCache::AddWatch(const std::string& path) {
+  for (std::map<int, Watch>::iterator it = watches_.begin();
+       it != watches_.end(); ++it) {
+    if (it->second.path == path) {
+      ++it->second.references;
+      return it->first;
+    }
+  }
+
+  // The entry being looked up is at the front, and stays.
+  while (watches_.size() >= kMaxWatches && entries_.size() > 1)
+    EraseLeastRecentlyUsed();
+  if (watches_.size() >= kMaxWatches)
+    return -1;
+
+  int watch = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+  if (watch < 0)
+    return -1;
+  Watch& entry = watches_[watch];
+  if (entry.references) {
+    // Another path to the same directory, whose events would be reported
+    // for the first path only.
+    return -1;
+  }
+  entry.path = path;
+  entry.references = 1;
+  return watch;
+}
+
+void MetadataCache::ReleaseWatch(int watch) {
+  std::map<int, Watch>::iterator it = watches_.find(watch);
+  if (it == watches_.end() || --it->second.references)
+    return;
+  inotify_rm_watch(inotify_fd_, watch);
+  watches_.erase(it);
+}
+
+void MetadataCache::Resize(Entry* entry, size_t size) {
+  size_ = size_ - entry->size + size;
+  entry->size = size;
+  while (size_ > kMaxSize && entries_.size() > 1)
+    EraseLeastRecentlyUsed();
+}
+
+void MetadataCache::Erase(EntryList::iterator it) {
+  for (size_t i = 0; i < it->ancestor_watches.size(); ++i)
+    ReleaseWatch(it->ancestor_watches[i]);
+  if (it->self_watch >= 0)
+    ReleaseWatch(it->self_watch);
+  size_ -= it->size;
+  index_.erase(it->path);
+  entries_.erase(it);
+}
+
+void MetadataCache::EraseLeastRecentlyUsed() {
+  Erase(--entries_.end());
+}
+
+void MetadataCache::Invalidate(const std::string& path) {
+  std::map<std::string, EntryList::iterator>::iterator it = index_.find(path);
+  if (it == index_.end())
+    return;
+  Erase(it->second);
+  ++generation_;
+}
+
+void MetadataCache::InvalidateTree(const std::string& path) {
+  Invalidate(path);
+  std::string prefix = path == "/" ? path : path + "/";
+  std::map<std::string, EntryList::iterator>::iterator it =
+      index_.lower_bound(prefix);
+  while (it != index_.end() &&
+         !it->first.compare(0, prefix.size(), prefix)) {
+    EntryList::iterator entry = it->second;
+    ++it;
+    Erase(entry);
+    ++generation_;
+  }
+}
+
+void MetadataCache::ProcessEvents() {
+  if (inotify_fd_ < 0)
+    return;
+
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t size = read(inotify_fd_, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR)
+      continue;
+    if (size <= 0)
+      return;
+
+    for (char* p = buffer; p < buffer + size;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(*event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        while (!entries_.empty())
+          Erase(entries_.begin());
+        ++generation_;
+        continue;
+      }
+      std::map<int, Watch>::iterator it = watches_.find(event->wd);
+      if (it == watches_.end())
+        continue;
+      // The watch may go away with the entries.
+      std::string directory = it->second.path;
+
+      if (event->len && event->name[0]) {
+        // Whatever the type, the path may now lead somewhere else for
+        // the entries below it: it may have been a link.
+        InvalidateTree(ChildPath(directory, event->name));
+        if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                           IN_MOVED_TO))
+          Invalidate(directory);
+      } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT |
+                                IN_IGNORED)) {
+        InvalidateTree(directory);
+      } else {
+        Invalidate(directory);
+      }
+    }
+  }
+}
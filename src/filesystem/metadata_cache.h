@@ -0,0 +1,116 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_METADATA_CACHE_H_
+#define FILESYSTEM_METADATA_CACHE_H_
+
+// Caches stat() results, entry counts and listings of directories by real
+// path, for the apps which stat and list the same few directories over and
+// over. Entries stay coherent through inotify: the directories above every
+// cached path are watched, and so are cached directories themselves. Pending
+// events are applied before every lookup, so changes made before a call are
+// always seen, including those made by the extension itself.
+//
+// The cache is shared by the instances of the extension and is thread-safe.
+// It holds a bounded number of bytes and of watches, evicting the least
+// recently used entries. Without inotify, every call goes to the filesystem.
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/utils.h"
+#include "filesystem/directory_reader.h"
+
+class MetadataCache {
+ public:
+  struct ListingEntry {
+    std::string name;
+    DirectoryReader::Type type;
+  };
+  typedef std::vector<ListingEntry> Listing;
+
+  MetadataCache();
+  ~MetadataCache();
+
+  // Same as stat(), failures included.
+  bool Stat(const std::string& path, struct stat* st);
+
+  // The number of files and directories in |path|, 0 if it can't be read.
+  int GetEntryCount(const std::string& path);
+
+  // Returns NULL if the listing of |path| is not cached. Otherwise the
+  // listing can be used for as long as needed, even if the directory
+  // changes meanwhile.
+  std::shared_ptr<const Listing> GetListing(const std::string& path);
+
+  // Caching a listing read by the caller goes in two steps, as the watches
+  // must be in place before the directory is read:
+  //
+  //   uint64_t token = cache->PrepareListing(path);
+  //   ... read the whole directory ...
+  //   cache->PutListing(path, token, listing);
+  //
+  // The listing is dropped if something changed in between.
+  uint64_t PrepareListing(const std::string& path);
+  void PutListing(const std::string& path, uint64_t token,
+                  const std::shared_ptr<const Listing>& listing);
+
+ private:
+  struct Entry {
+    std::string path;
+    // 0 if the stat is cached and succeeded, the error of stat() if it
+    // failed, -1 if not cached.
+    int stat_error;
+    struct stat st;
+    // -1 if not cached.
+    int entry_count;
+    std::shared_ptr<const Listing> listing;
+    // Of the parent directory and all those above it, and of the path if it
+    // is a directory.
+    std::vector<int> ancestor_watches;
+    int self_watch;
+    size_t size;
+  };
+  typedef std::list<Entry> EntryList;
+
+  struct Watch {
+    std::string path;
+    // Entries using the watch.
+    int references;
+  };
+
+  // Returns NULL if the entry can't be watched. Moves it to the front of
+  // the LRU list.
+  Entry* FindOrCreate(const std::string& path);
+  bool WatchSelf(Entry* entry);
+  int AddWatch(const std::string& path);
+  void ReleaseWatch(int watch);
+  void Resize(Entry* entry, size_t size);
+  void Erase(EntryList::iterator it);
+  void EraseLeastRecentlyUsed();
+  void Invalidate(const std::string& path);
+  void InvalidateTree(const std::string& path);
+  void ProcessEvents();
+
+  std::mutex mutex_;
+  int inotify_fd_;
+  // Most recently used first.
+  EntryList entries_;
+  std::map<std::string, EntryList::iterator> index_;
+  std::map<int, Watch> watches_;
+  size_t size_;
+  // Incremented when entries are invalidated, see PrepareListing().
+  uint64_t generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetadataCache);
+};
+
+#endif  // FILESYSTEM_METADATA_CACHE_H_
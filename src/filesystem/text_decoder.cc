@@ -0,0 +1,409 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "filesystem/text_decoder.h"
+
+#include <errno.h>
+#include <iconv.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// The vector code path needs intrinsics usable from functions with a target
+// attribute, so that the rest of the build keeps the baseline instruction
+// set. It is picked at runtime according to the CPU.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define TEXT_DECODER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Returns 0 for bytes which can't start a character.
+size_t SequenceLength(uint8_t lead) {
+  if (lead < 0x80)
+    return 1;
+  if (lead >= 0xc2 && lead <= 0xdf)
+    return 2;
+  if (lead >= 0xe0 && lead <= 0xef)
+    return 3;
+  if (lead >= 0xf0 && lead <= 0xf4)
+    return 4;
+  return 0;
+}
+
+bool IsContinuation(uint8_t c) {
+  return (c & 0xc0) == 0x80;
+}
+
+// Counts the characters of valid UTF-8.
+size_t CountCharacters(const char* data, size_t size) {
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+  size_t continuations = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, src + i, sizeof(word));
+    // Continuation bytes are those with 10 in the top bits.
+    uint64_t marks = word & ~(word << 1) & kHighBits;
+    continuations += __builtin_popcountll(marks);
+  }
+  for (; i < size; ++i)
+    continuations += IsContinuation(src[i]);
+  return size - continuations;
+}
+
+bool ValidateAscii(const uint8_t* src, size_t size) {
+  uint64_t bits = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, src + i, sizeof(word));
+    bits |= word;
+  }
+  for (; i < size; ++i)
+    bits |= src[i];
+  return !(bits & kHighBits);
+}
+
+// Validates whole characters and adds their number to |chars|.
+bool ValidateScalar(const uint8_t* src, size_t size, size_t* chars) {
+  size_t i = 0;
+  while (i < size) {
+    uint8_t lead = src[i];
+    if (lead < 0x80) {
+      ++i;
+      ++*chars;
+      continue;
+    }
+
+    size_t length = SequenceLength(lead);
+    if (!length || length > size - i)
+      return false;
+    // The range of the second byte rules out overlong forms, surrogates
+    // and code points past U+10FFFF.
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if (lead == 0xe0)
+      low = 0xa0;
+    else if (lead == 0xed)
+      high = 0x9f;
+    else if (lead == 0xf0)
+      low = 0x90;
+    else if (lead == 0xf4)
+      high = 0x8f;
+    if (src[i + 1] < low || src[i + 1] > high)
+      return false;
+    for (size_t j = 2; j < length; ++j) {
+      if (!IsContinuation(src[i + j]))
+        return false;
+    }
+    i += length;
+    ++*chars;
+  }
+  return true;
+}
+
+// The vector functions validate as much of the input as they can in whole
+// blocks, set |done| to the end of the last whole character in them and add
+// the characters to |chars|. The scalar code does the rest.
+typedef bool (*ValidateBlocksFunc)(const uint8_t* src, size_t size,
+                                   size_t* done, size_t* chars);
+
+bool ValidateBlocksNone(const uint8_t*, size_t, size_t* done, size_t*) {
+  *done = 0;
+  return true;
+}
+
+#if defined(TEXT_DECODER_X86_SIMD)
+
+// The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than
+// One Instruction Per Byte". Each byte is classified by its high nibble and
+// by both nibbles of the byte before it; a bit is left set in the AND of the
+// three lookups for each error of the pair. Third and fourth bytes of
+// characters are checked apart, with saturated subtractions.
+const int8_t kTooShort = 1 << 0;
+const int8_t kTooLong = 1 << 1;
+const int8_t kOverlong3 = 1 << 2;
+const int8_t kTooLarge = 1 << 3;
+const int8_t kSurrogate = 1 << 4;
+const int8_t kOverlong2 = 1 << 5;
+const int8_t kTooLarge1000 = 1 << 6;
+const int8_t kOverlong4 = 1 << 6;
+const int8_t kTwoContinuations = static_cast<int8_t>(1 << 7);
+const int8_t kCarry = kTooShort | kTooLong | kTwoContinuations;
+
+__attribute__((target("ssse3")))
+bool ValidateBlocksSSSE3(const uint8_t* src, size_t size, size_t* done,
+                         size_t* chars) {
+  const __m128i byte_1_high = _mm_setr_epi8(
+      kTooLong, kTooLong, kTooLong, kTooLong,
+      kTooLong, kTooLong, kTooLong, kTooLong,
+      kTwoContinuations, kTwoContinuations,
+      kTwoContinuations, kTwoContinuations,
+      kTooShort | kOverlong2,
+      kTooShort,
+      kTooShort | kOverlong3 | kSurrogate,
+      kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+  const __m128i byte_1_low = _mm_setr_epi8(
+      kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+      kCarry | kOverlong2,
+      kCarry,
+      kCarry,
+      kCarry | kTooLarge,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000);
+  const __m128i byte_2_high = _mm_setr_epi8(
+      kTooShort, kTooShort, kTooShort, kTooShort,
+      kTooShort, kTooShort, kTooShort, kTooShort,
+      kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 |
+          kTooLarge1000 | kOverlong4,
+      kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge,
+      kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+      kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+      kTooShort, kTooShort, kTooShort, kTooShort);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  // Lead bytes in the last three bytes of a block which need more bytes.
+  const __m128i incomplete = _mm_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      static_cast<int8_t>(0xf0 - 1), static_cast<int8_t>(0xe0 - 1),
+      static_cast<int8_t>(0xc0 - 1));
+
+  __m128i previous = _mm_setzero_si128();
+  __m128i previous_incomplete = _mm_setzero_si128();
+  __m128i errors = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (!_mm_movemask_epi8(input)) {
+      // ASCII, which is only wrong after a truncated character.
+      errors = _mm_or_si128(errors, previous_incomplete);
+      previous_incomplete = _mm_setzero_si128();
+      previous = input;
+      *chars += 16;
+      continue;
+    }
+
+    __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(byte_1_high,
+                _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high,
+            _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80));
+    __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth),
+                                          _mm_set1_epi8(-128));
+    errors = _mm_or_si128(errors, _mm_xor_si128(must_continue, special));
+    previous_incomplete = _mm_subs_epu8(input, incomplete);
+    previous = input;
+
+    // Everything but continuation bytes, 0x80 to 0xbf, starts a character.
+    __m128i starts = _mm_cmpgt_epi8(input, _mm_set1_epi8(-65));
+    *chars += __builtin_popcount(_mm_movemask_epi8(starts));
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) !=
+      0xffff)
+    return false;
+
+  // The last lead byte is only checked along with the bytes after it. If
+  // its character is cut by the end of the blocks, or if it is no lead byte
+  // at all, the scalar code validates it again.
+  *done = i;
+  for (size_t back = 1; back <= 3 && back <= i; ++back) {
+    uint8_t c = src[i - back];
+    if (IsContinuation(c))
+      continue;
+    if (c >= 0x80 && SequenceLength(c) != back) {
+      *done = i - back;
+      --*chars;
+    }
+    break;
+  }
+  return true;
+}
+
+#endif  // defined(TEXT_DECODER_X86_SIMD)
+
+struct Validator {
+  Validator() : validate_blocks(ValidateBlocksNone) {
+#if defined(TEXT_DECODER_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+      validate_blocks = ValidateBlocksSSSE3;
+#endif
+  }
+
+  ValidateBlocksFunc validate_blocks;
+};
+
+const Validator& GetValidator() {
+  static const Validator validator;
+  return validator;
+}
+
+bool ValidateUtf8(const uint8_t* src, size_t size, size_t* chars) {
+  size_t done;
+  if (!GetValidator().validate_blocks(src, size, &done, chars))
+    return false;
+  return ValidateScalar(src + done, size - done, chars);
+}
+
+// Also decodes ASCII, which is the subset of UTF-8 below 0x80.
+class Utf8Decoder : public TextDecoder {
+ public:
+  explicit Utf8Decoder(bool ascii)
+      : ascii_(ascii),
+        partial_size_(0) {}
+
+  virtual ssize_t Decode(const char* data, size_t size, std::string* out) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+    if (ascii_) {
+      if (!ValidateAscii(src, size))
+        return -1;
+      out->append(data, size);
+      return size;
+    }
+
+    size_t chars = 0;
+    if (partial_size_) {
+      size_t length = SequenceLength(partial_[0]);
+      while (partial_size_ < length && size) {
+        partial_[partial_size_++] = *src++;
+        --size;
+      }
+      if (partial_size_ < length)
+        return 0;
+      if (!ValidateScalar(partial_, length, &chars))
+        return -1;
+      out->append(reinterpret_cast<const char*>(partial_), length);
+      partial_size_ = 0;
+    }
+
+    size_t complete = CompleteSize(src, size);
+    if (!ValidateUtf8(src, complete, &chars))
+      return -1;
+    out->append(reinterpret_cast<const char*>(src), complete);
+    memcpy(partial_, src + complete, size - complete);
+    partial_size_ = size - complete;
+    return chars;
+  }
+
+  virtual bool HasPartialCharacter() const {
+    return partial_size_ > 0;
+  }
+
+  virtual void Reset(bool) {
+    partial_size_ = 0;
+  }
+
+ private:
+  // The size of |src| without a character cut at the end.
+  static size_t CompleteSize(const uint8_t* src, size_t size) {
+    for (size_t back = 1; back <= 3 && back <= size; ++back) {
+      uint8_t c = src[size - back];
+      if (IsContinuation(c))
+        continue;
+      return SequenceLength(c) > back ? size - back : size;
+    }
+    return size;
+  }
+
+  bool ascii_;
+  uint8_t partial_[4];
+  size_t partial_size_;
+};
+
+class IconvDecoder : public TextDecoder {
+ public:
+  explicit IconvDecoder(iconv_t cd) : cd_(cd) {}
+
+  virtual ~IconvDecoder() {
+    iconv_close(cd_);
+  }
+
+  virtual ssize_t Decode(const char* data, size_t size, std::string* out) {
+    std::string input;
+    if (!partial_.empty()) {
+      input.swap(partial_);
+      input.append(data, size);
+      data = input.data();
+      size = input.size();
+    }
+
+    // Ugly cast for the inconsistent iconv prototype.
+    char* in = const_cast<char*>(data);
+    size_t in_left = size;
+    size_t start = out->size();
+    size_t end = start;
+    while (in_left) {
+      // Hardly any character takes more than 3 UTF-8 bytes per input
+      // byte, iconv asks for more room otherwise.
+      out->resize(end + in_left * 3 + 16);
+      char* out_p = &(*out)[end];
+      size_t out_left = out->size() - end;
+      size_t result = iconv(cd_, &in, &in_left, &out_p, &out_left);
+      end = out->size() - out_left;
+      if (result != static_cast<size_t>(-1))
+        break;
+      if (errno == EINVAL) {
+        partial_.assign(in, in_left);
+        break;
+      }
+      if (errno != E2BIG) {
+        out->resize(start);
+        return -1;
+      }
+    }
+    out->resize(end);
+    return CountCharacters(out->data() + start, end - start);
+  }
+
+  virtual bool HasPartialCharacter() const {
+    return !partial_.empty();
+  }
+
+  virtual void Reset(bool at_start) {
+    partial_.clear();
+    if (at_start)
+      iconv(cd_, NULL, NULL, NULL, NULL);
+  }
+
+ private:
+  iconv_t cd_;
+  std::string partial_;
+};
+
+}  // namespace
+
+TextDecoder* TextDecoder::Create(const std::string& encoding) {
+  const char* name = encoding.c_str();
+  if (!strcasecmp(name, "UTF-8") || !strcasecmp(name, "UTF8"))
+    return new Utf8Decoder(false);
+  if (!strcasecmp(name, "ASCII") || !strcasecmp(name, "US-ASCII"))
+    return new Utf8Decoder(true);
+
+  iconv_t cd = iconv_open("UTF-8", name);
+  if (cd == reinterpret_cast<iconv_t>(-1))
+    return NULL;
+  return new IconvDecoder(cd);
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILESYSTEM_TEXT_DECODER_H_
+#define FILESYSTEM_TEXT_DECODER_H_
+
+// Decodes the text read from FileStreams to UTF-8, counting the characters
+// as FileStream.read() wants them. UTF-8 and ASCII are validated and counted
+// in place, with vector instructions when the CPU has them; other encodings
+// go through iconv.
+//
+// A decoder belongs to a stream and keeps its state from one read to the
+// next: the bytes of a character cut by the end of a read, and whatever
+// iconv learnt such as the byte order of a BOM. Reading never goes past the
+// characters wanted, so the stream never has to seek back.
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <string>
+
+class TextDecoder {
+ public:
+  // Returns NULL if |encoding| is not supported.
+  static TextDecoder* Create(const std::string& encoding);
+
+  virtual ~TextDecoder() {}
+
+  // Appends the characters of |data| to |out| and returns how many there
+  // are, or -1 if |data| is not valid in the encoding. All of |data| is
+  // consumed, an incomplete character at the end is completed by the next
+  // call.
+  virtual ssize_t Decode(const char* data, size_t size, std::string* out) = 0;
+
+  // Whether the last call ended in the middle of a character.
+  virtual bool HasPartialCharacter() const = 0;
+
+  // Drops the partial character, when the stream moves elsewhere. Moving
+  // back to the start of the file also forgets the state learnt from the
+  // text, which may begin with a BOM again.
+  virtual void Reset(bool at_start) = 0;
+};
+
+#endif  // FILESYSTEM_TEXT_DECODER_H_
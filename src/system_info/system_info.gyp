@@ -81,6 +81,8 @@
         'system_info_locale.h',
         'system_info_locale_desktop.cc',
         'system_info_locale_tizen.cc',
+        'system_info_memory.cc',
+        'system_info_memory.h',
         'system_info_network.cc',
         'system_info_network.h',
         'system_info_network_desktop.cc',
@@ -92,6 +94,8 @@
         'system_info_peripheral.h',
         'system_info_peripheral_desktop.cc',
         'system_info_peripheral_tizen.cc',
+        'system_info_scheduler.cc',
+        'system_info_scheduler.h',
         'system_info_sim.cc',
         'system_info_sim.h',
         'system_info_sim_ivi.cc',
@@ -11,7 +11,7 @@ var props_array = ['BATTERY', 'CPU',
                    'DEVICE_ORIENTATION', 'BUILD',
                    'LOCALE', 'NETWORK',
                    'WIFI_NETWORK', 'CELLULAR_NETWORK',
-                   'SIM', 'PERIPHERAL'];
+                   'SIM', 'PERIPHERAL', 'MEMORY'];
 
 var postMessage = function(msg, callback) {
   var reply_id = _next_reply_id;
@@ -58,8 +58,7 @@ var _checkThreshold = function(value, highThreshold, lowThreshold) {
   return false;
 };
 
-extension.setMessageListener(function(json) {
-  var msg = JSON.parse(json);
+var _handleMessage = function(msg) {
 
   // For listeners
   if (msg.cmd == 'SystemInfoPropertyValueChanged') {
@@ -74,6 +73,7 @@ extension.setMessageListener(function(json) {
             var lowThreshold = parseFloat(option['lowThreshold']);
             var timeStamp = parseFloat(_listeners[id]['timestamp']);
             if (timeout && (currentTime - timeStamp) > timeout) {
+              var interval = _getSamplingInterval(msg.prop);
               delete _listeners[id];
               if (!_hasListener(msg.prop)) {
                 var message = {
@@ -83,6 +83,8 @@ extension.setMessageListener(function(json) {
                 extension.postMessage(JSON.stringify(message));
                 return;
               }
+              if (_getSamplingInterval(msg.prop) !== interval)
+                _startListening(msg.prop);
               continue;
             }
             switch (msg.prop) {
@@ -98,6 +100,10 @@ extension.setMessageListener(function(json) {
                 if (_checkThreshold(msg.data.brightness, highThreshold, lowThreshold))
                   _listeners[id]['callback'](_createConstClone(msg.data));
                 break;
+              case 'MEMORY':
+                if (_checkThreshold(msg.data.load, highThreshold, lowThreshold))
+                  _listeners[id]['callback'](_createConstClone(msg.data));
+                break;
               case 'STORAGE':
               case 'DEVICE_ORIENTATION':
               case 'BUILD':
@@ -129,6 +135,10 @@ extension.setMessageListener(function(json) {
   } else {
     console.log('Invalid reply_id received from tizen.systeminfo extension: ' + reply_id);
   }
+};
+
+extension.setMessageListener(function(json) {
+  xwalk.utils.dispatchMessages(json, _handleMessage);
 });
 
 exports.getCapabilities = function() {
@@ -188,6 +198,35 @@ var _hasListener = function(prop) {
   return (0 !== count);
 };
 
+// How often the listeners of |prop| want it sampled in ms, the shortest of
+// the 'interval' of their options, or 0 if one wants the default.
+var _getSamplingInterval = function(prop) {
+  var interval = 0;
+
+  for (var i in _listeners) {
+    if (_listeners[i]['prop'] !== prop)
+      continue;
+    var option = _listeners[i]['option'];
+    var listenerInterval = option ? parseFloat(option['interval']) : NaN;
+    if (!(listenerInterval > 0))
+      return 0;
+    if (!interval || listenerInterval < interval)
+      interval = listenerInterval;
+  }
+
+  return interval;
+};
+
+// Starts listening to |prop|, or updates its sampling interval.
+var _startListening = function(prop) {
+  var msg = {
+    'cmd': 'startListening',
+    'prop': prop,
+    'interval': _getSamplingInterval(prop)
+  };
+  extension.postMessage(JSON.stringify(msg));
+};
+
 exports.addPropertyValueChangeListener = function(prop, successCallback, option) {
   if (typeof prop !== 'string' || props_array.indexOf(prop) < 0)
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
@@ -198,13 +237,8 @@ exports.addPropertyValueChangeListener = function(prop, successCallback, option)
   if (arguments.length == 3 && option !== null && (typeof option !== 'object'))
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
-  if (!_hasListener(prop)) {
-    var msg = {
-      'cmd': 'startListening',
-      'prop': prop
-    };
-    extension.postMessage(JSON.stringify(msg));
-  }
+  var hadListener = _hasListener(prop);
+  var interval = _getSamplingInterval(prop);
 
   var timeStamp = (new Date()).valueOf();
   var listener = {
@@ -218,6 +252,9 @@ exports.addPropertyValueChangeListener = function(prop, successCallback, option)
   _next_listener_id += 1;
   _listeners[listener_id] = listener;
 
+  if (!hadListener || _getSamplingInterval(prop) !== interval)
+    _startListening(prop);
+
   return listener_id;
 };
 
@@ -226,6 +263,7 @@ exports.removePropertyValueChangeListener = function(listenerId) {
     throw new tizen.WebAPIException(tizen.WebAPIException.TYPE_MISMATCH_ERR);
 
   var prop = _listeners[listenerId]['prop'];
+  var interval = _getSamplingInterval(prop);
 
   delete _listeners[listenerId];
   if (!_hasListener(prop)) {
@@ -234,5 +272,7 @@ exports.removePropertyValueChangeListener = function(listenerId) {
       'prop': prop
     };
     extension.postMessage(JSON.stringify(msg));
+  } else if (_getSamplingInterval(prop) !== interval) {
+    _startListening(prop);
   }
 };
@@ -5,7 +5,6 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_BATTERY_H_
 #define SYSTEM_INFO_SYSTEM_INFO_BATTERY_H_
 
-#include <glib.h>
 #include <libudev.h>
 
 #if defined(TIZEN)
@@ -40,10 +39,12 @@ class SysInfoBattery : public SysInfoObject {
   void SetData(picojson::value& data);
 
 #if defined(GENERIC_DESKTOP)
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  void Sample();
+  static void OnUdevEvent(void* data);
 
   udev* udev_;
-  int timeout_cb_id_;
+  udev_monitor* udev_monitor_;
+  int watch_id_;
 #elif defined(TIZEN)
   void UpdateLevel(double level);
   void UpdateCharging(bool charging);
@@ -15,30 +15,41 @@ const std::string SysInfoBattery::name_ = "BATTERY";
 SysInfoBattery::SysInfoBattery()
     : level_(0.0),
       charging_(false),
-      timeout_cb_id_(0) {
+      udev_monitor_(NULL),
+      watch_id_(0) {
   udev_ = udev_new();
 }
 
 SysInfoBattery::~SysInfoBattery() {
+  StopListening();
   if (udev_)
     udev_unref(udev_);
-  if (timeout_cb_id_ > 0)
-    g_source_remove(timeout_cb_id_);
 }
 
 void SysInfoBattery::StartListening() {
-  // FIXME(halton): Use udev D-Bus interface to monitor.
-  if (timeout_cb_id_ == 0) {
-    timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                   SysInfoBattery::OnUpdateTimeout,
-                                   static_cast<gpointer>(this));
+  // The power supplies send uevents as they change, but not all of them
+  // for every step of the capacity.
+  if (!udev_monitor_) {
+    udev_monitor_ = system_info::NewUdevMonitor(udev_, "power_supply");
+    if (udev_monitor_) {
+      watch_id_ = SysInfoScheduler::GetInstance().AddWatch(
+          udev_monitor_get_fd(udev_monitor_), SysInfoBattery::OnUdevEvent,
+          this);
+    }
   }
+  StartSampling(udev_monitor_ ? system_info::event_fallback_interval
+                              : system_info::default_timeout_interval);
 }
 
 void SysInfoBattery::StopListening() {
-  if (timeout_cb_id_ > 0) {
-    g_source_remove(timeout_cb_id_);
-    timeout_cb_id_ = 0;
+  StopSampling();
+  if (watch_id_ > 0) {
+    SysInfoScheduler::GetInstance().Remove(watch_id_);
+    watch_id_ = 0;
+  }
+  if (udev_monitor_) {
+    udev_monitor_unref(udev_monitor_);
+    udev_monitor_ = NULL;
   }
 }
 
@@ -98,33 +109,35 @@ bool SysInfoBattery::Update(picojson::value& error) {
   return found;
 }
 
-gboolean SysInfoBattery::OnUpdateTimeout(gpointer user_data) {
-  SysInfoBattery* instance = static_cast<SysInfoBattery*>(user_data);
+void SysInfoBattery::OnUdevEvent(void* data) {
+  SysInfoBattery* instance = static_cast<SysInfoBattery*>(data);
+  if (system_info::DrainUdevMonitor(instance->udev_monitor_))
+    instance->Sample();
+}
 
-  double old_level = instance->level_;
-  double old_charging = instance->charging_;
+void SysInfoBattery::Sample() {
+  double old_level = level_;
+  double old_charging = charging_;
   picojson::value error = picojson::value(picojson::object());
-  if (!instance->Update(error)) {
+  if (!Update(error)) {
     // Fail to update, wait for next round
-    return TRUE;
+    return;
   }
 
-  if ((old_level != instance->level_) ||
-      (old_charging != instance->charging_)) {
+  if ((old_level != level_) ||
+      (old_charging != charging_)) {
     picojson::value output = picojson::value(picojson::object());
     picojson::value data = picojson::value(picojson::object());
 
-    instance->SetData(data);
+    SetData(data);
     system_info::SetPicoJsonObjectValue(output, "cmd",
         picojson::value("SystemInfoPropertyValueChanged"));
     system_info::SetPicoJsonObjectValue(output, "prop",
         picojson::value("BATTERY"));
     system_info::SetPicoJsonObjectValue(output, "data", data);
 
-    instance->PostMessageToListeners(output);
+    PostMessageToListeners(output);
   }
-
-  return TRUE;
 }
 
 void SysInfoBattery::SetData(picojson::value& data) {
@@ -5,7 +5,6 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_BUILD_H_
 #define SYSTEM_INFO_SYSTEM_INFO_BUILD_H_
 
-#include <glib.h>
 #include <string>
 
 #include "common/picojson.h"
@@ -19,39 +18,27 @@ class SysInfoBuild : public SysInfoObject {
     static SysInfoBuild instance;
     return instance;
   }
-  ~SysInfoBuild() {
-    if (timeout_cb_id_ > 0)
-      g_source_remove(timeout_cb_id_);
-  }
   void Get(picojson::value& error, picojson::value& data);
+  // The build cannot change much while running, it is sampled rarely.
   inline void StartListening() {
-    if (timeout_cb_id_ == 0) {
-      timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                     SysInfoBuild::OnUpdateTimeout,
-                                     static_cast<gpointer>(this));
-    }
+    StartSampling(system_info::event_fallback_interval);
   }
   inline void StopListening() {
-    if (timeout_cb_id_ > 0) {
-      g_source_remove(timeout_cb_id_);
-      timeout_cb_id_ = 0;
-    }
+    StopSampling();
   }
 
   static const std::string name_;
 
  private:
-  SysInfoBuild()
-      : timeout_cb_id_(0) {}
+  SysInfoBuild() {}
 
   bool UpdateHardware();
   bool UpdateOSBuild();
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  void Sample();
 
   std::string model_;
   std::string manufacturer_;
   std::string buildversion_;
-  int timeout_cb_id_;
 
   DISALLOW_COPY_AND_ASSIGN(SysInfoBuild);
 };
@@ -86,35 +86,31 @@ bool SysInfoBuild::UpdateOSBuild() {
   return true;
 }
 
-gboolean SysInfoBuild::OnUpdateTimeout(gpointer user_data) {
-  SysInfoBuild* instance = static_cast<SysInfoBuild*>(user_data);
-
-  std::string oldmodel_ = instance->model_;
-  std::string oldmanufacturer_ = instance->manufacturer_;
-  std::string oldbuildversion_ = instance->buildversion_;
-  instance->UpdateHardware();
-  instance->UpdateOSBuild();
-
-  if (oldmodel_ != instance->model_ ||
-      oldmanufacturer_ != instance->manufacturer_ ||
-      oldbuildversion_ != instance->buildversion_) {
+void SysInfoBuild::Sample() {
+  std::string oldmodel_ = model_;
+  std::string oldmanufacturer_ = manufacturer_;
+  std::string oldbuildversion_ = buildversion_;
+  UpdateHardware();
+  UpdateOSBuild();
+
+  if (oldmodel_ != model_ ||
+      oldmanufacturer_ != manufacturer_ ||
+      oldbuildversion_ != buildversion_) {
     picojson::value output = picojson::value(picojson::object());
     picojson::value data = picojson::value(picojson::object());
 
     system_info::SetPicoJsonObjectValue(data, "manufacturer",
-        picojson::value(instance->manufacturer_));
+        picojson::value(manufacturer_));
     system_info::SetPicoJsonObjectValue(data, "model",
-        picojson::value(instance->model_));
+        picojson::value(model_));
     system_info::SetPicoJsonObjectValue(data, "buildVersion",
-        picojson::value(instance->buildversion_));
+        picojson::value(buildversion_));
     system_info::SetPicoJsonObjectValue(output, "cmd",
         picojson::value("SystemInfoPropertyValueChanged"));
     system_info::SetPicoJsonObjectValue(output, "prop",
         picojson::value("BUILD"));
     system_info::SetPicoJsonObjectValue(output, "data", data);
 
-    instance->PostMessageToListeners(output);;
+    PostMessageToListeners(output);
   }
-
-  return TRUE;
 }
@@ -4,11 +4,57 @@
 
 #include "system_info/system_info_cpu.h"
 
-#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <string>
 
+namespace {
+
+// Enough for the lines of a few dozen cores; grown for more.
+const size_t kStatBufferSize = 4096;
+
+// Parses the decimal number after the blanks at |*p|, moving past it. Gives
+// 0 at the end of the line, for the fields of newer kernels.
+uint64_t ParseNumber(const char** p, const char* end) {
+  const char* q = *p;
+  while (q < end && *q == ' ')
+    ++q;
+
+  uint64_t value = 0;
+  for (; q < end && *q >= '0' && *q <= '9'; ++q)
+    value = value * 10 + (*q - '0');
+  *p = q;
+  return value;
+}
+
+bool IsCpuLine(const char* p, const char* end) {
+  return end - p > 3 && !memcmp(p, "cpu", 3);
+}
+
+}  // namespace
+
 const std::string SysInfoCpu::name_ = "CPU";
 
+SysInfoCpu::SysInfoCpu()
+    : stat_fd_(open("/proc/stat", O_RDONLY | O_CLOEXEC)),
+      process_stat_fd_(open("/proc/self/stat", O_RDONLY | O_CLOEXEC)),
+      stat_buffer_(kStatBufferSize),
+      process_times_(0),
+      process_load_(0.0) {
+  memset(&times_, 0, sizeof(times_));
+  memset(&load_, 0, sizeof(load_));
+  UpdateLoad();
+}
+
+SysInfoCpu::~SysInfoCpu() {
+  if (stat_fd_ >= 0)
+    close(stat_fd_);
+  if (process_stat_fd_ >= 0)
+    close(process_stat_fd_);
+}
+
 void SysInfoCpu::Get(picojson::value& error,
                      picojson::value& data) {
   if (!UpdateLoad()) {
@@ -17,70 +63,182 @@ void SysInfoCpu::Get(picojson::value& error,
     return;
   }
 
-  system_info::SetPicoJsonObjectValue(data, "load", picojson::value(load_));
+  SetData(data);
   system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
 }
 
-gboolean SysInfoCpu::OnUpdateTimeout(gpointer user_data) {
-  SysInfoCpu* instance = static_cast<SysInfoCpu*>(user_data);
-
-  double old_load = instance->load_;
-  instance->UpdateLoad();
-  if (old_load != instance->load_) {
+void SysInfoCpu::Sample() {
+  double old_load = load_.load;
+  UpdateLoad();
+  if (old_load != load_.load) {
     picojson::value output = picojson::value(picojson::object());
     picojson::value data = picojson::value(picojson::object());
 
-    system_info::SetPicoJsonObjectValue(data, "load",
-        picojson::value(instance->load_));
+    SetData(data);
     system_info::SetPicoJsonObjectValue(output, "cmd",
         picojson::value("SystemInfoPropertyValueChanged"));
     system_info::SetPicoJsonObjectValue(output, "prop", picojson::value("CPU"));
     system_info::SetPicoJsonObjectValue(output, "data", data);
 
-    instance->PostMessageToListeners(output);
+    PostMessageToListeners(output);
   }
-
-  return TRUE;
 }
 
 void SysInfoCpu::StartListening() {
-  if (timeout_cb_id_ == 0) {
-    timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                   SysInfoCpu::OnUpdateTimeout,
-                                   static_cast<gpointer>(this));
-  }
+  StartSampling(system_info::default_timeout_interval);
 }
 
 void SysInfoCpu::StopListening() {
-  if (timeout_cb_id_ > 0) {
-    g_source_remove(timeout_cb_id_);
-    timeout_cb_id_ = 0;
+  StopSampling();
+}
+
+void SysInfoCpu::SetData(picojson::value& data) {
+  system_info::SetPicoJsonObjectValue(data, "load",
+      picojson::value(load_.load));
+  system_info::SetPicoJsonObjectValue(data, "iowait",
+      picojson::value(load_.iowait));
+  system_info::SetPicoJsonObjectValue(data, "steal",
+      picojson::value(load_.steal));
+
+  picojson::array cores;
+  for (size_t i = 0; i < core_loads_.size(); ++i) {
+    picojson::value core = picojson::value(picojson::object());
+    system_info::SetPicoJsonObjectValue(core, "load",
+        picojson::value(core_loads_[i].load));
+    system_info::SetPicoJsonObjectValue(core, "iowait",
+        picojson::value(core_loads_[i].iowait));
+    system_info::SetPicoJsonObjectValue(core, "steal",
+        picojson::value(core_loads_[i].steal));
+    cores.push_back(core);
   }
+  system_info::SetPicoJsonObjectValue(data, "cores", picojson::value(cores));
+  system_info::SetPicoJsonObjectValue(data, "processLoad",
+      picojson::value(process_load_));
+}
+
+size_t SysInfoCpu::ReadStat() {
+  for (;;) {
+    ssize_t length = pread(stat_fd_, &stat_buffer_[0], stat_buffer_.size(),
+                           0);
+    if (length <= 0)
+      return 0;
+
+    bool whole = static_cast<size_t>(length) < stat_buffer_.size();
+    const char* begin = &stat_buffer_[0];
+    const char* end = begin + length;
+    const char* p = begin;
+    while (p < end && IsCpuLine(p, end)) {
+      const char* line_end =
+          static_cast<const char*>(memchr(p, '\n', end - p));
+      if (!line_end)
+        break;
+      p = line_end + 1;
+    }
+
+    // Done past the lines of the cores, or at the end of the file.
+    if (whole || (end - p > 3 && !IsCpuLine(p, end)))
+      return p - begin;
+    stat_buffer_.resize(stat_buffer_.size() * 2);
+  }
+}
+
+bool SysInfoCpu::ReadProcessTimes(uint64_t* times) {
+  char buffer[1024];
+  ssize_t length = pread(process_stat_fd_, buffer, sizeof(buffer), 0);
+  if (length <= 0)
+    return false;
+
+  // The name of the command is in parentheses and can hold anything, the
+  // fields are counted from the last one. utime and stime are the 14th and
+  // 15th fields, 12 fields past the name.
+  const char* end = buffer + length;
+  const char* p = static_cast<const char*>(memrchr(buffer, ')', length));
+  if (!p)
+    return false;
+  for (int field = 0; field < 12; ++field) {
+    p = static_cast<const char*>(memchr(p + 1, ' ', end - p - 1));
+    if (!p)
+      return false;
+  }
+
+  uint64_t utime = ParseNumber(&p, end);
+  uint64_t stime = ParseNumber(&p, end);
+  *times = utime + stime;
+  return true;
 }
 
 bool SysInfoCpu::UpdateLoad() {
-  FILE *fp = fopen("/proc/stat", "r");
-  if (!fp)
+  if (stat_fd_ < 0)
+    return false;
+
+  size_t length = ReadStat();
+  const char* p = &stat_buffer_[0];
+  const char* end = p + length;
+  if (!IsCpuLine(p, end) || p[3] != ' ')
     return false;
 
-  unsigned long long user; //NOLINT
-  unsigned long long nice; //NOLINT
-  unsigned long long system; //NOLINT
-  unsigned long long idle; //NOLINT
-  unsigned long long iowait; //NOLINT
-  unsigned long long irq; //NOLINT
-  unsigned long long softirq; //NOLINT
+  CpuTimes old_times = times_;
+  for (size_t i = 0; i < core_loads_.size(); ++i)
+    memset(&core_loads_[i], 0, sizeof(core_loads_[i]));
 
-  unsigned long long total; //NOLINT
-  unsigned long long used; //NOLINT
+  while (p < end) {
+    // "cpu" for all the cores, then "cpuN" for each of those online.
+    p += 3;
+    bool total = *p == ' ';
+    size_t core = total ? 0 : ParseNumber(&p, end);
 
-  if (fscanf(fp, "%*s %llu %llu %llu %llu %llu %llu %llu",
-             &user, &nice, &system, &idle, &iowait, &irq, &softirq) != 7) {
-      fclose(fp);
-      return false;
+    CpuTimes times;
+    times.user = ParseNumber(&p, end);
+    times.nice = ParseNumber(&p, end);
+    times.system = ParseNumber(&p, end);
+    times.idle = ParseNumber(&p, end);
+    times.iowait = ParseNumber(&p, end);
+    times.irq = ParseNumber(&p, end);
+    times.softirq = ParseNumber(&p, end);
+    times.steal = ParseNumber(&p, end);
+
+    if (total) {
+      load_ = GetLoad(times_, times);
+      times_ = times;
+    } else {
+      if (core >= core_times_.size()) {
+        CpuTimes none;
+        memset(&none, 0, sizeof(none));
+        core_times_.resize(core + 1, none);
+        core_loads_.resize(core + 1);
+      }
+      core_loads_[core] = GetLoad(core_times_[core], times);
+      core_times_[core] = times;
+    }
+
+    p = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!p)
+      break;
+    ++p;
+  }
+
+  // The share of all the cores used by this process.
+  uint64_t process_times;
+  uint64_t elapsed = GetTotal(times_) - GetTotal(old_times);
+  if (process_stat_fd_ >= 0 && ReadProcessTimes(&process_times)) {
+    process_load_ = elapsed > 0 && process_times >= process_times_ ?
+        static_cast<double>(process_times - process_times_) / elapsed : 0.0;
+    process_times_ = process_times;
   }
-  fclose(fp);
 
+  return true;
+}
+
+// static
+uint64_t SysInfoCpu::GetTotal(const CpuTimes& times) {
+  // Without the steal time, which the load never counted.
+  return times.user + times.nice + times.system + times.idle + times.iowait +
+      times.irq + times.softirq;
+}
+
+// static
+SysInfoCpu::CpuLoad SysInfoCpu::GetLoad(const CpuTimes& old_times,
+                                        const CpuTimes& new_times) {
   // The algorithm here can be found at:
   // http://stackoverflow.com/questions/3017162
   // /how-to-get-total-cpu-usage-in-linux-c
@@ -89,13 +247,25 @@ bool SysInfoCpu::UpdateLoad() {
   // work_over_period = work_jiffies_2 - work_jiffies_1
   // total_over_period = total_jiffies_2 - total_jiffies_1
   // cpu_load = work_over_period / total_over_period
-  used = user + nice + system;
-  total = used + idle + iowait + irq + softirq;
-
-  load_ = static_cast<double>(used - old_used_) / (total - old_total_);
+  CpuLoad load = { 0.0, 0.0, 0.0 };
+  uint64_t old_total = GetTotal(old_times);
+  uint64_t new_total = GetTotal(new_times);
+  // The counters of a core restart when it comes back online.
+  if (new_total <= old_total)
+    return load;
 
-  old_total_ = total;
-  old_used_ = used;
-
-  return true;
+  double total = new_total - old_total;
+  uint64_t old_used = old_times.user + old_times.nice + old_times.system;
+  uint64_t new_used = new_times.user + new_times.nice + new_times.system;
+  if (new_used >= old_used)
+    load.load = (new_used - old_used) / total;
+  if (new_times.iowait >= old_times.iowait)
+    load.iowait = (new_times.iowait - old_times.iowait) / total;
+  // The share of the time the hypervisor ran something else, so out of the
+  // total along with it.
+  if (new_times.steal >= old_times.steal) {
+    double steal = new_times.steal - old_times.steal;
+    load.steal = steal / (total + steal);
+  }
+  return load;
 }
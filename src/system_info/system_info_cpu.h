@@ -4,26 +4,27 @@
 
 #ifndef SYSTEM_INFO_SYSTEM_INFO_CPU_H_
 #define SYSTEM_INFO_SYSTEM_INFO_CPU_H_
-#include <stdio.h>
-#include <glib.h>
+#include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "common/picojson.h"
 #include "common/utils.h"
 #include "system_info/system_info_instance.h"
 #include "system_info/system_info_utils.h"
 
+// The load of the CPU, with the share of it waiting for I/O and stolen by
+// the hypervisor, for all the cores and for each of them, and the share used
+// by this process. The loads are over the time since the previous update,
+// parsed from /proc/stat and /proc/self/stat through descriptors kept open.
 class SysInfoCpu : public SysInfoObject {
  public:
   static SysInfoObject& GetInstance() {
     static SysInfoCpu instance;
     return instance;
   }
-  ~SysInfoCpu() {
-    if (timeout_cb_id_ > 0)
-      g_source_remove(timeout_cb_id_);
-  }
+  ~SysInfoCpu();
   // Get support
   void Get(picojson::value& error, picojson::value& data);
 
@@ -34,20 +35,51 @@ class SysInfoCpu : public SysInfoObject {
   static const std::string name_;
 
  private:
-  SysInfoCpu()
-      : load_(0.0),
-        old_total_(0),
-        old_used_(0),
-        timeout_cb_id_(0) {
-    UpdateLoad();
-  }
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  // Clock ticks spent by a core, or by all of them, in each state.
+  struct CpuTimes {
+    uint64_t user;
+    uint64_t nice;
+    uint64_t system;
+    uint64_t idle;
+    uint64_t iowait;
+    uint64_t irq;
+    uint64_t softirq;
+    uint64_t steal;
+  };
+
+  struct CpuLoad {
+    double load;
+    double iowait;
+    double steal;
+  };
+
+  SysInfoCpu();
+  void Sample();
   bool UpdateLoad();
+  // Reads /proc/stat into |stat_buffer_| up to the end of the lines of the
+  // cores, returns their length.
+  size_t ReadStat();
+  // Ticks spent by this process, in user and system mode.
+  bool ReadProcessTimes(uint64_t* times);
+  void SetData(picojson::value& data);
+
+  static uint64_t GetTotal(const CpuTimes& times);
+  static CpuLoad GetLoad(const CpuTimes& old_times,
+                         const CpuTimes& new_times);
+
+  int stat_fd_;
+  int process_stat_fd_;
+  std::vector<char> stat_buffer_;
+
+  CpuTimes times_;
+  // Indexed by the number of the core. The cores which are offline keep
+  // their last times, with no load.
+  std::vector<CpuTimes> core_times_;
+  uint64_t process_times_;
 
-  double load_;
-  unsigned long long old_total_; //NOLINT
-  unsigned long long old_used_; //NOLINT
-  int timeout_cb_id_;
+  CpuLoad load_;
+  std::vector<CpuLoad> core_loads_;
+  double process_load_;
 
   DISALLOW_COPY_AND_ASSIGN(SysInfoCpu);
 };
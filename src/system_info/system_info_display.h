@@ -5,7 +5,7 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_DISPLAY_H_
 #define SYSTEM_INFO_SYSTEM_INFO_DISPLAY_H_
 
-#include <glib.h>
+#include <libudev.h>
 
 #include <string>
 
@@ -21,24 +21,39 @@ class SysInfoDisplay : public SysInfoObject {
     return instance;
   }
   ~SysInfoDisplay() {
-    if (timeout_cb_id_ > 0)
-      g_source_remove(timeout_cb_id_);
+    StopListening();
+    if (udev_)
+      udev_unref(udev_);
   }
   // Get support
   void Get(picojson::value& error, picojson::value& data);
   // Listerner support
   inline void StartListening() {
-    // FIXME(halton): Use Xlib event or D-Bus interface to monitor.
-    if (timeout_cb_id_ == 0) {
-      timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                     SysInfoDisplay::OnUpdateTimeout,
-                                     static_cast<gpointer>(this));
+    // The backlight sends uevents as the brightness changes, the size is
+    // sampled.
+    // FIXME(halton): Use Xlib event or D-Bus interface to monitor the size.
+    if (!udev_)
+      udev_ = udev_new();
+    if (!udev_monitor_) {
+      udev_monitor_ = system_info::NewUdevMonitor(udev_, "backlight");
+      if (udev_monitor_) {
+        watch_id_ = SysInfoScheduler::GetInstance().AddWatch(
+            udev_monitor_get_fd(udev_monitor_), SysInfoDisplay::OnUdevEvent,
+            this);
+      }
     }
+    StartSampling(udev_monitor_ ? system_info::event_fallback_interval
+                                : system_info::default_timeout_interval);
   }
   inline void StopListening() {
-    if (timeout_cb_id_ > 0) {
-      g_source_remove(timeout_cb_id_);
-      timeout_cb_id_ = 0;
+    StopSampling();
+    if (watch_id_ > 0) {
+      SysInfoScheduler::GetInstance().Remove(watch_id_);
+      watch_id_ = 0;
+    }
+    if (udev_monitor_) {
+      udev_monitor_unref(udev_monitor_);
+      udev_monitor_ = NULL;
     }
   }
 
@@ -47,7 +62,12 @@ class SysInfoDisplay : public SysInfoObject {
  private:
   SysInfoDisplay();
 
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  void Sample();
+  static void OnUdevEvent(void* data) {
+    SysInfoDisplay* instance = static_cast<SysInfoDisplay*>(data);
+    if (system_info::DrainUdevMonitor(instance->udev_monitor_))
+      instance->Sample();
+  }
   bool UpdateSize();
   bool UpdateBrightness();
   void SetData(picojson::value& data);
@@ -59,7 +79,9 @@ class SysInfoDisplay : public SysInfoObject {
   double physical_width_;
   double physical_height_;
   double brightness_;
-  int timeout_cb_id_;
+  udev* udev_;
+  udev_monitor* udev_monitor_;
+  int watch_id_;
   int scale_factor_;
 
   DISALLOW_COPY_AND_ASSIGN(SysInfoDisplay);
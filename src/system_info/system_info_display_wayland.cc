@@ -131,7 +131,9 @@ SysInfoDisplay::SysInfoDisplay()
       physical_width_(0.0),
       physical_height_(0.0),
       brightness_(0.0),
-      timeout_cb_id_(0),
+      udev_(NULL),
+      udev_monitor_(NULL),
+      watch_id_(0),
       scale_factor_(0) {}
 
 void SysInfoDisplay::Get(picojson::value& error,
@@ -208,43 +210,39 @@ bool SysInfoDisplay::UpdateBrightness() {
   return true;
 }
 
-gboolean SysInfoDisplay::OnUpdateTimeout(gpointer user_data) {
-  SysInfoDisplay* instance = static_cast<SysInfoDisplay*>(user_data);
-
-  double old_brightness = instance->brightness_;
-  if (!instance->UpdateBrightness()) {
+void SysInfoDisplay::Sample() {
+  double old_brightness = brightness_;
+  if (!UpdateBrightness()) {
     // Fail to update brightness, wait for next round
-    return TRUE;
+    return;
   }
 
-  int old_resolution_width = instance->resolution_width_;
-  int old_resolution_height = instance->resolution_width_;
-  double old_physical_width = instance->physical_width_;
-  double old_physical_height = instance->physical_height_;
-  if (!instance->UpdateSize()) {
+  int old_resolution_width = resolution_width_;
+  int old_resolution_height = resolution_width_;
+  double old_physical_width = physical_width_;
+  double old_physical_height = physical_height_;
+  if (!UpdateSize()) {
     // Fail to update size, wait for next round
-    return TRUE;
+    return;
   }
 
-  if ((old_brightness != instance->brightness_) ||
-      (old_resolution_width != instance->resolution_width_) ||
-      (old_resolution_height != instance->resolution_width_) ||
-      (old_physical_width != instance->physical_width_) ||
-      (old_physical_height != instance->physical_height_)) {
+  if ((old_brightness != brightness_) ||
+      (old_resolution_width != resolution_width_) ||
+      (old_resolution_height != resolution_width_) ||
+      (old_physical_width != physical_width_) ||
+      (old_physical_height != physical_height_)) {
     picojson::value output = picojson::value(picojson::object());;
     picojson::value data = picojson::value(picojson::object());
 
-    instance->SetData(data);
+    SetData(data);
     system_info::SetPicoJsonObjectValue(output, "cmd",
         picojson::value("SystemInfoPropertyValueChanged"));
     system_info::SetPicoJsonObjectValue(output, "prop",
         picojson::value("DISPLAY"));
     system_info::SetPicoJsonObjectValue(output, "data", data);
 
-    instance->PostMessageToListeners(output);
+    PostMessageToListeners(output);
   }
-
-  return TRUE;
 }
 
 void SysInfoDisplay::SetData(picojson::value& data) {
@@ -20,12 +20,14 @@
 #include "system_info/system_info_instance.h"
 
 #include <dlfcn.h>
+#include <limits.h>
 #include <stdlib.h>
 #if defined(TIZEN)
 #include <pkgmgr-info.h>
 #include <system_info.h>
 #endif
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -36,6 +38,7 @@
 #include "system_info/system_info_device_orientation.h"
 #include "system_info/system_info_display.h"
 #include "system_info/system_info_locale.h"
+#include "system_info/system_info_memory.h"
 #ifdef GENERIC_DESKTOP
 #include "system_info/system_info_network_desktop.h"
 #else
@@ -48,11 +51,24 @@
 #include "system_info/system_info_utils.h"
 #include "system_info/system_info_wifi_network.h"
 
+namespace {
+
+// Property changes are sampled on the shared ticks of SysInfoScheduler, so
+// they tend to come together.
+const unsigned kMessageBatchWindowMs = 50;
+const size_t kMaxMessageBatchBytes = 64 * 1024;
+
+}  // namespace
+
 template <class T>
 void SystemInfoInstance::RegisterClass() {
   classes_.insert(SysInfoClassPair(T::name_ , T::GetInstance()));
 }
 
+SystemInfoInstance::SystemInfoInstance() {
+  EnableMessageBatching(kMessageBatchWindowMs, kMaxMessageBatchBytes);
+}
+
 SystemInfoInstance::~SystemInfoInstance() {
   for (classes_iterator it = classes_.begin();
        it != classes_.end(); ++it) {
@@ -67,6 +83,7 @@ void SystemInfoInstance::InstancesMapInitialize() {
   RegisterClass<SysInfoDeviceOrientation>();
   RegisterClass<SysInfoDisplay>();
   RegisterClass<SysInfoLocale>();
+  RegisterClass<SysInfoMemory>();
   RegisterClass<SysInfoPeripheral>();
 #ifdef GENERIC_DESKTOP
   RegisterClass<SysInfoNetworkDesktop>();
@@ -113,9 +130,16 @@ void SystemInfoInstance::HandleStartListening(const picojson::value& input) {
   std::string prop = input.get("prop").to_str();
   classes_iterator it = classes_.find(prop);
 
-  if (it != classes_.end()) {
-    (it->second).AddListener(this);
+  if (it == classes_.end())
+    return;
+
+  unsigned interval = 0;
+  const picojson::value& interval_value = input.get("interval");
+  if (interval_value.is<double>() && interval_value.get<double>() > 0) {
+    interval = static_cast<unsigned>(
+        std::min(interval_value.get<double>(), static_cast<double>(INT_MAX)));
   }
+  (it->second).AddListener(this, interval);
 }
 
 void SystemInfoInstance::HandleStopListening(const picojson::value& input) {
@@ -5,13 +5,18 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_INSTANCE_H_
 #define SYSTEM_INFO_SYSTEM_INFO_INSTANCE_H_
 
+#include <limits.h>
+
+#include <algorithm>
 #include <list>
 #include <map>
 #include <string>
 #include <utility>
 
 #include "common/extension.h"
+#include "common/json_writer.h"
 #include "common/picojson.h"
+#include "system_info/system_info_scheduler.h"
 #include "system_info/system_info_utils.h"
 
 namespace picojson {
@@ -20,6 +25,7 @@ class value;
 
 class SystemInfoInstance : public common::Instance {
  public:
+  SystemInfoInstance();
   ~SystemInfoInstance();
   static void InstancesMapInitialize();
 
@@ -46,7 +52,9 @@ class SystemInfoInstance : public common::Instance {
 
 class SysInfoObject {
  public:
-  SysInfoObject() {
+  SysInfoObject()
+      : sampling_timer_id_(0),
+        sampling_fallback_(0) {
     pthread_mutex_init(&listeners_mutex_, NULL);
   }
 
@@ -56,6 +64,7 @@ class SysInfoObject {
          it != listeners_.end(); it++) {
       RemoveListener(*it);
     }
+    StopSampling();
     delete lock;
     pthread_mutex_destroy(&listeners_mutex_);
   }
@@ -63,21 +72,35 @@ class SysInfoObject {
   // Get support
   virtual void Get(picojson::value& error, picojson::value& data) = 0;
 
-  // Listener support
-  void AddListener(SystemInfoInstance* instance) {
+  // Listener support. |interval| is how often |instance| wants the property
+  // sampled in ms, 0 for the default of the property. Adding a listener
+  // again updates its interval.
+  void AddListener(SystemInfoInstance* instance, unsigned interval = 0) {
     AutoLock lock(&listeners_mutex_);
-    listeners_.push_back(instance);
-
-    if (listeners_.size() > 1)
-      return;
-    StartListening();
+    if (interval > 0)
+      intervals_[instance] = interval;
+    else
+      intervals_.erase(instance);
+
+    if (std::find(listeners_.begin(), listeners_.end(), instance) ==
+        listeners_.end()) {
+      listeners_.push_back(instance);
+      if (listeners_.size() == 1) {
+        StartListening();
+        return;
+      }
+    }
+    UpdateSampling();
   }
   void RemoveListener(SystemInfoInstance* instance) {
     AutoLock lock(&listeners_mutex_);
     listeners_.remove(instance);
+    intervals_.erase(instance);
 
-    if (!listeners_.empty())
+    if (!listeners_.empty()) {
+      UpdateSampling();
       return;
+    }
     StopListening();
   }
   virtual void StartListening() {}
@@ -90,10 +113,62 @@ class SysInfoObject {
       (*it)->PostMessage(result.c_str());
     }
   }
+  void PostMessageToListeners(const common::JsonWriter& output) {
+    AutoLock lock(&listeners_mutex_);
+    for (std::list<SystemInfoInstance*>::iterator it = listeners_.begin();
+         it != listeners_.end(); it++) {
+      (*it)->PostMessage(output.c_str());
+    }
+  }
 
  protected:
+  // Calls Sample() on the ticks of SysInfoScheduler until StopSampling(),
+  // at the shortest interval asked by the listeners or else every
+  // |fallback| ms. Meant for StartListening() and StopListening().
+  void StartSampling(unsigned fallback) {
+    sampling_fallback_ = fallback;
+    if (sampling_timer_id_ == 0) {
+      sampling_timer_id_ = SysInfoScheduler::GetInstance().AddTimer(
+          GetSamplingInterval(), SysInfoObject::OnSample, this);
+    }
+  }
+  void StopSampling() {
+    if (sampling_timer_id_ > 0) {
+      SysInfoScheduler::GetInstance().Remove(sampling_timer_id_);
+      sampling_timer_id_ = 0;
+    }
+  }
+  // Reads the property and posts it to the listeners if it changed.
+  virtual void Sample() {}
+
   pthread_mutex_t listeners_mutex_;
   std::list<SystemInfoInstance*> listeners_;
+
+ private:
+  unsigned GetSamplingInterval() const {
+    unsigned interval = intervals_.size() < listeners_.size() ?
+        sampling_fallback_ : UINT_MAX;
+    for (std::map<SystemInfoInstance*, unsigned>::const_iterator it =
+         intervals_.begin(); it != intervals_.end(); ++it) {
+      interval = std::min(interval, it->second);
+    }
+    return std::max(interval,
+        static_cast<unsigned>(system_info::min_timeout_interval));
+  }
+  void UpdateSampling() {
+    if (sampling_timer_id_ > 0) {
+      SysInfoScheduler::GetInstance().SetInterval(sampling_timer_id_,
+                                                  GetSamplingInterval());
+    }
+  }
+  static void OnSample(void* data) {
+    static_cast<SysInfoObject*>(data)->Sample();
+  }
+
+  // The intervals asked by the listeners, for those which did.
+  std::map<SystemInfoInstance*, unsigned> intervals_;
+  int sampling_timer_id_;
+  unsigned sampling_fallback_;
 };
 
 typedef std::map<std::string, SysInfoObject&> SysInfoClassMap;
@@ -10,7 +10,6 @@
 #include <vconf-keys.h>
 #endif
 
-#include <glib.h>
 #include <string>
 
 #include "common/picojson.h"
@@ -40,9 +39,11 @@ class SysInfoLocale : public SysInfoObject {
   std::string country_;
 
 #if defined(GENERIC_DESKTOP)
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  void Sample();
+  static void OnInotifyEvent(void* data);
 
-  int timeout_cb_id_;
+  int inotify_fd_;
+  int watch_id_;
 #elif defined(TIZEN)
   static void OnCountryChanged(keynode_t* node, void* user_data);
   static void OnLanguageChanged(keynode_t* node, void* user_data);
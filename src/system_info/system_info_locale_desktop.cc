@@ -5,33 +5,68 @@
 #include "system_info/system_info_locale.h"
 
 #include <locale.h>
-
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 #include <string>
 
 #include "common/picojson.h"
 
+namespace {
+
+// The country comes from the time zone, which tools replace rather than
+// write over: the directory is watched.
+const char kTimezoneDir[] = "/etc";
+const char* kTimezoneFiles[] = { "timezone", "localtime" };
+
+}  // namespace
+
 const std::string SysInfoLocale::name_ = "LOCALE";
 
 SysInfoLocale::SysInfoLocale()
-    : timeout_cb_id_(0) {}
+    : inotify_fd_(-1),
+      watch_id_(0) {}
 
-SysInfoLocale::~SysInfoLocale() {}
+SysInfoLocale::~SysInfoLocale() {
+  StopListening();
+}
 
 void SysInfoLocale::StartListening() {
-  if (timeout_cb_id_ == 0) {
-    timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                   SysInfoLocale::OnUpdateTimeout,
-                                   static_cast<gpointer>(this));
+  // The language is set once from the environment, only the time zone can
+  // change.
+  if (inotify_fd_ >= 0)
+    return;
+
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0 &&
+      inotify_add_watch(inotify_fd_, kTimezoneDir,
+                        IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                        IN_MOVED_FROM | IN_MOVED_TO) >= 0) {
+    watch_id_ = SysInfoScheduler::GetInstance().AddWatch(
+        inotify_fd_, SysInfoLocale::OnInotifyEvent, this);
+    return;
   }
+
+  // Without inotify, sample.
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+  StartSampling(system_info::default_timeout_interval);
 }
 
 void SysInfoLocale::StopListening() {
-  if (timeout_cb_id_ > 0) {
-    g_source_remove(timeout_cb_id_);
-    timeout_cb_id_ = 0;
+  StopSampling();
+  if (watch_id_ > 0) {
+    SysInfoScheduler::GetInstance().Remove(watch_id_);
+    watch_id_ = 0;
+  }
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
   }
 }
 
@@ -101,32 +136,51 @@ bool SysInfoLocale::GetCountry() {
   }
 }
 
-gboolean SysInfoLocale::OnUpdateTimeout(gpointer user_data) {
-  SysInfoLocale* instance = static_cast<SysInfoLocale*>(user_data);
+void SysInfoLocale::OnInotifyEvent(void* data) {
+  SysInfoLocale* instance = static_cast<SysInfoLocale*>(data);
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+
+  ssize_t length;
+  while ((length = read(instance->inotify_fd_, buffer, sizeof(buffer))) > 0) {
+    for (char* p = buffer; p < buffer + length;) {
+      const inotify_event* event = reinterpret_cast<inotify_event*>(p);
+      for (size_t i = 0;
+           i < sizeof(kTimezoneFiles) / sizeof(kTimezoneFiles[0]); ++i) {
+        if (event->len && !strcmp(event->name, kTimezoneFiles[i]))
+          changed = true;
+      }
+      p += sizeof(inotify_event) + event->len;
+    }
+  }
 
-  std::string oldlanguage_ = instance->language_;
-  std::string oldcountry_ = instance->country_;
-  instance->GetLanguage();
-  instance->GetCountry();
+  if (changed)
+    instance->Sample();
+}
+
+void SysInfoLocale::Sample() {
+  std::string oldlanguage_ = language_;
+  std::string oldcountry_ = country_;
+  GetLanguage();
+  GetCountry();
 
-  if (oldlanguage_ != instance->language_ ||
-      oldcountry_ != instance->country_) {
+  if (oldlanguage_ != language_ ||
+      oldcountry_ != country_) {
     picojson::value output = picojson::value(picojson::object());
     picojson::value data = picojson::value(picojson::object());
 
     system_info::SetPicoJsonObjectValue(data, "language",
-        picojson::value(instance->language_));
+        picojson::value(language_));
     system_info::SetPicoJsonObjectValue(data, "country",
-        picojson::value(instance->country_));
+        picojson::value(country_));
     system_info::SetPicoJsonObjectValue(output, "cmd",
         picojson::value("SystemInfoPropertyValueChanged"));
     system_info::SetPicoJsonObjectValue(output, "prop",
         picojson::value("LOCALE"));
     system_info::SetPicoJsonObjectValue(output, "data", data);
 
-    instance->PostMessageToListeners(output);
+    PostMessageToListeners(output);
   }
-
-  return TRUE;
 }
 
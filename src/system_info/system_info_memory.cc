@@ -0,0 +1,319 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "system_info/system_info_memory.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+namespace {
+
+const char kMeminfoPath[] = "/proc/meminfo";
+const char kPressurePath[] = "/proc/pressure/memory";
+const char kCgroupPath[] = "/proc/self/cgroup";
+// Where the cgroup v2 hierarchy is, alone or next to the v1 ones.
+const char* kCgroup2Roots[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+
+// Tells when some tasks stalled on memory for 150 ms in 2 s, the smallest
+// window allowed without privileges.
+const char kPressureTrigger[] = "some 150000 2000000";
+
+// The status goes to WARNING and CRITICAL below these shares of the memory
+// left, or above these shares of the time stalled on memory over the last
+// 10 s.
+const double kWarningAvailable = 0.15;
+const double kCriticalAvailable = 0.05;
+const double kWarningPressure = 0.10;
+const double kCriticalPressure = 0.25;
+
+// Changes of the load and of the pressure smaller than these are not told to
+// the listeners, unless the status changes.
+const double kLoadStep = 0.01;
+const double kPressureStep = 0.01;
+
+// Reads the file open as |fd| into |buffer|, NUL terminated.
+bool ReadFile(int fd, char* buffer, size_t size) {
+  if (fd < 0)
+    return false;
+  ssize_t length = pread(fd, buffer, size - 1, 0);
+  if (length <= 0)
+    return false;
+  buffer[length] = '\0';
+  return true;
+}
+
+// The value of the field |key| in /proc/meminfo, in bytes.
+bool GetMeminfoValue(const char* meminfo, const char* key, uint64_t* value) {
+  size_t key_length = strlen(key);
+  for (const char* line = meminfo; line; line = strchr(line, '\n')) {
+    if (*line == '\n')
+      ++line;
+    if (!strncmp(line, key, key_length) && line[key_length] == ':') {
+      *value = strtoull(line + key_length + 1, NULL, 10) * 1024;
+      return true;
+    }
+  }
+  return false;
+}
+
+// The share of the time of the "some" or "full" line of a PSI file stalled
+// over the last 10 s.
+double GetPressure(const char* pressure, const char* line) {
+  const char* p = strstr(pressure, line);
+  if (!p)
+    return 0.0;
+  p = strstr(p, "avg10=");
+  return p ? strtod(p + 6, NULL) / 100 : 0.0;
+}
+
+int OpenCgroupFile(const std::string& dir, const char* name) {
+  return open((dir + "/" + name).c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+}  // namespace
+
+const std::string SysInfoMemory::name_ = "MEMORY";
+
+SysInfoMemory::SysInfoMemory()
+    : meminfo_fd_(open(kMeminfoPath, O_RDONLY | O_CLOEXEC)),
+      pressure_fd_(open(kPressurePath, O_RDONLY | O_CLOEXEC)),
+      trigger_fd_(-1),
+      watch_id_(0),
+      capacity_(0),
+      available_capacity_(0),
+      cgroup_usage_(0),
+      cgroup_limit_(0),
+      pressure_some_(0.0),
+      pressure_full_(0.0),
+      load_(0.0),
+      status_("NORMAL") {
+  OpenCgroups();
+}
+
+SysInfoMemory::~SysInfoMemory() {
+  StopListening();
+  if (meminfo_fd_ >= 0)
+    close(meminfo_fd_);
+  if (pressure_fd_ >= 0)
+    close(pressure_fd_);
+  for (size_t i = 0; i < cgroups_.size(); ++i) {
+    close(cgroups_[i].current_fd);
+    close(cgroups_[i].max_fd);
+  }
+}
+
+void SysInfoMemory::OpenCgroups() {
+  // The line of the v2 hierarchy is "0::/path".
+  std::ifstream file(kCgroupPath);
+  std::string line;
+  std::string path;
+  while (std::getline(file, line)) {
+    if (!line.compare(0, 3, "0::")) {
+      path = line.substr(3);
+      break;
+    }
+  }
+  if (path.empty() || path[0] != '/')
+    return;
+
+  for (size_t i = 0; i < sizeof(kCgroup2Roots) / sizeof(kCgroup2Roots[0]);
+       ++i) {
+    // The root cgroup has no limit, nor those files.
+    for (std::string dir = path; dir.size() > 1;
+         dir.erase(dir.find_last_of('/'))) {
+      CgroupFiles files;
+      files.current_fd = OpenCgroupFile(kCgroup2Roots[i] + dir,
+                                        "memory.current");
+      files.max_fd = OpenCgroupFile(kCgroup2Roots[i] + dir, "memory.max");
+      if (files.current_fd < 0 || files.max_fd < 0) {
+        if (files.current_fd >= 0)
+          close(files.current_fd);
+        if (files.max_fd >= 0)
+          close(files.max_fd);
+        break;
+      }
+      cgroups_.push_back(files);
+      if (dir.find_last_of('/') == 0)
+        break;
+    }
+    if (!cgroups_.empty())
+      return;
+  }
+}
+
+void SysInfoMemory::Get(picojson::value& error,
+                        picojson::value& data) {
+  if (!Update()) {
+    system_info::SetPicoJsonObjectValue(error, "message",
+        picojson::value("Get memory info failed."));
+    return;
+  }
+
+  SetData(data);
+  system_info::SetPicoJsonObjectValue(error, "message", picojson::value(""));
+}
+
+void SysInfoMemory::StartListening() {
+  // Without the PSI trigger the pressure is only seen as sampled.
+  trigger_fd_ = open(kPressurePath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (trigger_fd_ >= 0 &&
+      write(trigger_fd_, kPressureTrigger, sizeof(kPressureTrigger)) < 0) {
+    close(trigger_fd_);
+    trigger_fd_ = -1;
+  }
+  if (trigger_fd_ >= 0) {
+    watch_id_ = SysInfoScheduler::GetInstance().AddWatch(
+        trigger_fd_, SysInfoMemory::OnPressureEvent, this, G_IO_PRI);
+  }
+  StartSampling(system_info::default_timeout_interval);
+}
+
+void SysInfoMemory::StopListening() {
+  StopSampling();
+  if (watch_id_ > 0) {
+    SysInfoScheduler::GetInstance().Remove(watch_id_);
+    watch_id_ = 0;
+  }
+  if (trigger_fd_ >= 0) {
+    close(trigger_fd_);
+    trigger_fd_ = -1;
+  }
+}
+
+bool SysInfoMemory::Update() {
+  char buffer[4096];
+  if (!ReadFile(meminfo_fd_, buffer, sizeof(buffer)) ||
+      !GetMeminfoValue(buffer, "MemTotal", &capacity_) || capacity_ == 0)
+    return false;
+
+  // MemAvailable is only known since Linux 3.14.
+  if (!GetMeminfoValue(buffer, "MemAvailable", &available_capacity_)) {
+    uint64_t free = 0;
+    uint64_t buffers = 0;
+    uint64_t cached = 0;
+    GetMeminfoValue(buffer, "MemFree", &free);
+    GetMeminfoValue(buffer, "Buffers", &buffers);
+    GetMeminfoValue(buffer, "Cached", &cached);
+    available_capacity_ = std::min(capacity_, free + buffers + cached);
+  }
+
+  UpdateCgroups();
+  UpdatePressure();
+
+  double available = static_cast<double>(available_capacity_) / capacity_;
+  if (cgroup_limit_ > 0) {
+    uint64_t left = cgroup_limit_ - std::min(cgroup_usage_, cgroup_limit_);
+    available = std::min(available,
+                         static_cast<double>(left) / cgroup_limit_);
+  }
+  load_ = 1.0 - available;
+
+  if (available < kCriticalAvailable || pressure_full_ >= kCriticalPressure)
+    status_ = "CRITICAL";
+  else if (available < kWarningAvailable ||
+           pressure_some_ >= kWarningPressure)
+    status_ = "WARNING";
+  else
+    status_ = "NORMAL";
+  return true;
+}
+
+void SysInfoMemory::UpdateCgroups() {
+  cgroup_usage_ = 0;
+  cgroup_limit_ = 0;
+
+  uint64_t least_left = 0;
+  for (size_t i = 0; i < cgroups_.size(); ++i) {
+    char buffer[32];
+    // memory.max is "max" without a limit.
+    if (!ReadFile(cgroups_[i].max_fd, buffer, sizeof(buffer)) ||
+        !isdigit(buffer[0]))
+      continue;
+    uint64_t limit = strtoull(buffer, NULL, 10);
+    if (!ReadFile(cgroups_[i].current_fd, buffer, sizeof(buffer)))
+      continue;
+    uint64_t usage = strtoull(buffer, NULL, 10);
+
+    uint64_t left = limit - std::min(usage, limit);
+    if (cgroup_limit_ == 0 || left < least_left) {
+      cgroup_usage_ = usage;
+      cgroup_limit_ = limit;
+      least_left = left;
+    }
+  }
+}
+
+void SysInfoMemory::UpdatePressure() {
+  char buffer[256];
+  if (!ReadFile(pressure_fd_, buffer, sizeof(buffer))) {
+    pressure_some_ = 0.0;
+    pressure_full_ = 0.0;
+    return;
+  }
+  pressure_some_ = GetPressure(buffer, "some");
+  pressure_full_ = GetPressure(buffer, "full");
+}
+
+void SysInfoMemory::SetData(picojson::value& data) {
+  system_info::SetPicoJsonObjectValue(data, "capacity",
+      picojson::value(static_cast<double>(capacity_)));
+  system_info::SetPicoJsonObjectValue(data, "availableCapacity",
+      picojson::value(static_cast<double>(available_capacity_)));
+  if (cgroup_limit_ > 0) {
+    system_info::SetPicoJsonObjectValue(data, "cgroupUsage",
+        picojson::value(static_cast<double>(cgroup_usage_)));
+    system_info::SetPicoJsonObjectValue(data, "cgroupLimit",
+        picojson::value(static_cast<double>(cgroup_limit_)));
+  }
+  system_info::SetPicoJsonObjectValue(data, "pressureSome",
+      picojson::value(pressure_some_));
+  system_info::SetPicoJsonObjectValue(data, "pressureFull",
+      picojson::value(pressure_full_));
+  system_info::SetPicoJsonObjectValue(data, "load", picojson::value(load_));
+  system_info::SetPicoJsonObjectValue(data, "status",
+      picojson::value(status_));
+}
+
+void SysInfoMemory::Sample() {
+  double old_load = load_;
+  const char* old_status = status_;
+  double old_pressure_some = pressure_some_;
+  if (!Update()) {
+    // Fail to update, wait for next round
+    return;
+  }
+
+  if (old_status != status_ ||
+      fabs(old_pressure_some - pressure_some_) >= kPressureStep ||
+      fabs(old_load - load_) >= kLoadStep) {
+    picojson::value output = picojson::value(picojson::object());
+    picojson::value data = picojson::value(picojson::object());
+
+    SetData(data);
+    system_info::SetPicoJsonObjectValue(output, "cmd",
+        picojson::value("SystemInfoPropertyValueChanged"));
+    system_info::SetPicoJsonObjectValue(output, "prop",
+        picojson::value("MEMORY"));
+    system_info::SetPicoJsonObjectValue(output, "data", data);
+
+    PostMessageToListeners(output);
+  } else {
+    // Keep the values of the last change, so that slow drifts are told.
+    load_ = old_load;
+    pressure_some_ = old_pressure_some;
+  }
+}
+
+// static
+void SysInfoMemory::OnPressureEvent(void* data) {
+  static_cast<SysInfoMemory*>(data)->Sample();
+}
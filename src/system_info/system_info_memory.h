@@ -0,0 +1,72 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SYSTEM_INFO_SYSTEM_INFO_MEMORY_H_
+#define SYSTEM_INFO_SYSTEM_INFO_MEMORY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "common/picojson.h"
+#include "common/utils.h"
+#include "system_info/system_info_instance.h"
+#include "system_info/system_info_utils.h"
+
+// The memory left to this process, from /proc/meminfo and from the limits of
+// its cgroups when they are v2, and how much the system stalls on memory as
+// told by the pressure stall information (PSI) of /proc/pressure/memory.
+// Listeners are told as soon as the stalls pass a trigger, besides the
+// samples.
+class SysInfoMemory : public SysInfoObject {
+ public:
+  static SysInfoObject& GetInstance() {
+    static SysInfoMemory instance;
+    return instance;
+  }
+  ~SysInfoMemory();
+  void Get(picojson::value& error, picojson::value& data);
+  void StartListening();
+  void StopListening();
+
+  static const std::string name_;
+
+ private:
+  // The memory.current and memory.max of a cgroup.
+  struct CgroupFiles {
+    int current_fd;
+    int max_fd;
+  };
+
+  SysInfoMemory();
+  void OpenCgroups();
+  bool Update();
+  void UpdateCgroups();
+  void UpdatePressure();
+  void SetData(picojson::value& data);
+  void Sample();
+  static void OnPressureEvent(void* data);
+
+  int meminfo_fd_;
+  int pressure_fd_;
+  // The cgroup of this process and those above it, which all limit it.
+  std::vector<CgroupFiles> cgroups_;
+  int trigger_fd_;
+  int watch_id_;
+
+  uint64_t capacity_;
+  uint64_t available_capacity_;
+  // Of the cgroup with the least memory left, 0 without a limit.
+  uint64_t cgroup_usage_;
+  uint64_t cgroup_limit_;
+  double pressure_some_;
+  double pressure_full_;
+  double load_;
+  const char* status_;
+
+  DISALLOW_COPY_AND_ASSIGN(SysInfoMemory);
+};
+
+#endif  // SYSTEM_INFO_SYSTEM_INFO_MEMORY_H_
@@ -0,0 +1,177 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "system_info/system_info_scheduler.h"
+
+#include <vector>
+
+#include "system_info/system_info_utils.h"
+
+namespace {
+
+// Timers due this soon run with the ones being fired, rather than waking the
+// process up again right after.
+const int64_t kTickSlackMs = 50;
+
+// The first multiple of |interval| past |time|.
+int64_t NextTick(int64_t time, unsigned interval) {
+  return (time / interval + 1) * interval;
+}
+
+}  // namespace
+
+SysInfoScheduler& SysInfoScheduler::GetInstance() {
+  // Never destroyed, the SysInfoObjects stop their samplers from their
+  // destructors.
+  static SysInfoScheduler* instance = new SysInfoScheduler;
+  return *instance;
+}
+
+SysInfoScheduler::SysInfoScheduler()
+    : next_id_(1),
+      tick_source_id_(0),
+      tick_due_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+SysInfoScheduler::~SysInfoScheduler() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+int SysInfoScheduler::AddTimer(unsigned interval, Callback callback,
+                               void* data) {
+  AutoLock lock(&mutex_);
+  int64_t now = Now();
+  Timer timer = { interval, NextTick(now, interval), callback, data };
+  int id = next_id_++;
+  timers_[id] = timer;
+  Arm(now);
+  return id;
+}
+
+void SysInfoScheduler::SetInterval(int id, unsigned interval) {
+  AutoLock lock(&mutex_);
+  std::map<int, Timer>::iterator it = timers_.find(id);
+  if (it == timers_.end() || it->second.interval == interval)
+    return;
+
+  int64_t now = Now();
+  it->second.interval = interval;
+  it->second.due = NextTick(now, interval);
+  Arm(now);
+}
+
+int SysInfoScheduler::AddWatch(int fd, Callback callback, void* data,
+                               GIOCondition condition) {
+  AutoLock lock(&mutex_);
+  int id = next_id_++;
+  Watch watch;
+  watch.channel = g_io_channel_unix_new(fd);
+  watch.source_id = g_io_add_watch(watch.channel, condition,
+                                   SysInfoScheduler::OnWatchReady,
+                                   GINT_TO_POINTER(id));
+  watch.callback = callback;
+  watch.data = data;
+  watches_[id] = watch;
+  return id;
+}
+
+void SysInfoScheduler::Remove(int id) {
+  AutoLock lock(&mutex_);
+  std::map<int, Watch>::iterator watch = watches_.find(id);
+  if (watch != watches_.end()) {
+    g_source_remove(watch->second.source_id);
+    g_io_channel_unref(watch->second.channel);
+    watches_.erase(watch);
+    return;
+  }
+
+  if (timers_.erase(id))
+    Arm(Now());
+}
+
+void SysInfoScheduler::Arm(int64_t now) {
+  if (timers_.empty()) {
+    if (tick_source_id_ > 0) {
+      g_source_remove(tick_source_id_);
+      tick_source_id_ = 0;
+    }
+    return;
+  }
+
+  int64_t due = timers_.begin()->second.due;
+  for (std::map<int, Timer>::const_iterator it = timers_.begin();
+       it != timers_.end(); ++it) {
+    if (it->second.due < due)
+      due = it->second.due;
+  }
+
+  if (tick_source_id_ > 0) {
+    if (tick_due_ == due)
+      return;
+    g_source_remove(tick_source_id_);
+  }
+  tick_due_ = due;
+  tick_source_id_ = g_timeout_add(due > now ? due - now : 0,
+                                  SysInfoScheduler::OnTick, this);
+}
+
+void SysInfoScheduler::Run(int id) {
+  Callback callback;
+  void* data;
+  {
+    AutoLock lock(&mutex_);
+    std::map<int, Timer>::const_iterator timer = timers_.find(id);
+    std::map<int, Watch>::const_iterator watch = watches_.find(id);
+    if (timer != timers_.end()) {
+      callback = timer->second.callback;
+      data = timer->second.data;
+    } else if (watch != watches_.end()) {
+      callback = watch->second.callback;
+      data = watch->second.data;
+    } else {
+      return;
+    }
+  }
+  callback(data);
+}
+
+// static
+int64_t SysInfoScheduler::Now() {
+  return g_get_monotonic_time() / 1000;
+}
+
+// static
+gboolean SysInfoScheduler::OnTick(gpointer data) {
+  SysInfoScheduler* scheduler = static_cast<SysInfoScheduler*>(data);
+  std::vector<int> due;
+  {
+    AutoLock lock(&scheduler->mutex_);
+    // Unless it was replaced while firing, this timeout is done.
+    if (scheduler->tick_source_id_ == g_source_get_id(g_main_current_source()))
+      scheduler->tick_source_id_ = 0;
+
+    int64_t now = Now();
+    for (std::map<int, Timer>::iterator it = scheduler->timers_.begin();
+         it != scheduler->timers_.end(); ++it) {
+      if (it->second.due > now + kTickSlackMs)
+        continue;
+      due.push_back(it->first);
+      it->second.due = NextTick(now + kTickSlackMs, it->second.interval);
+    }
+    scheduler->Arm(now);
+  }
+
+  for (size_t i = 0; i < due.size(); ++i)
+    scheduler->Run(due[i]);
+  return FALSE;
+}
+
+// static
+gboolean SysInfoScheduler::OnWatchReady(GIOChannel* channel,
+                                        GIOCondition condition,
+                                        gpointer data) {
+  GetInstance().Run(GPOINTER_TO_INT(data));
+  return TRUE;
+}
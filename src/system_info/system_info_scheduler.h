@@ -0,0 +1,78 @@
+// Copyright (c) 2014 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SYSTEM_INFO_SYSTEM_INFO_SCHEDULER_H_
+#define SYSTEM_INFO_SYSTEM_INFO_SCHEDULER_H_
+
+// Runs the samplers of the SysInfoObjects on the glib main loop. The timers
+// fire on the multiples of their interval, all from a single glib timeout,
+// so that the samplers wake the process up together rather than each on its
+// own. Descriptors of event sources such as udev monitors and inotify are
+// watched for the properties which do not need polling.
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <map>
+
+#include "common/utils.h"
+
+class SysInfoScheduler {
+ public:
+  typedef void (*Callback)(void* data);
+
+  static SysInfoScheduler& GetInstance();
+
+  // Calls |callback| every |interval| ms, until Remove(). Timers with
+  // intervals which are multiples of each other fire on the same ticks.
+  int AddTimer(unsigned interval, Callback callback, void* data);
+  void SetInterval(int id, unsigned interval);
+
+  // Calls |callback| when |fd| is readable, or meets |condition|, until
+  // Remove(). The descriptor stays owned by the caller.
+  int AddWatch(int fd, Callback callback, void* data,
+               GIOCondition condition = G_IO_IN);
+
+  void Remove(int id);
+
+ private:
+  struct Timer {
+    unsigned interval;
+    int64_t due;
+    Callback callback;
+    void* data;
+  };
+
+  struct Watch {
+    GIOChannel* channel;
+    guint source_id;
+    Callback callback;
+    void* data;
+  };
+
+  SysInfoScheduler();
+  ~SysInfoScheduler();
+
+  // Sets the glib timeout for the earliest timer. Called with |mutex_| held.
+  void Arm(int64_t now);
+  // Calls the timer or watch |id| if it was not removed meanwhile.
+  void Run(int id);
+
+  static int64_t Now();
+  static gboolean OnTick(gpointer data);
+  static gboolean OnWatchReady(GIOChannel* channel, GIOCondition condition,
+                               gpointer data);
+
+  pthread_mutex_t mutex_;
+  int next_id_;
+  std::map<int, Timer> timers_;
+  std::map<int, Watch> watches_;
+  guint tick_source_id_;
+  int64_t tick_due_;
+
+  DISALLOW_COPY_AND_ASSIGN(SysInfoScheduler);
+};
+
+#endif  // SYSTEM_INFO_SYSTEM_INFO_SCHEDULER_H_
@@ -13,7 +13,7 @@ SysInfoStorage::SysInfoStorage()
       udev_(udev_new()),
       udev_monitor_(NULL),
       udev_monitor_fd_(-1),
-      timeout_cb_id_(0) {
+      watch_id_(0) {
   units_ = picojson::value(picojson::array(0));
   InitStorageMonitor();
   QueryAllAvailableStorageUnits();
@@ -26,10 +26,6 @@ SysInfoStorage::~SysInfoStorage() {
     udev_monitor_unref(udev_monitor_);
   if (udev_)
     udev_unref(udev_);
-  if (timeout_cb_id_ > 0) {
-    g_source_remove(timeout_cb_id_);
-    timeout_cb_id_ = 0;
-  }
 }
 
 void SysInfoStorage::Get(picojson::value& error,
@@ -61,6 +57,28 @@ void SysInfoStorage::GetAllAvailableStorageDevices() {
   }
 }
 
+void SysInfoStorage::WriteAllAvailableStorageDevices(
+    common::JsonWriter* writer) {
+  writer->BeginArray();
+  std::map<int, SysInfoDeviceStorageUnit>::const_iterator it;
+  for (it = storages_.begin(); it != storages_.end(); ++it) {
+    writer->BeginObject();
+    writer->Key("type");
+    writer->String(ToStorageUnitTypeString(it->second.type));
+    writer->Key("capacity");
+    writer->Number(it->second.capacity);
+    writer->Key("availableCapacity");
+    writer->Number(it->second.available_capacity);
+    writer->Key("isRemovable");
+    writer->Bool(it->second.is_removable);
+    // Attribute 'isRemoveable' is deprecated. A typographic error.
+    writer->Key("isRemoveable");
+    writer->Bool(it->second.is_removable);
+    writer->EndObject();
+  }
+  writer->EndArray();
+}
+
 void SysInfoStorage::InitStorageMonitor() {
   if (!udev_) {
     std::cout << "Failed to create udev \n";
@@ -140,23 +158,8 @@ std::string SysInfoStorage::ToStorageUnitTypeString(StorageUnitType type) {
 }
 
 void SysInfoStorage::UpdateStorageList() {
-  fd_set fds;
-  timeval tv;
-
-  FD_ZERO(&fds);
-  FD_SET(udev_monitor_fd_, &fds);
-  tv.tv_sec = 0;
-  tv.tv_usec = 0;
-
-  // select() will only operate on a single file descriptor, which is related
-  // to the udev_monitor. The timeval object is set to 0 for not blocking
-  // select().
-  int ret = select(udev_monitor_fd_ + 1, &fds, NULL, NULL, &tv);
-  if (ret > 0 && FD_ISSET(udev_monitor_fd_, &fds)) {
-    udev_device* dev = udev_monitor_receive_device(udev_monitor_);
-    if (!dev)
-      return;
-
+  // The monitor does not block, this takes the pending uevents.
+  while (udev_device* dev = udev_monitor_receive_device(udev_monitor_)) {
     int dev_id = udev_device_get_devnum(dev);
     std::string action = udev_device_get_action(dev);
     if (action == "add") {
@@ -170,38 +173,38 @@ void SysInfoStorage::UpdateStorageList() {
   }
 }
 
-gboolean SysInfoStorage::OnUpdateTimeout(gpointer user_data) {
-  SysInfoStorage* instance = static_cast<SysInfoStorage*>(user_data);
+void SysInfoStorage::OnUdevEvent(void* data) {
+  SysInfoStorage* instance = static_cast<SysInfoStorage*>(data);
   int old_storage_count = instance->storages_.size();
   instance->UpdateStorageList();
   if (instance->storages_.size() == old_storage_count)
-    return TRUE;
-
-  instance->GetAllAvailableStorageDevices();
-  picojson::value output = picojson::value(picojson::object());
-  picojson::value data = picojson::value(picojson::object());
-
-  system_info::SetPicoJsonObjectValue(data, "units", instance->units_);
-  system_info::SetPicoJsonObjectValue(output, "cmd",
-      picojson::value("SystemInfoPropertyValueChanged"));
-  system_info::SetPicoJsonObjectValue(output, "prop",
-      picojson::value("STORAGE"));
-  system_info::SetPicoJsonObjectValue(output, "data", data);
-  instance->PostMessageToListeners(output);
-  return TRUE;
+    return;
+
+  common::JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("cmd");
+  writer.String("SystemInfoPropertyValueChanged");
+  writer.Key("prop");
+  writer.String("STORAGE");
+  writer.Key("data");
+  writer.BeginObject();
+  writer.Key("units");
+  instance->WriteAllAvailableStorageDevices(&writer);
+  writer.EndObject();
+  writer.EndObject();
+  instance->PostMessageToListeners(writer);
 }
 
 void SysInfoStorage::StartListening() {
-  if (timeout_cb_id_ == 0) {
-    timeout_cb_id_ = g_timeout_add(system_info::default_timeout_interval,
-                                   SysInfoStorage::OnUpdateTimeout,
-                                   static_cast<gpointer>(this));
+  if (watch_id_ == 0 && udev_monitor_fd_ >= 0) {
+    watch_id_ = SysInfoScheduler::GetInstance().AddWatch(
+        udev_monitor_fd_, SysInfoStorage::OnUdevEvent, this);
   }
 }
 
 void SysInfoStorage::StopListening() {
-  if (timeout_cb_id_ > 0) {
-    g_source_remove(timeout_cb_id_);
-    timeout_cb_id_ = 0;
+  if (watch_id_ > 0) {
+    SysInfoScheduler::GetInstance().Remove(watch_id_);
+    watch_id_ = 0;
   }
 }
@@ -5,12 +5,12 @@
 #ifndef SYSTEM_INFO_SYSTEM_INFO_STORAGE_H_
 #define SYSTEM_INFO_SYSTEM_INFO_STORAGE_H_
 
-#include <glib.h>
 #include <libudev.h>
 
 #include <map>
 #include <string>
 
+#include "common/json_writer.h"
 #include "common/picojson.h"
 #include "common/utils.h"
 #include "system_info/system_info_instance.h"
@@ -47,14 +47,17 @@ class SysInfoStorage : public SysInfoObject {
  private:
   SysInfoStorage();
   void GetAllAvailableStorageDevices();
+  // Same as GetAllAvailableStorageDevices(), written straight into |writer|
+  // for change notifications.
+  void WriteAllAvailableStorageDevices(common::JsonWriter* writer);
   void InitStorageMonitor();
   void QueryAllAvailableStorageUnits();
   bool MakeStorageUnit(SysInfoDeviceStorageUnit& unit, udev_device* dev) const;
   std::string ToStorageUnitTypeString(StorageUnitType type);
   void UpdateStorageList();
-  static gboolean OnUpdateTimeout(gpointer user_data);
+  static void OnUdevEvent(void* data);
 
-  int timeout_cb_id_;
+  int watch_id_;
   int udev_monitor_fd_;
   picojson::value units_;
   udev* udev_;
@@ -170,6 +170,32 @@ std::string GetUdevProperty(struct udev_device* dev,
   return std::string(udev_list_entry_get_value(attr_entry));
 }
 
+udev_monitor* NewUdevMonitor(udev* udev, const char* subsystem) {
+  if (!udev)
+    return NULL;
+
+  udev_monitor* monitor = udev_monitor_new_from_netlink(udev, "udev");
+  if (!monitor)
+    return NULL;
+
+  if (udev_monitor_filter_add_match_subsystem_devtype(monitor, subsystem,
+                                                      NULL) < 0 ||
+      udev_monitor_enable_receiving(monitor) < 0) {
+    udev_monitor_unref(monitor);
+    return NULL;
+  }
+  return monitor;
+}
+
+bool DrainUdevMonitor(udev_monitor* monitor) {
+  bool drained = false;
+  while (udev_device* dev = udev_monitor_receive_device(monitor)) {
+    udev_device_unref(dev);
+    drained = true;
+  }
+  return drained;
+}
+
 void SetPicoJsonObjectValue(picojson::value& obj,
                             const char* prop,
                             const picojson::value& val) {
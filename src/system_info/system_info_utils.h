@@ -29,6 +29,11 @@ namespace system_info {
 
 // The default timeout interval is set to 1s to match the top update interval.
 const int default_timeout_interval = 1000;
+// Properties with change events are still sampled this often, for the
+// changes which come without one.
+const int event_fallback_interval = 30000;
+// Listeners cannot have their property sampled more often than this.
+const int min_timeout_interval = 100;
 #ifdef TIZEN
 char* GetDuidProperty();
 #ifndef TIZEN_MOBILE
@@ -50,6 +55,11 @@ int ReadOneByte(const char* path);
 char* ReadOneLine(const char* path);
 std::string GetUdevProperty(struct udev_device* dev,
                               const std::string& attr);
+// Returns a monitor receiving the uevents of the devices of |subsystem|,
+// or NULL. Its descriptor does not block.
+udev_monitor* NewUdevMonitor(udev* udev, const char* subsystem);
+// Drops the uevents pending on |monitor|, returns whether there were any.
+bool DrainUdevMonitor(udev_monitor* monitor);
 void SetPicoJsonObjectValue(picojson::value& obj,
                             const char* prop,
                             const picojson::value& val);
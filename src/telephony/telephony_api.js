@@ -181,8 +181,7 @@ function rejectPromise(msg) {
 }
 
 // Handle replies and notifications from native extension code.
-extension.setMessageListener(function(json) {
-  var msg = JSON.parse(json);
+var handleMessage = function(msg) {
   switch (msg.cmd) {
     // Event notifications.
     case 'activeCallChanged':
@@ -247,8 +246,12 @@ extension.setMessageListener(function(json) {
       msg.isError ? rejectPromise(msg) : resolvePromise(msg);
       break;
     default:
-      error('Invalid message from extension: ' + json);
+      error('Invalid message from extension: ' + JSON.stringify(msg));
   }
+};
+
+extension.setMessageListener(function(json) {
+  xwalk.utils.dispatchMessages(json, handleMessage);
 });
 
 function enableBackendNotifications() {
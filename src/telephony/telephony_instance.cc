@@ -34,9 +34,14 @@ const char kCmdGetParticipants[] = "getParticipants";
 const char kCmdEnableNotifications[] = "enableNotifications";
 const char kCmdDisableNotifications[] = "disableNotifications";
 
+// Call state changes of a conference are notified call by call.
+const unsigned kMessageBatchWindowMs = 16;
+const size_t kMaxMessageBatchBytes = 64 * 1024;
+
 }  // namespace
 
 TelephonyInstance::TelephonyInstance() : backend_(new TelephonyBackend(this)) {
+  EnableMessageBatching(kMessageBatchWindowMs, kMaxMessageBatchBytes);
 }
 
 TelephonyInstance::~TelephonyInstance() {
@@ -8,6 +8,7 @@
 #include <vconf.h>
 #endif
 
+#include <functional>
 #include <sstream>
 #include <string>
 #include <memory>
@@ -28,49 +29,41 @@ const int _hourInMilliseconds = 3600000;
 
 }  // namespace
 
-TimeInstance::TimeInstance() {}
+TimeInstance::TimeInstance() {
+  using std::placeholders::_1;
 
-TimeInstance::~TimeInstance() {}
+#define REGISTER_SYNC(c, x) \
+  RegisterTimeHandler(c, std::bind(&TimeInstance::x, this, _1));
 
-void TimeInstance::HandleMessage(const char* message) {}
+  REGISTER_SYNC("GetLocalTimeZone", HandleGetLocalTimeZone);
+  REGISTER_SYNC("GetAvailableTimeZones", HandleGetAvailableTimeZones);
+  REGISTER_SYNC("GetTimeZoneOffset", HandleGetTimeZoneOffset);
+  REGISTER_SYNC("GetTimeZoneAbbreviation", HandleGetTimeZoneAbbreviation);
+  REGISTER_SYNC("IsDST", HandleIsDST);
+  REGISTER_SYNC("GetDSTTransition", HandleGetDSTTransition);
+  REGISTER_SYNC("GetTimeFormat", HandleGetTimeFormat);
 
-void TimeInstance::HandleSyncMessage(const char* message) {
-  picojson::value v;
+#undef REGISTER_SYNC
 
-  std::string err;
-  picojson::parse(v, message, message + strlen(message), &err);
-  if (!err.empty()) {
-    std::cout << "Ignoring Sync message.\n";
-    return;
-  }
+  RegisterTimeHandler("ToDateString", std::bind(&TimeInstance::HandleToString,
+                      this, _1, TimeInstance::DATE_FORMAT));
+  RegisterTimeHandler("ToTimeString", std::bind(&TimeInstance::HandleToString,
+                      this, _1, TimeInstance::TIME_FORMAT));
+  RegisterTimeHandler("ToString", std::bind(&TimeInstance::HandleToString,
+                      this, _1, TimeInstance::DATETIME_FORMAT));
+}
 
-  std::string cmd = v.get("cmd").to_str();
-  picojson::value::object o;
-  if (cmd == "GetLocalTimeZone")
-    o = HandleGetLocalTimeZone(v);
-  else if (cmd == "GetAvailableTimeZones")
-    o = HandleGetAvailableTimeZones(v);
-  else if (cmd == "GetTimeZoneOffset")
-    o = HandleGetTimeZoneOffset(v);
-  else if (cmd == "GetTimeZoneAbbreviation")
-    o = HandleGetTimeZoneAbbreviation(v);
-  else if (cmd == "IsDST")
-    o = HandleIsDST(v);
-  else if (cmd == "GetDSTTransition")
-    o = HandleGetDSTTransition(v);
-  else if (cmd == "ToDateString")
-    o = HandleToString(v, TimeInstance::DATE_FORMAT);
-  else if (cmd == "ToTimeString")
-    o = HandleToString(v, TimeInstance::TIME_FORMAT);
-  else if (cmd == "ToString")
-    o = HandleToString(v, TimeInstance::DATETIME_FORMAT);
-  else if (cmd == "GetTimeFormat")
-    o = HandleGetTimeFormat(v);
-
-  if (o.empty())
-    o["error"] = picojson::value(true);
-
-  SendSyncReply(picojson::value(o).serialize().c_str());
+TimeInstance::~TimeInstance() {}
+
+void TimeInstance::RegisterTimeHandler(const char* cmd,
+                                       const TimeHandler& handler) {
+  RegisterSyncHandler(cmd,
+      [handler](const picojson::value& msg, std::string& reply) {
+    picojson::value::object o = handler(msg);
+    if (o.empty())
+      o["error"] = picojson::value(true);
+    reply = picojson::value(o).serialize();
+  });
 }
 
 const picojson::value::object TimeInstance::HandleGetLocalTimeZone(
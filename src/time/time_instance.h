@@ -5,6 +5,8 @@
 #ifndef TIME_TIME_INSTANCE_H_
 #define TIME_TIME_INSTANCE_H_
 
+#include <functional>
+
 #include "common/extension.h"
 #include "common/picojson.h"
 #include "unicode/unistr.h"
@@ -15,9 +17,12 @@ class TimeInstance : public common::Instance {
   virtual ~TimeInstance();
 
  private:
-  // common::Instance implementation.
-  virtual void HandleMessage(const char* msg);
-  virtual void HandleSyncMessage(const char* msg);
+  typedef std::function<const picojson::value::object(const picojson::value&)>
+      TimeHandler;
+
+  // Registers a sync handler whose result object is sent as the reply, or
+  // an error object if the handler returned an empty one.
+  void RegisterTimeHandler(const char* cmd, const TimeHandler& handler);
 
   enum DateTimeFormatType {
     TIME_FORMAT,
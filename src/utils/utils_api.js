@@ -47,4 +47,54 @@ Utils.prototype.validateObject = function(object, signature, attributes) {
   return true;
 };
 
+// Native events may be sent batched in an array, see
+// common::Instance::EnableMessageBatching(). Calls |handler| with each of the
+// messages of |json|. A handler throwing does not drop the rest of the batch,
+// the exception is rethrown once they are all handled.
+Utils.prototype.dispatchMessages = function(json, handler) {
+  var msg = JSON.parse(json);
+  if (!Array.isArray(msg)) {
+    handler(msg);
+    return;
+  }
+
+  msg.forEach(function(m) {
+    try {
+      handler(m);
+    } catch (e) {
+      setTimeout(function() { throw e; }, 0);
+    }
+  });
+};
+
+// Parses a message from the native side. Those posted with
+// common::Instance::PostBinaryMessage() come as an ArrayBuffer holding the
+// JSON header, a NUL byte and the data, or as JSON with the data in base64
+// under "binary". Either way the data is given under "binary" as a
+// Uint8Array.
+Utils.prototype.parseMessage = function(message) {
+  var msg;
+  var bytes;
+  if (message instanceof ArrayBuffer) {
+    var buffer = new Uint8Array(message);
+    var nul = Array.prototype.indexOf.call(buffer, 0);
+    if (nul < 0)
+      nul = buffer.length;
+    // The header is UTF-8.
+    msg = JSON.parse(decodeURIComponent(escape(
+        String.fromCharCode.apply(null, buffer.subarray(0, nul)))));
+    bytes = buffer.subarray(nul + 1);
+  } else {
+    msg = JSON.parse(message);
+    if (typeof msg.binary !== 'string')
+      return msg;
+    var data = atob(msg.binary);
+    bytes = new Uint8Array(data.length);
+    for (var i = 0; i < data.length; i++)
+      bytes[i] = data.charCodeAt(i);
+  }
+  msg.binary = bytes;
+  return msg;
+};
+
 exports = new Utils();
@@ -3,6 +3,12 @@
     'src/common/common.gypi',
   ],
 
+  'variables': {
+    # The message trace replay tool of src/bench, a development aid which is
+    # not packaged.
+    'extension_bench%': '0',
+  },
+
   'targets': [
     {
       'target_name': 'build_all_tizen_extensions',
@@ -52,6 +58,17 @@
         }],
       ],
     },
+    {
+      'target_name': 'build_extension_bench',
+      'type': 'none',
+      'conditions': [
+        [ 'extension_bench == 1', {
+          'dependencies': [
+            'src/bench/bench.gyp:*',
+          ],
+        }],
+      ],
+    },
     {
       'target_name': 'generate_manifest',
       'type': 'none',